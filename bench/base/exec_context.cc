@@ -0,0 +1,51 @@
+#include "bench.h"
+
+#include "os/exec_context.h"
+
+using namespace xynq;
+using namespace xynq::platform;
+
+namespace {
+
+static constexpr uint64_t kNumRoundTrips = 1000000;
+
+// Ping-pongs between the main context and a fiber.
+// Every round trip is two context switches.
+template<class Context>
+uint64_t SwitchPingPong() {
+    alignas(16) static char stack[64 * 1024];
+
+    struct State {
+        Context main;
+        Context fiber;
+        uint64_t counter = 0;
+        bool done = false;
+    } state;
+
+    state.fiber.Execute(state.main, stack, sizeof(stack), [](State *state) {
+        while (!state->done) {
+            ++state->counter;
+            state->fiber.Suspend();
+        }
+    }, &state);
+
+    for (uint64_t i = 1; i < kNumRoundTrips; ++i) {
+        state.fiber.Resume(state.main);
+    }
+
+    state.done = true;
+    state.fiber.Resume(state.main); // Let fiber finish.
+    return state.counter * 2;
+}
+
+} // anon namespace
+
+XYBenchmark(ExecContextSwitchUContext) {
+    return SwitchPingPong<UContextExecContext>();
+}
+
+#if defined(XYNQ_EXEC_CONTEXT_ASM)
+XYBenchmark(ExecContextSwitchAsm) {
+    return SwitchPingPong<AsmExecContext>();
+}
+#endif
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstdint>
+
+namespace xynq {
+namespace bench {
+
+// Benchmark body. Performs some operations and returns how many were done.
+// Harness measures wall time of the call and reports operations per second.
+using BenchFunc = uint64_t(*)();
+
+// Registers benchmark at static init time. Use XYBenchmark macro instead.
+struct BenchRegistrar {
+    BenchRegistrar(const char *name, BenchFunc func);
+};
+
+// Runs all registered benchmarks which names contain filter (or all if filter is null).
+// json: results are printed as a single json object once all benchmarks have finished
+// instead of a line per benchmark, so runs can be compared by scripts.
+// Returns number of benchmarks run.
+int RunAll(const char *filter, bool json);
+
+} // bench
+} // xynq
+
+// Defines and registers benchmark:
+//   XYBenchmark(Foo) {
+//       for (int i = 0; i < 1000; ++i) { ... }
+//       return 1000;
+//   }
+#define XYBenchmark(name) \
+    static uint64_t XYBench_##name(); \
+    static ::xynq::bench::BenchRegistrar XYBenchRegistrar_##name{#name, &XYBench_##name}; \
+    static uint64_t XYBench_##name()
@@ -0,0 +1,117 @@
+#include "bench.h"
+
+#include "base/output.h"
+#include "base/platform_def.h"
+#include "base/system_allocator.h"
+
+#include <chrono>
+#include <cstring>
+
+using namespace xynq;
+using namespace xynq::bench;
+
+namespace {
+
+struct BenchEntry {
+    const char *name = nullptr;
+    BenchFunc func = nullptr;
+};
+
+struct BenchResult {
+    const char *name = nullptr;
+    uint64_t num_ops = 0;
+    double sec = 0.0;
+};
+
+static constexpr int kMaxBenchmarks = 256;
+
+// Function-local statics: registrars run during static init in any order.
+BenchEntry *Benchmarks() {
+    static BenchEntry benchmarks[kMaxBenchmarks];
+    return benchmarks;
+}
+
+int &NumBenchmarks() {
+    static int num_benchmarks = 0;
+    return num_benchmarks;
+}
+
+double OpsPerSec(const BenchResult &result) {
+    return result.sec > 0.0 ? double(result.num_ops) / result.sec : 0.0;
+}
+
+double NsPerOp(const BenchResult &result) {
+    return result.num_ops > 0 ? result.sec * 1e9 / double(result.num_ops) : 0.0;
+}
+
+void OutputJson(const BenchResult *results, int num_results) {
+    XYOutput("{");
+    XYOutput("  \"flavour\": \"%s\",", XYNQ_BUILD_FLAVOUR);
+    XYOutput("  \"benchmarks\": [");
+    for (int i = 0; i < num_results; ++i) {
+        const BenchResult &result = results[i];
+        XYOutput("    {\"name\": \"%s\", \"ops\": %llu, \"time_ms\": %.3f, \"ops_per_sec\": %.0f, \"ns_per_op\": %.1f}%s",
+                 result.name,
+                 (unsigned long long)result.num_ops,
+                 result.sec * 1000.0,
+                 OpsPerSec(result),
+                 NsPerOp(result),
+                 i + 1 < num_results ? "," : "");
+    }
+    XYOutput("  ]");
+    XYOutput("}");
+}
+
+} // anon namespace
+
+BenchRegistrar::BenchRegistrar(const char *name, BenchFunc func) {
+    if (NumBenchmarks() < kMaxBenchmarks) {
+        Benchmarks()[NumBenchmarks()++] = BenchEntry{name, func};
+    }
+}
+
+int bench::RunAll(const char *filter, bool json) {
+    static BenchResult results[kMaxBenchmarks];
+
+    int num_run = 0;
+    for (int i = 0; i < NumBenchmarks(); ++i) {
+        const BenchEntry &entry = Benchmarks()[i];
+        if (filter != nullptr && strstr(entry.name, filter) == nullptr) {
+            continue;
+        }
+
+        auto before = std::chrono::steady_clock::now();
+        uint64_t num_ops = entry.func();
+        double sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - before).count();
+
+        BenchResult &result = results[num_run++];
+        result = BenchResult{entry.name, num_ops, sec};
+        if (!json) {
+            XYOutput("%-40s %12llu ops %10.3f ms %14.0f ops/s %10.1f ns/op",
+                     result.name,
+                     (unsigned long long)result.num_ops,
+                     result.sec * 1000.0,
+                     OpsPerSec(result),
+                     NsPerOp(result));
+        }
+    }
+
+    if (json) {
+        OutputJson(results, num_run);
+    }
+    return num_run;
+}
+
+// Usage: xynq_bench [--json] [name_filter]
+int main(int argc, char **argv) {
+    bool json = argc > 1 && strcmp(argv[1], "--json") == 0;
+    if (json) {
+        --argc;
+        ++argv;
+    }
+
+    SystemAllocator::Initialize();
+    int num_run = RunAll(argc > 1 ? argv[1] : nullptr, json);
+    SystemAllocator::Shutdown();
+    return num_run > 0 ? 0 : 1;
+}
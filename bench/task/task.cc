@@ -0,0 +1,246 @@
+#include "bench.h"
+
+#include "task/task_channel.h"
+#include "task/task_group.h"
+#include "task/task_manager.h"
+#include "task/task_semaphore.h"
+
+#include "base/log.h"
+
+#include <atomic>
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+using namespace xynq;
+
+namespace {
+
+static constexpr uint64_t kNumSpawns = 1000000;
+static constexpr uint64_t kSpawnBatch = 64; // Fits into task pool, so fibers are reused.
+static constexpr uint64_t kNumYields = 1000000;
+static constexpr uint64_t kNumRoundTrips = 20000;
+static constexpr uint64_t kNumStealTasks = 200000;
+static constexpr unsigned kNumFanInRounds = 2000;
+static constexpr unsigned kFanIn = 64;
+static constexpr size_t kNumThreads = 4;
+static constexpr uint64_t kMaxSpinUsec = 50;
+
+Dependable<Log> CreateLog() {
+    return Dependable<Log>{std::move(Log::Create(LogLevel::None, 0, {}).Right())};
+}
+
+struct EmptyTask : public TaskDefaults {
+    static constexpr auto exec = [](TaskContext *, uint64_t *counter) {
+        ++*counter;
+    };
+};
+
+// Single thread: spawned tasks run before the yielding parent is resumed.
+struct SpawnTest : public TaskDefaults {
+    static constexpr auto exec = [](TaskContext *tc, uint64_t *counter) {
+        for (uint64_t spawned = 0; spawned < kNumSpawns; spawned += kSpawnBatch) {
+            for (uint64_t i = 0; i < kSpawnBatch; ++i) {
+                tc->PerformAsync<EmptyTask>(counter);
+            }
+
+            while (*counter < spawned + kSpawnBatch) {
+                tc->Yield();
+            }
+        }
+        tc->Exit();
+    };
+};
+
+struct YieldTest : public TaskDefaults {
+    static constexpr auto exec = [](TaskContext *tc, int *num_running) {
+        for (uint64_t i = 0; i < kNumYields / 2; ++i) {
+            tc->Yield();
+        }
+
+        if (--*num_running == 0) {
+            tc->Exit();
+        }
+    };
+};
+
+// Pinned to different workers: every message resumes the task on the other worker.
+struct PingTask : public TaskDefaults {
+    static constexpr auto exec = [](TaskContext *tc, TaskChannel<uint64_t> *ping, TaskChannel<uint64_t> *pong) {
+        for (uint64_t i = 0; i < kNumRoundTrips; ++i) {
+            ping->Send(*tc, uint64_t{i});
+            pong->Receive(*tc);
+        }
+        tc->Exit();
+    };
+};
+
+struct PongTask : public TaskDefaults {
+    static constexpr auto exec = [](TaskContext *tc, TaskChannel<uint64_t> *ping, TaskChannel<uint64_t> *pong) {
+        for (uint64_t i = 0; i < kNumRoundTrips; ++i) {
+            Maybe<uint64_t> value = ping->Receive(*tc);
+            pong->Send(*tc, std::move(value.Value()));
+        }
+    };
+};
+
+struct StealChild : public TaskDefaults {
+    static constexpr auto exec = [](TaskContext *, std::atomic<uint64_t> *sink) {
+        // A bit of work, so thieves have a chance to catch up with the spawner.
+        uint64_t value = 0;
+        for (uint64_t i = 0; i < 256; ++i) {
+            value = value * 31 + i;
+        }
+        sink->fetch_add(value & 1, std::memory_order_relaxed);
+    };
+};
+
+// All tasks are spawned by a single worker, others only get them by stealing.
+struct StealTest : public TaskDefaults {
+    static constexpr auto exec = [](TaskContext *tc, std::atomic<uint64_t> *sink) {
+        TaskGroup group;
+        for (uint64_t i = 0; i < kNumStealTasks; ++i) {
+            group.Run<StealChild>(*tc, sink);
+        }
+        group.Wait(*tc);
+        tc->Exit();
+    };
+};
+
+// Bounces a byte over the socket pair: every hop is a WaitEvent wakeup.
+struct EventPing : public TaskDefaults {
+    static constexpr auto exec = [](TaskContext *tc, int sock) {
+        EventSource source{sock};
+        char byte = 0;
+        for (uint64_t i = 0; i < kNumRoundTrips; ++i) {
+            XYAssert(write(sock, &byte, 1) == 1);
+            tc->WaitEvent(&source, EventFlags::Read | EventFlags::ExactlyOnce);
+            XYAssert(read(sock, &byte, 1) == 1);
+        }
+        tc->Exit();
+    };
+};
+
+struct EventPong : public TaskDefaults {
+    static constexpr auto exec = [](TaskContext *tc, int sock) {
+        EventSource source{sock};
+        char byte = 0;
+        for (uint64_t i = 0; i < kNumRoundTrips; ++i) {
+            tc->WaitEvent(&source, EventFlags::Read | EventFlags::ExactlyOnce);
+            XYAssert(read(sock, &byte, 1) == 1);
+            XYAssert(write(sock, &byte, 1) == 1);
+        }
+    };
+};
+
+struct FanInChild : public TaskDefaults {
+    static constexpr auto exec = [](TaskContext *tc, TaskSemaphore *sem) {
+        sem->Signal(*tc);
+    };
+};
+
+struct FanInTest : public TaskDefaults {
+    static constexpr auto exec = [](TaskContext *tc) {
+        for (unsigned round = 0; round < kNumFanInRounds; ++round) {
+            TaskSemaphore sem{kFanIn};
+            for (unsigned i = 0; i < kFanIn; ++i) {
+                tc->PerformAsync<FanInChild>(&sem);
+            }
+            sem.Wait(*tc);
+        }
+        tc->Exit();
+    };
+};
+
+uint64_t CrossThreadPingPong(uint64_t max_spin_usec) {
+    Dependable<Log> log = CreateLog();
+    TaskManager task_manager(log, 10, 2, false, true, EventBackend::Epoll, false, max_spin_usec);
+
+    TaskChannel<uint64_t> ping{1};
+    TaskChannel<uint64_t> pong{1};
+    task_manager.AddPinnedEntryPoint<PingTask>(0, &ping, &pong);
+    task_manager.AddPinnedEntryPoint<PongTask>(1, &ping, &pong);
+    task_manager.Run();
+    return kNumRoundTrips;
+}
+
+uint64_t WaitEventRoundTrip(uint64_t max_spin_usec) {
+    int socks[2];
+    XYAssert(socketpair(AF_UNIX, SOCK_STREAM, 0, socks) == 0);
+
+    {
+        Dependable<Log> log = CreateLog();
+        TaskManager task_manager(log, 10, 2, false, true, EventBackend::Epoll, false, max_spin_usec);
+        task_manager.AddEntryPoint<EventPing>(socks[0]);
+        task_manager.AddEntryPoint<EventPong>(socks[1]);
+        task_manager.Run();
+    }
+
+    close(socks[0]);
+    close(socks[1]);
+    return kNumRoundTrips;
+}
+
+} // anon namespace
+
+// Fiber creation, run and recycling on a single worker.
+XYBenchmark(TaskSpawnDestroy) {
+    Dependable<Log> log = CreateLog();
+    TaskManager task_manager(log, 10, 1, false, true);
+
+    uint64_t counter = 0;
+    task_manager.AddEntryPoint<SpawnTest>(&counter);
+    task_manager.Run();
+    return counter;
+}
+
+// Yield of one task resumes the other one on the same worker.
+XYBenchmark(TaskYieldPingPong) {
+    Dependable<Log> log = CreateLog();
+    TaskManager task_manager(log, 10, 1, false, true);
+
+    int num_running = 2;
+    task_manager.AddEntryPoint<YieldTest>(&num_running);
+    task_manager.AddEntryPoint<YieldTest>(&num_running);
+    task_manager.Run();
+    return kNumYields;
+}
+
+// Round trips between tasks on different workers. ns/op is the round trip latency.
+XYBenchmark(TaskCrossThreadPingPongPark) {
+    return CrossThreadPingPong(0);
+}
+
+XYBenchmark(TaskCrossThreadPingPongSpin) {
+    return CrossThreadPingPong(kMaxSpinUsec);
+}
+
+// Tasks spawned by a single worker and spread over the others by stealing.
+XYBenchmark(TaskStealThroughput) {
+    Dependable<Log> log = CreateLog();
+    TaskManager task_manager(log, 10, kNumThreads, false, true, EventBackend::Epoll, false, kMaxSpinUsec);
+
+    std::atomic<uint64_t> sink{0};
+    task_manager.AddEntryPoint<StealTest>(&sink);
+    task_manager.Run();
+    return kNumStealTasks;
+}
+
+// Round trips of a byte over a socket pair, every hop wakes the waiting task up.
+XYBenchmark(TaskWaitEventRoundTripPark) {
+    return WaitEventRoundTrip(0);
+}
+
+XYBenchmark(TaskWaitEventRoundTripSpin) {
+    return WaitEventRoundTrip(kMaxSpinUsec);
+}
+
+// Many tasks signal a semaphore a single task waits on.
+XYBenchmark(TaskSemaphoreFanIn) {
+    Dependable<Log> log = CreateLog();
+    TaskManager task_manager(log, 10, kNumThreads, false, true, EventBackend::Epoll, false, kMaxSpinUsec);
+
+    task_manager.AddEntryPoint<FanInTest>();
+    task_manager.Run();
+    return uint64_t(kNumFanInRounds) * kFanIn;
+}
@@ -3,6 +3,7 @@
 #include "assert.h"
 
 #include <cstdint>
+#include <new>
 #include <stddef.h>
 #include <utility>
 
@@ -0,0 +1,152 @@
+#include "os/exec_context.h"
+
+#include <cstdint>
+#include <cstring>
+
+#if defined(XYNQ_EXEC_CONTEXT_ASM)
+
+using namespace xynq;
+using namespace xynq::platform;
+
+// Entry trampoline: first switch into a new stack "returns" here
+// with entry function and its argument restored into callee-saved registers.
+#if defined(__x86_64__)
+
+// Stack layout of a suspended context (from sp upwards):
+//   fpu control word, mxcsr, r15, r14, r13, r12, rbx, rbp, return address.
+asm(R"(
+    .text
+    .globl xynq_exec_context_switch
+    .type xynq_exec_context_switch,@function
+    .align 16
+xynq_exec_context_switch:
+    pushq %rbp
+    pushq %rbx
+    pushq %r12
+    pushq %r13
+    pushq %r14
+    pushq %r15
+    subq $16, %rsp
+    stmxcsr 8(%rsp)
+    fnstcw (%rsp)
+    movq %rsp, (%rdi)
+    movq %rsi, %rsp
+    ldmxcsr 8(%rsp)
+    fldcw (%rsp)
+    addq $16, %rsp
+    popq %r15
+    popq %r14
+    popq %r13
+    popq %r12
+    popq %rbx
+    popq %rbp
+    ret
+    .size xynq_exec_context_switch,.-xynq_exec_context_switch
+
+    .globl xynq_exec_context_entry
+    .type xynq_exec_context_entry,@function
+    .align 16
+xynq_exec_context_entry:
+    movq %r13, %rdi
+    callq *%r12
+    ud2
+    .size xynq_exec_context_entry,.-xynq_exec_context_entry
+)");
+
+namespace {
+
+enum FrameSlot {
+    kSlotFpuCw = 0,
+    kSlotMxcsr,
+    kSlotR15,
+    kSlotR14,
+    kSlotArg,   // r13
+    kSlotEntry, // r12
+    kSlotRbx,
+    kSlotRbp,
+    kSlotReturn, // Stack top is 16-byte aligned after returning into entry trampoline.
+    kNumSlots
+};
+
+} // anon namespace
+
+#elif defined(__aarch64__)
+
+// Stack layout of a suspended context (from sp upwards):
+//   d8-d15, x19-x28, x29 (fp), x30 (lr).
+asm(R"(
+    .text
+    .globl xynq_exec_context_switch
+    .type xynq_exec_context_switch,%function
+    .align 4
+xynq_exec_context_switch:
+    sub sp, sp, #0xb0
+    stp d8, d9, [sp, #0x00]
+    stp d10, d11, [sp, #0x10]
+    stp d12, d13, [sp, #0x20]
+    stp d14, d15, [sp, #0x30]
+    stp x19, x20, [sp, #0x40]
+    stp x21, x22, [sp, #0x50]
+    stp x23, x24, [sp, #0x60]
+    stp x25, x26, [sp, #0x70]
+    stp x27, x28, [sp, #0x80]
+    stp x29, x30, [sp, #0x90]
+    mov x9, sp
+    str x9, [x0]
+    mov sp, x1
+    ldp d8, d9, [sp, #0x00]
+    ldp d10, d11, [sp, #0x10]
+    ldp d12, d13, [sp, #0x20]
+    ldp d14, d15, [sp, #0x30]
+    ldp x19, x20, [sp, #0x40]
+    ldp x21, x22, [sp, #0x50]
+    ldp x23, x24, [sp, #0x60]
+    ldp x25, x26, [sp, #0x70]
+    ldp x27, x28, [sp, #0x80]
+    ldp x29, x30, [sp, #0x90]
+    add sp, sp, #0xb0
+    ret
+    .size xynq_exec_context_switch,.-xynq_exec_context_switch
+
+    .globl xynq_exec_context_entry
+    .type xynq_exec_context_entry,%function
+    .align 4
+xynq_exec_context_entry:
+    mov x0, x20
+    blr x19
+    brk #0
+    .size xynq_exec_context_entry,.-xynq_exec_context_entry
+)");
+
+namespace {
+
+enum FrameSlot {
+    kSlotEntry = 8,   // x19
+    kSlotArg = 9,     // x20
+    kSlotReturn = 19, // x30
+    kNumSlots = 22    // 0xb0 bytes.
+};
+
+} // anon namespace
+
+#endif
+
+extern "C" void xynq_exec_context_entry();
+
+void *detail::MakeExecStack(void *stack_buf, size_t stack_size, void (*entry)(void *), void *arg) {
+    uintptr_t stack_top = (reinterpret_cast<uintptr_t>(stack_buf) + stack_size) & ~uintptr_t(15);
+    uint64_t *frame = reinterpret_cast<uint64_t *>(stack_top) - kNumSlots;
+    memset(frame, 0, sizeof(uint64_t) * kNumSlots);
+
+#if defined(__x86_64__)
+    // Default control words: all exceptions masked, round to nearest.
+    frame[kSlotFpuCw] = 0x037F;
+    frame[kSlotMxcsr] = 0x1F80;
+#endif
+    frame[kSlotEntry] = reinterpret_cast<uint64_t>(entry);
+    frame[kSlotArg] = reinterpret_cast<uint64_t>(arg);
+    frame[kSlotReturn] = reinterpret_cast<uint64_t>(&xynq_exec_context_entry);
+    return frame;
+}
+
+#endif // XYNQ_EXEC_CONTEXT_ASM
@@ -1,29 +1,38 @@
 #pragma once
 
+#include <cstddef>
+#include <tuple>
 #include <utility>
 
 #include <ucontext.h>
 
+// Hand-written context switch is available on x86-64 and aarch64.
+// Define XYNQ_EXEC_CONTEXT_UCONTEXT to force ucontext-based implementation.
+#if !defined(XYNQ_EXEC_CONTEXT_UCONTEXT) && (defined(__x86_64__) || defined(__aarch64__))
+    #define XYNQ_EXEC_CONTEXT_ASM 1
+#endif
+
 namespace xynq {
 namespace platform {
 
 // Linux ucontext_t based implementation of ExecContext.
-class ExecContext {
+// Every switch costs rt_sigprocmask syscall to save/restore signal mask.
+class UContextExecContext {
 public:
-    inline ExecContext() = default;
-    ExecContext(const ExecContext &) = delete;
-    ExecContext(ExecContext &&) = delete;
-    ExecContext& operator=(const ExecContext &) = delete;
-    ExecContext& operator=(ExecContext &&) = delete;
+    inline UContextExecContext() = default;
+    UContextExecContext(const UContextExecContext &) = delete;
+    UContextExecContext(UContextExecContext &&) = delete;
+    UContextExecContext& operator=(const UContextExecContext &) = delete;
+    UContextExecContext& operator=(UContextExecContext &&) = delete;
 
     template<class Func, class...Args>
-    inline void Execute(ExecContext &prev, void *stack_buf, size_t stack_size, Func func, Args...args);
+    inline void Execute(UContextExecContext &prev, void *stack_buf, size_t stack_size, Func func, Args...args);
 
     inline void Suspend() {
         swapcontext(&ctx_, prev_);
     }
 
-    inline void Resume(ExecContext &prev) {
+    inline void Resume(UContextExecContext &prev) {
         prev_ = &prev.ctx_;
         swapcontext(prev_, &ctx_);
     }
@@ -33,9 +42,56 @@ public:
 };
 
 
+#if defined(XYNQ_EXEC_CONTEXT_ASM)
+namespace detail {
+
+// Implemented in assembly (exec_context.cc).
+// Saves callee-saved registers on the current stack, stores stack pointer into *from_sp
+// and restores registers from to_sp.
+extern "C" void xynq_exec_context_switch(void **from_sp, void *to_sp);
+
+// Prepares stack so that switching to the returned stack pointer
+// calls entry(arg) on that stack. entry must never return.
+void *MakeExecStack(void *stack_buf, size_t stack_size, void (*entry)(void *), void *arg);
+
+} // detail
+
+// Context switch that only saves callee-saved registers.
+// No syscalls and signal mask is not touched.
+class AsmExecContext {
+public:
+    inline AsmExecContext() = default;
+    AsmExecContext(const AsmExecContext &) = delete;
+    AsmExecContext(AsmExecContext &&) = delete;
+    AsmExecContext& operator=(const AsmExecContext &) = delete;
+    AsmExecContext& operator=(AsmExecContext &&) = delete;
+
+    template<class Func, class...Args>
+    inline void Execute(AsmExecContext &prev, void *stack_buf, size_t stack_size, Func func, Args...args);
+
+    inline void Suspend() {
+        detail::xynq_exec_context_switch(&sp_, prev_->sp_);
+    }
+
+    inline void Resume(AsmExecContext &prev) {
+        prev_ = &prev;
+        detail::xynq_exec_context_switch(&prev.sp_, sp_);
+    }
+
+    AsmExecContext *prev_ = nullptr;
+    void *sp_ = nullptr;
+};
+
+using ExecContext = AsmExecContext;
+#else
+using ExecContext = UContextExecContext;
+#endif // XYNQ_EXEC_CONTEXT_ASM
+////////////////////////////////////////////////////////////
+
+
 template<class Func, class...Args>
-void ExecContext::Execute(ExecContext &prev, void *stack_buf, size_t stack_size, Func func, Args...args) {
-    void (*func_ptr) (ExecContext *, Func, Args...) = [](ExecContext *cur, Func func, Args...args) {
+void UContextExecContext::Execute(UContextExecContext &prev, void *stack_buf, size_t stack_size, Func func, Args...args) {
+    void (*func_ptr) (UContextExecContext *, Func, Args...) = [](UContextExecContext *cur, Func func, Args...args) {
         func(std::forward<Args>(args)...);
         swapcontext(&cur->ctx_, cur->prev_);
     };
@@ -50,5 +106,28 @@ void ExecContext::Execute(ExecContext &prev, void *stack_buf, size_t stack_size,
     swapcontext(prev_, &ctx_);
 }
 
+#if defined(XYNQ_EXEC_CONTEXT_ASM)
+template<class Func, class...Args>
+void AsmExecContext::Execute(AsmExecContext &prev, void *stack_buf, size_t stack_size, Func func, Args...args) {
+    using EntryArgs = std::tuple<AsmExecContext *, Func, Args...>;
+
+    // Lives on the caller stack. Entry copies everything out before the first switch back.
+    EntryArgs entry_args{this, func, args...};
+    void (*entry)(void *) = [](void *data) {
+        AsmExecContext *cur = std::apply([](AsmExecContext *cur, Func func, Args...args) {
+            func(std::forward<Args>(args)...);
+            return cur;
+        }, *static_cast<EntryArgs *>(data));
+
+        // Finished - never comes back here.
+        detail::xynq_exec_context_switch(&cur->sp_, cur->prev_->sp_);
+    };
+
+    prev_ = &prev;
+    sp_ = detail::MakeExecStack(stack_buf, stack_size, entry, &entry_args);
+    detail::xynq_exec_context_switch(&prev.sp_, sp_);
+}
+#endif // XYNQ_EXEC_CONTEXT_ASM
+
 } // platform
-} // xynq
\ No newline at end of file
+} // xynq
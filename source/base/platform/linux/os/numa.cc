@@ -0,0 +1,148 @@
+#include "os/numa.h"
+#include "os/utils.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include <dirent.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+using namespace xynq;
+using namespace xynq::platform;
+
+namespace {
+
+// From linux/mempolicy.h. Called through syscall() to avoid dependency on libnuma.
+static constexpr int kMpolPreferred = 1;
+
+static constexpr unsigned kMaxNumaNodes = 1024;
+static constexpr size_t kNodeMaskWords = kMaxNumaNodes / (8 * sizeof(unsigned long));
+
+// Parses cpu list in "0-3,8,10-11" format.
+Vec<unsigned> ParseCpuList(const char *str) {
+    Vec<unsigned> cpus;
+    while (*str != '\0' && *str != '\n') {
+        char *end = nullptr;
+        unsigned long first = strtoul(str, &end, 10);
+        if (end == str) {
+            break;
+        }
+
+        unsigned long last = first;
+        if (*end == '-') {
+            str = end + 1;
+            last = strtoul(str, &end, 10);
+            if (end == str) {
+                break;
+            }
+        }
+
+        for (unsigned long cpu = first; cpu <= last; ++cpu) {
+            cpus.push_back(static_cast<unsigned>(cpu));
+        }
+
+        str = *end == ',' ? end + 1 : end;
+    }
+    return cpus;
+}
+
+bool ReadNodeCpus(unsigned node, Vec<unsigned> &cpus) {
+    char path[64];
+    snprintf(path, sizeof(path), "/sys/devices/system/node/node%u/cpulist", node);
+
+    FILE *file = fopen(path, "r");
+    if (file == nullptr) {
+        return false;
+    }
+
+    char buf[4096];
+    bool read = fgets(buf, sizeof(buf), file) != nullptr;
+    fclose(file);
+    if (!read) {
+        return false;
+    }
+
+    cpus = ParseCpuList(buf);
+    return true;
+}
+
+bool SetPreferredNode(unsigned long nodemask[kNodeMaskWords], unsigned node) {
+    if (node >= kMaxNumaNodes) {
+        return false;
+    }
+
+    memset(nodemask, 0, sizeof(unsigned long) * kNodeMaskWords);
+    nodemask[node / (8 * sizeof(unsigned long))] |= 1ul << (node % (8 * sizeof(unsigned long)));
+    return true;
+}
+
+} // anon namespace
+
+Vec<NumaNode> xynq::platform::NumaTopology() {
+    Vec<NumaNode> nodes;
+
+    DIR *dir = opendir("/sys/devices/system/node");
+    if (dir != nullptr) {
+        while (dirent *entry = readdir(dir)) {
+            unsigned id = 0;
+            char tail = 0;
+            if (sscanf(entry->d_name, "node%u%c", &id, &tail) != 1) {
+                continue;
+            }
+
+            NumaNode node;
+            node.id = id;
+            if (ReadNodeCpus(id, node.cpus) && !node.cpus.empty()) {
+                nodes.push_back(std::move(node));
+            }
+        }
+        closedir(dir);
+    }
+
+    if (nodes.empty()) {
+        NumaNode node;
+        for (unsigned cpu = 0; cpu < NumCores(); ++cpu) {
+            node.cpus.push_back(cpu);
+        }
+        nodes.push_back(std::move(node));
+    }
+
+    std::sort(nodes.begin(), nodes.end(), [](const NumaNode &lhs, const NumaNode &rhs) {
+        return lhs.id < rhs.id;
+    });
+    return nodes;
+}
+
+bool xynq::platform::PinThreadToCpus(const unsigned *cpus, size_t num_cpus) {
+    cpu_set_t cpu_set;
+    CPU_ZERO(&cpu_set);
+    for (size_t i = 0; i < num_cpus; ++i) {
+        if (cpus[i] < CPU_SETSIZE) {
+            CPU_SET(cpus[i], &cpu_set);
+        }
+    }
+
+    return CPU_COUNT(&cpu_set) > 0 && sched_setaffinity(0, sizeof(cpu_set_t), &cpu_set) == 0;
+}
+
+bool xynq::platform::SetThreadNumaNode(unsigned node) {
+    unsigned long nodemask[kNodeMaskWords];
+    if (!SetPreferredNode(nodemask, node)) {
+        return false;
+    }
+
+    return syscall(SYS_set_mempolicy, kMpolPreferred, nodemask, kMaxNumaNodes) == 0;
+}
+
+bool xynq::platform::BindMemoryToNode(void *mem, size_t size, unsigned node) {
+    unsigned long nodemask[kNodeMaskWords];
+    if (!SetPreferredNode(nodemask, node)) {
+        return false;
+    }
+
+    return syscall(SYS_mbind, mem, size, kMpolPreferred, nodemask, kMaxNumaNodes, 0u) == 0;
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include "containers/vec.h"
+
+#include <cstddef>
+
+namespace xynq {
+namespace platform {
+
+// NUMA node with its online cpus.
+struct NumaNode {
+    unsigned id = 0;
+    Vec<unsigned> cpus;
+};
+
+// Reads NUMA topology from /sys/devices/system/node.
+// Falls back to a single node with all cores if topology is not available.
+// Nodes without cpus (memory-only) are skipped.
+Vec<NumaNode> NumaTopology();
+
+// Restricts calling thread to the set of cpus.
+bool PinThreadToCpus(const unsigned *cpus, size_t num_cpus);
+
+// Makes node preferred for memory first touched by the calling thread.
+// Allocation falls back to other nodes if the node is out of memory.
+bool SetThreadNumaNode(unsigned node);
+
+// Makes node preferred for pages of [mem, mem + size) that are not committed yet.
+// mem should be page aligned.
+bool BindMemoryToNode(void *mem, size_t size, unsigned node);
+
+} // platform
+} // xynq
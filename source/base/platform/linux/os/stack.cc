@@ -0,0 +1,183 @@
+#include "os/stack.h"
+#include "os/numa.h"
+
+#include <atomic>
+#include <cstring>
+
+#include <signal.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+using namespace xynq;
+using namespace xynq::platform;
+
+namespace {
+
+// Alternative signal stack. Overflow handler runs on it while the fiber stack is exhausted.
+static constexpr size_t kSignalStackSize = 64 * 1024;
+
+struct CurrentStack {
+    const char *begin = nullptr;
+    size_t size = 0;
+    const char *name = nullptr;
+};
+
+thread_local CurrentStack current_stack;
+thread_local void *signal_stack = nullptr;
+
+std::atomic_flag overflow_handler_installed = ATOMIC_FLAG_INIT;
+struct sigaction prev_segv_action;
+struct sigaction prev_bus_action;
+
+size_t PageSize() {
+    static const size_t page_size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    return page_size;
+}
+
+size_t RoundToPages(size_t size) {
+    return (size + PageSize() - 1) & ~(PageSize() - 1);
+}
+
+// Only async-signal-safe calls below.
+void WriteStr(const char *str) {
+    ssize_t ignored = write(STDERR_FILENO, str, strlen(str));
+    (void)ignored;
+}
+
+void WriteNum(size_t value) {
+    char buf[24];
+    char *cur = buf + sizeof(buf);
+    *--cur = '\0';
+    do {
+        *--cur = char('0' + value % 10);
+        value /= 10;
+    } while (value != 0);
+    WriteStr(cur);
+}
+
+void StackFaultHandler(int sig, siginfo_t *info, void *ucontext) {
+    const char *fault_addr = static_cast<const char *>(info->si_addr);
+    const CurrentStack &stack = current_stack;
+
+    if (stack.begin != nullptr && fault_addr < stack.begin && fault_addr >= stack.begin - StackGuardSize()) {
+        WriteStr("FATAL: Stack overflow in task '");
+        WriteStr(stack.name != nullptr && stack.name[0] != '\0' ? stack.name : "<unnamed>");
+        WriteStr("' (stack_size=");
+        WriteNum(stack.size);
+        WriteStr(" bytes). Increase stack_size of the task.\n");
+
+        // Faulting instruction is executed again and terminates the process with default action.
+        signal(sig, SIG_DFL);
+        return;
+    }
+
+    // Not ours.
+    const struct sigaction &prev = sig == SIGSEGV ? prev_segv_action : prev_bus_action;
+    if ((prev.sa_flags & SA_SIGINFO) != 0) {
+        prev.sa_sigaction(sig, info, ucontext);
+    } else if (prev.sa_handler != SIG_DFL && prev.sa_handler != SIG_IGN) {
+        prev.sa_handler(sig);
+    } else {
+        signal(sig, SIG_DFL);
+    }
+}
+
+} // anon namespace
+
+size_t xynq::platform::StackGuardSize() {
+    return PageSize();
+}
+
+void *xynq::platform::AllocStack(size_t stack_size, int numa_node) {
+    size_t guard_size = StackGuardSize();
+    size_t map_size = guard_size + RoundToPages(stack_size);
+
+    // MAP_NORESERVE: pages are committed on the first touch.
+    void *mem = mmap(nullptr, map_size, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_STACK, -1, 0);
+    if (mem == MAP_FAILED) {
+        return nullptr;
+    }
+
+    // Stacks grow down: guard goes below the usable region.
+    if (mprotect(mem, guard_size, PROT_NONE) != 0) {
+        munmap(mem, map_size);
+        return nullptr;
+    }
+
+    // Nothing is committed yet, so the policy applies to all pages. Failure is not fatal:
+    // pages are placed by the default policy then.
+    char *stack = static_cast<char *>(mem) + guard_size;
+    if (numa_node >= 0) {
+        BindMemoryToNode(stack, map_size - guard_size, static_cast<unsigned>(numa_node));
+    }
+
+    return stack;
+}
+
+void xynq::platform::FreeStack(void *stack, size_t stack_size) {
+    if (stack == nullptr) {
+        return;
+    }
+
+    size_t guard_size = StackGuardSize();
+    munmap(static_cast<char *>(stack) - guard_size, guard_size + RoundToPages(stack_size));
+}
+
+void xynq::platform::InitStackOverflowHandler() {
+    if (overflow_handler_installed.test_and_set()) {
+        return;
+    }
+
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_sigaction = StackFaultHandler;
+    action.sa_flags = SA_SIGINFO | SA_ONSTACK;
+    sigemptyset(&action.sa_mask);
+
+    sigaction(SIGSEGV, &action, &prev_segv_action);
+    sigaction(SIGBUS, &action, &prev_bus_action);
+}
+
+bool xynq::platform::InitThreadSignalStack() {
+    if (signal_stack != nullptr) {
+        return true;
+    }
+
+    void *mem = mmap(nullptr, kSignalStackSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mem == MAP_FAILED) {
+        return false;
+    }
+
+    stack_t ss;
+    memset(&ss, 0, sizeof(ss));
+    ss.ss_sp = mem;
+    ss.ss_size = kSignalStackSize;
+    if (sigaltstack(&ss, nullptr) != 0) {
+        munmap(mem, kSignalStackSize);
+        return false;
+    }
+
+    signal_stack = mem;
+    return true;
+}
+
+void xynq::platform::ShutdownThreadSignalStack() {
+    if (signal_stack == nullptr) {
+        return;
+    }
+
+    stack_t ss;
+    memset(&ss, 0, sizeof(ss));
+    ss.ss_flags = SS_DISABLE;
+    sigaltstack(&ss, nullptr);
+
+    munmap(signal_stack, kSignalStackSize);
+    signal_stack = nullptr;
+}
+
+void xynq::platform::SetCurrentStack(const void *stack, size_t stack_size, const char *name) {
+    current_stack.begin = static_cast<const char *>(stack);
+    current_stack.size = stack_size;
+    current_stack.name = name;
+}
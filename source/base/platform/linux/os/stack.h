@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstddef>
+
+namespace xynq {
+namespace platform {
+
+// Fiber stacks are mmaped with a PROT_NONE guard page below the usable region.
+// Pages are committed lazily on the first touch, so big stacks only cost address space.
+// Stack overflow hits the guard page and faults instead of corrupting neighbouring memory.
+
+// Size of the guard page(s) below every stack.
+size_t StackGuardSize();
+
+// Returns lowest usable address of the stack or nullptr on failure.
+// stack_size should be a multiple of page size.
+// Pages are placed on numa_node if it's not negative.
+void *AllocStack(size_t stack_size, int numa_node = -1);
+
+// Frees stack allocated with AllocStack.
+void FreeStack(void *stack, size_t stack_size);
+
+// Installs process-wide SIGSEGV/SIGBUS handler that reports faults on stack guard pages.
+// Handler chains to previously installed one for all other faults.
+// Safe to call multiple times.
+void InitStackOverflowHandler();
+
+// Sets up alternative signal stack for the calling thread, so overflow can be reported
+// while the fiber stack is exhausted. Should be paired with ShutdownThreadSignalStack.
+bool InitThreadSignalStack();
+void ShutdownThreadSignalStack();
+
+// Tells the overflow handler which stack is currently used by the calling thread.
+// name is reported on overflow, it must outlive the stack. nullptr stack - no fiber is running.
+void SetCurrentStack(const void *stack, size_t stack_size, const char *name);
+
+} // platform
+} // xynq
@@ -3,6 +3,7 @@
 #include <thread>
 #include <signal.h>
 #include <sched.h>
+#include <time.h>
 #include <unistd.h>
 
 using namespace xynq;
@@ -66,6 +67,18 @@ bool xynq::platform::PinThread(unsigned core_index) {
     return sched_setaffinity(0, sizeof(cpu_set_t), &cpus) == 0;
 }
 
+uint64_t xynq::platform::MonotonicTimeMsec() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000 + static_cast<uint64_t>(ts.tv_nsec) / 1000000;
+}
+
+uint64_t xynq::platform::MonotonicTimeUsec() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000 + static_cast<uint64_t>(ts.tv_nsec) / 1000;
+}
+
 uint64_t xynq::platform::GetPid() {
     return getpid();
 }
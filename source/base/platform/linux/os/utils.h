@@ -12,6 +12,21 @@ unsigned NumCores();
 // Core index should be in [0, NumCores() - 1]
 bool PinThread(unsigned core_index);
 
+// Monotonic clock in milliseconds. Not related to wall clock time.
+uint64_t MonotonicTimeMsec();
+
+// Monotonic clock in microseconds.
+uint64_t MonotonicTimeUsec();
+
+// Hints the cpu that the caller is busy-waiting.
+inline void CpuRelax() {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield");
+#endif
+}
+
 // Returns platform-specific numeric process id.
 uint64_t GetPid();
 
@@ -88,6 +88,27 @@ Either<StreamError, MutDataSpan> StreamReader::RefillAvailable() {
     });
 }
 
+Either<StreamError, MutDataSpan> StreamReader::ReadAtLeast(size_t size) {
+    XYAssert(size <= read_buf_.Size());
+
+    uint8_t *buf_end = (uint8_t *)read_buf_.Data() + read_buf_.Size();
+    if (available_begin_ == available_end_) {
+        available_begin_ = (uint8_t *)read_buf_.Data();
+        available_end_ = available_begin_;
+    } else if (available_begin_ + size > buf_end) { // Not enough space left behind available data.
+        NormalizeAvailable();
+    }
+
+    while ((size_t)(available_end_ - available_begin_) < size) {
+        auto result = stream_.Read(MutDataSpan{available_end_, buf_end});
+        if (result.IsLeft()) {
+            return result.Left();
+        }
+        available_end_ += result.Right();
+    }
+
+    return Available();
+}
 
 // Stream writer.
 StreamWriter::StreamWriter(MutDataSpan buffer, OutStream &stream)
@@ -102,7 +123,9 @@ StreamWriter::StreamWriter(MutDataSpan buffer, OutStream &stream, size_t written
 }
 
 StreamWriter::~StreamWriter() {
-    Flush();
+    if (written_size_ > 0) {
+        Flush();
+    }
 }
 
 OutStream &StreamWriter::Stream() {
@@ -114,6 +137,15 @@ bool StreamWriter::IsGood() const {
 }
 
 StreamWriteResult StreamWriter::WriteData(DataSpan buf) {
+    // Big buffer would be copied in chunks and every chunk written separately.
+    // Hand it to the stream as is instead.
+    if (buf.Size() >= write_buf_.Size()) {
+        DataSpan bufs[2] = {{write_buf_.Data(), written_size_}, buf};
+        size_t first_buf = written_size_ > 0 ? 0 : 1;
+        written_size_ = 0;
+        return stream_.WriteV({bufs + first_buf, 2 - first_buf});
+    }
+
     const char *ptr = (const char *)buf.Data();
     const char *ptr_end = (const char *)buf.Data() + buf.Size();
 
@@ -145,6 +177,17 @@ Either<StreamError, StreamWriteSuccess> StreamWriter::Flush() {
     return stream_.Write({write_buf_.Data(), sz});
 }
 
+// OutStream.
+StreamWriteResult OutStream::DoWriteV(Span<DataSpan> write_bufs) {
+    for (DataSpan buf : write_bufs) {
+        auto result = DoWrite(buf);
+        if (result.IsLeft()) {
+            return result;
+        }
+    }
+    return StreamWriteSuccess{};
+}
+
 // DummyInStream.
 Either<StreamError, size_t> DummyInStream::DoRead(MutDataSpan /*read_buf*/) {
     return StreamError::Closed;
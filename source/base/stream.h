@@ -15,7 +15,10 @@ enum class StreamError {
     Closed,
 
     // Error at the IO/Network layer.
-    IOError
+    IOError,
+
+    // Operation didn't complete in time. (ie. network peer stopped responding)
+    Timeout
 };
 
 enum class StreamWriteSuccess {};
@@ -56,12 +59,25 @@ public:
         });
     }
 
+    // Writes buffers one after another. Streams that support scatter-gather io
+    // (ie. tcp) send them with a single syscall without copying them together first.
+    // Buffers can be reused once the call returns.
+    StreamWriteResult WriteV(Span<DataSpan> write_bufs) {
+        return DoWriteV(write_bufs).MapLeft([this](StreamError error) {
+            write_error_ = error;
+            return error;
+        });
+    }
+
 protected:
     CStrSpan name_ = "n/a"; // Name for debugging/logging.
     StreamError write_error_ = StreamError::None;
 
     virtual StreamWriteResult DoWrite(DataSpan write_buf) = 0;
 
+    // Writes buffers one by one by default.
+    virtual StreamWriteResult DoWriteV(Span<DataSpan> write_bufs);
+
     // Only allow destroying from the parent class.
     // So we don't need a virtual d-tor here.
     ~OutStream() = default;
@@ -89,6 +105,9 @@ public:
     // Otherwise false. That means the stream is either closed or some IO error happened.
     bool IsGood() const;
 
+    // Size of the buffer. Nothing bigger can be available at once.
+    size_t BufferSize() const { return read_buf_.Size(); }
+
     // Returns currently available buffered data.
     MutDataSpan Available();
     DataSpan Available() const;
@@ -107,6 +126,10 @@ public:
     // Enforces prebuffering, resets all data that currently is prebuffered.
     Either<StreamError, MutDataSpan> RefillAvailable();
 
+    // Reads from the stream until at least size bytes are available and returns available data.
+    // Keeps already available data. size must not be bigger than the buffer.
+    Either<StreamError, MutDataSpan> ReadAtLeast(size_t size);
+
     // Reads one charactar from the buffer without checking for buffer bounds.
     inline char ReadAvailableCharUnsafe();
 
@@ -131,7 +154,7 @@ public:
     // Allows setting buffer that already has some data in it.
     // After initialization buffer is offseted by written_size.
     StreamWriter(MutDataSpan buffer, OutStream &stream, size_t written_size);
-    // Will flush currently prebuffered data into the stream.
+    // Will flush currently prebuffered data into the stream. Empty buffer is not written.
     ~StreamWriter();
 
     // Underlying stream.
@@ -142,6 +165,8 @@ public:
     bool IsGood() const;
 
     // Writes buffer of data into the stream.
+    // Buffers that are at least as big as the writer buffer are not copied:
+    // they are written to the stream together with already buffered data (see OutStream::WriteV).
     StreamWriteResult WriteData(DataSpan buf);
 
     // Writers string into the stream.
@@ -153,6 +178,9 @@ public:
     // Flushes data into the stream.
     // ie. if underlying stream is network i/o -> will write or schedule writing to the wire.
     StreamWriteResult Flush();
+
+    // Number of bytes written into the buffer and not flushed yet.
+    size_t BufferedSize() const { return written_size_; }
 private:
     MutDataSpan write_buf_; // User buffer used for prebuffering data from the stream.
     OutStream &stream_;
@@ -182,21 +210,12 @@ template<class T>
 Either<StreamError, T> StreamReader::ReadValue() {
     XYAssert(sizeof(T) <= read_buf_.Size()); // if T is smaller than buffer size -> we would never be able to read it.
 
-    while (available_begin_ + sizeof(T) > available_end_) {
-        MutDataSpan buf = NormalizeAvailable();
-        auto res = stream_.Read(buf);
-        if (res.IsLeft()) {
-            return res.Left();
-        }
-
-        available_begin_ = (uint8_t *)read_buf_.Data();
-        available_end_ = available_end_ + res.Right();
-    }
-
-    XYAssert(((uintptr_t)available_begin_ % alignof(T)) == 0);
-    T *value = reinterpret_cast<T *>(available_begin_);
-    available_begin_ += sizeof(T);
-    return *value;
+    return ReadAtLeast(sizeof(T)).MapRight([this](MutDataSpan) {
+        XYAssert(((uintptr_t)available_begin_ % alignof(T)) == 0);
+        T *value = reinterpret_cast<T *>(available_begin_);
+        available_begin_ += sizeof(T);
+        return *value;
+    });
 }
 
 char StreamReader::ReadAvailableCharUnsafe() {
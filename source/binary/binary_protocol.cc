@@ -0,0 +1,193 @@
+#include "binary_protocol.h"
+
+#include "storage/object_writer.h"
+
+#include <algorithm>
+#include <climits>
+#include <cstring>
+
+using namespace xynq;
+
+namespace {
+
+// Objects handles copied out of the vault at once by select.
+static constexpr size_t kSelectBatchSize = 64;
+
+// Reads [uint8 size][name] from the front of the payload.
+bool ReadTypeName(DataSpan &payload, StrSpan &type_name) {
+    const uint8_t *data = (const uint8_t *)payload.Data();
+    if (payload.Size() == 0 || payload.Size() < 1u + data[0]) {
+        return false;
+    }
+
+    type_name = StrSpan{(const char *)data + 1, data[0]};
+    payload = DataSpan{data + 1 + data[0], payload.Size() - 1 - data[0]};
+    return true;
+}
+
+// Skips size bytes of the stream.
+bool SkipBytes(StreamReader &reader, size_t size) {
+    while (size > 0) {
+        auto read = reader.AvailableOrRead();
+        if (read.IsLeft()) {
+            return false;
+        }
+
+        size_t skip_size = std::min(size, read.Right().Size());
+        reader.Advance(skip_size);
+        size -= skip_size;
+    }
+    return true;
+}
+
+} // anon namespace
+
+BinaryRequestHandler::BinaryRequestHandler(Dep<Storage> storage, Dep<TypeVault> types)
+    : storage_(storage)
+    , types_(types) {
+}
+
+bool BinaryRequestHandler::Process(StreamReader &reader, StreamWriter &writer) {
+    BinaryFrameHeader request;
+    auto read_header = reader.ReadAtLeast(sizeof(request));
+    if (read_header.IsLeft()) {
+        return false;
+    }
+    memcpy(&request, read_header.Right().Data(), sizeof(request));
+    reader.Advance(sizeof(request));
+
+    if (request.payload_size > reader.BufferSize()) {
+        if (!SkipBytes(reader, request.payload_size)) {
+            return false;
+        }
+        WriteBinaryError(writer, request, "Request is too big");
+        return writer.IsGood();
+    }
+
+    auto read_payload = reader.ReadAtLeast(request.payload_size);
+    if (read_payload.IsLeft()) {
+        return false;
+    }
+
+    // Payload stays in the reader buffer until the request is served.
+    DataSpan payload{read_payload.Right().Data(), request.payload_size};
+    switch ((BinaryOpcode)request.opcode) {
+        case BinaryOpcode::Create:
+            Create(request, payload, writer);
+            break;
+        case BinaryOpcode::Select:
+            Select(request, payload, writer);
+            break;
+        default:
+            WriteBinaryError(writer, request, "Unknown opcode");
+            break;
+    }
+
+    reader.Advance(request.payload_size);
+    return writer.IsGood();
+}
+
+void BinaryRequestHandler::Create(const BinaryFrameHeader &request, DataSpan payload, StreamWriter &writer) {
+    StrSpan type_name;
+    if (!ReadTypeName(payload, type_name)) {
+        WriteBinaryError(writer, request, "Expected type name");
+        return;
+    }
+
+    // Payload is checked before the object is created: failed requests leave nothing behind in the vault.
+    ObjectVault *vault = storage_->EnsureVaultWithType(types_, type_name);
+    if (vault == nullptr) {
+        WriteBinaryError(writer, request, "Unknown type");
+        return;
+    }
+
+    size_t fields_size = ObjectWriter::NativeFieldsSize(vault->Schema());
+    if (fields_size == 0) {
+        WriteBinaryError(writer, request, "Unsupported type");
+        return;
+    }
+
+    if (payload.Size() != fields_size) {
+        WriteBinaryError(writer, request, "Fields size mismatch");
+        return;
+    }
+
+    auto result = storage_->CreateObject(type_name);
+    if (result.IsLeft()) {
+        WriteBinaryError(writer, request, result.Left());
+        return;
+    }
+
+    auto [new_object, new_object_schema] = result.Right();
+    ObjectWriter object_writer(new_object, new_object_schema, storage_);
+    auto written = object_writer.WriteNative(payload);
+    if (written.IsLeft()) {
+        WriteBinaryError(writer, request, written.Left());
+        return;
+    }
+
+    uint64_t guid = new_object->guid_;
+    WriteBinaryFrameHeader(writer, request, BinaryStatus::Ok, sizeof(guid));
+    writer.Write(guid);
+}
+
+void BinaryRequestHandler::Select(const BinaryFrameHeader &request, DataSpan payload, StreamWriter &writer) {
+    StrSpan type_name;
+    if (!ReadTypeName(payload, type_name)) {
+        WriteBinaryError(writer, request, "Expected type name");
+        return;
+    }
+
+    ObjectVault *vault = storage_->EnsureVaultWithType(types_, type_name);
+    if (vault == nullptr) {
+        WriteBinaryError(writer, request, "Unknown type");
+        return;
+    }
+
+    // Objects are sent as they are laid out in memory. Fields that are not stored inline
+    // (ie. strings) would be sent as pointers into the server memory.
+    if (ObjectWriter::NativeFieldsSize(vault->Schema()) == 0) {
+        WriteBinaryError(writer, request, "Unsupported type");
+        return;
+    }
+
+    // Objects created after this point are not sent: payload size is already in the header.
+    size_t object_size = vault->Schema()->size;
+    size_t num_objects = vault->NumObjects();
+    if (object_size > 0) {
+        num_objects = std::min(num_objects, (UINT32_MAX - sizeof(uint32_t)) / object_size);
+    }
+
+    uint32_t num_objects_u32 = (uint32_t)num_objects;
+    WriteBinaryFrameHeader(writer, request, BinaryStatus::Ok, sizeof(num_objects_u32) + num_objects * object_size);
+    writer.Write(num_objects_u32);
+
+    Object::Handle objects[kSelectBatchSize];
+    size_t first = 0;
+    while (first < num_objects) {
+        size_t batch_size = std::min(kSelectBatchSize, num_objects - first);
+        size_t num_copied = vault->GetObjects(first, MutSpan<Object::Handle>{objects, batch_size});
+        XYAssert(num_copied == batch_size); // Objects are never removed.
+
+        for (size_t i = 0; i < num_copied; ++i) {
+            writer.WriteData(DataSpan{objects[i]->Data(), object_size});
+        }
+        first += num_copied;
+    }
+}
+
+void xynq::WriteBinaryFrameHeader(StreamWriter &writer, const BinaryFrameHeader &request, BinaryStatus status, size_t payload_size) {
+    XYAssert(payload_size <= UINT32_MAX);
+
+    BinaryFrameHeader response;
+    response.payload_size = (uint32_t)payload_size;
+    response.opcode = request.opcode;
+    response.status = (uint8_t)status;
+    response.request_id = request.request_id;
+    writer.Write(response);
+}
+
+void xynq::WriteBinaryError(StreamWriter &writer, const BinaryFrameHeader &request, StrSpan error) {
+    WriteBinaryFrameHeader(writer, request, BinaryStatus::Error, error.Size());
+    writer.Write(error);
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include "base/dep.h"
+#include "base/span.h"
+#include "base/stream.h"
+#include "storage/storage.h"
+#include "types/type_vault.h"
+
+#include <stdint.h>
+
+namespace xynq {
+
+// Length-prefixed binary protocol.
+// Every request and response is a frame: BinaryFrameHeader followed by payload_size bytes of payload.
+// All integers are little endian. Field values are sent in their native in-memory representation,
+// so objects are written from and read into storage as is, without any text parsing or formatting.
+
+// First byte sent by a client to switch the connection into binary protocol.
+// Never starts a slang request.
+static constexpr uint8_t kBinaryProtocolMagic = 0xB7;
+
+enum class BinaryOpcode : uint8_t {
+    // Request:  [uint8 type name size][type name][fields] - every field of the type in the schema order,
+    //           packed with no padding (see ObjectWriter::WriteNative).
+    // Response: [uint64 guid of the new object]
+    Create = 1,
+
+    // Request:  [uint8 type name size][type name]
+    // Response: [uint32 number of objects][objects] - objects as they are laid out in memory,
+    //           TypeSchema::size bytes each.
+    // Both requests fail for types that have fields that can't be sent natively (ie. strings).
+    Select = 2,
+};
+
+enum class BinaryStatus : uint8_t {
+    Ok = 0,
+    // Payload of the response is the error text.
+    Error = 1,
+};
+
+struct BinaryFrameHeader {
+    uint32_t payload_size = 0;
+    uint8_t opcode = 0;         // BinaryOpcode. Response repeats opcode of the request.
+    uint8_t status = 0;         // BinaryStatus. Always Ok in requests.
+    uint16_t reserved = 0;
+    uint64_t request_id = 0;    // Chosen by the client, response repeats it.
+};
+static_assert(sizeof(BinaryFrameHeader) == 16, "Frame header is a part of the protocol");
+
+// Serves binary protocol requests.
+class BinaryRequestHandler {
+public:
+    BinaryRequestHandler(Dep<Storage> storage, Dep<TypeVault> types);
+
+    // Reads one request from the reader and writes response for it.
+    // Requests that don't fit into the reader buffer are skipped and answered with an error.
+    // Returns false if the stream failed.
+    bool Process(StreamReader &reader, StreamWriter &writer);
+
+private:
+    Dep<Storage> storage_;
+    Dep<TypeVault> types_;
+
+    void Create(const BinaryFrameHeader &request, DataSpan payload, StreamWriter &writer);
+    void Select(const BinaryFrameHeader &request, DataSpan payload, StreamWriter &writer);
+};
+
+// Writes frame header with given payload size, payload is expected to be written next.
+void WriteBinaryFrameHeader(StreamWriter &writer, const BinaryFrameHeader &request, BinaryStatus status, size_t payload_size);
+
+// Writes error response to request.
+void WriteBinaryError(StreamWriter &writer, const BinaryFrameHeader &request, StrSpan error);
+
+} // xynq
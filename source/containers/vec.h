@@ -38,6 +38,16 @@ public:
         : VecBaseType<T>(allocator)
     {}
 
+    Vec &operator=(const Vec<T> &other) {
+        VecBaseType<T>::operator=(other);
+        return *this;
+    }
+
+    Vec &operator=(Vec<T> &&other) {
+        VecBaseType<T>::operator=(std::move(other));
+        return *this;
+    }
+
     using VecBaseType<T>::operator=;
 };
 
@@ -0,0 +1,214 @@
+#pragma once
+
+#include "base/assert.h"
+#include "base/platform_def.h"
+#include "base/span.h"
+#include "base/system_allocator.h"
+
+#include <atomic>
+#include <cstdint>
+#include <type_traits>
+
+namespace xynq {
+
+// Lock-free work-stealing deque (Chase-Lev).
+// Single owner thread pushes and pops at the bottom end (LIFO),
+// any other thread can steal from the top end (FIFO).
+// Grows when full instead of rejecting values. Buffers replaced by growth are
+// kept alive until the deque is destroyed because thieves might still read from them.
+// T must be trivially copyable: a thief that loses the race for a slot may read
+// a value that is being overwritten, such value is discarded.
+template<class T>
+class WorkStealingDeque {
+    static_assert(std::is_trivially_copyable<T>::value, "WorkStealingDeque only supports trivially copyable types.");
+public:
+    // initial_capacity must be power of 2.
+    explicit WorkStealingDeque(size_t initial_capacity = 1024);
+    ~WorkStealingDeque();
+
+    WorkStealingDeque(const WorkStealingDeque &) = delete;
+    WorkStealingDeque &operator=(const WorkStealingDeque &) = delete;
+
+    // Owner thread only. Never fails, grows if needed.
+    void Push(const T &value);
+
+    // Owner thread only. Pushes all values and publishes them to thieves at once.
+    // Grows at most once.
+    void PushBatch(Span<T> values);
+
+    // Owner thread only. Takes most recently pushed value.
+    // Returns false if the deque is empty.
+    bool Pop(T &value);
+
+    // Can be called from any thread. Takes the oldest value.
+    // Returns false if the deque is empty or lost the race to another thread.
+    bool Steal(T &value);
+
+    // Approximate number of values in the deque.
+    size_t Size() const;
+
+    // Approximate check if there are no values in the deque.
+    inline bool IsEmpty() const { return Size() == 0; }
+private:
+    struct Buffer {
+        int64_t mask_ = 0;
+        Buffer *retired_ = nullptr; // Previous (smaller) buffer waiting to be freed.
+        T *data_ = nullptr;
+
+        inline T &At(int64_t index) { return data_[index & mask_]; }
+        inline int64_t Capacity() const { return mask_ + 1; }
+    };
+
+    alignas(k_cache_line_size) std::atomic<int64_t> top_;
+    alignas(k_cache_line_size) std::atomic<int64_t> bottom_;
+    std::atomic<Buffer *> buffer_;
+
+    static Buffer *CreateBuffer(int64_t capacity);
+    static void DestroyBuffer(Buffer *buffer);
+
+    // Replaces buffer with a bigger one and copies values in range [top, bottom).
+    // capacity must be power of 2.
+    Buffer *Grow(Buffer *buffer, int64_t top, int64_t bottom, int64_t capacity);
+};
+////////////////////////////////////////////////////////////
+
+
+// Implementation.
+template<class T>
+WorkStealingDeque<T>::WorkStealingDeque(size_t initial_capacity)
+    : top_(0)
+    , bottom_(0) {
+    XYAssert(initial_capacity > 0 && (initial_capacity & (initial_capacity - 1)) == 0);
+    buffer_.store(CreateBuffer(static_cast<int64_t>(initial_capacity)), std::memory_order_relaxed);
+}
+
+template<class T>
+WorkStealingDeque<T>::~WorkStealingDeque() {
+    Buffer *buffer = buffer_.load(std::memory_order_relaxed);
+    while (buffer != nullptr) {
+        Buffer *retired = buffer->retired_;
+        DestroyBuffer(buffer);
+        buffer = retired;
+    }
+}
+
+template<class T>
+void WorkStealingDeque<T>::Push(const T &value) {
+    int64_t bottom = bottom_.load(std::memory_order_relaxed);
+    int64_t top = top_.load(std::memory_order_acquire);
+    Buffer *buffer = buffer_.load(std::memory_order_relaxed);
+
+    if (bottom - top > buffer->mask_) {
+        buffer = Grow(buffer, top, bottom, buffer->Capacity() * 2);
+    }
+
+    buffer->At(bottom) = value;
+    std::atomic_thread_fence(std::memory_order_release);
+    bottom_.store(bottom + 1, std::memory_order_relaxed);
+}
+
+template<class T>
+void WorkStealingDeque<T>::PushBatch(Span<T> values) {
+    int64_t count = static_cast<int64_t>(values.Size());
+    if (count == 0) {
+        return;
+    }
+
+    int64_t bottom = bottom_.load(std::memory_order_relaxed);
+    int64_t top = top_.load(std::memory_order_acquire);
+    Buffer *buffer = buffer_.load(std::memory_order_relaxed);
+
+    if (bottom - top + count > buffer->Capacity()) {
+        int64_t capacity = buffer->Capacity() * 2;
+        while (bottom - top + count > capacity) {
+            capacity *= 2;
+        }
+        buffer = Grow(buffer, top, bottom, capacity);
+    }
+
+    for (const T &value : values) {
+        buffer->At(bottom++) = value;
+    }
+    std::atomic_thread_fence(std::memory_order_release);
+    bottom_.store(bottom, std::memory_order_relaxed);
+}
+
+template<class T>
+bool WorkStealingDeque<T>::Pop(T &value) {
+    int64_t bottom = bottom_.load(std::memory_order_relaxed) - 1;
+    Buffer *buffer = buffer_.load(std::memory_order_relaxed);
+    bottom_.store(bottom, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t top = top_.load(std::memory_order_relaxed);
+
+    if (top > bottom) { // Empty.
+        bottom_.store(bottom + 1, std::memory_order_relaxed);
+        return false;
+    }
+
+    value = buffer->At(bottom);
+    if (top != bottom) { // More than one value left - no race with thieves possible.
+        return true;
+    }
+
+    // Last value: race against thieves for it.
+    bool won = top_.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+    bottom_.store(bottom + 1, std::memory_order_relaxed);
+    return won;
+}
+
+template<class T>
+bool WorkStealingDeque<T>::Steal(T &value) {
+    int64_t top = top_.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t bottom = bottom_.load(std::memory_order_acquire);
+
+    if (top >= bottom) { // Empty.
+        return false;
+    }
+
+    Buffer *buffer = buffer_.load(std::memory_order_acquire);
+    T stolen = buffer->At(top);
+    if (!top_.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+        return false; // Someone else took it.
+    }
+
+    value = stolen;
+    return true;
+}
+
+template<class T>
+size_t WorkStealingDeque<T>::Size() const {
+    int64_t bottom = bottom_.load(std::memory_order_relaxed);
+    int64_t top = top_.load(std::memory_order_relaxed);
+    return bottom > top ? static_cast<size_t>(bottom - top) : 0;
+}
+
+template<class T>
+typename WorkStealingDeque<T>::Buffer *WorkStealingDeque<T>::CreateBuffer(int64_t capacity) {
+    Buffer *buffer = CreateObject<Buffer>(SystemAllocator::Shared());
+    buffer->mask_ = capacity - 1;
+    buffer->data_ = (T *)SystemAllocator::Shared().Alloc(sizeof(T) * capacity);
+    XYAssert(buffer->data_ != nullptr);
+    return buffer;
+}
+
+template<class T>
+void WorkStealingDeque<T>::DestroyBuffer(Buffer *buffer) {
+    SystemAllocator::Shared().Free(buffer->data_);
+    DestroyObject(SystemAllocator::Shared(), buffer);
+}
+
+template<class T>
+typename WorkStealingDeque<T>::Buffer *WorkStealingDeque<T>::Grow(Buffer *buffer, int64_t top, int64_t bottom, int64_t capacity) {
+    Buffer *grown = CreateBuffer(capacity);
+    for (int64_t i = top; i != bottom; ++i) {
+        grown->At(i) = buffer->At(i);
+    }
+
+    grown->retired_ = buffer;
+    buffer_.store(grown, std::memory_order_release);
+    return grown;
+}
+
+} // xynq
@@ -0,0 +1,207 @@
+#include "event/epoll_eventqueue.h"
+
+#include "base/assert.h"
+#include "base/system_allocator.h"
+#include "base/platform_def.h"
+#include "event/event_def.h"
+
+#include <poll.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <errno.h>
+#include <climits>
+#include <string.h>
+#include <unistd.h>
+
+DefineTaggedLog(Event)
+
+using namespace xynq;
+
+EpollEventQueue::EpollEventQueue(Dep<Log> log,
+                                 size_t thread_max_events_at_once,
+                                 size_t num_threads)
+    : log_(log)
+    , num_threads_(num_threads)
+    , poller_(kNoPoller) {
+    XYAssert(thread_max_events_at_once <= INT_MAX);
+
+    epoll_fd_ = ::epoll_create1(0);
+    // add padding between buffers for multiple threads to avoid cache line sharing.
+    size_t padding = (k_cache_line_size + sizeof(epoll_event)) / sizeof(epoll_event);
+    thread_events_size_ = thread_max_events_at_once + padding;
+    events_ = reinterpret_cast<epoll_event *>(SystemAllocator::Shared().Alloc(
+                                                sizeof(epoll_event) * thread_events_size_ * num_threads));
+    thread_max_events_ = static_cast<int>(thread_max_events_at_once);
+    poller_wakeup_fd_ = EpollEventSource{eventfd(0, EFD_NONBLOCK)};
+
+    thread_wakeups_ = reinterpret_cast<ThreadWakeup *>(SystemAllocator::Shared().AllocAligned(
+                                                alignof(ThreadWakeup), sizeof(ThreadWakeup) * num_threads));
+    for (size_t i = 0; i < num_threads; ++i) {
+        ThreadWakeup *wakeup = new (thread_wakeups_ + i) ThreadWakeup{};
+        wakeup->fd_ = eventfd(0, EFD_NONBLOCK);
+        XYAssert(wakeup->fd_ >= 0);
+    }
+
+    XYAssert(poller_wakeup_fd_.FD() >= 0);
+    XYAssert(events_ != nullptr);
+    XYAssert(epoll_fd_ >= 0);
+    AddEvent(poller_wakeup_fd_, EventFlags::Read, nullptr);
+}
+
+EpollEventQueue::~EpollEventQueue() {
+    close(poller_wakeup_fd_.FD());
+    for (size_t i = 0; i < num_threads_; ++i) {
+        close(thread_wakeups_[i].fd_);
+    }
+
+    if (epoll_fd_ >= 0) {
+        ::close(epoll_fd_);
+    }
+
+    SystemAllocator::Shared().Free(thread_wakeups_);
+    SystemAllocator::Shared().Free(events_);
+}
+
+void EpollEventQueue::AddEvent(EpollEventSource &event_source, uint32_t event_flags, void *user_handle) {
+    XYAssert(event_source.FD() >= 0);
+
+    epoll_event event;
+    event.events = EPOLLERR | EPOLLHUP;
+    event.data.ptr = user_handle;
+
+    // Allow events on one descriptor(ie. one connection) only come to a single thread exclusevely.
+    if (event_flags & EventFlags::Read) {
+        event.events |= EPOLLIN;
+    }
+    if (event_flags & EventFlags::Write) {
+        event.events |= EPOLLOUT;
+    }
+    if (event_flags & EventFlags::ExactlyOnce) {
+        event.events |= EPOLLONESHOT;
+    }
+    if (event_flags & EventFlags::EdgeTriggered) {
+        event.events |= EPOLLET;
+    }
+
+    int err;
+    if (event_source.is_added_) {
+        err = ::epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, event_source.FD(), &event);
+    } else {
+        err = ::epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, event_source.FD(), &event);
+        event_source.is_added_ = true;
+    }
+
+    if (err < 0) {
+        XYEventError(log_, "epoll_ctl add failed with ", errno, '(', ::strerror(errno), ')');
+    }
+}
+
+void EpollEventQueue::RemoveEvent(EpollEventSource &event_source) {
+    XYAssert(event_source.FD() >= 0);
+    if (!event_source.is_added_) {
+        return;
+    }
+
+    int err = ::epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, event_source.FD(), nullptr);
+    if (err < 0) {
+        XYEventError(log_, "epoll_ctl del failed with ", errno, '(', ::strerror(errno), ')');
+    } else {
+        event_source.is_added_ = false;
+    }
+}
+
+Span<Event> EpollEventQueue::Wait(size_t thread_index, int timeout_msec) {
+    XYAssert(thread_index < num_threads_);
+
+    // Whoever comes first polls for events, the rest park.
+    size_t no_poller = kNoPoller;
+    if (poller_.compare_exchange_strong(no_poller, thread_index, std::memory_order_seq_cst)) {
+        Span<Event> events = WaitPoller(thread_index, timeout_msec);
+        poller_.store(kNoPoller, std::memory_order_release);
+        return events;
+    }
+
+    Park(thread_index, timeout_msec);
+    return {};
+}
+
+Span<Event> EpollEventQueue::WaitPoller(size_t thread_index, int timeout_msec) {
+    static_assert(sizeof(Event) == sizeof(struct epoll_event),
+        "Invalid event type. Should be epoll_event.");
+    XYAssert(epoll_fd_ >= 0);
+
+    // Thread could have been interrupted right before it became the poller.
+    // Poller does not watch its own wakeup fd, so check it once here.
+    if (timeout_msec != 0 && Drain(thread_wakeups_[thread_index].fd_)) {
+        timeout_msec = 0;
+    }
+
+    epoll_event *events_buf = events_ + thread_events_size_ * thread_index;
+    int nevents = ::epoll_wait(epoll_fd_, events_buf, thread_max_events_, timeout_msec);
+
+    if (nevents < 0) {
+        if (errno != EINTR) {
+            XYEventError(log_, "epoll_wait failed with error=", errno, '(', ::strerror(errno), ')');
+        }
+        return {};
+    }
+
+    // Drain interrupt event if it was the reason of the wakeup.
+    for (int i = 0; i < nevents; ++i) {
+        if (events_buf[i].data.ptr == nullptr) {
+            Drain(poller_wakeup_fd_.FD());
+            break;
+        }
+    }
+
+    return {static_cast<const Event *>(events_buf),
+            static_cast<size_t>(nevents)};
+}
+
+void EpollEventQueue::Park(size_t thread_index, int timeout_msec) {
+    XYAssert(thread_index < num_threads_);
+
+    pollfd wakeup_poll;
+    wakeup_poll.fd = thread_wakeups_[thread_index].fd_;
+    wakeup_poll.events = POLLIN;
+    wakeup_poll.revents = 0;
+
+    int err = ::poll(&wakeup_poll, 1, timeout_msec);
+    if (err < 0 && errno != EINTR) {
+        XYEventError(log_, "poll on wakeup fd failed with error=", errno, '(', ::strerror(errno), ')');
+    } else if (err > 0) {
+        Drain(wakeup_poll.fd);
+    }
+}
+
+void EpollEventQueue::Interrupt(size_t thread_index) {
+    if (thread_index == kNoPoller) {
+        Signal(poller_wakeup_fd_.FD());
+        return;
+    }
+
+    XYAssert(thread_index < num_threads_);
+    Signal(thread_wakeups_[thread_index].fd_);
+
+    // Poller waits in epoll_wait and doesn't watch its own wakeup fd.
+    if (poller_.load(std::memory_order_seq_cst) == thread_index) {
+        Signal(poller_wakeup_fd_.FD());
+    }
+}
+
+void EpollEventQueue::InterruptAll() {
+    for (size_t i = 0; i < num_threads_; ++i) {
+        Signal(thread_wakeups_[i].fd_);
+    }
+    Signal(poller_wakeup_fd_.FD());
+}
+
+void EpollEventQueue::Signal(int fd) {
+    uint64_t value = 1;
+    write(fd, &value, sizeof(value));
+}
+
+bool EpollEventQueue::Drain(int fd) {
+    uint64_t value;
+    return read(fd, &value, sizeof(value)) > 0; // eventfd resets its counter on read.
+}
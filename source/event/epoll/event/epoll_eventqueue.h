@@ -0,0 +1,75 @@
+#pragma once
+
+#include "event.h"
+
+#include "base/dep.h"
+#include "base/log.h"
+#include "base/platform_def.h"
+#include "base/span.h"
+
+#include <atomic>
+#include <vector>
+
+namespace xynq {
+
+// Linux/epoll-based EventQueue implementation.
+class EpollEventQueue {
+public:
+    //  thread_max_events_at_once: is number of events that can be processed
+    //                             on a single epoll_wait hit per single thread.
+    //  num_threads: number of threads this queue will be running on.
+    EpollEventQueue(Dep<Log> log,
+                    size_t thread_max_events_at_once,
+                    size_t num_threads);
+    ~EpollEventQueue();
+
+    EpollEventQueue(const EpollEventQueue &) = delete;
+    EpollEventQueue &operator=(const EpollEventQueue &) = delete;
+
+    // Adds event to epoll.
+    // fs is expected to be valid file descriptor ie. valid socket.
+    void AddEvent(EpollEventSource &event_source, uint32_t event_flags, void *user_handle);
+
+    // Removes file descriptor from epoll.
+    void RemoveEvent(EpollEventSource &event_source);
+
+    // Blocks and waits for events.
+    // Only one thread at a time (the poller) waits in epoll_wait and receives events.
+    // Other threads park on their own wakeup fd and return no events when interrupted.
+    Span<Event> Wait(size_t thread_index, int timeout_msec);
+
+    // Blocks until the thread is interrupted or timeout expires. Never polls for events.
+    void Park(size_t thread_index, int timeout_msec);
+
+    // Interrupts specific thread: wakes it up if it's waiting, otherwise its next Wait
+    // returns immediately.
+    // thread_index = -1 - means no preference, wakes the poller.
+    void Interrupt(size_t thread_index = ~size_t());
+
+    // Interrupts waits of all threads.
+    void InterruptAll();
+private:
+    static constexpr size_t kNoPoller = ~size_t();
+
+    // Per-thread wakeup eventfd. Padded to avoid false sharing.
+    struct alignas(k_cache_line_size) ThreadWakeup {
+        int fd_ = -1;
+    };
+
+    Dep<Log> log_;
+    epoll_event *events_ = nullptr;
+    int thread_max_events_ = 0;
+    size_t thread_events_size_ = 0;
+    int epoll_fd_ = -1;
+    EpollEventSource poller_wakeup_fd_; // dummy event to wakeup the poller thread.
+    ThreadWakeup *thread_wakeups_ = nullptr;
+    size_t num_threads_ = 0;
+    alignas(k_cache_line_size) std::atomic<size_t> poller_; // Thread currently in epoll_wait.
+
+    Span<Event> WaitPoller(size_t thread_index, int timeout_msec);
+    static void Signal(int fd);
+    // Returns true if fd was signaled.
+    static bool Drain(int fd);
+};
+
+} // xynq
\ No newline at end of file
@@ -9,6 +9,7 @@ namespace xynq {
 // EventSource is bsd socket wrapper.
 class EpollEventSource {
     friend class EpollEventQueue;
+    friend class UringEventQueue;
 public:
     inline EpollEventSource() = default;
     inline EpollEventSource(int fd)
@@ -16,9 +17,15 @@ public:
     {}
 
     inline int FD() const { return fd_; };
+
+    // Event source was added to the queue and wasn't removed since.
+    inline bool IsAdded() const { return is_added_; }
 private:
     int fd_ = -1;
-    bool is_added_ = false; // Used by epoll queue.
+    bool is_added_ = false; // Used by epoll queue. io_uring: has poll that might still be armed.
+    bool uring_multishot_ = false; // io_uring: the poll is multishot.
+    uint32_t uring_index_ = 0; // io_uring: ring the poll was armed on.
+    EventUserHandle uring_handle_ = nullptr; // io_uring: user handle of the armed poll.
 };
 
 
@@ -1,55 +1,160 @@
 #pragma once
 
 #include "event.h"
+#include "epoll_eventqueue.h"
+#include "event/uring_eventqueue.h"
 
+#include "base/assert.h"
 #include "base/dep.h"
 #include "base/log.h"
+#include "base/maybe.h"
 #include "base/span.h"
 
-#include <vector>
-
 namespace xynq {
 
-// Linux/epoll-based EventQueue implementation.
-class EpollEventQueue {
+// Parses backend name as used in the config: "epoll" or "io_uring".
+Maybe<EventBackend> EventBackendFromString(CStrSpan name);
+
+// Event queue with the implementation selected at runtime.
+// Every call takes thread_index of the calling worker thread:
+// io_uring backend keeps separate ring per thread, epoll ignores it for Add/Remove.
+class EventQueue {
 public:
+    // Falls back to epoll if requested backend is not available.
     //  thread_max_events_at_once: is number of events that can be processed
-    //                             on a single epoll_wait hit per single thread.
+    //                             on a single Wait per single thread.
     //  num_threads: number of threads this queue will be running on.
-    EpollEventQueue(Dep<Log> log,
-                    size_t thread_max_events_at_once,
-                    size_t num_threads);
-    ~EpollEventQueue();
+    EventQueue(Dep<Log> log,
+               EventBackend backend,
+               size_t thread_max_events_at_once,
+               size_t num_threads);
+    ~EventQueue();
+
+    EventQueue(const EventQueue &) = delete;
+    EventQueue &operator=(const EventQueue &) = delete;
+
+    // Backend that is actually in use.
+    inline EventBackend Backend() const { return backend_; }
+
+    // true if SubmitIoRequest can be used.
+    inline bool SupportsIoRequests() const { return backend_ == EventBackend::IoUring; }
+
+    // Subscribes to events of event_source. Event will be reported with user_handle.
+    inline void AddEvent(size_t thread_index, EventSource &event_source, uint32_t event_flags, void *user_handle);
+
+    // Unsubscribes event_source.
+    inline void RemoveEvent(size_t thread_index, EventSource &event_source);
+
+    // Submits io operation. Completion is reported as an event with user_handle.
+    // Only valid if SupportsIoRequests().
+    inline void SubmitIoRequest(size_t thread_index, EventIoRequest &request, void *user_handle);
+
+    // Submits multishot io operation. Every completion is queued in the request and
+    // reported as an event with user_handle. Only valid if SupportsIoRequests().
+    inline void SubmitMultishot(size_t thread_index, EventMultishotRequest &request, void *user_handle);
+
+    // Cancels armed multishot request. Request stays alive until it's no longer armed.
+    inline void CancelMultishot(size_t thread_index, EventMultishotRequest &request);
+
+    // true if multishot recv requests can be submitted.
+    inline bool SupportsRecvBuffers() const { return uring_ != nullptr && uring_->SupportsRecvBuffers(); }
 
-    EpollEventQueue(const EpollEventQueue &) = delete;
-    EpollEventQueue &operator=(const EpollEventQueue &) = delete;
+    // Data of a multishot recv completion. Only valid until its buffer is released.
+    inline DataSpan RecvData(const EventMultishotRequest &request, const EventMultishotRequest::Completion &completion) const;
 
-    // Adds event to epoll.
-    // fs is expected to be valid file descriptor ie. valid socket.
-    void AddEvent(EpollEventSource &event_source, uint32_t event_flags, void *user_handle);
+    // Gives buffer of a multishot recv completion back to the queue.
+    inline void ReleaseRecvBuffer(const EventMultishotRequest &request, uint32_t buffer);
 
-    // Removes file descriptor from epoll.
-    void RemoveEvent(EpollEventSource &event_source);
+    // Blocks and waits for events.
+    inline Span<Event> Wait(size_t thread_index, int timeout_msec);
 
-    // Blocks and waits for events, basically epoll_wait.
-    Span<Event> Wait(size_t thread_index, int timeout_msec);
+    // Blocks until the thread is interrupted or timeout expires without polling for events.
+    // For threads that never add events or submit io requests with their thread_index.
+    inline void Park(size_t thread_index, int timeout_msec);
 
-    // Interrupts specific thread.
-    // Guarantees st least one thread woken up. Does not guarantee it will be preferred_thread_index;
-    // preferred_thread_index = -1 - means no preference.
-    void Interrupt(size_t preferred_thread_index = ~size_t());
+    // Wakes up specific thread.
+    // thread_index = -1 - means no preference.
+    inline void Interrupt(size_t thread_index = ~size_t());
 
     // Interrupts waits of all threads.
-    void InterruptAll();
+    inline void InterruptAll();
 private:
-    Dep<Log> log_;
-    epoll_event *events_ = nullptr;
-    int thread_max_events_ = 0;
-    size_t thread_events_size_ = 0;
-    int epoll_fd_ = -1;
-    EpollEventSource wakeup_fd_; // dummy event to wakeup threads.
+    EventBackend backend_ = EventBackend::Epoll;
+    EpollEventQueue *epoll_ = nullptr;
+    UringEventQueue *uring_ = nullptr;
 };
+////////////////////////////////////////////////////////////
+
+
+// Implementation
+void EventQueue::AddEvent(size_t thread_index, EventSource &event_source, uint32_t event_flags, void *user_handle) {
+    if (uring_ != nullptr) {
+        uring_->AddEvent(thread_index, event_source, event_flags, user_handle);
+    } else {
+        epoll_->AddEvent(event_source, event_flags, user_handle);
+    }
+}
+
+void EventQueue::RemoveEvent(size_t thread_index, EventSource &event_source) {
+    if (uring_ != nullptr) {
+        uring_->RemoveEvent(thread_index, event_source);
+    } else {
+        epoll_->RemoveEvent(event_source);
+    }
+}
+
+void EventQueue::SubmitIoRequest(size_t thread_index, EventIoRequest &request, void *user_handle) {
+    XYAssert(uring_ != nullptr);
+    uring_->SubmitIoRequest(thread_index, request, user_handle);
+}
+
+void EventQueue::SubmitMultishot(size_t thread_index, EventMultishotRequest &request, void *user_handle) {
+    XYAssert(uring_ != nullptr);
+    uring_->SubmitMultishot(thread_index, request, user_handle);
+}
+
+void EventQueue::CancelMultishot(size_t thread_index, EventMultishotRequest &request) {
+    XYAssert(uring_ != nullptr);
+    uring_->CancelMultishot(thread_index, request);
+}
+
+DataSpan EventQueue::RecvData(const EventMultishotRequest &request, const EventMultishotRequest::Completion &completion) const {
+    XYAssert(uring_ != nullptr);
+    return uring_->RecvData(request, completion);
+}
+
+void EventQueue::ReleaseRecvBuffer(const EventMultishotRequest &request, uint32_t buffer) {
+    XYAssert(uring_ != nullptr);
+    uring_->ReleaseRecvBuffer(request, buffer);
+}
+
+Span<Event> EventQueue::Wait(size_t thread_index, int timeout_msec) {
+    return uring_ != nullptr ? uring_->Wait(thread_index, timeout_msec)
+                             : epoll_->Wait(thread_index, timeout_msec);
+}
+
+void EventQueue::Park(size_t thread_index, int timeout_msec) {
+    if (uring_ != nullptr) {
+        uring_->Park(thread_index, timeout_msec);
+    } else {
+        epoll_->Park(thread_index, timeout_msec);
+    }
+}
+
+void EventQueue::Interrupt(size_t thread_index) {
+    if (uring_ != nullptr) {
+        uring_->Interrupt(thread_index);
+    } else {
+        epoll_->Interrupt(thread_index);
+    }
+}
 
-using EventQueue = EpollEventQueue;
+void EventQueue::InterruptAll() {
+    if (uring_ != nullptr) {
+        uring_->InterruptAll();
+    } else {
+        epoll_->InterruptAll();
+    }
+}
 
-} // xynq
\ No newline at end of file
+} // xynq
@@ -1,6 +1,11 @@
 #pragma once
 
+#include "containers/vec.h"
+
+#include <atomic>
+#include <cstddef>
 #include <cstdint>
+#include <mutex>
 
 namespace xynq {
 
@@ -10,9 +15,144 @@ struct EventFlags {
         Read        = 1 << 0, // Eventsource has new incoming data ready for read.
         Write       = 1 << 1, // Eventsource is ready to accept new outgoing data.
         ExactlyOnce = 1 << 2, // Will only hit once.
+        EdgeTriggered = 1 << 3, // Stays registered and only hits when event source becomes ready.
     };
 };
 
 using EventUserHandle = void*;
 
-} // xynq
\ No newline at end of file
+// User handles are pointers to objects aligned to at least 8 bytes or other values with the same
+// low bits clear, handles up to 4 are reserved. Their lowest bit is left for callers to tag
+// handles with: queues report it back as is. Queues can use the other alignment bits internally.
+static constexpr uintptr_t kEventUserHandleTagBit = 1;
+
+// Event queue implementations.
+enum class EventBackend {
+    // Readiness notifications with epoll.
+    Epoll,
+    // Linux io_uring. Also supports submitting io operations directly (see EventIoRequest).
+    IoUring,
+};
+
+// Io operation that is performed by the event queue itself instead of
+// waiting for readiness and doing the syscall afterwards.
+// Only supported by event queues that report SupportsIoRequests().
+struct EventIoRequest {
+    enum class Op {
+        Recv,   // recv(fd, buf, size)
+        Send,    // send(fd, buf, size)
+        SendMsg, // sendmsg(fd, buf), buf points to msghdr that stays alive until completion.
+        Accept,  // accept(fd), result is the accepted socket.
+    };
+
+    Op op = Op::Recv;
+    int fd = -1;
+    void *buf = nullptr;
+    size_t size = 0;
+
+    // Extra MSG_* flags for Send and SendMsg. (ie. MSG_ZEROCOPY)
+    int msg_flags = 0;
+
+    // Operation is cancelled if it doesn't complete in time. -1 - no timeout.
+    int timeout_msec = -1;
+
+    // Result of the operation as returned by the syscall, or -errno on failure.
+    // -ECANCELED if timeout has expired.
+    int32_t result = 0;
+
+    // Handle that is reported in the completion event. Set by the queue on submit.
+    EventUserHandle user_handle = nullptr;
+
+    // Timeout in the queue's format. Kept in the request as queue reads it on submission.
+    int64_t timeout_storage[2] = {0, 0};
+};
+
+// Io operation that keeps completing until it fails or is cancelled (ie. io_uring multishot).
+// Every completion is queued in the request and reported as an event with the request's user handle.
+// Request must stay alive until it's no longer armed. Completions can be taken from any thread.
+// Only supported by event queues that report SupportsIoRequests().
+class EventMultishotRequest {
+    friend class UringEventQueue;
+public:
+    enum class Op {
+        Accept, // accept(fd) for every incoming connection, result is the accepted socket.
+        Recv,   // recv(fd) into buffers the queue provides, result is the number of bytes received.
+                // Only supported by event queues that report SupportsRecvBuffers().
+    };
+
+    static constexpr uint32_t kNoBuffer = ~0u;
+
+    struct Completion {
+        // Same as EventIoRequest::result. Last completion of the request is either 0 or -errno.
+        int32_t result = 0;
+        // Recv: queue's buffer with the received data. It's owned by the taker until it's released.
+        uint32_t buffer = kNoBuffer;
+    };
+
+    EventMultishotRequest(Op op, int fd)
+        : op_(op)
+        , fd_(fd)
+    {}
+
+    EventMultishotRequest(const EventMultishotRequest &) = delete;
+    EventMultishotRequest &operator=(const EventMultishotRequest &) = delete;
+
+    inline Op Operation() const { return op_; }
+    inline int FD() const { return fd_; }
+
+    // Request was submitted and more completions might come.
+    inline bool IsArmed() const { return armed_.load(std::memory_order_acquire); }
+
+    // Thread the request was last submitted on. Buffers of its completions belong to that thread.
+    inline size_t ThreadIndex() const { return thread_index_; }
+
+    // There are completions that were not taken yet.
+    inline bool HasCompletions() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return next_completion_ < completions_.size();
+    }
+
+    // Takes the oldest completion. Returns false if there are none.
+    inline bool Take(Completion &completion) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (next_completion_ == completions_.size()) {
+            completions_.clear();
+            next_completion_ = 0;
+            return false;
+        }
+        completion = completions_[next_completion_++];
+        return true;
+    }
+
+private:
+    Op op_;
+    int fd_ = -1;
+    size_t thread_index_ = 0;
+    EventUserHandle user_handle_ = nullptr;
+
+    std::mutex mutex_;
+    Vec<Completion> completions_;
+    size_t next_completion_ = 0;
+    std::atomic<bool> armed_{false};
+
+    // Called by the queue on submission.
+    inline void Arm(size_t thread_index, EventUserHandle user_handle) {
+        thread_index_ = thread_index;
+        user_handle_ = user_handle;
+        armed_.store(true, std::memory_order_release);
+    }
+
+    // Called by the queue for every completion. Request is not touched after its last completion:
+    // it can be released as soon as it's not armed.
+    inline void Complete(Completion completion, bool more) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            completions_.push_back(completion);
+        }
+        if (!more) {
+            armed_.store(false, std::memory_order_release);
+        }
+    }
+};
+
+} // xynq
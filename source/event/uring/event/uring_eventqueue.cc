@@ -0,0 +1,653 @@
+#include "event/uring_eventqueue.h"
+
+#include "base/assert.h"
+#include "base/system_allocator.h"
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <errno.h>
+#include <algorithm>
+#include <climits>
+#include <string.h>
+#include <unistd.h>
+
+DefineTaggedLog(Event)
+
+using namespace xynq;
+
+namespace {
+
+// user_data of completions that are not reported as events.
+// Real handles are never equal to these values (see kEventUserHandleTagBit).
+static constexpr uint64_t kWakeupTag = 2;   // Read on ring's wakeup eventfd.
+static constexpr uint64_t kInternalTag = 4; // Poll removals and linked timeouts.
+
+// Marks user_data that points to EventIoRequest. Lowest bit belongs to user handles of polls.
+static constexpr uint64_t kIoRequestTag = 2;
+static_assert(kIoRequestTag != kEventUserHandleTagBit, "Io requests are told apart from tagged user handles");
+static_assert(alignof(EventIoRequest) > kIoRequestTag, "Io request pointers must leave the tag bit free");
+
+// Marks user_data that points to EventMultishotRequest. Lowest bit is free: requests are not user handles.
+static constexpr uint64_t kMultishotTag = kIoRequestTag | kEventUserHandleTagBit;
+static constexpr uint64_t kRequestTagMask = kMultishotTag;
+static_assert(alignof(EventMultishotRequest) > kRequestTagMask, "Multishot request pointers must leave tag bits free");
+
+// Buffers multishot recv requests of a ring receive into. Power of 2.
+// Connection that finds all of them taken falls back to single shot recv.
+static constexpr unsigned kRecvBufferCount = 64;
+static constexpr size_t kRecvBufferSize = 8 * 1024;
+static constexpr uint16_t kRecvBufferGroup = 0;
+static_assert((kRecvBufferCount & (kRecvBufferCount - 1)) == 0, "Buffer ring size must be power of 2");
+
+static int IoUringSetup(unsigned entries, io_uring_params *params) {
+    return static_cast<int>(::syscall(__NR_io_uring_setup, entries, params));
+}
+
+static int IoUringEnter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags,
+                        const void *arg, size_t arg_size) {
+    return static_cast<int>(::syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, arg, arg_size));
+}
+
+static int IoUringRegister(int fd, unsigned opcode, void *arg, unsigned nr_args) {
+    return static_cast<int>(::syscall(__NR_io_uring_register, fd, opcode, arg, nr_args));
+}
+
+template<class T>
+static T *RingPtr(void *ring_ptr, uint32_t offset) {
+    return reinterpret_cast<T *>(static_cast<char *>(ring_ptr) + offset);
+}
+
+} // anon namespace
+
+Maybe<UringEventQueue *> UringEventQueue::Create(Dep<Log> log,
+                                                 size_t thread_max_events_at_once,
+                                                 size_t num_threads) {
+    void *mem = SystemAllocator::Shared().Alloc(sizeof(UringEventQueue));
+    UringEventQueue *queue = new (mem) UringEventQueue(log, thread_max_events_at_once, num_threads);
+
+    bool success = true;
+    for (size_t i = 0; i < num_threads && success; ++i) {
+        success = queue->InitRing(queue->rings_[i]);
+    }
+
+    if (!success) {
+        DestroyObject(SystemAllocator::Shared(), queue);
+        return {};
+    }
+    return queue;
+}
+
+UringEventQueue::UringEventQueue(Dep<Log> log, size_t thread_max_events_at_once, size_t num_threads)
+    : log_(log)
+    , num_threads_(num_threads)
+    , next_interrupt_(0) {
+    XYAssert(thread_max_events_at_once <= INT_MAX);
+    XYAssert(num_threads > 0);
+
+    thread_max_events_ = static_cast<unsigned>(thread_max_events_at_once);
+    rings_ = reinterpret_cast<Ring *>(SystemAllocator::Shared().AllocAligned(
+                                                alignof(Ring), sizeof(Ring) * num_threads));
+    XYAssert(rings_ != nullptr);
+    for (size_t i = 0; i < num_threads; ++i) {
+        new (rings_ + i) Ring{};
+    }
+}
+
+UringEventQueue::~UringEventQueue() {
+    for (size_t i = 0; i < num_threads_; ++i) {
+        DestroyRing(rings_[i]);
+        rings_[i].~Ring();
+    }
+    SystemAllocator::Shared().Free(rings_);
+}
+
+bool UringEventQueue::InitRing(Ring &ring) {
+    // Completions are reaped at most thread_max_events_ at a time, leave room for
+    // polls and io requests that complete in between.
+    unsigned entries = thread_max_events_ * 2;
+
+    io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    params.flags = IORING_SETUP_CLAMP;
+
+    ring.fd_ = IoUringSetup(entries, &params);
+    if (ring.fd_ < 0) {
+        XYEventWarning(log_, "io_uring_setup failed with ", errno, '(', ::strerror(errno), ')');
+        return false;
+    }
+
+    // Timed waits rely on passing timeout to io_uring_enter (5.11+).
+    if ((params.features & IORING_FEAT_EXT_ARG) == 0) {
+        XYEventWarning(log_, "io_uring doesn't support IORING_FEAT_EXT_ARG.");
+        return false;
+    }
+
+    ring.sq_ring_size_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    ring.cq_ring_size_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    bool single_mmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (single_mmap) {
+        ring.sq_ring_size_ = std::max(ring.sq_ring_size_, ring.cq_ring_size_);
+        ring.cq_ring_size_ = 0;
+    }
+
+    ring.sq_ring_ptr_ = ::mmap(nullptr, ring.sq_ring_size_, PROT_READ | PROT_WRITE,
+                               MAP_SHARED | MAP_POPULATE, ring.fd_, IORING_OFF_SQ_RING);
+    if (ring.sq_ring_ptr_ == MAP_FAILED) {
+        ring.sq_ring_ptr_ = nullptr;
+        XYEventWarning(log_, "io_uring sq ring mmap failed with ", errno, '(', ::strerror(errno), ')');
+        return false;
+    }
+
+    if (single_mmap) {
+        ring.cq_ring_ptr_ = ring.sq_ring_ptr_;
+    } else {
+        ring.cq_ring_ptr_ = ::mmap(nullptr, ring.cq_ring_size_, PROT_READ | PROT_WRITE,
+                                   MAP_SHARED | MAP_POPULATE, ring.fd_, IORING_OFF_CQ_RING);
+        if (ring.cq_ring_ptr_ == MAP_FAILED) {
+            ring.cq_ring_ptr_ = nullptr;
+            XYEventWarning(log_, "io_uring cq ring mmap failed with ", errno, '(', ::strerror(errno), ')');
+            return false;
+        }
+    }
+
+    ring.sqes_size_ = params.sq_entries * sizeof(io_uring_sqe);
+    void *sqes = ::mmap(nullptr, ring.sqes_size_, PROT_READ | PROT_WRITE,
+                        MAP_SHARED | MAP_POPULATE, ring.fd_, IORING_OFF_SQES);
+    if (sqes == MAP_FAILED) {
+        XYEventWarning(log_, "io_uring sqes mmap failed with ", errno, '(', ::strerror(errno), ')');
+        return false;
+    }
+    ring.sqes_ = static_cast<io_uring_sqe *>(sqes);
+
+    ring.sq_head_ = RingPtr<std::atomic<unsigned>>(ring.sq_ring_ptr_, params.sq_off.head);
+    ring.sq_tail_ = RingPtr<std::atomic<unsigned>>(ring.sq_ring_ptr_, params.sq_off.tail);
+    ring.sq_local_tail_ = ring.sq_tail_->load(std::memory_order_relaxed);
+    ring.sq_array_ = RingPtr<unsigned>(ring.sq_ring_ptr_, params.sq_off.array);
+    ring.sq_mask_ = *RingPtr<unsigned>(ring.sq_ring_ptr_, params.sq_off.ring_mask);
+    ring.sq_entries_ = *RingPtr<unsigned>(ring.sq_ring_ptr_, params.sq_off.ring_entries);
+
+    ring.cq_head_ = RingPtr<std::atomic<unsigned>>(ring.cq_ring_ptr_, params.cq_off.head);
+    ring.cq_tail_ = RingPtr<std::atomic<unsigned>>(ring.cq_ring_ptr_, params.cq_off.tail);
+    ring.cq_mask_ = *RingPtr<unsigned>(ring.cq_ring_ptr_, params.cq_off.ring_mask);
+    ring.cqes_ = RingPtr<io_uring_cqe>(ring.cq_ring_ptr_, params.cq_off.cqes);
+
+    ring.events_ = reinterpret_cast<Event *>(SystemAllocator::Shared().Alloc(sizeof(Event) * thread_max_events_));
+    XYAssert(ring.events_ != nullptr);
+
+    // Blocking eventfd: io_uring completes reads on nonblocking files with -EAGAIN instead of waiting.
+    ring.wakeup_fd_ = eventfd(0, 0);
+    if (ring.wakeup_fd_ < 0) {
+        XYEventWarning(log_, "eventfd failed with ", errno, '(', ::strerror(errno), ')');
+        return false;
+    }
+
+    ArmWakeup(ring);
+
+    if (recv_buffers_supported_ && !InitRecvBuffers(ring)) {
+        recv_buffers_supported_ = false;
+    }
+    return true;
+}
+
+bool UringEventQueue::InitRecvBuffers(Ring &ring) {
+    // Buffer ring has to be page aligned.
+    ring.buf_ring_size_ = sizeof(io_uring_buf) * kRecvBufferCount;
+    void *buf_ring = ::mmap(nullptr, ring.buf_ring_size_, PROT_READ | PROT_WRITE,
+                            MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0);
+    if (buf_ring == MAP_FAILED) {
+        XYEventWarning(log_, "io_uring buffer ring mmap failed with ", errno, '(', ::strerror(errno), ')');
+        return false;
+    }
+    ring.buf_ring_ = static_cast<io_uring_buf_ring *>(buf_ring);
+
+    io_uring_buf_reg reg;
+    memset(&reg, 0, sizeof(reg));
+    reg.ring_addr = reinterpret_cast<uint64_t>(buf_ring);
+    reg.ring_entries = kRecvBufferCount;
+    reg.bgid = kRecvBufferGroup;
+    if (IoUringRegister(ring.fd_, IORING_REGISTER_PBUF_RING, &reg, 1) < 0) {
+        XYEventInfo(log_, "io_uring doesn't support buffer rings (", errno, '(', ::strerror(errno), "))."
+                          " Multishot recv is disabled.");
+        return false;
+    }
+
+    ring.recv_buffers_ = static_cast<uint8_t *>(SystemAllocator::Shared().Alloc(kRecvBufferCount * kRecvBufferSize));
+    XYAssert(ring.recv_buffers_ != nullptr);
+    for (unsigned i = 0; i < kRecvBufferCount; ++i) {
+        PushRecvBuffer(ring, static_cast<uint16_t>(i));
+    }
+    return true;
+}
+
+void UringEventQueue::DestroyRing(Ring &ring) {
+    if (ring.wakeup_fd_ >= 0) {
+        ::close(ring.wakeup_fd_);
+    }
+    if (ring.sqes_ != nullptr) {
+        ::munmap(ring.sqes_, ring.sqes_size_);
+    }
+    if (ring.cq_ring_ptr_ != nullptr && ring.cq_ring_ptr_ != ring.sq_ring_ptr_) {
+        ::munmap(ring.cq_ring_ptr_, ring.cq_ring_size_);
+    }
+    if (ring.sq_ring_ptr_ != nullptr) {
+        ::munmap(ring.sq_ring_ptr_, ring.sq_ring_size_);
+    }
+    if (ring.fd_ >= 0) {
+        ::close(ring.fd_);
+    }
+    // Kernel might still be using buffers until the ring is closed.
+    if (ring.buf_ring_ != nullptr) {
+        ::munmap(ring.buf_ring_, ring.buf_ring_size_);
+    }
+    SystemAllocator::Shared().Free(ring.recv_buffers_);
+    SystemAllocator::Shared().Free(ring.events_);
+}
+
+void UringEventQueue::AddEvent(size_t thread_index, EpollEventSource &event_source, uint32_t event_flags, void *user_handle) {
+    XYAssert(event_source.FD() >= 0);
+    XYAssert(thread_index < num_threads_);
+    XYAssert((reinterpret_cast<uint64_t>(user_handle) & kIoRequestTag) == 0);
+
+    // Rearming replaces the previous multishot poll. Single shot polls are gone once triggered.
+    if (event_source.is_added_ && event_source.uring_multishot_) {
+        RemoveEvent(thread_index, event_source);
+    }
+
+    uint32_t poll_events = EPOLLERR | EPOLLHUP;
+    if (event_flags & EventFlags::Read) {
+        poll_events |= EPOLLIN;
+    }
+    if (event_flags & EventFlags::Write) {
+        poll_events |= EPOLLOUT;
+    }
+    if (event_flags & EventFlags::EdgeTriggered) {
+        poll_events |= EPOLLET;
+    }
+
+    bool multishot = (event_flags & EventFlags::ExactlyOnce) == 0;
+    Ring &ring = rings_[thread_index];
+    {
+        std::lock_guard<std::mutex> lock(ring.sq_mutex_);
+        SubmitPoll(ring, event_source.FD(), poll_events, multishot, user_handle);
+        if (multishot) {
+            MultishotPoll &poll = ring.multishot_polls_[user_handle];
+            poll.fd_ = event_source.FD();
+            poll.poll_events_ = poll_events;
+            poll.removed_ = false;
+            ++poll.num_armed_;
+        }
+    }
+
+    event_source.uring_multishot_ = multishot;
+    event_source.is_added_ = true;
+    event_source.uring_index_ = static_cast<uint32_t>(thread_index);
+    event_source.uring_handle_ = user_handle;
+}
+
+void UringEventQueue::RemoveEvent(size_t thread_index, EpollEventSource &event_source) {
+    XYAssert(event_source.FD() >= 0);
+
+    // Removing already triggered single shot poll just completes with -ENOENT.
+    if (!event_source.is_added_) {
+        return;
+    }
+
+    size_t ring_index = event_source.uring_index_;
+    Ring &ring = rings_[ring_index];
+    {
+        std::lock_guard<std::mutex> lock(ring.sq_mutex_);
+        if (event_source.uring_multishot_) {
+            auto found = ring.multishot_polls_.find(event_source.uring_handle_);
+            XYAssert(found != ring.multishot_polls_.end());
+            found->second.removed_ = true;
+
+            // Failed poll has nothing left to cancel.
+            if (found->second.num_armed_ == 0) {
+                ring.multishot_polls_.erase(found);
+                event_source.is_added_ = false;
+                return;
+            }
+        }
+
+        io_uring_sqe *sqe = NextSqe(ring);
+        sqe->opcode = IORING_OP_POLL_REMOVE;
+        sqe->fd = -1;
+        sqe->addr = reinterpret_cast<uint64_t>(event_source.uring_handle_);
+        sqe->user_data = kInternalTag;
+        Publish(ring);
+    }
+    event_source.is_added_ = false;
+
+    // Owner flushes submissions only when it waits next time.
+    if (ring_index != thread_index) {
+        Interrupt(ring_index);
+    }
+}
+
+void UringEventQueue::SubmitIoRequest(size_t thread_index, EventIoRequest &request, void *user_handle) {
+    XYAssert(request.fd >= 0);
+    XYAssert(thread_index < num_threads_);
+    XYAssert((reinterpret_cast<uint64_t>(&request) & kIoRequestTag) == 0);
+
+    request.user_handle = user_handle;
+    request.result = 0;
+
+    Ring &ring = rings_[thread_index];
+    std::lock_guard<std::mutex> lock(ring.sq_mutex_);
+    io_uring_sqe *sqe = NextSqe(ring);
+    sqe->fd = request.fd;
+    sqe->user_data = reinterpret_cast<uint64_t>(&request) | kIoRequestTag;
+
+    switch (request.op) {
+        case EventIoRequest::Op::Recv:
+            sqe->opcode = IORING_OP_RECV;
+            sqe->addr = reinterpret_cast<uint64_t>(request.buf);
+            sqe->len = static_cast<uint32_t>(request.size);
+            break;
+        case EventIoRequest::Op::Send:
+            sqe->opcode = IORING_OP_SEND;
+            sqe->addr = reinterpret_cast<uint64_t>(request.buf);
+            sqe->len = static_cast<uint32_t>(request.size);
+            sqe->msg_flags = MSG_NOSIGNAL | request.msg_flags;
+            break;
+        case EventIoRequest::Op::SendMsg:
+            sqe->opcode = IORING_OP_SENDMSG;
+            sqe->addr = reinterpret_cast<uint64_t>(request.buf);
+            sqe->len = 1;
+            sqe->msg_flags = MSG_NOSIGNAL | request.msg_flags;
+            break;
+        case EventIoRequest::Op::Accept:
+            sqe->opcode = IORING_OP_ACCEPT;
+            break;
+    }
+
+    // Request is cancelled with -ECANCELED once the linked timeout expires.
+    if (request.timeout_msec >= 0) {
+        static_assert(sizeof(request.timeout_storage) == sizeof(__kernel_timespec), "Invalid timeout storage size.");
+        __kernel_timespec *ts = reinterpret_cast<__kernel_timespec *>(request.timeout_storage);
+        ts->tv_sec = request.timeout_msec / 1000;
+        ts->tv_nsec = (request.timeout_msec % 1000) * 1000000ll;
+
+        sqe->flags |= IOSQE_IO_LINK;
+        io_uring_sqe *timeout_sqe = NextSqe(ring);
+        timeout_sqe->opcode = IORING_OP_LINK_TIMEOUT;
+        timeout_sqe->fd = -1;
+        timeout_sqe->addr = reinterpret_cast<uint64_t>(ts);
+        timeout_sqe->len = 1;
+        timeout_sqe->user_data = kInternalTag;
+    }
+
+    // Linked requests have to become visible to the kernel together.
+    Publish(ring);
+}
+
+void UringEventQueue::SubmitMultishot(size_t thread_index, EventMultishotRequest &request, void *user_handle) {
+    XYAssert(request.FD() >= 0);
+    XYAssert(thread_index < num_threads_);
+    XYAssert(!request.IsArmed());
+    XYAssert((reinterpret_cast<uint64_t>(&request) & kRequestTagMask) == 0);
+
+    request.Arm(thread_index, user_handle);
+
+    Ring &ring = rings_[thread_index];
+    std::lock_guard<std::mutex> lock(ring.sq_mutex_);
+    io_uring_sqe *sqe = NextSqe(ring);
+    sqe->fd = request.FD();
+    sqe->user_data = reinterpret_cast<uint64_t>(&request) | kMultishotTag;
+
+    switch (request.Operation()) {
+        case EventMultishotRequest::Op::Accept:
+            sqe->opcode = IORING_OP_ACCEPT;
+            sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+            break;
+        case EventMultishotRequest::Op::Recv:
+            // Kernel picks a buffer for every completion. Request ends with -ENOBUFS once there are none.
+            XYAssert(recv_buffers_supported_);
+            sqe->opcode = IORING_OP_RECV;
+            sqe->ioprio = IORING_RECV_MULTISHOT;
+            sqe->flags |= IOSQE_BUFFER_SELECT;
+            sqe->buf_group = kRecvBufferGroup;
+            break;
+    }
+    Publish(ring);
+}
+
+void UringEventQueue::CancelMultishot(size_t thread_index, EventMultishotRequest &request) {
+    // Request that is ending anyway has nothing to cancel, cancellation would just complete with -ENOENT.
+    if (!request.IsArmed()) {
+        return;
+    }
+
+    size_t ring_index = request.ThreadIndex();
+    Ring &ring = rings_[ring_index];
+    {
+        std::lock_guard<std::mutex> lock(ring.sq_mutex_);
+        io_uring_sqe *sqe = NextSqe(ring);
+        sqe->opcode = IORING_OP_ASYNC_CANCEL;
+        sqe->fd = -1;
+        sqe->addr = reinterpret_cast<uint64_t>(&request) | kMultishotTag;
+        sqe->user_data = kInternalTag;
+        Publish(ring);
+    }
+
+    // Owner flushes submissions only when it waits next time.
+    if (ring_index != thread_index) {
+        Interrupt(ring_index);
+    }
+}
+
+DataSpan UringEventQueue::RecvData(const EventMultishotRequest &request,
+                                   const EventMultishotRequest::Completion &completion) const {
+    XYAssert(completion.buffer < kRecvBufferCount);
+    XYAssert(completion.result > 0);
+    const Ring &ring = rings_[request.ThreadIndex()];
+    return DataSpan{ring.recv_buffers_ + completion.buffer * kRecvBufferSize, static_cast<size_t>(completion.result)};
+}
+
+void UringEventQueue::ReleaseRecvBuffer(const EventMultishotRequest &request, uint32_t buffer) {
+    XYAssert(buffer < kRecvBufferCount);
+    Ring &ring = rings_[request.ThreadIndex()];
+    std::lock_guard<std::mutex> lock(ring.sq_mutex_);
+    PushRecvBuffer(ring, static_cast<uint16_t>(buffer));
+}
+
+Span<Event> UringEventQueue::Wait(size_t thread_index, int timeout_msec) {
+    XYAssert(thread_index < num_threads_);
+    Ring &ring = rings_[thread_index];
+
+    size_t nevents = ReapCompletions(ring, 0);
+    unsigned to_submit = ring.sq_tail_->load(std::memory_order_acquire) -
+                         ring.sq_head_->load(std::memory_order_acquire);
+
+    // Nothing to submit and there are completions already: no syscall needed.
+    if (nevents > 0 && to_submit == 0) {
+        return {ring.events_, nevents};
+    }
+
+    int err;
+    if (nevents > 0 || timeout_msec == 0) {
+        err = IoUringEnter(ring.fd_, to_submit, 0, 0, nullptr, 0);
+    } else if (timeout_msec < 0) {
+        err = IoUringEnter(ring.fd_, to_submit, 1, IORING_ENTER_GETEVENTS, nullptr, 0);
+    } else {
+        __kernel_timespec ts;
+        ts.tv_sec = timeout_msec / 1000;
+        ts.tv_nsec = (timeout_msec % 1000) * 1000000ll;
+
+        io_uring_getevents_arg arg;
+        memset(&arg, 0, sizeof(arg));
+        arg.ts = reinterpret_cast<uint64_t>(&ts);
+        err = IoUringEnter(ring.fd_, to_submit, 1, IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG, &arg, sizeof(arg));
+    }
+
+    if (err < 0 && errno != EINTR && errno != ETIME && errno != EBUSY && errno != EAGAIN) {
+        XYEventError(log_, "io_uring_enter failed with error=", errno, '(', ::strerror(errno), ')');
+    }
+
+    nevents = ReapCompletions(ring, nevents);
+    return {ring.events_, nevents};
+}
+
+void UringEventQueue::Park(size_t thread_index, int timeout_msec) {
+    Span<Event> events = Wait(thread_index, timeout_msec);
+    XYAssert(events.IsEmpty()); // Only wakeups are armed on the ring.
+}
+
+void UringEventQueue::Interrupt(size_t thread_index) {
+    if (thread_index == ~size_t()) {
+        thread_index = next_interrupt_.fetch_add(1, std::memory_order_relaxed) % num_threads_;
+    }
+
+    XYAssert(thread_index < num_threads_);
+    uint64_t value = 1;
+    write(rings_[thread_index].wakeup_fd_, &value, sizeof(value));
+}
+
+void UringEventQueue::InterruptAll() {
+    for (size_t i = 0; i < num_threads_; ++i) {
+        Interrupt(i);
+    }
+}
+
+io_uring_sqe *UringEventQueue::NextSqe(Ring &ring) {
+    unsigned tail = ring.sq_local_tail_++;
+    while (tail - ring.sq_head_->load(std::memory_order_acquire) >= ring.sq_entries_) {
+        // Submission queue is full - flush it without waiting for completions.
+        int err = IoUringEnter(ring.fd_, ring.sq_entries_, 0, 0, nullptr, 0);
+        if (err < 0 && errno != EINTR && errno != EBUSY && errno != EAGAIN) {
+            XYEventError(log_, "io_uring_enter submit failed with error=", errno, '(', ::strerror(errno), ')');
+        }
+    }
+
+    unsigned index = tail & ring.sq_mask_;
+    io_uring_sqe *sqe = ring.sqes_ + index;
+    memset(sqe, 0, sizeof(io_uring_sqe));
+    ring.sq_array_[index] = index;
+    return sqe;
+}
+
+void UringEventQueue::Publish(Ring &ring) {
+    ring.sq_tail_->store(ring.sq_local_tail_, std::memory_order_release);
+}
+
+void UringEventQueue::PushRecvBuffer(Ring &ring, uint16_t buffer) {
+    // Tail overlays reserved field of the first entry: only the rest of the entry is written.
+    // Entries are not taken from io_uring_buf_ring::bufs: its flexible array is shifted in C++.
+    io_uring_buf *entries = reinterpret_cast<io_uring_buf *>(ring.buf_ring_);
+    io_uring_buf &entry = entries[ring.buf_ring_tail_ & (kRecvBufferCount - 1)];
+    entry.addr = reinterpret_cast<uint64_t>(ring.recv_buffers_ + buffer * kRecvBufferSize);
+    entry.len = static_cast<uint32_t>(kRecvBufferSize);
+    entry.bid = buffer;
+
+    ++ring.buf_ring_tail_;
+    reinterpret_cast<std::atomic<uint16_t> *>(&ring.buf_ring_->tail)->store(ring.buf_ring_tail_, std::memory_order_release);
+}
+
+void UringEventQueue::ArmWakeup(Ring &ring) {
+    std::lock_guard<std::mutex> lock(ring.sq_mutex_);
+    io_uring_sqe *sqe = NextSqe(ring);
+    sqe->opcode = IORING_OP_READ;
+    sqe->fd = ring.wakeup_fd_;
+    sqe->addr = reinterpret_cast<uint64_t>(&ring.wakeup_value_);
+    sqe->len = sizeof(ring.wakeup_value_);
+    sqe->user_data = kWakeupTag;
+    Publish(ring);
+}
+
+void UringEventQueue::SubmitPoll(Ring &ring, int fd, uint32_t poll_events, bool multishot, EventUserHandle user_handle) {
+    io_uring_sqe *sqe = NextSqe(ring);
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = fd;
+    sqe->poll32_events = poll_events;
+    sqe->user_data = reinterpret_cast<uint64_t>(user_handle);
+    if (multishot) {
+        sqe->len = IORING_POLL_ADD_MULTI;
+    }
+    Publish(ring);
+}
+
+void UringEventQueue::RetireMultishot(Ring &ring, EventUserHandle user_handle, int result) {
+    std::lock_guard<std::mutex> lock(ring.sq_mutex_);
+    auto found = ring.multishot_polls_.find(user_handle);
+    if (found == ring.multishot_polls_.end()) {
+        return; // Single shot poll.
+    }
+
+    MultishotPoll &poll = found->second;
+    XYAssert(poll.num_armed_ > 0);
+    if (--poll.num_armed_ > 0) {
+        return; // Replaced by AddEvent, the new poll is still armed.
+    }
+
+    if (poll.removed_) {
+        ring.multishot_polls_.erase(found);
+    } else if (result >= 0) {
+        // Terminated by the kernel, ie. there was no room for its completion.
+        SubmitPoll(ring, poll.fd_, poll.poll_events_, true, user_handle);
+        ++poll.num_armed_;
+    } else {
+        XYEventWarning(log_, "Multishot poll on fd=", poll.fd_, " failed with ", -result, '(', ::strerror(-result), ')');
+    }
+}
+
+size_t UringEventQueue::ReapCompletions(Ring &ring, size_t nevents) {
+    unsigned head = ring.cq_head_->load(std::memory_order_relaxed);
+    unsigned tail = ring.cq_tail_->load(std::memory_order_acquire);
+
+    bool rearm_wakeup = false;
+    while (head != tail && nevents < thread_max_events_) {
+        const io_uring_cqe &cqe = ring.cqes_[head & ring.cq_mask_];
+        ++head;
+
+        if (cqe.user_data == kWakeupTag) {
+            rearm_wakeup = true;
+            continue;
+        }
+        if (cqe.user_data == kInternalTag) {
+            continue;
+        }
+
+        Event &event = ring.events_[nevents];
+        if ((cqe.user_data & kRequestTagMask) == kMultishotTag) {
+            // Request can be released once its last completion is queued: take the handle first.
+            EventMultishotRequest *request = reinterpret_cast<EventMultishotRequest *>(cqe.user_data & ~kRequestTagMask);
+            event.events = EPOLLIN | EPOLLOUT;
+            event.data.ptr = request->user_handle_;
+
+            EventMultishotRequest::Completion completion;
+            completion.result = cqe.res;
+            if (cqe.flags & IORING_CQE_F_BUFFER) {
+                completion.buffer = cqe.flags >> IORING_CQE_BUFFER_SHIFT;
+            }
+            request->Complete(completion, (cqe.flags & IORING_CQE_F_MORE) != 0);
+        } else if (cqe.user_data & kIoRequestTag) {
+            // Io request is done: report it as readiness of its handle.
+            EventIoRequest *request = reinterpret_cast<EventIoRequest *>(cqe.user_data & ~kRequestTagMask);
+            request->result = cqe.res;
+            event.events = EPOLLIN | EPOLLOUT;
+            event.data.ptr = request->user_handle;
+        } else {
+            if ((cqe.flags & IORING_CQE_F_MORE) == 0) {
+                RetireMultishot(ring, reinterpret_cast<EventUserHandle>(cqe.user_data), cqe.res);
+            }
+
+            // Removed multishot poll or terminated one that reports no events (it's armed again).
+            if (cqe.res == -ECANCELED || cqe.res == 0) {
+                continue;
+            }
+            event.events = cqe.res < 0 ? EPOLLERR : static_cast<uint32_t>(cqe.res);
+            event.data.ptr = reinterpret_cast<void *>(cqe.user_data);
+        }
+        ++nevents;
+    }
+
+    ring.cq_head_->store(head, std::memory_order_release);
+
+    if (rearm_wakeup) {
+        ArmWakeup(ring);
+    }
+    return nevents;
+}
@@ -0,0 +1,165 @@
+#pragma once
+
+#include "event/event.h"
+
+#include "base/dep.h"
+#include "base/log.h"
+#include "base/maybe.h"
+#include "base/platform_def.h"
+#include "base/span.h"
+#include "containers/hash.h"
+
+#include <linux/io_uring.h>
+
+#include <atomic>
+#include <mutex>
+
+namespace xynq {
+
+// Linux io_uring-based EventQueue implementation.
+// Every thread owns its ring: events and io requests are submitted into the ring of the thread
+// that calls AddEvent/SubmitIoRequest and completions are reaped by the same thread in Wait.
+// Submissions are batched and flushed with a single io_uring_enter together with waiting.
+// Readiness events are implemented with poll requests and reported with epoll event flags,
+// so the same Event type is used for both epoll and io_uring backends.
+class UringEventQueue {
+public:
+    // Returns nothing if io_uring is not available (ie. old kernel or disabled by the system).
+    //  thread_max_events_at_once: is number of events that can be processed
+    //                             on a single Wait per single thread.
+    //  num_threads: number of threads this queue will be running on.
+    static Maybe<UringEventQueue *> Create(Dep<Log> log,
+                                           size_t thread_max_events_at_once,
+                                           size_t num_threads);
+    ~UringEventQueue();
+
+    UringEventQueue(const UringEventQueue &) = delete;
+    UringEventQueue &operator=(const UringEventQueue &) = delete;
+
+    // Arms poll request for event_source on the ring of thread_index.
+    // Multishot poll that is terminated by the kernel (ie. completion queue overflow) is armed again,
+    // one that fails is reported with an error event once. Handle of a multishot poll must not be
+    // used by other polls on the same ring while it's armed.
+    void AddEvent(size_t thread_index, EpollEventSource &event_source, uint32_t event_flags, void *user_handle);
+
+    // Cancels poll that is still armed. Can be called from any thread.
+    void RemoveEvent(size_t thread_index, EpollEventSource &event_source);
+
+    // Submits io request on the ring of thread_index. Completion is reported as an event
+    // with user_handle, request.result is filled before that. Request must stay alive until completion.
+    // Timeout is implemented with linked timeout request.
+    void SubmitIoRequest(size_t thread_index, EventIoRequest &request, void *user_handle);
+
+    // Submits multishot request on the ring of thread_index. Every completion is queued
+    // in the request and reported as an event with user_handle.
+    void SubmitMultishot(size_t thread_index, EventMultishotRequest &request, void *user_handle);
+
+    // Cancels armed multishot request. Request completes with -ECANCELED (or with its own result
+    // if it was ending anyway) and is no longer armed after that. Can be called from any thread.
+    void CancelMultishot(size_t thread_index, EventMultishotRequest &request);
+
+    // true if rings have buffers for multishot recv (IORING_REGISTER_PBUF_RING, 5.19+).
+    bool SupportsRecvBuffers() const { return recv_buffers_supported_; }
+
+    // Data received into the buffer of a recv completion.
+    DataSpan RecvData(const EventMultishotRequest &request, const EventMultishotRequest::Completion &completion) const;
+
+    // Gives the buffer back to the ring recv request was submitted on. Can be called from any thread.
+    void ReleaseRecvBuffer(const EventMultishotRequest &request, uint32_t buffer);
+
+    // Submits pending requests and waits for completions of this thread's ring.
+    Span<Event> Wait(size_t thread_index, int timeout_msec);
+
+    // Waits on the ring of a thread that never submits anything: returns once the thread
+    // is interrupted or timeout expires.
+    void Park(size_t thread_index, int timeout_msec);
+
+    // Wakes up specific thread.
+    // thread_index = -1 - means no preference.
+    void Interrupt(size_t thread_index = ~size_t());
+
+    // Interrupts waits of all threads.
+    void InterruptAll();
+private:
+    // Multishot poll armed by AddEvent. Kept until it's removed and its last poll request completes.
+    struct MultishotPoll {
+        int fd_ = -1;
+        uint32_t poll_events_ = 0;
+        uint32_t num_armed_ = 0; // Poll requests with this handle that are still in the kernel.
+        bool removed_ = false;
+    };
+
+    // Single io_uring instance with its mmaped rings.
+    struct alignas(k_cache_line_size) Ring {
+        int fd_ = -1;
+
+        // Submission queue.
+        std::mutex sq_mutex_; // Only contended when other threads cancel polls on this ring.
+        std::atomic<unsigned> *sq_head_ = nullptr;
+        std::atomic<unsigned> *sq_tail_ = nullptr;
+        unsigned sq_local_tail_ = 0; // Filled but not yet published entries end here.
+        unsigned *sq_array_ = nullptr;
+        unsigned sq_mask_ = 0;
+        unsigned sq_entries_ = 0;
+        io_uring_sqe *sqes_ = nullptr;
+
+        // Completion queue.
+        std::atomic<unsigned> *cq_head_ = nullptr;
+        std::atomic<unsigned> *cq_tail_ = nullptr;
+        unsigned cq_mask_ = 0;
+        io_uring_cqe *cqes_ = nullptr;
+
+        void *sq_ring_ptr_ = nullptr;
+        size_t sq_ring_size_ = 0;
+        void *cq_ring_ptr_ = nullptr;
+        size_t cq_ring_size_ = 0;
+        size_t sqes_size_ = 0;
+
+        // Wakeup eventfd with a read request always armed on it.
+        int wakeup_fd_ = -1;
+        uint64_t wakeup_value_ = 0;
+
+        Event *events_ = nullptr; // Completions converted to events.
+
+        // Guarded by sq_mutex_.
+        HashMap<EventUserHandle, MultishotPoll> multishot_polls_;
+
+        // Provided buffers multishot recv requests receive into. Tail is guarded by sq_mutex_.
+        io_uring_buf_ring *buf_ring_ = nullptr;
+        size_t buf_ring_size_ = 0;
+        uint8_t *recv_buffers_ = nullptr;
+        uint16_t buf_ring_tail_ = 0;
+    };
+
+    Dep<Log> log_;
+    Ring *rings_ = nullptr;
+    size_t num_threads_ = 0;
+    unsigned thread_max_events_ = 0;
+    std::atomic<size_t> next_interrupt_;
+    bool recv_buffers_supported_ = true;
+
+    UringEventQueue(Dep<Log> log, size_t thread_max_events_at_once, size_t num_threads);
+
+    bool InitRing(Ring &ring);
+    // Registers provided buffers with the ring. Returns false if kernel doesn't support them.
+    bool InitRecvBuffers(Ring &ring);
+    // Makes buffer available to the kernel again. Ring's sq_mutex_ must be locked.
+    static void PushRecvBuffer(Ring &ring, uint16_t buffer);
+    void DestroyRing(Ring &ring);
+
+    // Returns sqe to fill. Ring's sq_mutex_ must be locked.
+    io_uring_sqe *NextSqe(Ring &ring);
+    // Makes filled sqes visible to the kernel. Ring's sq_mutex_ must be locked.
+    static void Publish(Ring &ring);
+    void ArmWakeup(Ring &ring);
+    // Submits poll request. Ring's sq_mutex_ must be locked.
+    void SubmitPoll(Ring &ring, int fd, uint32_t poll_events, bool multishot, EventUserHandle user_handle);
+    // Handles completion of the last event of a multishot poll. Arms it again if it wasn't removed or failed.
+    void RetireMultishot(Ring &ring, EventUserHandle user_handle, int result);
+
+    // Converts available completions into events that follow nevents already reaped ones.
+    // Returns total number of events.
+    size_t ReapCompletions(Ring &ring, size_t nevents);
+};
+
+} // xynq
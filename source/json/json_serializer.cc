@@ -49,7 +49,6 @@ SerializerResult JsonSerializer::Serialize(StrSpan str) {
 
 SerializerResult JsonSerializer::FinalizeWrite() {
     writer_.Write('\n');
-    writer_.Flush();
     if (writer_.IsGood()) {
         return SerializerSuccess{};
     } else {
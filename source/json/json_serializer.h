@@ -7,6 +7,9 @@ namespace xynq {
 
 class StreamWriter;
 
+// Writes every serialized value as a single line of json.
+// Output stays in the writer buffer: flushing it is up to the owner of the writer,
+// so responses to pipelined requests can go out together.
 class JsonSerializer final : public Serializer {
 public:
     JsonSerializer(StreamWriter &writer);
@@ -3,15 +3,45 @@
 
 #include "base/log.h"
 #include "base/span.h"
+#include "binary/binary_protocol.h"
 #include "json/json_serializer.h"
 #include "slang/slang.h"
 #include "task/task_context.h"
 
+#include "os/utils.h"
+
 using namespace xynq;
 using namespace xynq::slang;
 
 DefineTaggedLog(Endpoint)
 
+namespace {
+
+// Endpoint input that flushes pending responses before reading more requests from the stream:
+// buffered requests are all served by then, and peer might wait for the responses before sending more.
+class FlushingInStream final : public InStream {
+public:
+    FlushingInStream(InStream &stream, StreamWriter &writer)
+        : stream_(stream)
+        , writer_(writer) {
+        name_ = stream.Name();
+    }
+
+protected:
+    Either<StreamError, size_t> DoRead(MutDataSpan read_buf) final {
+        if (writer_.BufferedSize() > 0 && writer_.Flush().IsLeft()) {
+            return writer_.Stream().LastError();
+        }
+        return stream_.Read(read_buf);
+    }
+
+private:
+    InStream &stream_;
+    StreamWriter &writer_;
+};
+
+} // anon namespace
+
 using namespace xynq;
 Endpoint::Endpoint(StrSpan name, InOutStream *io)
     : name_{name}
@@ -41,21 +71,71 @@ void Endpoint::Serve(TaskContext *tc) {
 }
 
 void Endpoint::ServeCommandMode(TaskContext *tc) {
+    SharedDeps &deps = tc->UserData<SharedDeps>();
     slang::Context context {
-        tc->UserData<SharedDeps>().slang_env,
+        deps.slang_env,
         allocator_,
-        &(tc->UserData<SharedDeps>())
+        &deps
     };
 
-    StreamReader request_reader(MutDataSpan{&in_buf_[0], sizeof(in_buf_)}, *io_);
+    const EndpointParameters &params = deps.endpoint_params;
+
     StreamWriter response_writer(MutDataSpan{&out_buf_[0], sizeof(out_buf_)}, *io_);
+    FlushingInStream request_stream(*io_, response_writer);
+    StreamReader request_reader(MutDataSpan{&in_buf_[0], sizeof(in_buf_)}, request_stream);
     JsonSerializer output_serializer(response_writer);
+    BinaryRequestHandler binary_handler(deps.storage, deps.types);
+
+    // Binary protocol clients start the connection with the magic byte.
+    auto first_read = request_reader.AvailableOrRead();
+    if (first_read.IsRight() && first_read.Right().Size() > 0 &&
+        *(const uint8_t *)first_read.Right().Data() == kBinaryProtocolMagic) {
+        request_reader.Advance(1);
+        data_format_ = EndpointDataFormat::Binary;
+        XYEndpointInfo(tc->Log(), "Endpoint '", name_, "' uses binary protocol");
+    }
 
+    uint64_t pending_since_usec = 0; // When the oldest pending response was started.
     while (request_reader.IsGood() && response_writer.IsGood()) {
-        slang::Execute(request_reader, output_serializer, context);
-        allocator_->Purge();
+        if (params.coalesce_responses && response_writer.BufferedSize() == 0) {
+            pending_since_usec = platform::MonotonicTimeUsec();
+        }
+
+        if (data_format_ == EndpointDataFormat::Binary) {
+            binary_handler.Process(request_reader, response_writer);
+        } else {
+            slang::Execute(request_reader, output_serializer, context);
+            allocator_->Purge();
+        }
+
+        // Pipelined requests that keep coming must not delay earlier responses for too long.
+        if (response_writer.BufferedSize() > 0 &&
+            (!params.coalesce_responses ||
+             platform::MonotonicTimeUsec() - pending_since_usec >= params.coalesce_max_delay_usec)) {
+            response_writer.Flush();
+        }
     }
 
     XYEndpointInfo(tc->Log(), "Data stream closed. Will drop endpoint: ", name_);
     SetMode(EndpointMode::None);
 }
+
+size_t xynq::ServeEndpointDatagram(TaskContext *tc, MutDataSpan datagram, MutDataSpan reply_buf) {
+    SharedDeps &deps = tc->UserData<SharedDeps>();
+
+    // Requests are read right from the datagram, responses are never flushed: both streams are closed.
+    DummyInStream no_input;
+    DummyOutStream no_output;
+    StreamReader request_reader(datagram, no_input, datagram.Size());
+    StreamWriter response_writer(reply_buf, no_output);
+    BinaryRequestHandler binary_handler(deps.storage, deps.types);
+
+    while (request_reader.Available().Size() > 0) {
+        if (!binary_handler.Process(request_reader, response_writer)) {
+            break;
+        }
+    }
+
+    // Stream error means responses didn't fit into the buffer.
+    return response_writer.IsGood() ? response_writer.BufferedSize() : 0;
+}
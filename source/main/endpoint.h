@@ -20,8 +20,20 @@ enum class EndpointMode {
 
 // Data format.
 enum class EndpointDataFormat {
-    // JSON.
+    // Slang requests, JSON responses.
     Json,
+    // Length-prefixed binary frames. See binary/binary_protocol.h.
+    Binary,
+};
+
+// Endpoint configuration parameters.
+struct EndpointParameters {
+    // Responses to pipelined requests that are already received are buffered and written out together.
+    // Pending responses are flushed before waiting for more requests, once the output buffer is full
+    // or once the oldest of them has been waiting for coalesce_max_delay_usec.
+    // Otherwise every response is flushed right away.
+    bool coalesce_responses = true;
+    uint64_t coalesce_max_delay_usec = 1000;
 };
 
 class Endpoint {
@@ -34,11 +46,15 @@ public:
     // Stream mode. See EndpointMode comments.
     EndpointMode Mode() const { return mode_; }
 
+    // Format negotiated with the peer once the connection starts.
+    EndpointDataFormat DataFormat() const { return data_format_; }
+
     void Serve(TaskContext *tc);
 private:
     StrSpan name_;
     InOutStream *io_ = nullptr;
     EndpointMode mode_ = EndpointMode::Repl;
+    EndpointDataFormat data_format_ = EndpointDataFormat::Json;
     Dependable<ScratchAllocator> allocator_; // per entry point memory.
 
     // Buffer used for IO buffering.
@@ -49,4 +65,8 @@ private:
     void SetMode(EndpointMode mode);
 };
 
+// Serves binary protocol requests that came in a single datagram (see UdpManager).
+// Responses are written into reply_buf. Returns their size, 0 - no reply (ie. it doesn't fit).
+size_t ServeEndpointDatagram(TaskContext *tc, MutDataSpan datagram, MutDataSpan reply_buf);
+
 } // xynq
@@ -13,6 +13,7 @@ namespace xynq {
 
 struct ExecuteFiles : public TaskDefaults {
     static constexpr auto debug_name = "ExecuteFiles";
+    static constexpr unsigned stack_size = 16 * 1024; // Runs slang programs.
 
     static constexpr auto exec = [](TaskContext *tc, Vec<CStrSpan> files) {
         Dependable<ScratchAllocator> allocator = ScratchAllocator{};
@@ -0,0 +1,42 @@
+#pragma once
+
+#include "shared_deps.h"
+
+#include "base/log.h"
+#include "task/task.h"
+#include "task/task_context.h"
+
+DefineTaggedLog(TaskStats)
+
+namespace xynq {
+
+// Writes scheduler counters of all workers into the log.
+struct LogTaskStats : public TaskDefaults {
+    static constexpr auto debug_name = "LogTaskStats";
+    static constexpr TaskPriority priority = TaskPriority::Bulk;
+
+    static constexpr auto exec = [](TaskContext *tc) {
+        TaskStats stats = tc->UserData<SharedDeps>().tasks->Stats();
+        XYTaskStatsInfo(tc->Log(), "Tasks: created=", stats.tasks_created,
+                                   " alive=", stats.TasksAlive(),
+                                   " executed=", stats.tasks_executed,
+                                   " resumed=", stats.tasks_resumed,
+                                   " yields=", stats.yields,
+                                   " steals=", stats.steals_succeeded, '/', stats.steals_attempted,
+                                   " event_wakeups=", stats.event_wakeups,
+                                   " idle_usec=", stats.idle_usec,
+                                   " max_queue_depth=", stats.max_queue_depth,
+                                   " fibers_cached=", stats.fibers_cached);
+    };
+};
+
+// Entry point that schedules LogTaskStats every interval_msec.
+struct StartTaskStatsLog : public TaskDefaults {
+    static constexpr auto debug_name = "StartTaskStatsLog";
+
+    static constexpr auto exec = [](TaskContext *tc, uint64_t interval_msec) {
+        tc->PerformPeriodic<LogTaskStats>(interval_msec);
+    };
+};
+
+} // xynq
@@ -1,4 +1,5 @@
 #include "execute_files.h"
+#include "log_task_stats.h"
 #include "json_payload_handler.h"
 #include "shared_deps.h"
 #include "slang_env.h"
@@ -15,6 +16,7 @@
 #include "main/echo_server.h"
 #include "main/endpoint_handler.h"
 #include "net/tcp.h"
+#include "net/udp.h"
 #include "task/task_manager.h"
 #include "task/task_context.h"
 #include "types/type_vault.h"
@@ -165,12 +167,54 @@ Maybe<TaskManager *> CreateTaskManager(Dep<Log> log, Dep<Config> conf) {
     bool pin_threads = conf->Get<bool>("task.pin-threads")
         .RightOrDefault(true);
 
+    bool numa_aware = conf->Get<bool>("task.numa")
+        .RightOrDefault(true);
+
+    uint64_t max_spin_usec = conf->Get<uint64_t>("task.max-spin-usec")
+        .RightOrDefault(50);
+
+    size_t num_io_threads = conf->Get<size_t>("task.io-threads").RightOrDefault(0);
+
+    CStrSpan event_backend_str = conf->Get<CStrSpan>("events.backend").RightOrDefault("epoll");
+    auto event_backend = EventBackendFromString(event_backend_str);
+    if (!event_backend.HasValue()) {
+        XYMainError(log, "Invalid event backend. Must be 'epoll' or 'io_uring'. (events.backend=", event_backend_str.CStr(), ").");
+        return {};
+    }
+
     return CreateObject<TaskManager>(SystemAllocator::Shared(),
                                      log,
                                      static_cast<size_t>(max_events_at_once),
                                      static_cast<size_t>(num_threads),
                                      pin_threads,
-                                     true);
+                                     true,
+                                     event_backend.Value(),
+                                     numa_aware,
+                                     max_spin_usec,
+                                     num_io_threads);
+}
+
+// Tcp parameters. Also used by unix domain sockets.
+TcpParameters ReadTcpParameters(Dep<Config> conf) {
+    TcpParameters tcp_params;
+    tcp_params.listen_backlog = conf->Get<int>("tcp.listen-backlog").RightOrDefault(512);
+    tcp_params.reuse_addr = conf->Get<bool>("tcp.reuse-bind-addr").RightOrDefault(false);
+    tcp_params.keep_alive.enable = conf->Get<bool>("tcp.keep-alive.enable").RightOrDefault(false);
+    tcp_params.keep_alive.idle_sec = conf->Get<int>("tcp.keep-alive.idle").RightOrDefault(20);
+    tcp_params.keep_alive.interval_sec = conf->Get<int>("tcp.keep-alive.interval").RightOrDefault(20);
+    tcp_params.keep_alive.num_probes = conf->Get<int>("tcp.keep-alive.probes").RightOrDefault(8);
+    tcp_params.io_timeout_msec = conf->Get<int>("tcp.io-timeout-msec").RightOrDefault(0);
+    tcp_params.accept_per_worker = conf->Get<bool>("tcp.accept-per-worker").RightOrDefault(false);
+    tcp_params.pin_connections = conf->Get<bool>("tcp.pin-connections").RightOrDefault(false);
+    tcp_params.optimistic_io = conf->Get<bool>("tcp.optimistic-io").RightOrDefault(false);
+    tcp_params.zerocopy_min_size = conf->Get<int>("tcp.zerocopy-min-size").RightOrDefault(0);
+    tcp_params.no_delay = conf->Get<bool>("tcp.no-delay").RightOrDefault(false);
+    return tcp_params;
+}
+
+// Serves tcp, unix domain socket and shared memory streams.
+void ServeStream(TaskContext *tc, StrSpan name, InOutStream *io_stream) {
+    tc->PerformSync<EndpointHandler>(name, io_stream);
 }
 
 Maybe<TcpManager> CreateTcpManager(Dep<Log> log, Dep<Config> conf, Dep<TaskManager> tasks) {
@@ -182,19 +226,63 @@ Maybe<TcpManager> CreateTcpManager(Dep<Log> log, Dep<Config> conf, Dep<TaskManag
         return {};
     }
 
-    TcpParameters tcp_params;
-    tcp_params.listen_backlog = conf->Get<int>("tcp.listen-backlog").RightOrDefault(512);
-    tcp_params.reuse_addr = conf->Get<bool>("tcp.reuse-bind-addr").RightOrDefault(false);
-    tcp_params.keep_alive.enable = conf->Get<bool>("tcp.keep-alive.enable").RightOrDefault(false);
-    tcp_params.keep_alive.idle_sec = conf->Get<int>("tcp.keep-alive.idle").RightOrDefault(20);
-    tcp_params.keep_alive.interval_sec = conf->Get<int>("tcp.keep-alive.interval").RightOrDefault(20);
-    tcp_params.keep_alive.num_probes = conf->Get<int>("tcp.keep-alive.probes").RightOrDefault(8);
+    return TcpManager::Create(log, tasks, ReadTcpParameters(conf), Span<CStrSpan>{addrs_result.Value()}, ServeStream);
+}
 
-    TcpNewStreamHandler stream_handler = [](TaskContext *tc, StrSpan name, InOutStream *io_stream) {
-        tc->PerformSync<EndpointHandler>(name, io_stream);
-    };
+// Udp. Only receives datagrams if there are addresses to bind to.
+Maybe<UdpManager> CreateUdpManager(Dep<Log> log, Dep<Config> conf, Dep<TaskManager> tasks) {
+    UdpParameters udp_params;
+    udp_params.batch_size = conf->Get<size_t>("udp.batch-size").RightOrDefault(32);
+    udp_params.max_datagram_size = conf->Get<size_t>("udp.max-datagram-size").RightOrDefault(1472);
+    udp_params.peer_timeout_msec = conf->Get<int>("udp.peer-timeout-msec").RightOrDefault(10000);
+
+    auto addrs_list = conf->GetList("udp.bind");
+    if (addrs_list.IsLeft()) {
+        return UdpManager::Create(log, tasks, udp_params, Span<CStrSpan>{}, ServeEndpointDatagram);
+    }
 
-    return TcpManager::Create(log, tasks, tcp_params, Span<CStrSpan>{addrs_result.Value()}, stream_handler);
+    auto addrs_result = addrs_list.Right().AsArray<CStrSpan>();
+    if (!addrs_result.HasValue()) {
+        XYMainError(log, "Udp bind addresses list is invalid. Should be list of strings like 'ip:port'");
+        return {};
+    }
+
+    return UdpManager::Create(log, tasks, udp_params, Span<CStrSpan>{addrs_result.Value()}, ServeEndpointDatagram);
+}
+
+// Unix domain socket paths from the list under key. No list - no paths.
+Maybe<Vec<CStrSpan>> ReadBindPaths(Dep<Log> log, Dep<Config> conf, CStrSpan key) {
+    auto paths_list = conf->GetList(key);
+    if (paths_list.IsLeft()) {
+        return Vec<CStrSpan>{};
+    }
+
+    auto paths_result = paths_list.Right().AsArray<CStrSpan>();
+    if (!paths_result.HasValue()) {
+        XYMainError(log, "Unix socket paths list (", key.CStr(), ") is invalid. Should be list of strings like '/run/xynq.sock'");
+    }
+    return paths_result;
+}
+
+// Unix domain sockets. Only listens if there are paths to bind to.
+Maybe<UdsManager> CreateUdsManager(Dep<Log> log, Dep<Config> conf, Dep<TaskManager> tasks) {
+    auto paths = ReadBindPaths(log, conf, "uds.bind");
+    auto shm_paths = ReadBindPaths(log, conf, "uds.shm-bind");
+    if (!paths.HasValue() || !shm_paths.HasValue()) {
+        return {};
+    }
+
+    return UdsManager::Create(log, tasks, ReadTcpParameters(conf),
+                              Span<CStrSpan>{paths.Value()}, Span<CStrSpan>{shm_paths.Value()},
+                              ServeStream);
+}
+
+// Endpoints.
+EndpointParameters ReadEndpointParameters(Dep<Config> conf) {
+    EndpointParameters params;
+    params.coalesce_responses = conf->Get<bool>("endpoint.coalesce-responses").RightOrDefault(true);
+    params.coalesce_max_delay_usec = conf->Get<uint64_t>("endpoint.coalesce-max-delay-usec").RightOrDefault(1000);
+    return params;
 }
 
 // Storage.
@@ -217,6 +305,15 @@ bool ScheduleConfigExecs(Dep<Config> conf, Dep<TaskManager> task_manager) {
     return true;
 }
 
+void ScheduleStatsLog(Dep<Config> conf, Dep<TaskManager> task_manager) {
+    uint64_t interval_sec = conf->Get<uint64_t>("task.stats-interval-sec").RightOrDefault(0);
+    if (interval_sec == 0) {
+        return;
+    }
+
+    task_manager->AddEntryPoint<StartTaskStatsLog>(interval_sec * 1000);
+}
+
 // Exit handler.
 std::function<void(int)> platform_exit_handler;
 std::function<void(const char *str)> platform_log_handler;
@@ -295,12 +392,27 @@ int XYEntrypoint(int argc, char *argv[]) {
 
     Dependable<TaskManager *> task_manager = create_tasks.Value();
 
+    // Endpoints.
+    EndpointParameters endpoint_params = ReadEndpointParameters(config);
+
     // Tcp.
     auto create_tcp = CreateTcpManager(log, config, task_manager);
     if (!create_tcp.HasValue()) {
         return -1;
     }
 
+    // Udp.
+    auto create_udp = CreateUdpManager(log, config, task_manager);
+    if (!create_udp.HasValue()) {
+        return -1;
+    }
+
+    // Unix domain sockets.
+    auto create_uds = CreateUdsManager(log, config, task_manager);
+    if (!create_uds.HasValue()) {
+        return -1;
+    }
+
     // Exit handler.
     CreateExitHandler(log, task_manager);
 
@@ -309,9 +421,12 @@ int XYEntrypoint(int argc, char *argv[]) {
         return -1;
     }
 
+    // Periodic scheduler counters in the log.
+    ScheduleStatsLog(config, task_manager);
+
     // Initialize per thread user-data.
     task_manager->hooks.before_thread_start.Add([&](size_t /*thread_index*/, Dep<Log> log, ThreadUserDataStorage &store){
-        SharedDeps *deps = new (&store) SharedDeps{slang_env, storage, type_manager->CreateVault(log)};
+        SharedDeps *deps = new (&store) SharedDeps{slang_env, storage, type_manager->CreateVault(log), task_manager, endpoint_params};
         XYAssert((void *)deps == &store);
     });
     task_manager->hooks.after_thread_stop.Add([&](size_t /*thread_index*/, ThreadUserDataStorage &store){
@@ -1,9 +1,12 @@
 #pragma once
 
+#include "endpoint.h"
+
 #include "slang/env.h"
 
 #include "base/dep.h"
 #include "storage/storage.h"
+#include "task/task_manager.h"
 #include "types/type_vault.h"
 
 namespace xynq {
@@ -12,6 +15,8 @@ struct SharedDeps {
     Dep<slang::Env> slang_env;
     Dep<Storage> storage;
     Dep<TypeVault> types;
+    Dep<TaskManager> tasks;
+    EndpointParameters endpoint_params;
 };
 
 } // xynq
@@ -177,6 +177,17 @@ slang::Env xynq::CreateSlangEnv(Dep<JsonPayloadHandler> json_payload_handler) {
         return schema != k_types_invalid_schema;
     };
 
+    // Scheduler counters summed over all worker threads.
+    // Signature: (stats) -> name value pairs.
+    func_table["stats"] = [](slang::CallContext &call_context) -> bool {
+        SharedDeps &deps = call_context.UserData<SharedDeps>();
+        deps.tasks->Stats().Enumerate([&](CStrSpan name, uint64_t value) {
+            call_context.output->Add((const StrSpan &)name);
+            call_context.output->Add(value);
+        });
+        return true;
+    };
+
     RegisterMathFunctions(func_table);
 
     PayloadHandlerTable payload_handlers;
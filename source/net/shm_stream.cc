@@ -0,0 +1,308 @@
+#include "shm_stream.h"
+#include "socket_utils.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+
+using namespace xynq;
+
+DefineTaggedLog(Shm);
+
+namespace {
+
+// Sleeping task wakes up this often to check if the client is still alive.
+const uint64_t kShmLivenessCheckMsec = 1000;
+
+static_assert(sizeof(ShmRegionHeader) <= k_cache_line_size, "Rings headers start at the next cache line");
+
+} // anon namespace
+
+
+// ShmRing.
+ShmRing::ShmRing(ShmRingHeader *header, uint8_t *data, size_t capacity)
+    : header_(header)
+    , data_(data)
+    , capacity_(capacity) {
+    XYAssert((capacity & (capacity - 1)) == 0);
+}
+
+Maybe<size_t> ShmRing::Write(DataSpan data) {
+    uint64_t head = header_->head.load(std::memory_order_relaxed);
+    uint64_t tail = header_->tail.load(std::memory_order_acquire);
+    uint64_t used = head - tail;
+    if (used > capacity_) {
+        return {};
+    }
+
+    size_t size = std::min(data.Size(), (size_t)(capacity_ - used));
+    size_t offset = head & (capacity_ - 1);
+    size_t first_size = std::min(size, capacity_ - offset);
+    memcpy(data_ + offset, data.Data(), first_size);
+    memcpy(data_, (const uint8_t *)data.Data() + first_size, size - first_size);
+
+    // Sequentially consistent to order it before reader_waiting check.
+    header_->head.store(head + size, std::memory_order_seq_cst);
+    return size;
+}
+
+Maybe<size_t> ShmRing::Read(MutDataSpan buf) {
+    uint64_t tail = header_->tail.load(std::memory_order_relaxed);
+    uint64_t head = header_->head.load(std::memory_order_acquire);
+    uint64_t available = head - tail;
+    if (available > capacity_) {
+        return {};
+    }
+
+    size_t size = std::min(buf.Size(), (size_t)available);
+    size_t offset = tail & (capacity_ - 1);
+    size_t first_size = std::min(size, capacity_ - offset);
+    memcpy(buf.Data(), data_ + offset, first_size);
+    memcpy((uint8_t *)buf.Data() + first_size, data_, size - first_size);
+
+    // Sequentially consistent to order it before writer_waiting check.
+    header_->tail.store(tail + size, std::memory_order_seq_cst);
+    return size;
+}
+
+bool ShmRing::PrepareWaitWrite() {
+    header_->writer_waiting.store(1, std::memory_order_seq_cst);
+    uint64_t used = header_->head.load(std::memory_order_relaxed) - header_->tail.load(std::memory_order_seq_cst);
+    return used >= capacity_;
+}
+
+bool ShmRing::PrepareWaitRead() {
+    header_->reader_waiting.store(1, std::memory_order_seq_cst);
+    return header_->head.load(std::memory_order_seq_cst) == header_->tail.load(std::memory_order_relaxed);
+}
+
+bool ShmRing::TakeReaderWaiting() {
+    return header_->reader_waiting.load(std::memory_order_seq_cst) != 0
+        && header_->reader_waiting.exchange(0, std::memory_order_seq_cst) != 0;
+}
+
+bool ShmRing::TakeWriterWaiting() {
+    return header_->writer_waiting.load(std::memory_order_seq_cst) != 0
+        && header_->writer_waiting.exchange(0, std::memory_order_seq_cst) != 0;
+}
+////////////////////////////////////////////////////////////
+
+
+// ShmRegion.
+Maybe<ShmRegion> ShmRegion::Map(Log *log, int region_fd) {
+    struct stat region_stat;
+    if (fstat(region_fd, &region_stat) < 0) {
+        XYShmError(log, "Failed to get region size. Error=(", errno, ", ", strerror(errno), ')');
+        return {};
+    }
+
+#if defined(F_GET_SEALS)
+    int seals = fcntl(region_fd, F_GET_SEALS);
+    if (seals < 0 || (seals & F_SEAL_SHRINK) == 0) {
+        XYShmError(log, "Region size is not sealed.");
+        return {};
+    }
+#endif
+
+    size_t size = (size_t)region_stat.st_size;
+    if (size < ShmRegionSize(0)) {
+        XYShmError(log, "Region is too small: ", size);
+        return {};
+    }
+
+    void *memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, region_fd, 0);
+    if (memory == MAP_FAILED) {
+        XYShmError(log, "Failed to map region. Error=(", errno, ", ", strerror(errno), ')');
+        return {};
+    }
+
+    ShmRegion region;
+    region.memory_ = memory;
+    region.size_ = size;
+
+    // Capacity is read once: client can still change the header afterwards.
+    const ShmRegionHeader *header = region.Header();
+    uint64_t capacity = header->ring_capacity;
+    if (header->magic != kShmRegionMagic) {
+        XYShmError(log, "Region has no magic.");
+        return {};
+    }
+
+    if (capacity == 0 || capacity > kShmMaxRingCapacity || (capacity & (capacity - 1)) != 0
+        || ShmRegionSize(capacity) != size) {
+        XYShmError(log, "Invalid ring capacity ", capacity, " for region of ", size, " bytes.");
+        return {};
+    }
+
+    uint8_t *rings = (uint8_t *)memory + k_cache_line_size;
+    uint8_t *data = rings + 2 * sizeof(ShmRingHeader);
+    region.requests_ = ShmRing{(ShmRingHeader *)rings, data, capacity};
+    region.responses_ = ShmRing{(ShmRingHeader *)rings + 1, data + capacity, capacity};
+    return std::move(region);
+}
+
+ShmRegion::ShmRegion(ShmRegion &&rhs)
+    : memory_(rhs.memory_)
+    , size_(rhs.size_)
+    , requests_(rhs.requests_)
+    , responses_(rhs.responses_) {
+    rhs.memory_ = nullptr;
+    rhs.size_ = 0;
+}
+
+ShmRegion::~ShmRegion() {
+    if (memory_ != nullptr) {
+        munmap(memory_, size_);
+    }
+}
+////////////////////////////////////////////////////////////
+
+
+// ShmStream.
+ShmStream::ShmStream(TaskContext &tc,
+                     StrSpan name,
+                     ShmRegion &region,
+                     int server_doorbell,
+                     int client_doorbell,
+                     int control_sock,
+                     int io_timeout_msec)
+    : tc_(tc)
+    , name_(name)
+    , region_(region)
+    , server_doorbell_(server_doorbell)
+    , client_doorbell_(client_doorbell)
+    , control_sock_(control_sock)
+    , io_timeout_msec_(io_timeout_msec)
+    , doorbell_source_(server_doorbell) {
+}
+
+ShmStream::~ShmStream() {
+    tc_.EventQueue()->RemoveEvent(tc_.ThreadIndex(), doorbell_source_);
+
+    // Client might be sleeping on a read.
+    region_.Header()->closed.store(1, std::memory_order_seq_cst);
+    RingClient();
+}
+
+Either<StreamError, size_t> ShmStream::DoRead(MutDataSpan read_buf) {
+    ShmRing &requests = region_.Requests();
+    uint64_t wait_start_msec = 0;
+    while (true) {
+        // Checked before reading: requests that were written before closing are still served.
+        bool closed = IsClosed();
+        Maybe<size_t> received = requests.Read(read_buf);
+        if (!received) {
+            XYShmWarning(tc_.Log(), "Corrupted requests ring (", name_, "). Disconnecting.");
+            return StreamError::IOError;
+        }
+
+        if (received.Value() > 0) {
+            if (requests.TakeWriterWaiting()) {
+                RingClient();
+            }
+            return received.Value();
+        }
+
+        if (closed) {
+            XYShmInfo(tc_.Log(), "Disconnected: ", name_);
+            return StreamError::Closed;
+        }
+
+        if (requests.PrepareWaitRead()) {
+            StreamError error = WaitDoorbell(wait_start_msec);
+            if (error != StreamError::None) {
+                return error;
+            }
+        }
+    }
+}
+
+Either<StreamError, StreamWriteSuccess> ShmStream::DoWrite(DataSpan write_buf) {
+    ShmRing &responses = region_.Responses();
+    uint64_t wait_start_msec = 0;
+    while (true) {
+        Maybe<size_t> sent = responses.Write(write_buf);
+        if (!sent) {
+            XYShmWarning(tc_.Log(), "Corrupted responses ring (", name_, "). Disconnecting.");
+            return StreamError::IOError;
+        }
+
+        if (sent.Value() > 0) {
+            write_buf = DataSpan{(const uint8_t *)write_buf.Data() + sent.Value(), write_buf.Size() - sent.Value()};
+            if (responses.TakeReaderWaiting()) {
+                RingClient();
+            }
+            wait_start_msec = 0;
+        }
+
+        if (write_buf.Size() == 0) {
+            return StreamWriteSuccess{};
+        }
+
+        if (IsClosed()) {
+            XYShmInfo(tc_.Log(), "Disconnected: ", name_);
+            return StreamError::Closed;
+        }
+
+        if (responses.PrepareWaitWrite()) {
+            StreamError error = WaitDoorbell(wait_start_msec);
+            if (error != StreamError::None) {
+                return error;
+            }
+        }
+    }
+}
+
+StreamError ShmStream::WaitDoorbell(uint64_t &wait_start_msec) {
+    uint64_t now = TaskContext::NowMsec();
+    if (wait_start_msec == 0) {
+        wait_start_msec = now;
+    }
+
+    uint64_t deadline = now + kShmLivenessCheckMsec;
+    if (io_timeout_msec_ > 0) {
+        uint64_t timeout_deadline = wait_start_msec + io_timeout_msec_;
+        if (now >= timeout_deadline) {
+            XYShmInfo(tc_.Log(), "Timed out (", name_, "). Disconnecting.");
+            return StreamError::Timeout;
+        }
+        deadline = std::min(deadline, timeout_deadline);
+    }
+
+    if (tc_.WaitEvent(&doorbell_source_, EventFlags::Read | EventFlags::ExactlyOnce, deadline)) {
+        uint64_t value;
+        while (read(server_doorbell_, &value, sizeof(value)) < 0 && errno == EINTR) { // eventfd resets its counter on read.
+        }
+        return StreamError::None;
+    }
+
+    // Client that crashed never sets the closed flag.
+    if (!IsClientAlive()) {
+        XYShmInfo(tc_.Log(), "Client has gone (", name_, "). Disconnecting.");
+        return StreamError::Closed;
+    }
+    return StreamError::None;
+}
+
+bool ShmStream::IsClientAlive() {
+    char byte;
+    ssize_t received = recv(control_sock_, &byte, sizeof(byte), MSG_PEEK | MSG_DONTWAIT);
+    return received > 0 || (received < 0 && IsInProgress(errno));
+}
+
+bool ShmStream::IsClosed() {
+    return region_.Header()->closed.load(std::memory_order_acquire) != 0;
+}
+
+void ShmStream::RingClient() {
+    uint64_t value = 1;
+    if (write(client_doorbell_, &value, sizeof(value)) < 0 && !IsInProgress(errno)) {
+        XYShmVerbose(tc_.Log(), "Failed to ring client doorbell (", name_, "). Error=", errno, ", ", strerror(errno));
+    }
+}
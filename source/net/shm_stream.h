@@ -0,0 +1,155 @@
+#pragma once
+
+#include "base/log.h"
+#include "base/maybe.h"
+#include "base/platform_def.h"
+#include "base/span.h"
+#include "base/stream.h"
+#include "task/task_context.h"
+
+#include <atomic>
+#include <stdint.h>
+
+namespace xynq {
+
+// Shared memory transport for clients running on the same host as the server.
+// Requests and responses are copied straight into a memory region mapped by both processes,
+// neither of them goes through a socket.
+//
+// Region is created by the client (ie. with memfd_create), see ShmRegionSize for its layout:
+//   [ShmRegionHeader][requests ShmRingHeader][responses ShmRingHeader][requests data][responses data]
+// All of it is zeroed except ShmRegionHeader::magic and ring_capacity. Region size must be sealed
+// (F_SEAL_SHRINK | F_SEAL_GROW) so the client can't truncate it under the server.
+// Client also creates two eventfd doorbells: server doorbell is rung by the client, client doorbell
+// is rung by the server.
+//
+// Handshake: client connects to the unix socket the server listens for shared memory clients on
+// (see UdsManager) and sends a single byte with region, server doorbell and client doorbell
+// fds attached (SCM_RIGHTS), in that order. Socket stays open for the whole session,
+// closing it or setting ShmRegionHeader::closed ends the session.
+//
+// Each ring has a single producer and a single consumer. Side that finds its ring empty (full)
+// sets reader_waiting (writer_waiting), checks the ring again and only then sleeps on its doorbell.
+// The other side rings the doorbell only if it has taken the flag down, so busy sessions don't
+// make any syscalls at all.
+
+static constexpr uint32_t kShmRegionMagic = 0x4D485358; // "XSHM"
+
+// Rings bigger than this are refused.
+static constexpr uint64_t kShmMaxRingCapacity = 1ull << 30;
+
+struct ShmRegionHeader {
+    uint32_t magic = 0;
+    // Set by either side to end the session. Peer is woken up with its doorbell.
+    std::atomic<uint32_t> closed{0};
+    // Size of data of each ring in bytes. Power of 2.
+    uint64_t ring_capacity = 0;
+};
+
+struct alignas(k_cache_line_size) ShmRingHeader {
+    // Total number of bytes ever written to the ring. Updated by the producer only.
+    alignas(k_cache_line_size) std::atomic<uint64_t> head{0};
+    // Producer waits for the consumer to free up space.
+    std::atomic<uint32_t> writer_waiting{0};
+
+    // Total number of bytes ever read from the ring. Updated by the consumer only.
+    alignas(k_cache_line_size) std::atomic<uint64_t> tail{0};
+    // Consumer waits for the producer to write data.
+    std::atomic<uint32_t> reader_waiting{0};
+};
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "Ring counters are shared between processes");
+static_assert(std::atomic<uint32_t>::is_always_lock_free, "Ring flags are shared between processes");
+
+// Size of the region with two rings of ring_capacity bytes.
+constexpr size_t ShmRegionSize(size_t ring_capacity) {
+    return k_cache_line_size + 2 * sizeof(ShmRingHeader) + 2 * ring_capacity;
+}
+
+// Single producer single consumer byte ring over shared memory.
+// Peer is not trusted: counters that don't make sense make reads and writes fail.
+class ShmRing {
+public:
+    ShmRing() = default;
+    ShmRing(ShmRingHeader *header, uint8_t *data, size_t capacity);
+
+    // Copies as much of data as fits into the ring. Returns number of bytes copied. Producer only.
+    Maybe<size_t> Write(DataSpan data);
+
+    // Copies up to buf size bytes out of the ring. Returns number of bytes copied. Consumer only.
+    Maybe<size_t> Read(MutDataSpan buf);
+
+    // Raises waiting flag and returns true if the ring is still full (empty), so it's safe to sleep.
+    bool PrepareWaitWrite();
+    bool PrepareWaitRead();
+
+    // Takes down waiting flag of the other side. Returns true if it was raised, other side is woken up then.
+    bool TakeReaderWaiting();
+    bool TakeWriterWaiting();
+
+private:
+    ShmRingHeader *header_ = nullptr;
+    uint8_t *data_ = nullptr;
+    size_t capacity_ = 0;
+};
+
+// Region mapped from the fd received from a client.
+class ShmRegion {
+public:
+    // Maps region and validates its header.
+    static Maybe<ShmRegion> Map(Log *log, int region_fd);
+
+    ShmRegion(ShmRegion &&rhs);
+    ~ShmRegion();
+
+    ShmRegionHeader *Header() const { return (ShmRegionHeader *)memory_; }
+    ShmRing &Requests() { return requests_; }
+    ShmRing &Responses() { return responses_; }
+
+private:
+    ShmRegion() = default;
+    ShmRegion(const ShmRegion &) = delete;
+
+    void *memory_ = nullptr;
+    size_t size_ = 0;
+    ShmRing requests_;
+    ShmRing responses_;
+};
+
+// Server side of the shared memory session.
+// Task sleeps on the server doorbell while waiting for requests or for the client to read responses.
+class ShmStream final : public InOutStream {
+public:
+    // control_sock: handshake socket, session ends when it's closed.
+    // io_timeout_msec: every read/write fails with StreamError::Timeout if client
+    //                  was not ready for that long. 0 - no timeout.
+    ShmStream(TaskContext &tc,
+              StrSpan name,
+              ShmRegion &region,
+              int server_doorbell,
+              int client_doorbell,
+              int control_sock,
+              int io_timeout_msec);
+    ~ShmStream();
+
+    Either<StreamError, size_t> DoRead(MutDataSpan read_buf) override;
+    Either<StreamError, StreamWriteSuccess> DoWrite(DataSpan write_buf) override;
+
+private:
+    // Sleeps on the server doorbell. wait_start_msec is 0 before the first wait of the operation.
+    StreamError WaitDoorbell(uint64_t &wait_start_msec);
+    bool IsClientAlive();
+    bool IsClosed();
+    void RingClient();
+
+    TaskContext &tc_;
+    StrSpan name_;
+    ShmRegion &region_;
+    int server_doorbell_ = -1;
+    int client_doorbell_ = -1;
+    int control_sock_ = -1;
+    int io_timeout_msec_ = 0;
+    EventSource doorbell_source_;
+};
+
+} // xynq
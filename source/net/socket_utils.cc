@@ -0,0 +1,54 @@
+#include "socket_utils.h"
+
+#include <cstdlib>
+#include <cstring>
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+
+using namespace xynq;
+
+Maybe<std::pair<Str, int>> xynq::ParseIPAddress(CStrSpan addr_str) {
+    size_t i = addr_str.Size();
+    while (i-- > 0) {
+        if (addr_str[i] == ':') {
+            return std::make_pair<Str, int>(StrSpan{addr_str.Data(), i}, atoi(addr_str.CStr() + i + 1));
+        }
+    }
+
+    return {};
+}
+
+socklen_t xynq::MakeSocketAddress(CStrSpan ip, int port, sockaddr_storage &addr) {
+    memset(&addr, 0, sizeof(addr));
+    sockaddr_in *addr4 = (sockaddr_in *)&addr;
+    addr4->sin_family = AF_INET; // try IPv4 first.
+    if (inet_pton(AF_INET, ip.CStr(), &(addr4->sin_addr)) == 1) {
+        addr4->sin_port = htons(port);
+        return sizeof(sockaddr_in);
+    }
+
+    // Failed to get IPv4 addr. Try IPv6.
+    memset(&addr, 0, sizeof(addr));
+    sockaddr_in6 *addr6 = (sockaddr_in6 *)&addr;
+    addr6->sin6_family = AF_INET6;
+    if (inet_pton(AF_INET6, ip.CStr(), &(addr6->sin6_addr)) != 1) {
+        return 0;
+    }
+    addr6->sin6_port = htons(port);
+    return sizeof(sockaddr_in6);
+}
+
+bool xynq::SetNonBlocking(int sock) {
+    int flags = fcntl(sock, F_GETFL, 0);
+    if (flags == -1) {
+        return false;
+    }
+    return fcntl(sock, F_SETFL, flags | O_NONBLOCK) == 0;
+}
+
+bool xynq::EnableReusePort(int sock) {
+    int enable = 1;
+    return setsockopt(sock, SOL_SOCKET, SO_REUSEPORT, &enable, sizeof(enable)) == 0;
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include "base/maybe.h"
+#include "base/span.h"
+#include "containers/str.h"
+
+#include <cerrno>
+#include <utility>
+
+#include <sys/socket.h>
+
+namespace xynq {
+
+// Checks if error code is a nonblocking socket error to retry.
+inline bool IsInProgress(int error_code) {
+    return error_code == EAGAIN || error_code == EWOULDBLOCK || error_code == EINPROGRESS;
+}
+
+// Takes string like 127.0.0.1:325 and returns address and port part of it.
+Maybe<std::pair<Str, int>> ParseIPAddress(CStrSpan addr_str);
+
+// Fills addr with IPv4 or IPv6 address (whichever ip is).
+// Returns size of the address, 0 if ip is not a valid address.
+socklen_t MakeSocketAddress(CStrSpan ip, int port, sockaddr_storage &addr);
+
+// Switches socket to nonblocking mode. errno is set on failure.
+bool SetNonBlocking(int sock);
+
+// Allows other sockets to bind to the same address (SO_REUSEPORT).
+// Kernel spreads incoming connections/datagrams over the sockets. errno is set on failure.
+bool EnableReusePort(int sock);
+
+} // xynq
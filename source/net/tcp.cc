@@ -1,24 +1,38 @@
 #include "tcp.h"
+#include "shm_stream.h"
+#include "socket_utils.h"
 
 #include "base/defer.h"
 #include "base/log.h"
 #include "base/stream.h"
 #include "task/task.h"
+#include "task/task_batch.h"
 #include "task/task_context.h"
 
 #include <unistd.h>
+#include <algorithm>
 #include <string.h>
 #include <cerrno>
 #include <utility>
 
 #include <arpa/inet.h>
-#include <fcntl.h>
 #include <netinet/in.h>
 #include <netinet/tcp.h>
 #include <sys/socket.h>
+#include <sys/stat.h>
 #include <sys/types.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+
+#if defined(XYNQ_LINUX)
+    #include <linux/errqueue.h>
+#endif
 
 
+#if !defined(MSG_ZEROCOPY)
+    #define MSG_ZEROCOPY 0
+#endif
+
 using namespace xynq;
 
 DefineTaggedLog(Tcp);
@@ -27,11 +41,29 @@ namespace {
 
  // 6 is for "tcp://", 8 - is for port, 1 is for zero.
  // Tcp stream name looks like: "tcp://127.0.0.1:3456". Can be IPv6 as well.
-const size_t kStreamNameMaxSize = 6 + INET6_ADDRSTRLEN + 8 + 1;
+const size_t kTcpStreamNameMaxSize = 6 + INET6_ADDRSTRLEN + 8 + 1;
+
+// 7 is for "unix://", 1 is for zero. Unix stream name looks like "unix:///run/xynq.sock".
+// Shared memory stream name looks like "shm:///run/xynq-shm.sock".
+const size_t kUnixStreamNameMaxSize = 7 + sizeof(sockaddr_un::sun_path) + 1;
+
+const size_t kStreamNameMaxSize = std::max(kTcpStreamNameMaxSize, kUnixStreamNameMaxSize);
+
+// Max number of already pending connections accepted after a wakeup before spawning their handlers.
+const size_t kMaxAcceptBatch = 64;
+
+// Max number of buffers passed to a single sendmsg. The rest is sent by following calls.
+const size_t kMaxWriteIovecs = 64;
+
+// Number of fds sent by shared memory client: region, server doorbell and client doorbell.
+const size_t kShmHandshakeFds = 3;
 
-// Checks if error code is a nonblocking socket error to retry.
-inline bool IsInProgress(int error_code) {
-    return error_code == EAGAIN || error_code == EWOULDBLOCK || error_code == EINPROGRESS;
+// Control buffer for reading zero copy completions from the socket error queue.
+const size_t kZeroCopyControlSize = 128;
+
+// Checks if error code means that io operation has timed out.
+inline bool IsTimedOut(int error_code) {
+    return error_code == ETIMEDOUT || error_code == ECANCELED; // io requests are cancelled on timeout.
 }
 
 
@@ -93,15 +125,24 @@ bool TcpSetKeepAlive(Log *log, int sock, const TcpKeepAlive &keep_alive) {
 }
 
 void TcpEnableReuseAddr(Log *log, int sock) {
-    uint32_t enable = 1;
-    int err = setsockopt(sock, SOL_SOCKET, SO_REUSEPORT, &enable, sizeof(enable));
-    if (err < 0) {
+    if (!EnableReusePort(sock)) {
         XYTcpWarning(log, "Failed to set SO_REUSEPORT. (",
                      errno, ", ",
                      strerror(errno), ')');
     }
 }
 
+bool TcpSetNoDelay(Log *log, int sock) {
+    int enable = 1;
+    if (setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable)) < 0) {
+        XYTcpWarning(log, "Failed to set TCP_NODELAY. (",
+                     errno, ", ",
+                     strerror(errno), ')');
+        return false;
+    }
+    return true;
+}
+
 // Returns ip:port from the socket.
 // Uses ip_buf to store ip string.
 std::pair<CStrSpan, int> SocketGetAddress(int sock, char *ip_buf, int ip_buf_size) {
@@ -129,42 +170,82 @@ std::pair<CStrSpan, int> SocketGetAddress(int sock, char *ip_buf, int ip_buf_siz
     }
 }
 
-// Takes string like 127.0.0.1:325 and returns address and port part of it.
-Maybe<std::pair<Str, int>> ParseIPAddress(CStrSpan addr_str) {
-    size_t i = addr_str.Size();
-    while (i-- > 0) {
-        if (addr_str[i] == ':') {
-            return std::make_pair<Str, int>(StrSpan{addr_str.Data(), i}, atoi(addr_str.CStr() + i + 1));
-        }
-    }
-
-    return {};
-}
+// Per connection part of TcpParameters.
+struct TcpStreamOptions {
+    int io_timeout_msec = 0;
+    size_t zerocopy_min_size = 0;
+    bool optimistic_io = false;
+    bool no_delay = false;
+};
 
 // xynq::Stream over tcp connection.
 class TcpStream final : public InOutStream {
 public:
-    TcpStream(TaskContext &tc, int sock, StrSpan name)
+    // options.io_timeout_msec: every read/write fails with StreamError::Timeout if socket
+    //                          was not ready for that long. 0 - no timeout.
+    // options.zerocopy_min_size: writes of at least this many bytes are sent with MSG_ZEROCOPY. 0 - never.
+    // options.optimistic_io: reads try recv first, socket stays added to the queue edge-triggered.
+    // options.no_delay: disables Nagle's algorithm on the socket.
+    TcpStream(TaskContext &tc, int sock, StrSpan name, const TcpStreamOptions &options)
         : tc_(tc)
         , sock_(sock)
         , event_source_(sock)
         , name_(name)
-    {}
+        , io_timeout_msec_(options.io_timeout_msec)
+        , zerocopy_min_size_(options.zerocopy_min_size)
+        , edge_triggered_(options.optimistic_io && !tc.EventQueue()->SupportsIoRequests())
+        , multishot_recv_(tc.EventQueue()->SupportsRecvBuffers())
+        , recv_request_(EventMultishotRequest::Op::Recv, sock) {
+        if (zerocopy_min_size_ > 0 && !EnableZeroCopy()) {
+            zerocopy_min_size_ = 0;
+        }
+        if (options.no_delay) {
+            TcpSetNoDelay(tc_.Log(), sock_);
+        }
+    }
 
     ~TcpStream() {
-        tc_.EventQueue()->RemoveEvent(event_source_);
+        if (multishot_recv_) {
+            FinishMultishotRecv();
+        }
+        tc_.EventQueue()->RemoveEvent(tc_.ThreadIndex(), event_source_);
     }
 
     Either<StreamError, size_t> DoRead(MutDataSpan read_buf) override {
         ssize_t received;
-        do {
-            tc_.WaitEvent(&event_source_, EventFlags::Read | EventFlags::ExactlyOnce);
-            received = recv(sock_, (char *)read_buf.Data(), read_buf.Size(), 0);
-        } while (received < 0 && IsInProgress(errno));
+        if (multishot_recv_) {
+            received = ReceiveMultishot(read_buf);
+        } else if (tc_.EventQueue()->SupportsIoRequests()) {
+            received = PerformIo(EventIoRequest::Op::Recv, (char *)read_buf.Data(), read_buf.Size());
+        } else if (edge_triggered_) {
+            // Data is usually there already when the connection is busy: wait only if it's not.
+            while (true) {
+                received = recv(sock_, (char *)read_buf.Data(), read_buf.Size(), MSG_DONTWAIT);
+                if (received >= 0 || !IsInProgress(errno)) {
+                    break;
+                }
+
+                if (!WaitReady(EventFlags::Read)) {
+                    errno = ETIMEDOUT;
+                    break;
+                }
+            }
+        } else {
+            do {
+                if (!WaitReady(EventFlags::Read)) {
+                    errno = ETIMEDOUT;
+                    break;
+                }
+                received = recv(sock_, (char *)read_buf.Data(), read_buf.Size(), MSG_DONTWAIT);
+            } while (received < 0 && IsInProgress(errno));
+        }
 
         if (received == 0) {
             XYTcpInfo(tc_.Log(), "Disconnected: ", name_);
             return StreamError::Closed;
+        } else if (received < 0 && IsTimedOut(errno)) {
+            XYTcpInfo(tc_.Log(), "Timed out on recv (", name_, "). Disconnecting.");
+            return StreamError::Timeout;
         } else if (received < 0) {
             XYTcpWarning(tc_.Log(), "Socket error on recv (", name_, "). ",
                                     "Disconnecting. Error=", errno, ", ", strerror(errno));
@@ -175,58 +256,391 @@ public:
     }
 
     Either<StreamError, StreamWriteSuccess> DoWrite(DataSpan send_buf) override {
-        char *to_send = (char *)send_buf.Data();
-        char *to_send_end = to_send + send_buf.Size();
-
-        while (to_send != to_send_end) {
-            size_t to_send_size = to_send_end - to_send;
-            int sent = send(sock_, to_send, to_send_size, 0);
-            if (sent < 0 && IsInProgress(sent)) {
-                tc_.WaitEvent(&event_source_, EventFlags::Write | EventFlags::ExactlyOnce);
+        return DoWriteV({&send_buf, 1});
+    }
+
+    Either<StreamError, StreamWriteSuccess> DoWriteV(Span<DataSpan> send_bufs) override {
+        int flags = 0;
+        if (zerocopy_min_size_ > 0) {
+            size_t total_size = 0;
+            for (const DataSpan &buf : send_bufs) {
+                total_size += buf.Size();
+            }
+            if (total_size >= zerocopy_min_size_) {
+                flags |= MSG_ZEROCOPY;
+            }
+        }
+
+        iovec iovs[kMaxWriteIovecs];
+        size_t first_iov = 0;
+        size_t num_iovs = 0;
+        size_t next_buf = 0;
+        while (true) {
+            // Everything passed to sendmsg is sent: take next buffers.
+            if (first_iov == num_iovs) {
+                first_iov = 0;
+                num_iovs = 0;
+                for (; next_buf < send_bufs.Size() && num_iovs < kMaxWriteIovecs; ++next_buf) {
+                    if (send_bufs[next_buf].Size() == 0) {
+                        continue;
+                    }
+                    iovs[num_iovs].iov_base = (void *)send_bufs[next_buf].Data();
+                    iovs[num_iovs].iov_len = send_bufs[next_buf].Size();
+                    ++num_iovs;
+                }
+
+                if (num_iovs == 0) {
+                    break;
+                }
+            }
+
+            msghdr msg;
+            memset(&msg, 0, sizeof(msg));
+            msg.msg_iov = iovs + first_iov;
+            msg.msg_iovlen = num_iovs - first_iov;
+            ssize_t sent = SendMsg(msg, flags);
+
+            // Socket is out of memory to pin pages with. Send rest of the data the usual way.
+            if (sent < 0 && errno == ENOBUFS && (flags & MSG_ZEROCOPY) != 0) {
+                flags &= ~MSG_ZEROCOPY;
                 continue;
             }
 
-            if (sent < 0) {
+            if (sent < 0 && IsTimedOut(errno)) {
+                XYTcpInfo(tc_.Log(), "Timed out on send (", name_, "). Disconnecting.");
+                return StreamError::Timeout;
+            } else if (sent < 0) {
                 XYTcpInfo(tc_.Log(), "Socket error on send (", name_, "). ",
                                      "Disconnecting. Error=", errno, ", ", strerror(errno));
                 return StreamError::IOError;
             }
 
-            to_send += sent;
+            if ((flags & MSG_ZEROCOPY) != 0) {
+                ++zerocopy_sent_;
+            }
+
+            // Skip sent buffers, partially sent buffer is advanced.
+            size_t sent_left = static_cast<size_t>(sent);
+            while (sent_left > 0) {
+                iovec &iov = iovs[first_iov];
+                if (sent_left < iov.iov_len) {
+                    iov.iov_base = (char *)iov.iov_base + sent_left;
+                    iov.iov_len -= sent_left;
+                    break;
+                }
+                sent_left -= iov.iov_len;
+                ++first_iov;
+            }
         }
 
+        // Caller can reuse buffers once write returns: wait for the kernel to release them.
+        if (zerocopy_completed_ != zerocopy_sent_) {
+            return WaitZeroCopy();
+        }
         return StreamWriteSuccess{};
     }
 
 private:
+    // Waits until socket is ready for read or write. Returns false on timeout.
+    // With no flags waits for socket error or its error queue to have messages.
+    // Edge-triggered socket is added for everything once: caller retries its syscall after any wakeup.
+    bool WaitReady(unsigned event_flags) {
+        if (edge_triggered_) {
+            event_flags = EventFlags::Read | EventFlags::Write | EventFlags::EdgeTriggered;
+        } else {
+            event_flags |= EventFlags::ExactlyOnce;
+        }
+
+        if (io_timeout_msec_ <= 0) {
+            tc_.WaitEvent(&event_source_, event_flags);
+            return true;
+        }
+
+        return tc_.WaitEvent(&event_source_, event_flags, TaskContext::NowMsec() + io_timeout_msec_);
+    }
+
+    // Lets event queue perform the syscall and waits for its completion.
+    // Returns -1 and sets errno on failure, same as the syscall would.
+    ssize_t PerformIo(EventIoRequest::Op op, void *buf, size_t size, int msg_flags = 0) {
+        EventIoRequest request;
+        request.op = op;
+        request.fd = sock_;
+        request.buf = buf;
+        request.size = size;
+        request.msg_flags = msg_flags;
+        request.timeout_msec = io_timeout_msec_ > 0 ? io_timeout_msec_ : -1;
+
+        int32_t result = tc_.WaitIo(request);
+        if (result < 0) {
+            errno = -result;
+            return -1;
+        }
+        return result;
+    }
+
+    // Copies data the multishot recv request has received. Request stays armed between reads,
+    // so busy connection is read without any submissions at all.
+    // Returns -1 and sets errno on failure, errno is ETIMEDOUT on timeout.
+    ssize_t ReceiveMultishot(MutDataSpan read_buf) {
+        uint64_t deadline = io_timeout_msec_ > 0 ? TaskContext::NowMsec() + io_timeout_msec_ : 0;
+        while (recv_pending_.buffer == EventMultishotRequest::kNoBuffer) {
+            if (!recv_request_.Take(recv_pending_)) {
+                if (deadline == 0) {
+                    tc_.WaitMultishot(recv_request_);
+                } else if (!tc_.WaitMultishot(recv_request_, deadline)) {
+                    errno = ETIMEDOUT;
+                    return -1;
+                }
+                continue;
+            }
+
+            // Last completion of the request: it's submitted again by the next wait.
+            int32_t result = recv_pending_.result;
+            if (result <= 0) {
+                recv_pending_ = EventMultishotRequest::Completion{};
+
+                // All buffers of the thread are taken (ie. by busy connections). Receive into the caller's buffer.
+                if (result == -ENOBUFS) {
+                    return PerformIo(EventIoRequest::Op::Recv, (char *)read_buf.Data(), read_buf.Size());
+                }
+                if (result < 0) {
+                    errno = -result;
+                    return -1;
+                }
+                return 0;
+            }
+            recv_pending_offset_ = 0;
+        }
+
+        // Caller's buffer might be smaller than received data: rest of it is copied by the next reads.
+        DataSpan data = tc_.EventQueue()->RecvData(recv_request_, recv_pending_);
+        size_t size = std::min(read_buf.Size(), data.Size() - recv_pending_offset_);
+        memcpy(read_buf.Data(), (const uint8_t *)data.Data() + recv_pending_offset_, size);
+        recv_pending_offset_ += size;
+        if (recv_pending_offset_ == data.Size()) {
+            tc_.EventQueue()->ReleaseRecvBuffer(recv_request_, recv_pending_.buffer);
+            recv_pending_ = EventMultishotRequest::Completion{};
+        }
+        return static_cast<ssize_t>(size);
+    }
+
+    // Cancels multishot recv and gives all its buffers back. Request is part of the stream,
+    // so it has to end before the stream is gone.
+    void FinishMultishotRecv() {
+        tc_.CancelMultishot(recv_request_);
+        while (true) {
+            if (recv_pending_.buffer != EventMultishotRequest::kNoBuffer) {
+                tc_.EventQueue()->ReleaseRecvBuffer(recv_request_, recv_pending_.buffer);
+            }
+            while (recv_request_.Take(recv_pending_)) {
+                if (recv_pending_.buffer != EventMultishotRequest::kNoBuffer) {
+                    tc_.EventQueue()->ReleaseRecvBuffer(recv_request_, recv_pending_.buffer);
+                }
+            }
+            recv_pending_ = EventMultishotRequest::Completion{};
+
+            if (!recv_request_.IsArmed()) {
+                break;
+            }
+            tc_.WaitMultishot(recv_request_);
+        }
+    }
+
+    // sendmsg that suspends the task until socket is writable.
+    // Returns -1 and sets errno on failure, errno is ETIMEDOUT on timeout.
+    ssize_t SendMsg(msghdr &msg, int flags) {
+        if (tc_.EventQueue()->SupportsIoRequests()) {
+            return PerformIo(EventIoRequest::Op::SendMsg, &msg, 0, flags);
+        }
+
+        while (true) {
+            ssize_t sent = sendmsg(sock_, &msg, flags | MSG_DONTWAIT);
+            if (sent >= 0 || !IsInProgress(errno)) {
+                return sent;
+            }
+
+            if (!WaitReady(EventFlags::Write)) {
+                errno = ETIMEDOUT;
+                return -1;
+            }
+        }
+    }
+
+    bool EnableZeroCopy() {
+#if defined(XYNQ_LINUX) && defined(SO_ZEROCOPY)
+        int enable = 1;
+        if (setsockopt(sock_, SOL_SOCKET, SO_ZEROCOPY, &enable, sizeof(enable)) == 0) {
+            return true;
+        }
+        XYTcpWarning(tc_.Log(), "Failed to enable zero copy sends (", name_, "). Error=", errno, ", ", strerror(errno));
+#endif
+        return false;
+    }
+
+    // Reads zero copy completions from the socket error queue until kernel has released all sent buffers.
+    StreamWriteResult WaitZeroCopy() {
+#if defined(XYNQ_LINUX)
+        while (zerocopy_completed_ != zerocopy_sent_) {
+            char control[kZeroCopyControlSize];
+            msghdr msg;
+            memset(&msg, 0, sizeof(msg));
+            msg.msg_control = control;
+            msg.msg_controllen = sizeof(control);
+
+            if (recvmsg(sock_, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) < 0) {
+                if (!IsInProgress(errno)) {
+                    XYTcpInfo(tc_.Log(), "Socket error on zero copy completion (", name_, "). ",
+                                         "Disconnecting. Error=", errno, ", ", strerror(errno));
+                    return StreamError::IOError;
+                }
+
+                if (!WaitReady(0)) {
+                    XYTcpInfo(tc_.Log(), "Timed out on zero copy completion (", name_, "). Disconnecting.");
+                    return StreamError::Timeout;
+                }
+                continue;
+            }
+
+            for (cmsghdr *cm = CMSG_FIRSTHDR(&msg); cm != nullptr; cm = CMSG_NXTHDR(&msg, cm)) {
+                bool is_error = (cm->cmsg_level == SOL_IP && cm->cmsg_type == IP_RECVERR)
+                             || (cm->cmsg_level == SOL_IPV6 && cm->cmsg_type == IPV6_RECVERR);
+                if (!is_error) {
+                    continue;
+                }
+
+                const sock_extended_err *err = (const sock_extended_err *)CMSG_DATA(cm);
+                if (err->ee_errno != 0 || err->ee_origin != SO_EE_ORIGIN_ZEROCOPY) {
+                    continue;
+                }
+
+                // Notification covers range of zero copy sendmsg calls [ee_info, ee_data].
+                zerocopy_completed_ += err->ee_data - err->ee_info + 1;
+
+                // Data was copied anyway (ie. loopback connection): page pinning is pure overhead then.
+                if ((err->ee_code & SO_EE_CODE_ZEROCOPY_COPIED) != 0 && zerocopy_min_size_ > 0) {
+                    XYTcpVerbose(tc_.Log(), "Zero copy sends are copied by kernel (", name_, "). Turning them off.");
+                    zerocopy_min_size_ = 0;
+                }
+            }
+        }
+#endif
+        return StreamWriteSuccess{};
+    }
+
     TaskContext &tc_;
     int sock_ = 0;
     EventSource event_source_;
     StrSpan name_;
+    int io_timeout_msec_ = 0;
+    size_t zerocopy_min_size_ = 0;
+    bool edge_triggered_ = false;
+    bool multishot_recv_ = false;
+    EventMultishotRequest recv_request_;
+    // Completion that is being copied out to the reader. Buffer is released once it's copied.
+    EventMultishotRequest::Completion recv_pending_;
+    size_t recv_pending_offset_ = 0;
+    // Zero copy sendmsg calls are numbered by the kernel, completions report ranges of those numbers.
+    uint32_t zerocopy_sent_ = 0;
+    uint32_t zerocopy_completed_ = 0;
 };
 
+// Waits for the handshake message and takes fds out of it.
+bool ReceiveShmHandshake(TaskContext *tc, int sock, int (&fds)[kShmHandshakeFds], int io_timeout_msec) {
+    EventSource event_source{sock};
+    Defer remove_event([tc, &event_source] {
+        tc->EventQueue()->RemoveEvent(tc->ThreadIndex(), event_source);
+    });
+
+    uint64_t deadline = TaskContext::NowMsec() + io_timeout_msec;
+    while (true) {
+        char byte;
+        iovec iov{&byte, sizeof(byte)};
+        alignas(cmsghdr) char control[CMSG_SPACE(sizeof(fds))];
+        msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+
+        ssize_t received = recvmsg(sock, &msg, MSG_DONTWAIT | MSG_CMSG_CLOEXEC);
+        if (received < 0 && (IsInProgress(errno) || errno == EINTR)) {
+            if (io_timeout_msec <= 0) {
+                tc->WaitEvent(&event_source, EventFlags::Read | EventFlags::ExactlyOnce);
+            } else if (!tc->WaitEvent(&event_source, EventFlags::Read | EventFlags::ExactlyOnce, deadline)) {
+                XYTcpInfo(tc->Log(), "Timed out on shared memory handshake. Disconnecting.");
+                return false;
+            }
+            continue;
+        }
+
+        if (received <= 0) {
+            XYTcpInfo(tc->Log(), "Disconnected before shared memory handshake. Error=", errno, ", ", strerror(errno));
+            return false;
+        }
+
+        // Fds that came in are closed on any error: they are installed into the process already.
+        size_t num_fds = 0;
+        for (cmsghdr *cm = CMSG_FIRSTHDR(&msg); cm != nullptr; cm = CMSG_NXTHDR(&msg, cm)) {
+            if (cm->cmsg_level != SOL_SOCKET || cm->cmsg_type != SCM_RIGHTS) {
+                continue;
+            }
+
+            size_t cm_num_fds = (cm->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+            for (size_t i = 0; i < cm_num_fds; ++i) {
+                int fd;
+                memcpy(&fd, CMSG_DATA(cm) + i * sizeof(int), sizeof(fd));
+                if (num_fds < kShmHandshakeFds) {
+                    fds[num_fds] = fd;
+                } else {
+                    close(fd);
+                }
+                ++num_fds;
+            }
+        }
+
+        if (num_fds != kShmHandshakeFds || (msg.msg_flags & MSG_CTRUNC) != 0) {
+            XYTcpError(tc->Log(), "Shared memory handshake expects ", kShmHandshakeFds, " fds, got ", num_fds);
+            for (size_t i = 0; i < std::min(num_fds, kShmHandshakeFds); ++i) {
+                close(fds[i]);
+            }
+            return false;
+        }
+        return true;
+    }
+}
+
 } // anon namespace
 
 
-// Handles single tcp stream.
+// Handles single tcp or unix domain socket stream.
 struct TcpConnectionHandler : public TaskDefaults {
-    static constexpr unsigned stack_size = 8 * 1024;
+    static constexpr unsigned stack_size = 16 * 1024; // Runs endpoint handler (slang + json) on this stack.
     static constexpr auto debug_name = "TcpConnectionHandler";
 
-    static constexpr auto exec = [](TaskContext *tc, int sock, TcpNewStreamHandler stream_handler) {
-        StrBuilder<kStreamNameMaxSize> stream_name{"tcp://"};
-
-        int src_port = 0;
-        stream_name.Write(INET6_ADDRSTRLEN + 1, [sock, &src_port](MutStrSpan buf) {
-            CStrSpan src_ip;
-            std::tie(src_ip, src_port) = SocketGetAddress(sock, buf.Data(), buf.Size());
-            return src_ip.Size();
-        });
-        stream_name.Append(':', src_port);
+    // unix_path: path the unix domain socket is bound to, empty for tcp.
+    static constexpr auto exec = [](TaskContext *tc,
+                                    int sock,
+                                    CStrSpan unix_path,
+                                    TcpNewStreamHandler stream_handler,
+                                    TcpStreamOptions options) {
+        StrBuilder<kStreamNameMaxSize> stream_name;
+        if (unix_path.IsEmpty()) {
+            int src_port = 0;
+            stream_name.Append("tcp://");
+            stream_name.Write(INET6_ADDRSTRLEN + 1, [sock, &src_port](MutStrSpan buf) {
+                CStrSpan src_ip;
+                std::tie(src_ip, src_port) = SocketGetAddress(sock, buf.Data(), buf.Size());
+                return src_ip.Size();
+            });
+            stream_name.Append(':', src_port);
+        } else {
+            stream_name.Append("unix://", unix_path);
+        }
         XYTcpInfo(tc->Log(), "Starting new stream: ", stream_name.Buffer());
 
         {
-            TcpStream stream{*tc, sock, stream_name.Buffer()};
+            TcpStream stream{*tc, sock, stream_name.Buffer(), options};
             XYAssert(stream_handler != nullptr);
             stream_handler(tc, stream_name.Buffer(), &stream);
         }
@@ -238,36 +652,193 @@ struct TcpConnectionHandler : public TaskDefaults {
 };
 
 
+// Receives shared memory client fds over the unix socket and serves the client through ShmStream.
+struct ShmConnectionHandler : public TaskDefaults {
+    static constexpr unsigned stack_size = 16 * 1024; // Runs endpoint handler (slang + json) on this stack.
+    static constexpr auto debug_name = "ShmConnectionHandler";
+
+    static constexpr auto exec = [](TaskContext *tc,
+                                    int sock,
+                                    CStrSpan unix_path,
+                                    TcpNewStreamHandler stream_handler,
+                                    TcpStreamOptions options) {
+        StrBuilder<kStreamNameMaxSize> stream_name;
+        stream_name.Append("shm://", unix_path);
+
+        Defer close_socket([tc, sock, &stream_name] {
+            close(sock);
+            XYTcpVerbose(tc->Log(), "Closed socket for ", stream_name.Buffer());
+        });
+
+        int fds[kShmHandshakeFds];
+        if (!ReceiveShmHandshake(tc, sock, fds, options.io_timeout_msec)) {
+            return;
+        }
+
+        Defer close_fds([&fds] {
+            for (int fd : fds) {
+                close(fd);
+            }
+        });
+
+        Maybe<ShmRegion> region = ShmRegion::Map(tc->Log(), fds[0]);
+        if (!region) {
+            XYTcpError(tc->Log(), "Refused shared memory client on ", unix_path.CStr());
+            return;
+        }
+
+        // Server doorbell is drained after every wakeup.
+        if (!SetNonBlocking(fds[1])) {
+            XYTcpError(tc->Log(), "Failed to setup nonblocking doorbell. Error=(", errno, ", ", strerror(errno), ')');
+            return;
+        }
+
+        XYTcpInfo(tc->Log(), "Starting new stream: ", stream_name.Buffer());
+        {
+            ShmStream stream{*tc, stream_name.Buffer(), region.Value(), fds[1], fds[2], sock, options.io_timeout_msec};
+            XYAssert(stream_handler != nullptr);
+            stream_handler(tc, stream_name.Buffer(), &stream);
+        }
+    };
+};
+
+
+namespace {
+
+// Accepts connections on the listening socket until the task shutdown.
+// Handlers of connections that are already pending are spawned at once.
+// unix_path: path the unix domain socket is bound to, empty for tcp.
+// pin_handlers: connection handlers only run on the accepting worker.
+template<class ConnectionHandler>
+void AcceptConnections(TaskContext *tc,
+                       int accept_socket,
+                       CStrSpan unix_path,
+                       TcpNewStreamHandler stream_handler,
+                       const TcpStreamOptions &stream_options,
+                       bool pin_handlers) {
+    EventSource event_source{accept_socket};
+    TaskBatch handlers;
+    handlers.Reserve(kMaxAcceptBatch);
+
+    // Single multishot request accepts all the connections. Task lives as long as the server,
+    // so the request is never cancelled.
+    EventMultishotRequest accept_request{EventMultishotRequest::Op::Accept, accept_socket};
+    bool multishot = tc->EventQueue()->SupportsIoRequests();
+
+    // Takes connection that is already accepted (multishot) or pending. Returns -1 and sets errno if there is none.
+    auto accept_next = [accept_socket, &accept_request, &multishot]() {
+        if (!multishot) {
+            return accept(accept_socket, nullptr, nullptr);
+        }
+
+        EventMultishotRequest::Completion completion;
+        if (!accept_request.Take(completion)) {
+            errno = EAGAIN;
+            return -1;
+        }
+        if (completion.result < 0) {
+            errno = -completion.result;
+            return -1;
+        }
+        return static_cast<int>(completion.result);
+    };
+
+    while (true) {
+        int accepted_socket;
+        if (multishot) {
+            tc->WaitMultishot(accept_request);
+            accepted_socket = accept_next();
+
+            // Request has ended (ie. kernel doesn't support multishot accept or doesn't wait
+            // on nonblocking listening socket). Single shot accepts are used from now on.
+            if (accepted_socket < 0 && !accept_request.IsArmed() && (errno == EINVAL || IsInProgress(errno))) {
+                XYTcpInfo(tc->Log(), "Multishot accept is not available. Error=(", errno, ", ", strerror(errno), ')');
+                multishot = false;
+                continue;
+            }
+        } else if (tc->EventQueue()->SupportsIoRequests()) {
+            EventIoRequest request;
+            request.op = EventIoRequest::Op::Accept;
+            request.fd = accept_socket;
+            accepted_socket = tc->WaitIo(request);
+            if (accepted_socket < 0) {
+                errno = -accepted_socket;
+            }
+
+            // Some kernels don't wait on nonblocking listening socket. Wait for readiness then.
+            if (accepted_socket < 0 && IsInProgress(errno)) {
+                tc->WaitEvent(&event_source, EventFlags::Read | EventFlags::ExactlyOnce);
+            }
+        } else {
+            tc->WaitEvent(&event_source, EventFlags::Read | EventFlags::ExactlyOnce);
+            accepted_socket = accept(accept_socket, nullptr, nullptr);
+        }
+
+        if (accepted_socket < 0) {
+            if (IsInProgress(errno) || errno == EINTR) {
+                continue;
+            }
+
+            XYTcpError(tc->Log(), "Failed to accept incoming connection, error=(", errno, ", ", strerror(errno), ')');
+            continue;
+        }
+
+        // Drain connections that are already pending: their handlers are spawned at once.
+        while (true) {
+            if (tc->Log()->ShouldLog(LogLevel::Info)) {
+                if (unix_path.IsEmpty()) {
+                    char buf[INET6_ADDRSTRLEN + 1];
+                    auto [ip, port] = SocketGetAddress(accepted_socket, buf, sizeof(buf));
+                    XYTcpInfo(tc->Log(), "Accepted new connection: ", ip.CStr(), ':', port);
+                } else {
+                    XYTcpInfo(tc->Log(), "Accepted new connection on ", unix_path.CStr());
+                }
+            }
+            if (pin_handlers) {
+                handlers.AddPinned<ConnectionHandler>(tc->ThreadIndex(), accepted_socket, unix_path, stream_handler, stream_options);
+            } else {
+                handlers.Add<ConnectionHandler>(accepted_socket, unix_path, stream_handler, stream_options);
+            }
+
+            if (handlers.Size() == kMaxAcceptBatch) {
+                break;
+            }
+
+            accepted_socket = accept_next();
+            if (accepted_socket < 0) {
+                if (!IsInProgress(errno) && errno != EINTR) {
+                    XYTcpError(tc->Log(), "Failed to accept incoming connection, error=(", errno, ", ", strerror(errno), ')');
+                }
+                break;
+            }
+        }
+        tc->PerformAsyncBatch(handlers);
+    }
+}
+
+} // anon namespace
+
+
 // Accepts incoming tcp connections and spawns new tasks to maintain those connections.
 // Supports both IPv4 and IPv6.
 struct TcpSocketAccept : public TaskDefaults {
     static const unsigned stack_size = 8 * 1024;
     static constexpr auto debug_name = "TcpSocketAccept";
 
+    // Parameters are copied: arguments the task was queued with are only valid until it suspends.
     static constexpr auto exec = [](TaskContext *tc,
                                     CStrSpan bind_addr,
                                     int bind_port,
                                     TcpNewStreamHandler stream_handler,
-                                    const TcpParameters &params) {
+                                    TcpParameters params) {
         XYTcpInfo(tc->Log(), "Prepare listening on ", bind_addr.CStr(), ':', bind_port);
         // Get socket address to bind to.
         sockaddr_storage addr_store;
         sockaddr *addr = (sockaddr *)&addr_store;
-        memset(&addr_store, 0, sizeof(addr_store));
-        sockaddr_in *addr4 = (sockaddr_in *)addr;
-        addr4->sin_family = AF_INET; // try IPv4 first.
-        if (inet_pton(AF_INET, bind_addr.CStr(), &(addr4->sin_addr)) == 1) {
-            addr4->sin_port = htons(bind_port);
-        } else {
-            // Failed to get IPv4 addr. Try IPv6.
-            memset(&addr_store, 0, sizeof(addr_store));
-            sockaddr_in6 *addr6 = (sockaddr_in6 *)addr;
-            addr6->sin6_family = AF_INET6;
-            if (inet_pton(AF_INET6, bind_addr.CStr(), &(addr6->sin6_addr)) != 1) {
-                XYTcpError(tc->Log(), "Failed to get bind address from '", bind_addr.CStr(), "' (", errno, ", ", strerror(errno), ')');
-                return;
-            }
-            addr6->sin6_port = htons(bind_port);
+        socklen_t addr_len = MakeSocketAddress(bind_addr, bind_port, addr_store);
+        if (addr_len == 0) {
+            XYTcpError(tc->Log(), "Failed to get bind address from '", bind_addr.CStr(), "' (", errno, ", ", strerror(errno), ')');
+            return;
         }
 
         // Create socket with a family depending whether bind_addr is ipv4 or 6.
@@ -283,27 +854,20 @@ struct TcpSocketAccept : public TaskDefaults {
         });
 
         // Make it non-blocking.
-        int flags = fcntl(accept_socket, F_GETFL, 0);
-        if (flags == -1) {
-            XYTcpError(tc->Log(), "Failed to setup nonblocking socket. F_GETFL failed with error=(", errno, ", ", strerror(errno), ')');
-            return;
-        }
-        flags |= O_NONBLOCK;
-        if (fcntl(accept_socket, F_SETFL, flags) != 0) {
-            XYTcpError(tc->Log(), "Failed to setup nonblocking socket. F_SETFL failed with error=(", errno, ", ", strerror(errno), ')');
+        if (!SetNonBlocking(accept_socket)) {
+            XYTcpError(tc->Log(), "Failed to setup nonblocking socket. Error=(", errno, ", ", strerror(errno), ')');
             return;
         }
 
         // Apply keep-alive parameters.
         TcpSetKeepAlive(tc->Log(), accept_socket, params.keep_alive);
 
-        // Set addr reuse if needed.
-        if (params.reuse_addr) {
+        // Set addr reuse if needed. Every worker binds to the same address in accept per worker mode.
+        if (params.reuse_addr || params.accept_per_worker) {
             TcpEnableReuseAddr(tc->Log(), accept_socket);
         }
 
         // Bind it to address.
-        socklen_t addr_len = addr->sa_family == AF_INET ? sizeof(sockaddr_in) : sizeof(sockaddr_in6);
         if (bind(accept_socket, addr, addr_len) == -1) {
             XYTcpError(tc->Log(), "Failed to bind address", bind_addr.CStr(), ':', bind_port, ". ",
                                   "Maybe address is already in use. (", errno, ", ", strerror(errno), ')');
@@ -317,29 +881,80 @@ struct TcpSocketAccept : public TaskDefaults {
         }
 
         // Accept connections until the task shutdown.
-        EventSource event_source{accept_socket};
-        while (true) {
-            sockaddr_storage accept_addr_store;
-            socklen_t len = addr_len;
+        TcpStreamOptions stream_options;
+        stream_options.io_timeout_msec = params.io_timeout_msec;
+        stream_options.zerocopy_min_size = params.zerocopy_min_size;
+        stream_options.optimistic_io = params.optimistic_io;
+        stream_options.no_delay = params.no_delay;
+        AcceptConnections<TcpConnectionHandler>(tc, accept_socket, CStrSpan{}, stream_handler, stream_options,
+                                                params.accept_per_worker && params.pin_connections);
+    };
+};
 
-            tc->WaitEvent(&event_source, EventFlags::Read | EventFlags::ExactlyOnce);
 
-            int accepted_socket = accept(accept_socket, (sockaddr *)&accept_addr_store, &len);
-            if (accepted_socket < 0) {
-                if (IsInProgress(errno) || errno == EINTR) {
-                    continue;
-                }
+// Accepts connections on unix domain socket. Connections are either served as regular
+// streams or they hand over shared memory region to serve through (see ShmStream).
+struct UdsSocketAccept : public TaskDefaults {
+    static const unsigned stack_size = 8 * 1024;
+    static constexpr auto debug_name = "UdsSocketAccept";
 
-                XYTcpError(tc->Log(), "Failed to accept incoming connection, error=(", errno, ", ", strerror(errno), ')');
-                continue;
-            }
+    static constexpr auto exec = [](TaskContext *tc,
+                                    CStrSpan bind_path,
+                                    bool shared_memory,
+                                    TcpNewStreamHandler stream_handler,
+                                    TcpParameters params) {
+        XYTcpInfo(tc->Log(), "Prepare listening on ", bind_path.CStr(), shared_memory ? " (shared memory)" : "");
+        sockaddr_un addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        if (bind_path.Size() >= sizeof(addr.sun_path)) {
+            XYTcpError(tc->Log(), "Unix socket path is too long: ", bind_path.CStr());
+            return;
+        }
+        memcpy(addr.sun_path, bind_path.Data(), bind_path.Size());
 
-            if (tc->Log()->ShouldLog(LogLevel::Info)) {
-                char buf[INET6_ADDRSTRLEN + 1];
-                auto [ip, port] = SocketGetAddress(accepted_socket, buf, sizeof(buf));
-                XYTcpInfo(tc->Log(), "Accepted new connection: ", ip.CStr(), ':', port);
-            }
-            tc->PerformAsync<TcpConnectionHandler>(accepted_socket, stream_handler);
+        int accept_socket = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (accept_socket < 0) {
+            XYTcpError(tc->Log(), "Failed to create socket. Error=(", errno, ", ", strerror(errno), ')');
+            return;
+        }
+
+        // Close socket if any error or on function exit.
+        Defer close_socket([accept_socket] {
+            close(accept_socket);
+        });
+
+        if (!SetNonBlocking(accept_socket)) {
+            XYTcpError(tc->Log(), "Failed to setup nonblocking socket. Error=(", errno, ", ", strerror(errno), ')');
+            return;
+        }
+
+        // Socket file is left behind by the previous run. Anything else at the path is not touched.
+        struct stat path_stat;
+        if (stat(addr.sun_path, &path_stat) == 0 && S_ISSOCK(path_stat.st_mode)) {
+            unlink(addr.sun_path);
+        }
+
+        if (bind(accept_socket, (sockaddr *)&addr, sizeof(addr)) == -1) {
+            XYTcpError(tc->Log(), "Failed to bind ", bind_path.CStr(), ". (", errno, ", ", strerror(errno), ')');
+            return;
+        }
+
+        if (listen(accept_socket, params.listen_backlog) < 0) {
+            XYTcpError(tc->Log(), "Listen call on '", bind_path.CStr(), "' failed. ",
+                                  "Error=(", errno, ", ", strerror(errno), ')');
+            return;
+        }
+
+        // Accept connections until the task shutdown.
+        // Zero copy and Nagle's algorithm don't apply to unix sockets.
+        TcpStreamOptions stream_options;
+        stream_options.io_timeout_msec = params.io_timeout_msec;
+        stream_options.optimistic_io = params.optimistic_io;
+        if (shared_memory) {
+            AcceptConnections<ShmConnectionHandler>(tc, accept_socket, bind_path, stream_handler, stream_options, false);
+        } else {
+            AcceptConnections<TcpConnectionHandler>(tc, accept_socket, bind_path, stream_handler, stream_options, false);
         }
     };
 };
@@ -364,8 +979,75 @@ TcpManager::Create(Dep<Log> log,
         manager.bind_addrs_.push_back(res.Value());
     }
 
+    // Io workers only run tasks pinned to them: connections are not kept there.
+    TcpParameters accept_parameters = parameters;
+    if (accept_parameters.pin_connections && task_manager->NumIoThreads() > 0) {
+        XYTcpWarning(log, "Connections are not pinned to io threads. Ignoring pin-connections.");
+        accept_parameters.pin_connections = false;
+    }
+
+    // Accepts run on io threads if there are any. Connection tasks they spawn are taken by other workers.
+    size_t num_accept_threads = task_manager->NumIoThreads() > 0 ? task_manager->NumIoThreads()
+                                                                 : task_manager->NumThreads();
+    size_t next_io_thread = 0;
     for (const auto &address : manager.bind_addrs_) {
-        task_manager->AddEntryPoint<TcpSocketAccept>(address.first, address.second, new_stream_handler, parameters);
+        // Task arguments are copied bytewise, so the string itself can't be passed: its short string
+        // buffer would be left behind. Addresses are not modified after this point and outlive the tasks.
+        CStrSpan bind_ip = address.first;
+        if (!parameters.accept_per_worker) {
+            if (task_manager->NumIoThreads() > 0) {
+                task_manager->AddPinnedEntryPoint<TcpSocketAccept>(next_io_thread++ % task_manager->NumIoThreads(),
+                                                                  bind_ip, address.second,
+                                                                  new_stream_handler, accept_parameters);
+            } else {
+                task_manager->AddEntryPoint<TcpSocketAccept>(bind_ip, address.second, new_stream_handler, accept_parameters);
+            }
+            continue;
+        }
+
+        // Accepts stay on the worker that owns the socket. So do connections if they are pinned.
+        for (size_t thread_index = 0; thread_index < num_accept_threads; ++thread_index) {
+            task_manager->AddPinnedEntryPoint<TcpSocketAccept>(thread_index, bind_ip, address.second,
+                                                              new_stream_handler, accept_parameters);
+        }
+    }
+    return std::move(manager);
+}
+////////////////////////////////////////////////////////////
+
+
+// UdsManager.
+Maybe<UdsManager>
+UdsManager::Create(Dep<Log> log,
+                   Dep<TaskManager> task_manager,
+                   const TcpParameters &parameters,
+                   Span<CStrSpan> bind_paths,
+                   Span<CStrSpan> shm_bind_paths,
+                   TcpNewStreamHandler new_stream_handler) {
+    UdsManager manager;
+    for (const CStrSpan &path : bind_paths) {
+        manager.bind_paths_.push_back(std::make_pair(Str{path}, false));
+    }
+    for (const CStrSpan &path : shm_bind_paths) {
+        manager.bind_paths_.push_back(std::make_pair(Str{path}, true));
+    }
+
+    size_t next_io_thread = 0;
+    for (const auto &[path, shared_memory] : manager.bind_paths_) {
+        // Paths are not modified after this point and outlive the tasks (see TcpManager::Create).
+        CStrSpan bind_path = path;
+        if (bind_path.Size() >= sizeof(sockaddr_un::sun_path)) {
+            XYTcpError(log, "Unix socket path is too long: ", bind_path.CStr());
+            return {};
+        }
+
+        if (task_manager->NumIoThreads() > 0) {
+            task_manager->AddPinnedEntryPoint<UdsSocketAccept>(next_io_thread++ % task_manager->NumIoThreads(),
+                                                               bind_path, shared_memory,
+                                                               new_stream_handler, parameters);
+        } else {
+            task_manager->AddEntryPoint<UdsSocketAccept>(bind_path, shared_memory, new_stream_handler, parameters);
+        }
     }
     return std::move(manager);
 }
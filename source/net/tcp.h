@@ -11,8 +11,8 @@
 
 namespace xynq {
 
-// Called when new Tcp connection established.
-// name is human readable stream identifier - ie. "tcp://127.0.0.1:5263".
+// Called when new Tcp connection established. Also used by unix domain sockets (see UdsManager).
+// name is human readable stream identifier - ie. "tcp://127.0.0.1:5263", "unix:///run/xynq.sock".
 // io_stream allows reading/writing from the connection.
 using TcpNewStreamHandler = void(*)(TaskContext *, StrSpan name, InOutStream *io_stream);
 
@@ -35,6 +35,35 @@ struct TcpParameters {
 
     // Keep-alive settings.
     TcpKeepAlive keep_alive;
+
+    // Connection is closed if a read or write doesn't complete in this time. 0 - no timeout.
+    int io_timeout_msec = 0;
+
+    // Every worker (every io worker if there are any, see TaskManager::NumIoThreads) listens
+    // on its own SO_REUSEPORT socket for each address and accepts connections on it.
+    // Kernel spreads incoming connections over the sockets.
+    // Otherwise there is a single accepting task per address.
+    bool accept_per_worker = false;
+
+    // With accept_per_worker connection tasks only run on the worker that accepted them,
+    // they are resumed there after every wait too. Otherwise they are stolen by idle workers.
+    // Ignored if there are io workers: accepts run there.
+    bool pin_connections = false;
+
+    // Reads try recv first and only wait if there is no data yet. Socket is added to the event queue
+    // edge-triggered once for the whole connection instead of being re-armed for every wait.
+    // Only used with epoll: io_uring performs reads and writes itself.
+    bool optimistic_io = false;
+
+    // Writes of at least this many bytes are sent with MSG_ZEROCOPY: kernel sends straight from
+    // the written buffers instead of copying them. Write returns once the peer has acknowledged the data,
+    // so it only pays off for big responses. 0 - disabled.
+    size_t zerocopy_min_size = 0;
+
+    // Disables Nagle's algorithm on connections (TCP_NODELAY): writes are sent right away
+    // instead of waiting for the acknowledgement of previously sent data.
+    // Endpoints coalesce pipelined responses themselves (see EndpointParameters).
+    bool no_delay = false;
 };
 
 // Sockets-based tcp streams implementation.
@@ -52,4 +81,24 @@ private:
     Vec<Address> bind_addrs_;
 };
 
+// Unix domain socket streams for clients running on the same host: they skip the tcp loopback stack.
+// Connections are served as tcp streams are, using the same TcpParameters (keep-alive, zero copy
+// and no delay settings don't apply).
+// Connections to shm_bind_paths hand over a shared memory region and are served through it
+// instead of the socket (see ShmStream for the handshake).
+// Stale socket file left at the path by the previous run is replaced.
+class UdsManager {
+public:
+    static Maybe<UdsManager>
+    Create(Dep<Log> log,
+           Dep<TaskManager> task_manager,
+           const TcpParameters &parameters,
+           Span<CStrSpan> bind_paths,
+           Span<CStrSpan> shm_bind_paths,
+           TcpNewStreamHandler new_stream_handler);
+private:
+    using BindPath = std::pair<Str, bool>; // Path and whether it's for shared memory clients.
+    Vec<BindPath> bind_paths_;
+};
+
 } // xynq
\ No newline at end of file
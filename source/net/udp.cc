@@ -0,0 +1,343 @@
+#include "udp.h"
+#include "udp_peer_table.h"
+#include "socket_utils.h"
+
+#include "base/defer.h"
+#include "base/log.h"
+#include "task/task.h"
+#include "task/task_context.h"
+
+#include "os/utils.h"
+
+#include <unistd.h>
+#include <string.h>
+#include <algorithm>
+#include <cerrno>
+#include <utility>
+
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+
+using namespace xynq;
+
+DefineTaggedLog(Udp);
+
+namespace {
+
+// Receive is retried after transient errors, waiting longer after every failure in a row.
+const uint64_t kMinErrorBackoffMsec = 1;
+const uint64_t kMaxErrorBackoffMsec = 1000;
+
+// Socket can't be received from anymore.
+bool IsFatalReceiveError(int error_code) {
+    return error_code == EBADF || error_code == ENOTSOCK || error_code == EINVAL || error_code == EFAULT;
+}
+
+// Buffers for a batch of datagrams and replies to them.
+// Datagram i is received into slot i, replies are packed into the first slots one after another.
+class UdpBatch {
+public:
+    UdpBatch(size_t batch_size, size_t max_datagram_size)
+        : batch_size_(batch_size)
+        , max_datagram_size_(max_datagram_size) {
+        recv_bufs_.resize(batch_size * max_datagram_size);
+        reply_bufs_.resize(batch_size * max_datagram_size);
+        addrs_.resize(batch_size);
+        recv_iovecs_.resize(batch_size);
+        reply_iovecs_.resize(batch_size);
+        recv_msgs_.resize(batch_size);
+        reply_msgs_.resize(batch_size);
+
+        for (size_t i = 0; i < batch_size; ++i) {
+            recv_iovecs_[i].iov_base = &recv_bufs_[i * max_datagram_size];
+            recv_iovecs_[i].iov_len = max_datagram_size;
+            reply_iovecs_[i].iov_base = &reply_bufs_[i * max_datagram_size];
+        }
+    }
+
+    // Receives pending datagrams without waiting. Returns number of received ones, -1 on error (see errno).
+    int Receive(int sock) {
+        for (size_t i = 0; i < batch_size_; ++i) {
+            msghdr &hdr = recv_msgs_[i].msg_hdr;
+            memset(&hdr, 0, sizeof(hdr));
+            hdr.msg_name = &addrs_[i];
+            hdr.msg_namelen = sizeof(sockaddr_storage);
+            hdr.msg_iov = &recv_iovecs_[i];
+            hdr.msg_iovlen = 1;
+        }
+        num_replies_ = 0;
+        return recvmmsg(sock, recv_msgs_.data(), (unsigned)batch_size_, MSG_DONTWAIT, nullptr);
+    }
+
+    // Received datagram. Empty if datagram was truncated.
+    MutDataSpan Datagram(size_t index) {
+        if ((recv_msgs_[index].msg_hdr.msg_flags & MSG_TRUNC) != 0) {
+            return MutDataSpan{recv_iovecs_[index].iov_base, size_t(0)};
+        }
+        return MutDataSpan{recv_iovecs_[index].iov_base, recv_msgs_[index].msg_len};
+    }
+
+    const sockaddr_storage &Sender(size_t index) const {
+        return addrs_[index];
+    }
+
+    // Buffer for the next reply.
+    MutDataSpan ReplyBuffer() {
+        return MutDataSpan{reply_iovecs_[num_replies_].iov_base, max_datagram_size_};
+    }
+
+    // Queues reply of reply_size bytes written into ReplyBuffer to the sender of datagram.
+    void AddReply(size_t datagram_index, size_t reply_size) {
+        XYAssert(reply_size <= max_datagram_size_);
+        reply_iovecs_[num_replies_].iov_len = reply_size;
+
+        msghdr &hdr = reply_msgs_[num_replies_].msg_hdr;
+        memset(&hdr, 0, sizeof(hdr));
+        hdr.msg_name = &addrs_[datagram_index];
+        hdr.msg_namelen = recv_msgs_[datagram_index].msg_hdr.msg_namelen;
+        hdr.msg_iov = &reply_iovecs_[num_replies_];
+        hdr.msg_iovlen = 1;
+        ++num_replies_;
+    }
+
+    // Sends queued replies without waiting. Replies that don't fit into the socket buffer are dropped.
+    // Returns false on error (see errno).
+    bool SendReplies(int sock) {
+        size_t num_sent = 0;
+        while (num_sent < num_replies_) {
+            int sent = sendmmsg(sock, &reply_msgs_[num_sent], (unsigned)(num_replies_ - num_sent), MSG_DONTWAIT);
+            if (sent < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                return IsInProgress(errno);
+            }
+            num_sent += sent;
+        }
+        return true;
+    }
+
+private:
+    size_t batch_size_ = 0;
+    size_t max_datagram_size_ = 0;
+    size_t num_replies_ = 0;
+
+    Vec<uint8_t> recv_bufs_;
+    Vec<uint8_t> reply_bufs_;
+    Vec<sockaddr_storage> addrs_;
+    Vec<iovec> recv_iovecs_;
+    Vec<iovec> reply_iovecs_;
+    Vec<mmsghdr> recv_msgs_;
+    Vec<mmsghdr> reply_msgs_;
+};
+
+
+// Receives datagrams on a socket bound to the address and passes them to the handler.
+// Supports both IPv4 and IPv6.
+struct UdpSocketReceive : public TaskDefaults {
+    static constexpr unsigned stack_size = 16 * 1024; // Runs datagram handler on this stack.
+    static constexpr auto debug_name = "UdpSocketReceive";
+
+    // Parameters are copied: arguments the task was queued with are only valid until it suspends.
+    static constexpr auto exec = [](TaskContext *tc,
+                                    CStrSpan bind_addr,
+                                    int bind_port,
+                                    UdpDatagramHandler datagram_handler,
+                                    UdpParameters params) {
+        XYUdpInfo(tc->Log(), "Prepare receiving on ", bind_addr.CStr(), ':', bind_port);
+        sockaddr_storage addr_store;
+        socklen_t addr_len = MakeSocketAddress(bind_addr, bind_port, addr_store);
+        if (addr_len == 0) {
+            XYUdpError(tc->Log(), "Failed to get bind address from '", bind_addr.CStr(), "' (", errno, ", ", strerror(errno), ')');
+            return;
+        }
+
+        int sock = socket(addr_store.ss_family, SOCK_DGRAM, 0);
+        if (sock < 0) {
+            XYUdpError(tc->Log(), "Failed to create socket. Error=(", errno, ", ", strerror(errno), ')');
+            return;
+        }
+
+        // Close socket if any error or on function exit.
+        Defer close_socket([sock] {
+            close(sock);
+        });
+
+        if (!SetNonBlocking(sock)) {
+            XYUdpError(tc->Log(), "Failed to setup nonblocking socket. Error=(", errno, ", ", strerror(errno), ')');
+            return;
+        }
+
+        // Every worker binds its own socket to the same address.
+        if (!EnableReusePort(sock)) {
+            XYUdpError(tc->Log(), "Failed to set SO_REUSEPORT. (", errno, ", ", strerror(errno), ')');
+            return;
+        }
+
+        if (bind(sock, (sockaddr *)&addr_store, addr_len) == -1) {
+            XYUdpError(tc->Log(), "Failed to bind address ", bind_addr.CStr(), ':', bind_port, ". ",
+                                  "Maybe address is already in use. (", errno, ", ", strerror(errno), ')');
+            return;
+        }
+
+        UdpBatch batch{params.batch_size, params.max_datagram_size};
+        UdpPeerTable peers{(uint64_t)params.peer_timeout_msec};
+        EventSource event_source{sock};
+        uint64_t error_backoff_msec = 0;
+        while (true) {
+            int num_received = batch.Receive(sock);
+            if (num_received < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                if (IsInProgress(errno)) {
+                    tc->WaitEvent(&event_source, EventFlags::Read | EventFlags::ExactlyOnce);
+                    continue;
+                }
+                if (IsFatalReceiveError(errno)) {
+                    XYUdpError(tc->Log(), "Stop receiving on ", bind_addr.CStr(), ':', bind_port,
+                                          ", error=(", errno, ", ", strerror(errno), ')');
+                    return;
+                }
+
+                // Transient errors (ie. ENOMEM or pending ICMP error) are retried after a while,
+                // so they don't keep the worker busy.
+                error_backoff_msec = std::min(std::max(2 * error_backoff_msec, kMinErrorBackoffMsec), kMaxErrorBackoffMsec);
+                XYUdpWarning(tc->Log(), "Failed to receive datagrams, retry in ", error_backoff_msec,
+                                        " msec, error=(", errno, ", ", strerror(errno), ')');
+                tc->Sleep(error_backoff_msec);
+                continue;
+            }
+            error_backoff_msec = 0;
+
+            uint64_t now_msec = platform::MonotonicTimeMsec();
+            for (int i = 0; i < num_received; ++i) {
+                MutDataSpan datagram = batch.Datagram(i);
+                if (datagram.Size() < sizeof(UdpSequence)) {
+                    XYUdpVerbose(tc->Log(), "Dropped truncated or empty datagram");
+                    continue;
+                }
+
+                UdpSequence sequence;
+                memcpy(&sequence, datagram.Data(), sizeof(sequence));
+                if (!peers.Accept(MakeUdpPeer(batch.Sender(i)), sequence, now_msec)) {
+                    XYUdpVerbose(tc->Log(), "Dropped stale datagram #", sequence);
+                    continue;
+                }
+
+                MutDataSpan payload{(uint8_t *)datagram.Data() + sizeof(sequence), datagram.Size() - sizeof(sequence)};
+                MutDataSpan reply_buf = batch.ReplyBuffer();
+                size_t reply_size = datagram_handler(tc, payload,
+                    MutDataSpan{(uint8_t *)reply_buf.Data() + sizeof(sequence), reply_buf.Size() - sizeof(sequence)});
+                if (reply_size > 0) {
+                    memcpy(reply_buf.Data(), &sequence, sizeof(sequence));
+                    batch.AddReply(i, sizeof(sequence) + reply_size);
+                }
+            }
+
+            if (!batch.SendReplies(sock)) {
+                XYUdpWarning(tc->Log(), "Failed to send replies, error=(", errno, ", ", strerror(errno), ')');
+            }
+
+            // Let other tasks of this worker run between the batches.
+            if (num_received == (int)params.batch_size) {
+                tc->Yield();
+            }
+        }
+    };
+};
+
+} // anon namespace
+
+
+// UdpPeerTable.
+UdpPeer xynq::MakeUdpPeer(const sockaddr_storage &addr) {
+    UdpPeer peer;
+    peer.family = addr.ss_family;
+    if (addr.ss_family == AF_INET) {
+        const sockaddr_in *addr4 = (const sockaddr_in *)&addr;
+        memcpy(&peer.ip[0], &addr4->sin_addr, sizeof(addr4->sin_addr));
+        peer.port = addr4->sin_port;
+    } else {
+        const sockaddr_in6 *addr6 = (const sockaddr_in6 *)&addr;
+        memcpy(&peer.ip[0], &addr6->sin6_addr, sizeof(addr6->sin6_addr));
+        peer.port = addr6->sin6_port;
+    }
+    return peer;
+}
+
+bool UdpPeerTable::Accept(const UdpPeer &peer, UdpSequence sequence, uint64_t now_msec) {
+    auto it = peers_.find(peer);
+    if (it == peers_.end()) {
+        if (peers_.size() >= kMaxTrackedPeers) {
+            ForgetTimedOut(now_msec);
+        }
+        peers_.emplace(peer, PeerState{sequence, now_msec});
+        return true;
+    }
+
+    PeerState &state = it->second;
+    // Serial number arithmetic: sequence numbers are allowed to wrap around.
+    if ((int64_t)(sequence - state.sequence) <= 0 && now_msec - state.last_seen_msec < peer_timeout_msec_) {
+        return false;
+    }
+
+    state.sequence = sequence;
+    state.last_seen_msec = now_msec;
+    return true;
+}
+
+void UdpPeerTable::ForgetTimedOut(uint64_t now_msec) {
+    for (auto it = peers_.begin(); it != peers_.end();) {
+        if (now_msec - it->second.last_seen_msec >= peer_timeout_msec_) {
+            it = peers_.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    // Every peer is active: start over rather than grow without a limit.
+    if (peers_.size() >= kMaxTrackedPeers) {
+        peers_.clear();
+    }
+}
+
+// UdpManager.
+Maybe<UdpManager>
+UdpManager::Create(Dep<Log> log,
+                   Dep<TaskManager> task_manager,
+                   const UdpParameters &parameters,
+                   Span<CStrSpan> bind_addrs,
+                   UdpDatagramHandler datagram_handler) {
+    if (parameters.batch_size == 0 || parameters.max_datagram_size <= sizeof(UdpSequence)) {
+        XYUdpError(log, "Invalid udp parameters: batch size=", parameters.batch_size,
+                        ", max datagram size=", parameters.max_datagram_size);
+        return {};
+    }
+
+    UdpManager manager;
+    for (const CStrSpan &str : bind_addrs) {
+        auto res = ParseIPAddress(str);
+        if (!res) {
+            XYUdpError(log, "Invalid address: ", str.CStr());
+            return {};
+        }
+
+        manager.bind_addrs_.push_back(res.Value());
+    }
+
+    // Receives run on io threads if there are any.
+    size_t num_receive_threads = task_manager->NumIoThreads() > 0 ? task_manager->NumIoThreads()
+                                                                  : task_manager->NumThreads();
+    for (const auto &address : manager.bind_addrs_) {
+        // Strings can't be passed as task arguments, see TcpManager::Create.
+        CStrSpan bind_ip = address.first;
+        for (size_t thread_index = 0; thread_index < num_receive_threads; ++thread_index) {
+            task_manager->AddPinnedEntryPoint<UdpSocketReceive>(thread_index, bind_ip, address.second,
+                                                               datagram_handler, parameters);
+        }
+    }
+    return std::move(manager);
+}
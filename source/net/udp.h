@@ -0,0 +1,51 @@
+#pragma once
+
+#include "base/dep.h"
+#include "base/maybe.h"
+#include "base/span.h"
+#include "containers/str.h"
+#include "containers/vec.h"
+#include "task/task_manager.h"
+
+namespace xynq {
+
+// Called for every datagram that is newer than the previous ones from the same peer.
+// datagram is the payload following the sequence number.
+// Reply is written into reply_buf, returns its size. 0 - no reply.
+using UdpDatagramHandler = size_t(*)(TaskContext *, MutDataSpan datagram, MutDataSpan reply_buf);
+
+// Udp configuration parameters.
+struct UdpParameters {
+    // Max number of datagrams received with a single recvmmsg call.
+    // Replies to them are sent with a single sendmmsg call.
+    size_t batch_size = 32;
+
+    // Longer datagrams are dropped. Replies can't be longer either.
+    size_t max_datagram_size = 1472;
+
+    // Peer that sent nothing for this long is forgotten, so its sequence numbers can start over.
+    int peer_timeout_msec = 10000;
+};
+
+// Sockets-based udp transport for frequent updates that don't need reliable delivery.
+// Every worker (every io worker if there are any, see TaskManager::NumIoThreads) receives on its own
+// SO_REUSEPORT socket for each address. Kernel picks the socket by peer address, so all datagrams
+// of a peer are handled by the same worker.
+// Datagram starts with 64 bit little endian sequence number. Datagrams with sequence number not greater
+// than the last handled one from the same peer are stale (ie. reordered by the network) and dropped.
+// Reply starts with the sequence number of the datagram it replies to.
+// Supports both IPv4 and 6.
+class UdpManager {
+public:
+    static Maybe<UdpManager>
+    Create(Dep<Log> log,
+           Dep<TaskManager> task_manager,
+           const UdpParameters &parameters,
+           Span<CStrSpan> bind_addrs,
+           UdpDatagramHandler datagram_handler);
+private:
+    using Address = std::pair<Str, int>; // Ip and port.
+    Vec<Address> bind_addrs_;
+};
+
+} // xynq
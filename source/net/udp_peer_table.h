@@ -0,0 +1,63 @@
+#pragma once
+
+#include "containers/hash.h"
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include <sys/socket.h>
+
+namespace xynq {
+
+// Sequence number in front of every datagram and reply.
+using UdpSequence = uint64_t;
+
+// Max number of peers whose sequence numbers are tracked by a single socket.
+// Peers that timed out are forgotten once there are more.
+static constexpr size_t kMaxTrackedPeers = 64 * 1024;
+
+// Ip and port of the peer. IPv4 address takes the first 4 bytes of ip.
+struct UdpPeer {
+    uint64_t ip[2] = {0, 0};
+    uint16_t port = 0;
+    uint16_t family = 0;
+
+    bool operator==(const UdpPeer &other) const {
+        return ip[0] == other.ip[0] && ip[1] == other.ip[1] && port == other.port && family == other.family;
+    }
+};
+
+struct UdpPeerHash {
+    size_t operator()(const UdpPeer &peer) const {
+        return std::hash<uint64_t>()(peer.ip[0] ^ (peer.ip[1] * 31) ^ ((uint64_t)peer.port << 48));
+    }
+};
+
+UdpPeer MakeUdpPeer(const sockaddr_storage &addr);
+
+// Last handled sequence number of every peer. Owned by a single socket, so it is not thread-safe.
+class UdpPeerTable {
+public:
+    explicit UdpPeerTable(uint64_t peer_timeout_msec)
+        : peer_timeout_msec_(peer_timeout_msec)
+    {}
+
+    // Returns false if sequence is not newer than the last accepted one from the peer.
+    bool Accept(const UdpPeer &peer, UdpSequence sequence, uint64_t now_msec);
+
+    // Number of peers currently tracked.
+    size_t NumPeers() const { return peers_.size(); }
+
+private:
+    struct PeerState {
+        UdpSequence sequence = 0;
+        uint64_t last_seen_msec = 0;
+    };
+
+    uint64_t peer_timeout_msec_ = 0;
+    HashMap<UdpPeer, PeerState, UdpPeerHash> peers_;
+
+    void ForgetTimedOut(uint64_t now_msec);
+};
+
+} // xynq
@@ -15,4 +15,19 @@ Either<StrSpan, Object::Handle> ObjectVault::CreateObject() {
     store_.push_back(obj);
     object_id_index_[obj->guid_] = obj;
     return obj;
-}
\ No newline at end of file
+}
+
+size_t ObjectVault::NumObjects() {
+    std::lock_guard<std::mutex> l(m_lock);
+    return store_.size();
+}
+
+size_t ObjectVault::GetObjects(size_t first, MutSpan<Object::Handle> objects) {
+    std::lock_guard<std::mutex> l(m_lock);
+    size_t num_copied = 0;
+    while (first + num_copied < store_.size() && num_copied < objects.Size()) {
+        objects[num_copied] = store_[first + num_copied];
+        ++num_copied;
+    }
+    return num_copied;
+}
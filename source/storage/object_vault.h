@@ -25,6 +25,14 @@ public:
 
     // Returns objects schema.
     TypeSchemaPtr Schema() const { return schema_; }
+
+    // Number of objects in the vault. Objects are only added, so Enumerate
+    // called afterwards visits at least that many.
+    size_t NumObjects();
+
+    // Copies handles of objects starting from the first one into objects.
+    // Returns number of copied handles. Unlike Enumerate, vault is not locked while objects are used.
+    size_t GetObjects(size_t first, MutSpan<Object::Handle> objects);
 private:
     std::mutex m_lock;
 
@@ -1,5 +1,7 @@
 #include "object_writer.h"
 
+#include <cstring>
+
 using namespace xynq;
 
 namespace {
@@ -47,6 +49,11 @@ void WriteBasicValue(TypeSchemaPtr type, Value value, TypeSchemaPtr dst_type, vo
     }
 }
 
+// Fields that are plain values in memory. Strings point to memory not owned by the object.
+bool IsNativeField(TypeSchemaPtr field_type) {
+    return field_type->IsNumeric();
+}
+
 } // anon namespace
 
 
@@ -89,4 +96,41 @@ ObjectWriterResult ObjectWriter::WriteTyped(StrSpan field_name, TypeSchemaPtr ty
         return StrSpan{"Unsupported type"};
     }
     return ObjectWriteSuccess{};
-}
\ No newline at end of file
+}
+
+ObjectWriterResult ObjectWriter::WriteNative(DataSpan packed_fields) {
+    size_t fields_size = NativeFieldsSize(schema_);
+    if (fields_size == 0) {
+        return StrSpan{"Unsupported type"};
+    }
+
+    if (packed_fields.Size() != fields_size) {
+        return StrSpan{"Fields size mismatch"};
+    }
+
+    const FieldSchema *field = &schema_->fields[0];
+    const FieldSchema *field_end = field + schema_->field_count;
+    const uint8_t *src = (const uint8_t *)packed_fields.Data();
+    void *cur = object_->Data();
+
+    while (field != field_end) {
+        cur = TypeSchema::AlignPtr(cur, field->schema->alignment);
+        memcpy(cur, src, field->schema->size);
+        src += field->schema->size;
+        cur = TypeSchema::OffsetPtr(cur, field->schema->size);
+        ++field;
+    }
+
+    return ObjectWriteSuccess{};
+}
+
+size_t ObjectWriter::NativeFieldsSize(TypeSchemaPtr schema) {
+    size_t size = 0;
+    for (size_t i = 0; i < schema->field_count; ++i) {
+        if (!IsNativeField(schema->fields[i].schema)) {
+            return 0;
+        }
+        size += schema->fields[i].schema->size;
+    }
+    return size;
+}
@@ -19,6 +19,14 @@ public:
     ~ObjectWriter();
 
     ObjectWriterResult WriteTyped(StrSpan field_name, TypeSchemaPtr type, Value value);
+
+    // Writes all fields from their native (in-memory) representation packed one after another
+    // in the schema order with no padding. See NativeFieldsSize.
+    ObjectWriterResult WriteNative(DataSpan packed_fields);
+
+    // Size of the fields written by WriteNative.
+    // Returns 0 if some of the fields can not be written from their native representation.
+    static size_t NativeFieldsSize(TypeSchemaPtr schema);
 private:
     Dep<Storage> storage_;
     Object *object_ = nullptr;
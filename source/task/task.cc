@@ -12,7 +12,7 @@ void Task::Execute(WorkerThread *from_thread, platform::ExecContext &prev, TaskA
 #if defined(XYNQ_TASK_TRACK_STACK_SIZE)
     DebugFillStack();
 #endif
-    context_.Execute(prev, stack_buf_, sizeof(stack_buf_), func_, (TaskContext *)this, args);
+    context_.Execute(prev, stack_buf_, stack_size_, func_, (TaskContext *)this, args);
 #if defined(XYNQ_TASK_TRACK_STACK_SIZE)
     DebugCheckStack();
 #endif
@@ -37,7 +37,7 @@ void Task::Resume(WorkerThread *from_thread, platform::ExecContext &prev) {
 
 #if defined(XYNQ_TASK_TRACK_STACK_SIZE)
 void Task::DebugFillStack() {
-    uint32_t *buf_cur = (uint32_t *)&stack_buf_[0];
+    uint32_t *buf_cur = (uint32_t *)stack_buf_;
     uint32_t *buf_end = buf_cur + (StackSize() >> 2);
     while (buf_cur != buf_end) {
         *buf_cur++ = 0xC1D2E3F4;
@@ -45,7 +45,7 @@ void Task::DebugFillStack() {
 }
 
 void Task::DebugCheckStack() {
-    uint32_t *buf_cur = (uint32_t *)&stack_buf_[0];
+    uint32_t *buf_cur = (uint32_t *)stack_buf_;
     uint32_t *buf_end = buf_cur + (StackSize() >> 2);
 
     while (buf_cur != buf_end && *buf_cur == 0xC1D2E3F4) {
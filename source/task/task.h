@@ -1,8 +1,13 @@
 #pragma once
 
+#include "task_arg_pool.h"
+#include "wait_slot.h"
+
 #include "base/assert.h"
 #include "os/exec_context.h"
 
+#include <atomic>
+#include <cstdint>
 #include <tuple>
 #include <type_traits>
 
@@ -16,13 +21,30 @@ namespace xynq {
 class TaskContext;
 class WorkerThread;
 
+// Task arguments up to kTaskMaxArgsSize are stored inside of the task tuple.
+// Bigger ones are spilled into a block from the per-worker TaskArgPool (see detail::TaskTuple).
 static constexpr size_t kTaskMaxArgsSize = 128;
 using TaskArgStorage = typename std::aligned_storage<kTaskMaxArgsSize>::type;
 using TaskFunc = void(*)(TaskContext *, TaskArgStorage *);
+using TaskArgsRelease = void(*)(TaskArgStorage *);
+
+// Task stacks are pooled by size classes: powers of two from kTaskMinStackSize
+// to kTaskMaxPooledStackSize. Requested stack size is rounded up to its class.
+// Stacks bigger than kTaskMaxPooledStackSize are allocated exactly and not pooled.
+static constexpr size_t kTaskMinStackSize = 8 * 1024;
+static constexpr size_t kTaskMaxPooledStackSize = 256 * 1024;
 
 static constexpr size_t kThreaduserDataSize = 128;
 using ThreadUserDataStorage = typename std::aligned_storage<kThreaduserDataSize>::type;
 
+// Scheduling classes. Workers run queued tasks of higher classes first.
+enum class TaskPriority : uint8_t {
+    Realtime,    // Short latency-critical tasks.
+    Interactive, // Request handling. Default class.
+    Bulk,        // Long-running background work. Still gets a share of workers when others are busy.
+};
+static constexpr size_t kNumTaskPriorities = 3;
+
 enum class TaskState {
     NotStarted,
     Executing,
@@ -32,7 +54,8 @@ enum class TaskState {
 // Tasks are defined as POD structs with some static fields:
 //   exec:       static function that must take TaskContext as the first argument.
 //   stack_size: min stack size needed for the task.
-//   debug_name: name used for task manager logging.
+//   debug_name: name used for task manager logging and stack overflow reports.
+//   priority:   scheduling class of the task.
 // Example:
 // struct HelloTask {
 //      static constexpr unsigned stack_size = 512;
@@ -49,14 +72,17 @@ struct TaskDefaults {
 
     // Min stack size required for the task.
     static constexpr unsigned stack_size = 1024;
+
+    // Scheduling class the task is queued with unless it's overridden on spawn.
+    static constexpr TaskPriority priority = TaskPriority::Interactive;
 };
 
 // Fiber-based task.
+// Does not own its stack. Tasks are created and recycled by TaskPool.
 class Task {
+    friend class TaskPool;
 public:
-#if defined(XYNQ_TASK_HAS_DEBUGNAME)
     const char *debug_name_ = TaskDefaults::debug_name;
-#endif
 #if defined(XYNQ_TASK_TRACK_STACK_SIZE)
     size_t used_stack_size_ = (size_t)-1;
 #endif
@@ -79,7 +105,10 @@ public:
     inline void Bind(T &&func) { func_ = std::forward<T>(func); }
 
     // Stack size of this task.
-    inline size_t StackSize() const { return sizeof(stack_buf_); }
+    inline size_t StackSize() const { return stack_size_; }
+
+    // Lowest address of the stack. Guard page lies right below it.
+    inline const char *StackBuffer() const { return stack_buf_; }
 
     // Execution context of this task.
     inline platform::ExecContext &ExecContext() { return context_; }
@@ -87,6 +116,22 @@ public:
     // Task state.
     inline TaskState State() const { return state_; }
 
+    // Scheduling class the task is queued with when it's resumed.
+    inline TaskPriority Priority() const { return priority_; }
+
+    // Deadline (see TaskContext::NowMsec) the task is queued with when it's resumed. 0 - no deadline.
+    inline uint64_t DeadlineMsec() const { return deadline_msec_; }
+
+    // Sets scheduling class and deadline the task is queued with.
+    inline void SetSchedule(TaskPriority priority, uint64_t deadline_msec) {
+        priority_ = priority;
+        deadline_msec_ = deadline_msec;
+    }
+
+    // Worker the task always runs on. -1 - any worker.
+    inline int PinnedThread() const { return pinned_thread_; }
+    inline void SetPinnedThread(int thread_index) { pinned_thread_ = thread_index; }
+
     // Thread that this fiber is currently running on.
     // Only valid for tasks that are in the executing state.
     inline WorkerThread *Thread() const {
@@ -94,14 +139,23 @@ public:
         return thread_;
     }
 
+    // Wakeup state of the task. Events the task waits for are registered with its handles.
+    inline detail::WaitSlot &WakeupSlot() { return *wait_slot_; }
+
 protected:
     platform::ExecContext context_;
     TaskFunc func_;
     TaskState state_ = TaskState::NotStarted;
+    TaskPriority priority_ = TaskPriority::Interactive;
+    uint64_t deadline_msec_ = 0;
+    int pinned_thread_ = -1;
     WorkerThread *thread_ = nullptr;
 
-    alignas(alignof(uint32_t)) char stack_buf_[16384];
-    static_assert((sizeof(stack_buf_) & 3u) == 0, "Stack size should be divisible by 4.");
+    char *stack_buf_ = nullptr;
+    size_t stack_size_ = 0;
+    int numa_node_ = -1; // Node the stack is placed on. -1 - default placement.
+    Task *pool_next_ = nullptr; // Next free task in the TaskPool.
+    detail::WaitSlot *wait_slot_ = nullptr; // Belongs to the task until it's destroyed.
 
 #if defined(XYNQ_TASK_TRACK_STACK_SIZE)
     void DebugFillStack();
@@ -116,16 +170,22 @@ namespace detail {
 // Helper to always enforce correct task constructor.
 template<class T> struct TaskCtorWrap{};
 
+// True if arguments are stored inside of the task tuple and not spilled.
+template<class...Args>
+static constexpr bool kTaskArgsFitInline = sizeof(std::tuple<TaskContext *, std::decay_t<Args>...>) <= kTaskMaxArgsSize;
+
 // Internal task representation.
 struct TaskTuple {
     TaskPtr task_ = nullptr;
     TaskArgStorage args_store_;
     TaskFunc func_;
+    TaskArgsRelease release_args_ = nullptr; // Frees spilled arguments of a task that never runs. nullptr - not spilled.
     unsigned stack_size_ = 0;
+    TaskPriority priority_ = TaskPriority::Interactive;
+    uint64_t deadline_msec_ = 0; // 0 - no deadline.
+    int pinned_thread_ = -1;     // Worker the task is not stolen from. -1 - any worker.
 
-#if defined(XYNQ_TASK_HAS_DEBUGNAME)
     const char *debug_name_ = nullptr;
-#endif
 
     inline TaskTuple() = default;
     inline TaskTuple(const TaskTuple &) = default;
@@ -148,27 +208,51 @@ struct TaskTuple {
 template<class TaskType, class...Args>
 TaskTuple::TaskTuple(TaskCtorWrap<TaskType>, Args...args) {
     using T = std::tuple<TaskContext *, Args...>;
-    static_assert(sizeof(T) <= kTaskMaxArgsSize, "Maximum task arguments size must be <= 128 bytes");
-
-    // Passing nullptr as context first.
-    // it will be set at the task execution.
-    new (&args_store_) T{nullptr, std::forward<Args>(args)...};
-    func_ = [](TaskContext *tc, TaskArgStorage *arg_buf) {
-        T *args_tuple_ptr = (T *)arg_buf;
-        std::get<0>(*args_tuple_ptr) = tc; // Assigning right context.
 
-        // Invoke Task::exec with arguments restored from the buffer
-        std::apply(TaskType::exec, *args_tuple_ptr);
-    };
+    if constexpr (sizeof(T) <= kTaskMaxArgsSize) {
+        // Passing nullptr as context first.
+        // it will be set at the task execution.
+        new (&args_store_) T{nullptr, std::forward<Args>(args)...};
+        func_ = [](TaskContext *tc, TaskArgStorage *arg_buf) {
+            T *args_tuple_ptr = (T *)arg_buf;
+            std::get<0>(*args_tuple_ptr) = tc; // Assigning right context.
+
+            // Invoke Task::exec with arguments restored from the buffer
+            std::apply(TaskType::exec, *args_tuple_ptr);
+        };
+    } else {
+        // Too big to be stored in place: arguments are spilled into a pooled block
+        // and only the pointer is stored. Block moves together with the tuple when the task is stolen
+        // and is released by the worker that ran the task.
+        static_assert(alignof(T) <= TaskArgPool::kAlignment, "Task arguments are overaligned");
+        T *spilled = new (AllocTaskArgs(sizeof(T))) T{nullptr, std::forward<Args>(args)...};
+        new (&args_store_) T*{spilled};
+        func_ = [](TaskContext *tc, TaskArgStorage *arg_buf) {
+            T *args_tuple_ptr = *(T **)arg_buf;
+            std::get<0>(*args_tuple_ptr) = tc;
+
+            std::apply(TaskType::exec, *args_tuple_ptr);
+
+            args_tuple_ptr->~T();
+            FreeTaskArgs(args_tuple_ptr);
+        };
+        release_args_ = [](TaskArgStorage *arg_buf) {
+            T *args_tuple_ptr = *(T **)arg_buf;
+            args_tuple_ptr->~T();
+            FreeTaskArgs(args_tuple_ptr);
+        };
+    }
 
     stack_size_ = TaskType::stack_size;
-#if defined(XYNQ_TASK_HAS_DEBUGNAME)
+    priority_ = TaskType::priority;
     debug_name_ = TaskType::debug_name;
-#endif
 }
 
 TaskTuple::TaskTuple(TaskPtr task)
-    : task_(task) {
+    : task_(task)
+    , priority_(task->Priority())
+    , deadline_msec_(task->DeadlineMsec())
+    , pinned_thread_(task->PinnedThread()) {
 }
 
 } // detail
@@ -0,0 +1,105 @@
+#include "task_arg_pool.h"
+
+#include "base/assert.h"
+#include "base/system_allocator.h"
+
+using namespace xynq;
+using namespace xynq::detail;
+
+namespace {
+
+// Pool of the worker running on this thread.
+thread_local TaskArgPool *t_current_pool = nullptr;
+
+} // anon namespace
+
+TaskArgPool::TaskArgPool(size_t max_cached_per_class)
+    : max_cached_per_class_(max_cached_per_class) {
+}
+
+TaskArgPool::~TaskArgPool() {
+    for (Bucket &bucket : buckets_) {
+        while (bucket.head_ != nullptr) {
+            Header *header = bucket.head_;
+            bucket.head_ = header->next;
+            SystemAllocator::Shared().Free(header);
+        }
+        bucket.num_free_ = 0;
+    }
+}
+
+void *TaskArgPool::Acquire(size_t size) {
+    size_t class_index = ClassIndex(size);
+    if (class_index < kNumClasses && buckets_[class_index].head_ != nullptr) {
+        Bucket &bucket = buckets_[class_index];
+        Header *header = bucket.head_;
+        bucket.head_ = header->next;
+        --bucket.num_free_;
+        header->next = nullptr;
+        return header + 1;
+    }
+
+    return AllocBlock(size);
+}
+
+void TaskArgPool::Release(void *block) {
+    XYAssert(block != nullptr);
+
+    Header *header = static_cast<Header *>(block) - 1;
+    if (header->class_index >= kNumClasses || buckets_[header->class_index].num_free_ >= max_cached_per_class_) {
+        SystemAllocator::Shared().Free(header);
+        return;
+    }
+
+    Bucket &bucket = buckets_[header->class_index];
+    header->next = bucket.head_;
+    bucket.head_ = header;
+    ++bucket.num_free_;
+}
+
+size_t TaskArgPool::NumFree() const {
+    size_t num_free = 0;
+    for (const Bucket &bucket : buckets_) {
+        num_free += bucket.num_free_;
+    }
+    return num_free;
+}
+
+void TaskArgPool::SetCurrent(TaskArgPool *pool) {
+    t_current_pool = pool;
+}
+
+size_t TaskArgPool::ClassIndex(size_t size) {
+    size_t index = 0;
+    size_t class_size = kMinBlockSize;
+    while (class_size < size && index < kNumClasses) {
+        class_size <<= 1;
+        ++index;
+    }
+    return index;
+}
+
+void *TaskArgPool::AllocBlock(size_t size) {
+    size_t class_index = ClassIndex(size);
+    size_t block_size = class_index < kNumClasses ? kMinBlockSize << class_index : size;
+
+    Header *header = static_cast<Header *>(SystemAllocator::Shared().AllocAligned(kAlignment, sizeof(Header) + block_size));
+    XYAssert(header != nullptr);
+    header->class_index = class_index;
+    header->next = nullptr;
+    return header + 1;
+}
+
+void *xynq::detail::AllocTaskArgs(size_t size) {
+    TaskArgPool *pool = t_current_pool;
+    return pool != nullptr ? pool->Acquire(size) : TaskArgPool::AllocBlock(size);
+}
+
+void xynq::detail::FreeTaskArgs(void *block) {
+    TaskArgPool *pool = t_current_pool;
+    if (pool != nullptr) {
+        pool->Release(block);
+    } else {
+        SystemAllocator::Shared().Free(static_cast<TaskArgPool::Header *>(block) - 1);
+    }
+}
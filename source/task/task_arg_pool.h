@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace xynq {
+namespace detail {
+
+// Per-thread cache of memory blocks for task arguments that don't fit into kTaskMaxArgsSize.
+// Blocks are bucketed by size class (see kMinBlockSize). Block is freed by the worker that
+// finished the task, so blocks migrate between pools of workers together with stolen tasks.
+// Not thread-safe: every worker thread owns its pool and makes it current (see SetCurrent).
+class TaskArgPool {
+public:
+    // max_cached_per_class: limit of free blocks kept in every bucket,
+    // blocks released above the limit are freed.
+    explicit TaskArgPool(size_t max_cached_per_class);
+    ~TaskArgPool();
+
+    TaskArgPool(const TaskArgPool &) = delete;
+    TaskArgPool &operator=(const TaskArgPool &) = delete;
+
+    // Returns block of at least size bytes aligned to kAlignment.
+    void *Acquire(size_t size);
+
+    // Returns block back into the pool. Block might be acquired from another pool.
+    void Release(void *block);
+
+    // Number of free blocks kept in the pool.
+    size_t NumFree() const;
+
+    // Pool used by AllocTaskArgs/FreeTaskArgs on the calling thread. nullptr - no pool.
+    static void SetCurrent(TaskArgPool *pool);
+
+    static constexpr size_t kAlignment = 16;
+private:
+    static constexpr size_t kMinBlockSize = 256;
+    static constexpr size_t kNumClasses = 5; // 256, 512, 1k, 2k, 4k.
+
+    // Placed in front of every block.
+    struct alignas(kAlignment) Header {
+        size_t class_index = 0;
+        Header *next = nullptr; // Next free block in the bucket.
+    };
+
+    struct Bucket {
+        Header *head_ = nullptr;
+        size_t num_free_ = 0;
+    };
+
+    Bucket buckets_[kNumClasses];
+    size_t max_cached_per_class_ = 0;
+
+    friend void *AllocTaskArgs(size_t size);
+    friend void FreeTaskArgs(void *block);
+
+    // Returns kNumClasses for blocks that are not pooled.
+    static size_t ClassIndex(size_t size);
+    static void *AllocBlock(size_t size);
+};
+
+// Allocates block for task arguments from the pool of the calling thread
+// or from the system allocator if there is none (ie. entry points added before workers start).
+void *AllocTaskArgs(size_t size);
+
+// Releases block into the pool of the calling thread.
+void FreeTaskArgs(void *block);
+
+} // detail
+} // xynq
@@ -0,0 +1,80 @@
+#pragma once
+
+#include "task_context.h"
+
+#include "containers/vec.h"
+
+#include <utility>
+
+namespace xynq {
+
+// Collects tasks to be queued at once with TaskContext::PerformAsyncBatch.
+// Tasks are published to other workers with a single queue update
+// and parked workers are woken up at most once each.
+// Batch is emptied on submission and can be reused.
+class TaskBatch {
+    friend class TaskContext;
+public:
+    TaskBatch() = default;
+    // Tasks that were not submitted are dropped, see Clear.
+    inline ~TaskBatch() { Clear(); }
+    TaskBatch(const TaskBatch &) = delete;
+    TaskBatch &operator=(const TaskBatch &) = delete;
+
+    // Preallocates space for num_tasks tasks.
+    inline void Reserve(size_t num_tasks) { tasks_.reserve(num_tasks); }
+
+    // Adds task with its default schedule. Same as TaskContext::PerformAsync.
+    template<class T, class...Args>
+    inline void Add(Args&&...args);
+
+    // Adds task with schedule. Same as TaskContext::PerformScheduled.
+    template<class T, class...Args>
+    inline void AddScheduled(const TaskSchedule &schedule, Args&&...args);
+
+    // Adds task that only runs on worker thread_index, it's resumed there after every wait too.
+    // Same as TaskManager::AddPinnedEntryPoint.
+    template<class T, class...Args>
+    inline void AddPinned(size_t thread_index, Args&&...args);
+
+    inline size_t Size() const { return tasks_.size(); }
+    inline bool IsEmpty() const { return tasks_.empty(); }
+
+    // Drops tasks without running them. Arguments spilled out of the tasks (see detail::TaskTuple) are released.
+    inline void Clear();
+private:
+    Vec<detail::TaskTuple> tasks_;
+};
+////////////////////////////////////////////////////////////
+
+
+
+// Implementation
+template<class T, class...Args>
+void TaskBatch::Add(Args&&...args) {
+    tasks_.emplace_back(detail::TaskCtorWrap<T>(), std::forward<Args>(args)...);
+}
+
+template<class T, class...Args>
+void TaskBatch::AddScheduled(const TaskSchedule &schedule, Args&&...args) {
+    detail::TaskTuple &task = tasks_.emplace_back(detail::TaskCtorWrap<T>(), std::forward<Args>(args)...);
+    task.priority_ = schedule.priority;
+    task.deadline_msec_ = schedule.deadline_msec;
+}
+
+template<class T, class...Args>
+void TaskBatch::AddPinned(size_t thread_index, Args&&...args) {
+    detail::TaskTuple &task = tasks_.emplace_back(detail::TaskCtorWrap<T>(), std::forward<Args>(args)...);
+    task.pinned_thread_ = static_cast<int>(thread_index);
+}
+
+void TaskBatch::Clear() {
+    for (detail::TaskTuple &task : tasks_) {
+        if (task.release_args_ != nullptr) {
+            task.release_args_(&task.args_store_);
+        }
+    }
+    tasks_.clear();
+}
+
+} // xynq
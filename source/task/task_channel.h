@@ -0,0 +1,200 @@
+#pragma once
+
+#include "task_context.h"
+#include "task_sync.h"
+
+#include "base/maybe.h"
+#include "base/system_allocator.h"
+
+#include <mutex>
+#include <utility>
+
+namespace xynq {
+
+// Bounded multi-producer multi-consumer queue for passing values between tasks.
+// Senders are suspended while the channel is full and receivers while it's empty.
+// Closed channel does not accept new values, but the ones already sent can still be received.
+template<class T>
+class TaskChannel {
+public:
+    explicit TaskChannel(size_t capacity);
+    ~TaskChannel();
+
+    TaskChannel(const TaskChannel &) = delete;
+    TaskChannel &operator=(const TaskChannel &) = delete;
+
+    // Suspends task until there is space in the channel.
+    // Returns false if the channel is closed, value is not sent in that case.
+    bool Send(TaskContext &tc, T &&value);
+
+    // Returns false if the channel is full or closed. Value is only moved from on success.
+    bool TrySend(TaskContext &tc, T &&value);
+
+    // Suspends task until there is a value in the channel.
+    // Returns nothing if the channel is closed and all values have been received.
+    Maybe<T> Receive(TaskContext &tc);
+
+    // Returns nothing if the channel is empty.
+    Maybe<T> TryReceive(TaskContext &tc);
+
+    // Resumes all waiting tasks. Sending to closed channel fails.
+    void Close(TaskContext &tc);
+
+    // Number of values in the channel.
+    size_t Size();
+
+    inline size_t Capacity() const { return capacity_; }
+private:
+    std::mutex mutex_;
+    T *items_ = nullptr;
+    size_t capacity_ = 0;
+    size_t head_ = 0; // Next value to receive.
+    size_t size_ = 0;
+    bool closed_ = false;
+    detail::TaskWaitList senders_;
+    detail::TaskWaitList receivers_;
+
+    // Suspends task on the wait list. Lock is locked again once the task is resumed.
+    static void Park(TaskContext &tc, std::unique_lock<std::mutex> &lock, detail::TaskWaitList &waiters);
+
+    // Resumes first waiter from the list. Unlocks lock.
+    static void WakeOne(TaskContext &tc, std::unique_lock<std::mutex> &lock, detail::TaskWaitList &waiters);
+
+    void Push(T &&value);
+    T Pop();
+};
+////////////////////////////////////////////////////////////
+
+
+
+// Implementation
+template<class T>
+TaskChannel<T>::TaskChannel(size_t capacity)
+    : capacity_(capacity) {
+    XYAssert(capacity > 0);
+    items_ = (T *)SystemAllocator::Shared().AllocAligned(alignof(T), sizeof(T) * capacity);
+}
+
+template<class T>
+TaskChannel<T>::~TaskChannel() {
+    XYAssert(senders_.IsEmpty() && receivers_.IsEmpty());
+    while (size_ > 0) {
+        Pop();
+    }
+    SystemAllocator::Shared().Free(items_);
+}
+
+template<class T>
+bool TaskChannel<T>::Send(TaskContext &tc, T &&value) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    // Another sender can take the space before resumed task gets the lock.
+    while (size_ == capacity_ && !closed_) {
+        Park(tc, lock, senders_);
+    }
+
+    if (closed_) {
+        return false;
+    }
+
+    Push(std::move(value));
+    WakeOne(tc, lock, receivers_);
+    return true;
+}
+
+template<class T>
+bool TaskChannel<T>::TrySend(TaskContext &tc, T &&value) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (size_ == capacity_ || closed_) {
+        return false;
+    }
+
+    Push(std::move(value));
+    WakeOne(tc, lock, receivers_);
+    return true;
+}
+
+template<class T>
+Maybe<T> TaskChannel<T>::Receive(TaskContext &tc) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (size_ == 0 && !closed_) {
+        Park(tc, lock, receivers_);
+    }
+
+    if (size_ == 0) { // Closed and drained.
+        return {};
+    }
+
+    Maybe<T> value{Pop()};
+    WakeOne(tc, lock, senders_);
+    return value;
+}
+
+template<class T>
+Maybe<T> TaskChannel<T>::TryReceive(TaskContext &tc) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (size_ == 0) {
+        return {};
+    }
+
+    Maybe<T> value{Pop()};
+    WakeOne(tc, lock, senders_);
+    return value;
+}
+
+template<class T>
+void TaskChannel<T>::Close(TaskContext &tc) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    closed_ = true;
+
+    detail::TaskWaitList waiters = senders_;
+    waiters.PushFront(std::move(receivers_));
+    senders_ = detail::TaskWaitList{};
+    receivers_ = detail::TaskWaitList{};
+    lock.unlock();
+
+    while (detail::TaskWaiter *waiter = waiters.PopFront()) {
+        tc.Wake(waiter->task_);
+    }
+}
+
+template<class T>
+size_t TaskChannel<T>::Size() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return size_;
+}
+
+template<class T>
+void TaskChannel<T>::Park(TaskContext &tc, std::unique_lock<std::mutex> &lock, detail::TaskWaitList &waiters) {
+    detail::TaskWaiter waiter;
+    waiter.task_ = &tc;
+    waiters.PushBack(&waiter);
+    tc.SuspendAndUnlock(lock);
+    lock.lock();
+}
+
+template<class T>
+void TaskChannel<T>::WakeOne(TaskContext &tc, std::unique_lock<std::mutex> &lock, detail::TaskWaitList &waiters) {
+    detail::TaskWaiter *waiter = waiters.PopFront();
+    lock.unlock();
+    if (waiter != nullptr) {
+        tc.Wake(waiter->task_);
+    }
+}
+
+template<class T>
+void TaskChannel<T>::Push(T &&value) {
+    new (&items_[(head_ + size_) % capacity_]) T(std::move(value));
+    ++size_;
+}
+
+template<class T>
+T TaskChannel<T>::Pop() {
+    T &item = items_[head_];
+    T value{std::move(item)};
+    item.~T();
+    head_ = (head_ + 1) % capacity_;
+    --size_;
+    return value;
+}
+
+} // xynq
@@ -1,4 +1,8 @@
 #include "task_context.h"
+#include "task_batch.h"
+
+#include "base/system_allocator.h"
+#include "os/utils.h"
 
 using namespace xynq;
 
@@ -26,6 +30,150 @@ void TaskContext::WaitEvent(EventSource *event_source, unsigned event_flags) {
     state.pending_event_flags_ = event_flags; // force exactly once for all waitable events.
     state.has_pending_event_ = true;
     state.current_task_->Suspend(); // Will switch fiber here and execution will stop until event
+
+    if (event_flags & EventFlags::EdgeTriggered) {
+        WakeupSlot().FinishEdgeWait();
+    }
+}
+
+int32_t TaskContext::WaitIo(EventIoRequest &request) {
+    XYAssert(thread_ != nullptr);
+    XYAssert(thread_->events_->SupportsIoRequests());
+
+    // Same as with WaitEvent: request is submitted once the task is suspended.
+    WorkerThread::ExecutionState &state = thread_->exec_;
+    state.pending_io_ = &request;
+    state.current_task_->Suspend();
+    return request.result;
+}
+
+void TaskContext::WaitMultishot(EventMultishotRequest &request) {
+    XYAssert(thread_ != nullptr);
+    XYAssert(thread_->events_->SupportsIoRequests());
+    if (request.HasCompletions()) {
+        return;
+    }
+
+    WorkerThread::ExecutionState &state = thread_->exec_;
+    state.pending_multishot_ = &request;
+    state.current_task_->Suspend();
+    WakeupSlot().FinishEdgeWait();
+}
+
+bool TaskContext::WaitMultishot(EventMultishotRequest &request, uint64_t deadline_msec) {
+    XYAssert(thread_ != nullptr);
+    XYAssert(thread_->events_->SupportsIoRequests());
+    if (request.HasCompletions()) {
+        return true;
+    }
+
+    detail::TaskTimer timer;
+    timer.task_ = this;
+    timer.deadline_msec_ = deadline_msec;
+
+    WorkerThread::ExecutionState &state = thread_->exec_;
+    state.pending_multishot_ = &request;
+    state.pending_timer_ = &timer;
+    state.current_task_->Suspend();
+    WakeupSlot().FinishEdgeWait();
+
+    if (timer.expired_) {
+        return false;
+    }
+
+    thread_->CancelTimer(&timer);
+    return true;
+}
+
+void TaskContext::CancelMultishot(EventMultishotRequest &request) {
+    XYAssert(thread_ != nullptr);
+    thread_->events_->CancelMultishot(ThreadIndex(), request);
+}
+
+bool TaskContext::WaitEvent(EventSource *event_source, unsigned event_flags, uint64_t deadline_msec) {
+    XYAssert(event_source != nullptr);
+    XYAssert(thread_ != nullptr);
+
+    bool edge_triggered = (event_flags & EventFlags::EdgeTriggered) != 0;
+    detail::TaskTimer timer;
+    timer.task_ = this;
+    timer.event_source_ = edge_triggered ? nullptr : event_source; // Edge-triggered event stays registered.
+    timer.deadline_msec_ = deadline_msec;
+
+    WorkerThread::ExecutionState &state = thread_->exec_;
+    state.pending_event_ = event_source;
+    state.pending_event_flags_ = event_flags;
+    state.has_pending_event_ = true;
+    state.pending_timer_ = &timer;
+    state.current_task_->Suspend();
+
+    if (edge_triggered) {
+        WakeupSlot().FinishEdgeWait();
+    }
+
+    if (timer.expired_) {
+        return false;
+    }
+
+    thread_->CancelTimer(&timer);
+    return true;
+}
+
+void TaskContext::SuspendAndUnlock(std::unique_lock<std::mutex> &lock) {
+    XYAssert(thread_ != nullptr);
+    XYAssert(lock.owns_lock());
+
+    // Lock is released in PostTask: waker can't resume the task before it's suspended.
+    WorkerThread::ExecutionState &state = thread_->exec_;
+    std::mutex *mutex = lock.release();
+    state.pending_unlock_ = mutex;
+    state.current_task_->Suspend();
+
+    lock = std::unique_lock<std::mutex>(*mutex, std::defer_lock);
+}
+
+void TaskContext::Wake(TaskPtr task) {
+    XYAssert(thread_ != nullptr);
+    XYAssert(task != nullptr);
+    XYAssert(task->State() == TaskState::Suspended);
+
+    thread_->QueueTask(task);
+    thread_->exec_.tasks_queued_++;
+}
+
+void TaskContext::PerformAsyncBatch(TaskBatch &batch) {
+    XYAssert(thread_ != nullptr);
+    if (batch.IsEmpty()) {
+        return;
+    }
+
+    thread_->QueueTasks(Span<detail::TaskTuple>{batch.tasks_.data(), batch.tasks_.size()});
+    thread_->exec_.tasks_queued_ += static_cast<unsigned>(batch.Size());
+    batch.tasks_.clear(); // Arguments are owned by the queued tasks now.
+}
+
+uint64_t TaskContext::NowMsec() {
+    return platform::MonotonicTimeMsec();
+}
+
+void TaskContext::Sleep(uint64_t msec) {
+    XYAssert(thread_ != nullptr);
+
+    detail::TaskTimer timer;
+    timer.task_ = this;
+    timer.deadline_msec_ = NowMsec() + msec;
+
+    thread_->exec_.pending_timer_ = &timer;
+    thread_->exec_.current_task_->Suspend();
+    XYAssert(timer.expired_);
+}
+
+void TaskContext::CancelPeriodic(PeriodicTaskHandle handle) {
+    XYAssert(thread_ != nullptr);
+    XYAssert(handle != nullptr);
+
+    thread_->CancelTimer(handle);
+    DestroyObject(SystemAllocator::Shared(), handle);
 }
 
 size_t TaskContext::ThreadIndex() const {
@@ -1,6 +1,8 @@
 #pragma once
 
 #include "task.h"
+#include "task_future.h"
+#include "task_group.h"
 #include "worker_thread.h"
 #include "task_manager.h"
 
@@ -10,10 +12,29 @@
 #include "event/eventqueue.h"
 
 #include <cstdint>
+#include <mutex>
+#include <type_traits>
 #include <utility>
 
 namespace xynq {
 
+class TaskBatch;
+
+// Stack size of tasks running ParallelFor chunks.
+static constexpr unsigned kParallelForStackSize = 32 * 1024;
+
+// Scheduling parameters that override defaults of the task.
+struct TaskSchedule {
+    TaskPriority priority = TaskPriority::Interactive;
+
+    // Tasks with deadline (see TaskContext::NowMsec) are run earliest deadline first
+    // right after realtime tasks regardless of their priority. 0 - no deadline.
+    uint64_t deadline_msec = 0;
+};
+
+// Identifies task scheduled with TaskContext::PerformPeriodic.
+using PeriodicTaskHandle = detail::PeriodicTimer *;
+
 // Passed into task on execution.
 // Provides interface for tasks to fork to other tasks etc.
 class TaskContext : public Task {
@@ -44,12 +65,81 @@ public:
     template<class T, class...Args>
     inline void PerformAsync(Args&&...args);
 
+    // Queues new task and returns future for its return value. Returns immediately.
+    // Result must be awaited (see TaskFuture) before the future goes out of scope.
+    template<class T, class...Args>
+    inline TaskFuture<detail::TaskResultOf<T, std::decay_t<Args>...>> PerformAsyncWithResult(Args&&...args);
+
+    // Same as PerformAsync, but task is queued with schedule instead of its defaults.
+    template<class T, class...Args>
+    inline void PerformScheduled(const TaskSchedule &schedule, Args&&...args);
+
+    // Queues all tasks of the batch and clears it. Returns immediately.
+    void PerformAsyncBatch(TaskBatch &batch);
+
     // Performs task immediately. Blocks calling task until this task is finished.
     template<class T, class...Args>
     inline void PerformSync(Args&&...args);
 
+    // Splits [begin, end) into chunks of at most grain elements and calls fn(TaskContext &, chunk_begin, chunk_end)
+    // for each chunk in parallel. Suspends calling task until all chunks are processed.
+    // Ranges are split in halves, so idle workers steal big chunks first.
+    // Chunks run in tasks with kParallelForStackSize stack.
+    template<class Func>
+    inline void ParallelFor(size_t begin, size_t end, size_t grain, Func &&fn);
+
+    // Queues new task every interval_msec milliseconds (fixed rate) until it's cancelled.
+    // Returns immediately. Arguments are copied into every queued task,
+    // so they must fit into kTaskMaxArgsSize.
+    template<class T, class...Args>
+    inline PeriodicTaskHandle PerformPeriodic(uint64_t interval_msec, Args&&...args);
+
+    // Stops queueing periodic task. Already queued tasks will still run.
+    void CancelPeriodic(PeriodicTaskHandle handle);
+
+    // Monotonic time in milliseconds used for deadlines.
+    static uint64_t NowMsec();
+
+    // Suspends task for at least msec milliseconds.
+    void Sleep(uint64_t msec);
+
     // Suspend task until the event is thrown.
+    // With EventFlags::EdgeTriggered the first wait adds event source for the task and it stays added
+    // until it's removed from the EventQueue, later waits don't touch the queue. Edge that came
+    // while the task was not waiting ends the next wait right away. Use for reads/writes that
+    // are tried first and only wait on EAGAIN. Event source must be removed before the task finishes.
     void WaitEvent(EventSource *event_source, unsigned event_flags);
+
+    // Suspend task until the event is thrown or deadline_msec (see NowMsec) has passed.
+    // Returns false on timeout, event is removed from the queue in that case.
+    bool WaitEvent(EventSource *event_source, unsigned event_flags, uint64_t deadline_msec);
+
+    // Submits io request to the event queue and suspends task until it completes.
+    // Returns request result (see EventIoRequest::result).
+    // Only valid if EventQueue()->SupportsIoRequests().
+    int32_t WaitIo(EventIoRequest &request);
+
+    // Suspends task until multishot request has completions (see EventMultishotRequest::Take).
+    // Request that is not armed is submitted first. Returns right away if there are completions already.
+    // Task might be woken up with no completions, so callers should wait in a loop.
+    // Only valid if EventQueue()->SupportsIoRequests().
+    void WaitMultishot(EventMultishotRequest &request);
+
+    // Same as above, but returns false once deadline_msec (see NowMsec) has passed.
+    // Request stays armed on timeout.
+    bool WaitMultishot(EventMultishotRequest &request, uint64_t deadline_msec);
+
+    // Cancels armed multishot request. Request can't be released until it's no longer armed:
+    // wait for its completions until then.
+    void CancelMultishot(EventMultishotRequest &request);
+
+    // Suspends task and unlocks lock once the task is suspended. Used by synchronization primitives:
+    // task is put on a wait list under the lock and is resumed with Wake by whoever takes it from the list.
+    // Lock is not owned when the task is resumed.
+    void SuspendAndUnlock(std::unique_lock<std::mutex> &lock);
+
+    // Queues task suspended with SuspendAndUnlock on the worker of this task.
+    void Wake(TaskPtr task);
 };
 
 static_assert(sizeof(Task) == sizeof(TaskContext),
@@ -58,6 +148,116 @@ static_assert(sizeof(Task) == sizeof(TaskContext),
 
 
 
+namespace detail {
+
+template<class T, class...Args>
+struct TaskGroupChild : public T {
+    static constexpr auto exec = [](TaskContext *tc, TaskGroup *group, Args...args) {
+        T::exec(tc, std::move(args)...);
+        group->Done(*tc);
+    };
+};
+
+// Splits range in halves queueing upper ones until it's small enough to be processed in place.
+template<class Func>
+inline void ParallelForSplit(TaskContext &tc, TaskGroup &group, size_t begin, size_t end, size_t grain, Func *fn);
+
+template<class Func>
+struct ParallelForTask : public TaskDefaults {
+    static constexpr unsigned stack_size = kParallelForStackSize;
+    static constexpr auto exec = [](TaskContext *tc, TaskGroup *group, size_t begin, size_t end, size_t grain, Func *fn) {
+        ParallelForSplit(*tc, *group, begin, end, grain, fn);
+    };
+};
+
+template<class Func>
+void ParallelForSplit(TaskContext &tc, TaskGroup &group, size_t begin, size_t end, size_t grain, Func *fn) {
+    while (end - begin > grain) {
+        size_t middle = begin + (end - begin) / 2;
+        group.Run<ParallelForTask<Func>>(tc, &group, middle, end, grain, fn);
+        end = middle;
+    }
+
+    (*fn)(tc, begin, end);
+}
+
+template<class T, class R, class...Args>
+struct FutureTask : public T {
+    static constexpr auto exec = [](TaskContext *tc, TaskFuture<R> *future, Args...args) {
+        if constexpr (std::is_void_v<R>) {
+            T::exec(tc, std::move(args)...);
+            future->SetResult(*tc);
+        } else {
+            future->SetResult(*tc, T::exec(tc, std::move(args)...));
+        }
+    };
+};
+
+} // detail
+
+template<class R>
+template<class T, class...Args>
+TaskFuture<R>::TaskFuture(TaskContext &tc, detail::TaskCtorWrap<T>, Args&&...args) {
+    tc.PerformAsync<detail::FutureTask<T, R, std::decay_t<Args>...>>(this, std::forward<Args>(args)...);
+}
+
+template<class R>
+template<class...V>
+void TaskFuture<R>::SetResult(TaskContext &tc, V&&...value) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    XYAssert(!ready_);
+    result_.Set(std::forward<V>(value)...);
+    ready_ = true;
+    if (waiter_ == nullptr) {
+        return;
+    }
+
+    // Awaiting task is queued on this worker and is likely the next one to run here.
+    TaskPtr task = waiter_->task_;
+    waiter_ = nullptr;
+    lock.unlock();
+    tc.Wake(task);
+}
+
+template<class R>
+R TaskFuture<R>::Await(TaskContext &tc) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    XYAssert(!awaited_);
+    awaited_ = true;
+    if (!ready_) {
+        detail::TaskWaiter waiter;
+        waiter.task_ = &tc;
+        waiter_ = &waiter;
+        tc.SuspendAndUnlock(lock);
+        lock.lock();
+    }
+
+    XYAssert(ready_);
+    return result_.Take();
+}
+
+template<class T, class...Args>
+void TaskGroup::Run(TaskContext &tc, Args&&...args) {
+    Add();
+    tc.PerformAsync<detail::TaskGroupChild<T, std::decay_t<Args>...>>(this, std::forward<Args>(args)...);
+}
+
+template<class Func>
+void TaskContext::ParallelFor(size_t begin, size_t end, size_t grain, Func &&fn) {
+    XYAssert(begin <= end);
+    if (begin == end) {
+        return;
+    }
+    if (grain == 0) {
+        grain = 1;
+    }
+
+    using FuncType = std::remove_reference_t<Func>;
+    TaskGroup group;
+    detail::ParallelForSplit<FuncType>(*this, group, begin, end, grain, &fn);
+    group.Wait(*this);
+}
+
 template<class T, class...Args>
 void TaskContext::PerformAsync(Args&&...args) {
     XYAssert(thread_ != nullptr);
@@ -65,12 +265,36 @@ void TaskContext::PerformAsync(Args&&...args) {
     detail::TaskTuple task(detail::TaskCtorWrap<T>(), std::forward<Args>(args)...);
     thread_->QueueTask(std::move(task));
 
-    //static const size_t kQueuedThreshold = 1;
-    //bool was_under_threshold = thread_->exec_.tasks_queued_++ < kQueuedThreshold;
+    // Parked workers are woken up by the scheduler loop once this task yields control.
+    thread_->exec_.tasks_queued_++;
+}
+
+template<class T, class...Args>
+TaskFuture<detail::TaskResultOf<T, std::decay_t<Args>...>> TaskContext::PerformAsyncWithResult(Args&&...args) {
+    // Guaranteed copy elision: future is constructed right in its final place.
+    return TaskFuture<detail::TaskResultOf<T, std::decay_t<Args>...>>(*this, detail::TaskCtorWrap<T>(), std::forward<Args>(args)...);
+}
+
+template<class T, class...Args>
+void TaskContext::PerformScheduled(const TaskSchedule &schedule, Args&&...args) {
+    XYAssert(thread_ != nullptr);
+
+    detail::TaskTuple task(detail::TaskCtorWrap<T>(), std::forward<Args>(args)...);
+    task.priority_ = schedule.priority;
+    task.deadline_msec_ = schedule.deadline_msec;
+    thread_->QueueTask(std::move(task));
+    thread_->exec_.tasks_queued_++;
+}
+
+template<class T, class...Args>
+PeriodicTaskHandle TaskContext::PerformPeriodic(uint64_t interval_msec, Args&&...args) {
+    XYAssert(thread_ != nullptr);
+    XYAssert(interval_msec > 0);
+    // Tuple is copied for every run, spilled arguments would be released by the first one.
+    static_assert(detail::kTaskArgsFitInline<Args...>, "Periodic task arguments must fit into kTaskMaxArgsSize");
 
-    // This is quite expensive call, so probably should move to
-    // a single place instead of calling on every task.
-    thread_->events_->InterruptAll();
+    detail::TaskTuple task(detail::TaskCtorWrap<T>(), std::forward<Args>(args)...);
+    return thread_->SchedulePeriodic(std::move(task), interval_msec);
 }
 
 template<class T, class...Args>
@@ -0,0 +1,128 @@
+#pragma once
+
+#include "task_sync.h"
+
+#include <mutex>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace xynq {
+
+class TaskContext;
+
+template<class R>
+class TaskFuture;
+
+namespace detail {
+
+// Runs task T and sets its return value into the future.
+// Defined in task_context.h together with other templates that need complete TaskContext.
+template<class T, class R, class...Args>
+struct FutureTask;
+
+// Return value of the task stored in place.
+template<class R>
+class FutureResult {
+public:
+    FutureResult() = default;
+    FutureResult(const FutureResult &) = delete;
+    FutureResult &operator=(const FutureResult &) = delete;
+
+    inline ~FutureResult() {
+        if (has_value_) {
+            Ptr()->~R();
+        }
+    }
+
+    template<class V>
+    inline void Set(V &&value) {
+        XYAssert(!has_value_);
+        new (&buf_) R(std::forward<V>(value));
+        has_value_ = true;
+    }
+
+    inline R Take() {
+        XYAssert(has_value_);
+        R value{std::move(*Ptr())};
+        Ptr()->~R();
+        has_value_ = false;
+        return value;
+    }
+private:
+    typename std::aligned_storage<sizeof(R), alignof(R)>::type buf_;
+    bool has_value_ = false;
+
+    inline R *Ptr() { return reinterpret_cast<R *>(&buf_); }
+};
+
+template<>
+class FutureResult<void> {
+public:
+    inline void Set() {}
+    inline void Take() {}
+};
+
+// Return type of T::exec called with arguments Args.
+template<class T, class...Args>
+using TaskResultOf = decltype(T::exec(std::declval<TaskContext *>(), std::declval<Args>()...));
+
+} // detail
+
+// Result of a task queued with TaskContext::PerformAsyncWithResult.
+// Result is stored inside of the future, so it lives on the stack of the awaiting task
+// and no memory is allocated. Future can't be moved: the task writes result into it.
+// Future must be awaited before it's destroyed.
+// Example:
+//   auto left = tc->PerformAsyncWithResult<Query>(&left_range);
+//   auto right = tc->PerformAsyncWithResult<Query>(&right_range);
+//   size_t count = left.Await(*tc) + right.Await(*tc);
+template<class R>
+class TaskFuture {
+    template<class T, class Result, class...Args> friend struct detail::FutureTask;
+    friend class TaskContext;
+public:
+    TaskFuture(const TaskFuture &) = delete;
+    TaskFuture(TaskFuture &&) = delete;
+    TaskFuture &operator=(const TaskFuture &) = delete;
+    TaskFuture &operator=(TaskFuture &&) = delete;
+
+    inline ~TaskFuture();
+
+    // Suspends task until the result is set and returns it.
+    // Task is resumed on the worker that completed the result. Can only be called once.
+    inline R Await(TaskContext &tc);
+
+    // True if the task has finished.
+    inline bool IsReady();
+private:
+    std::mutex mutex_;
+    bool ready_ = false;
+    bool awaited_ = false;
+    detail::TaskWaiter *waiter_ = nullptr;
+    detail::FutureResult<R> result_;
+
+    // Queues task T. Constructed in place of the returned value, so the task can keep a pointer to it.
+    template<class T, class...Args>
+    inline TaskFuture(TaskContext &tc, detail::TaskCtorWrap<T>, Args&&...args);
+
+    template<class...V>
+    inline void SetResult(TaskContext &tc, V&&...value);
+};
+////////////////////////////////////////////////////////////
+
+
+
+// Implementation
+template<class R>
+TaskFuture<R>::~TaskFuture() {
+    XYAssert(awaited_); // Task might still write into the future.
+}
+
+template<class R>
+bool TaskFuture<R>::IsReady() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return ready_;
+}
+
+} // xynq
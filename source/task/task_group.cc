@@ -0,0 +1,42 @@
+#include "task_group.h"
+#include "task_context.h"
+
+using namespace xynq;
+using namespace xynq::detail;
+
+TaskGroup::~TaskGroup() {
+    XYAssert(pending_ == 0); // Group must be waited on.
+}
+
+void TaskGroup::Add() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    ++pending_;
+}
+
+void TaskGroup::Done(TaskContext &tc) {
+    // Counter is only changed under the lock: waiter can't see zero
+    // and destroy the group while this task still touches it.
+    std::unique_lock<std::mutex> lock(mutex_);
+    XYAssert(pending_ > 0);
+    if (--pending_ > 0 || waiter_ == nullptr) {
+        return;
+    }
+
+    TaskPtr task = waiter_->task_;
+    waiter_ = nullptr;
+    lock.unlock();
+    tc.Wake(task);
+}
+
+void TaskGroup::Wait(TaskContext &tc) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (pending_ == 0) {
+        return;
+    }
+
+    XYAssert(waiter_ == nullptr); // Only one task can wait on the group.
+    TaskWaiter waiter;
+    waiter.task_ = &tc;
+    waiter_ = &waiter;
+    tc.SuspendAndUnlock(lock);
+}
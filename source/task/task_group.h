@@ -0,0 +1,55 @@
+#pragma once
+
+#include "task_sync.h"
+
+#include <cstddef>
+#include <mutex>
+
+namespace xynq {
+
+class TaskContext;
+class TaskGroup;
+
+namespace detail {
+
+// Runs task T and reports its completion to the group.
+// Defined in task_context.h together with other templates that need complete TaskContext.
+template<class T, class...Args>
+struct TaskGroupChild;
+
+} // detail
+
+// Fork-join group of tasks. Tasks are queued on the worker of the spawning task
+// and are spread across other workers by work stealing.
+// Waiting task is suspended until all tasks of the group have finished.
+// Group must outlive its tasks, so it has to be waited on before it's destroyed.
+// Example:
+//   TaskGroup group;
+//   group.Run<LeftTask>(*tc, &left);
+//   group.Run<RightTask>(*tc, &right);
+//   group.Wait(*tc);
+class TaskGroup {
+    template<class T, class...Args> friend struct detail::TaskGroupChild;
+public:
+    TaskGroup() = default;
+    ~TaskGroup();
+
+    TaskGroup(const TaskGroup &) = delete;
+    TaskGroup &operator=(const TaskGroup &) = delete;
+
+    // Queues task T as a part of the group. Can be called by tasks of the group as well.
+    template<class T, class...Args>
+    inline void Run(TaskContext &tc, Args&&...args);
+
+    // Suspends task until all tasks of the group have finished.
+    void Wait(TaskContext &tc);
+private:
+    std::mutex mutex_;
+    size_t pending_ = 0;
+    detail::TaskWaiter *waiter_ = nullptr;
+
+    void Add();
+    void Done(TaskContext &tc);
+};
+
+} // xynq
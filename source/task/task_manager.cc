@@ -4,6 +4,8 @@
 #include "task_manager.h"
 #include "worker_thread.h"
 
+#include "os/numa.h"
+#include "os/stack.h"
 #include "os/utils.h"
 
 using namespace xynq;
@@ -15,17 +17,32 @@ TaskManager::TaskManager(Dep<Log> log,
                        size_t max_events_at_once,
                        size_t num_threads,
                        bool pin_threads,
-                       bool takeover_current_thread)
+                       bool takeover_current_thread,
+                       EventBackend event_backend,
+                       bool numa_aware,
+                       uint64_t max_spin_usec,
+                       size_t num_io_threads)
     : log_(log)
     , num_threads_(num_threads)
+    , num_io_threads_(num_io_threads)
     , pin_threads_(pin_threads)
-    , takeover_current_thread_(takeover_current_thread) {
+    , takeover_current_thread_(takeover_current_thread)
+    , numa_aware_(numa_aware)
+    , max_spin_usec_(max_spin_usec)
+    , num_parked_(0) {
     if (num_threads == kNumThreadsAutoDetect) {
         num_threads_ = platform::NumCores();
         XYTaskInfo(log, "Auto detecting number of threads to use: ", num_threads_);
     }
-    event_queue_ = CreateObject<EventQueue>(SystemAllocator::Shared(), log, max_events_at_once, num_threads_);
+    event_queue_ = CreateObject<EventQueue>(SystemAllocator::Shared(), log, event_backend,
+                                            max_events_at_once, num_threads_);
     XYAssert(num_threads_ >= 1); // Cannot exeute any tasks if there are no threads.
+
+    if (num_io_threads_ >= num_threads_) {
+        XYTaskWarning(log, "Not enough threads for ", num_io_threads_, " io threads (", num_threads_, " threads). "
+                           "Every thread will do both io and tasks.");
+        num_io_threads_ = 0;
+    }
 }
 
 void TaskManager::Run() {
@@ -34,24 +51,63 @@ void TaskManager::Run() {
     XYAssert(num_threads_ > 0);
 
     hooks.before_start.Invoke(num_threads_);
+    platform::InitStackOverflowHandler();
+
+    Vec<platform::NumaNode> numa_nodes;
+    if (numa_aware_) {
+        numa_nodes = platform::NumaTopology();
+        if (numa_nodes.size() > 1) {
+            for (const platform::NumaNode &node : numa_nodes) {
+                XYTaskInfo(log_, "NUMA node ", node.id, ": ", node.cpus.size(), " cpus");
+            }
+        } else {
+            XYTaskInfo(log_, "Single NUMA node. NUMA aware scheduling is off.");
+        }
+    }
 
+    // Spinning only pays off if the task handing work over runs on another core.
+    unsigned num_cores = platform::NumCores();
+    if (max_spin_usec_ > 0 && (num_cores < 2 || num_threads_ > num_cores)) {
+        XYTaskInfo(log_, "Workers share cores (", num_threads_, " threads, ", num_cores, " cores). Spinning before parking is off.");
+        max_spin_usec_ = 0;
+    }
+
+    Vec<WorkerPlacement> placements = PlaceWorkers(num_threads_, numa_nodes, pin_threads_, numa_nodes.size() > 1);
     threads_ = (WorkerThread *)SystemAllocator::Shared().Alloc(sizeof(WorkerThread) * num_threads_);
 
-    size_t index = 1;
-    for (WorkerThread *thread_mem = threads_ + 1; thread_mem != threads_ + num_threads_; ++thread_mem) {
-        WorkerThread *thread = new(thread_mem) WorkerThread(*this, index, log_, event_queue_, pin_threads_, false, {});
-        hooks.before_thread_start.Invoke(index, log_, thread->UserData());
-        thread->Start();
-        ++index;
+    if (num_io_threads_ > 0) {
+        XYTaskInfo(log_, num_io_threads_, " io threads, ", num_threads_ - num_io_threads_, " task threads");
     }
 
-    // TODO: round robin spread entrypoints.
-
-    WorkerThread *thread = new(threads_) WorkerThread(*this, 0, log_, event_queue_, pin_threads_, takeover_current_thread_,
-                                                      MutSpan<TaskTuple>{entrypoints_.data(), entrypoints_.size()});
+    // Construct all workers before starting any of them:
+    // running workers steal from queues of other workers.
+    Vec<TaskTuple> tasks;
+    size_t num_task_threads = num_threads_ - num_io_threads_;
+    for (size_t index = 0; index < num_threads_; ++index) {
+        // Entry points are spread round robin over non-io workers, pinned ones go to their workers.
+        tasks.clear();
+        size_t next_thread = 0;
+        for (TaskTuple &task : entrypoints_) {
+            size_t target = task.pinned_thread_ >= 0 ? static_cast<size_t>(task.pinned_thread_)
+                                                     : num_io_threads_ + next_thread++ % num_task_threads;
+            if (target == index) {
+                tasks.push_back(std::move(task));
+            }
+        }
+        new(threads_ + index) WorkerThread(*this, index, log_, event_queue_, std::move(placements[index]),
+                                           index == 0 && takeover_current_thread_,
+                                           MutSpan<TaskTuple>{tasks.data(), tasks.size()});
+    }
     entrypoints_.clear();
-    hooks.before_thread_start.Invoke(index, log_, thread->UserData());
-    thread->Start();
+
+    for (size_t index = 1; index < num_threads_; ++index) {
+        WorkerThread &thread = threads_[index];
+        hooks.before_thread_start.Invoke(index, log_, thread.UserData());
+        thread.Start();
+    }
+
+    hooks.before_thread_start.Invoke(0, log_, threads_[0].UserData());
+    threads_[0].Start();
 }
 
 void TaskManager::Stop() {
@@ -67,6 +123,56 @@ bool TaskManager::IsRunning() const {
     return threads_ != nullptr;
 }
 
+void TaskManager::WakeParkedWorker(size_t from_index) {
+    WakeParkedWorkers(from_index, 1);
+}
+
+void TaskManager::WakeParkedWorkers(size_t from_index, size_t count) {
+    // Pairs with the fence in HasQueuedTasks: either the parking worker sees
+    // the queued task or we see the parked worker.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (count == 0 || num_parked_.load(std::memory_order_relaxed) == 0) {
+        return;
+    }
+
+    // Workers of the same NUMA node first: they steal from from_index first.
+    for (size_t index : threads_[from_index].placement_.victims) {
+        if (count == 0) {
+            break;
+        }
+
+        // Io workers never take queued tasks.
+        if (!IsIoThread(index) && threads_[index].Unpark()) {
+            event_queue_->Interrupt(index);
+            --count;
+        }
+    }
+}
+
+TaskStats TaskManager::Stats() const {
+    TaskStats stats;
+    for (size_t i = 0; i < num_threads_ && threads_ != nullptr; ++i) {
+        stats.Merge(threads_[i].Stats());
+    }
+    return stats;
+}
+
+TaskStats TaskManager::WorkerStats(size_t thread_index) const {
+    XYAssert(threads_ != nullptr);
+    XYAssert(thread_index < num_threads_);
+    return threads_[thread_index].Stats();
+}
+
+bool TaskManager::HasQueuedTasks() const {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    for (size_t i = 0; i < num_threads_; ++i) {
+        if (threads_[i].NumQueuedTasks() > 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
 void TaskManager::StopInternal() {
     size_t num_running;
     do {
@@ -2,12 +2,16 @@
 
 #include "task.h"
 #include "task_context.h"
+#include "task_stats.h"
 
 #include "base/hook.h"
 #include "base/log.h"
+#include "base/platform_def.h"
 #include "containers/vec.h"
 #include "event/eventqueue.h"
 
+#include <atomic>
+
 namespace xynq {
 
 class WorkerThread;
@@ -29,11 +33,24 @@ public:
     } hooks;
 
 
+    // numa_aware: workers are grouped by NUMA nodes, steal from workers of their node first
+    // and allocate fiber stacks and memory they touch on their node.
+    // Ignored on machines with a single node.
+    // max_spin_usec: idle worker polls queues and events up to this long before it parks.
+    // Actual spin time adapts to how often work has been arriving lately. 0 - never spin.
+    // Turned off if there are more threads than cores.
+    // num_io_threads: that many of num_threads workers only poll events and run tasks pinned to them
+    // (ie. socket accepts). Tasks woken up by events are handed over to the rest of workers
+    // that never poll. 0 - every worker does both.
     TaskManager(Dep<Log> log,
                size_t max_events_at_once,
                size_t num_threads,
                bool pin_threads,
-               bool takeover_current_thread);
+               bool takeover_current_thread,
+               EventBackend event_backend = EventBackend::Epoll,
+               bool numa_aware = false,
+               uint64_t max_spin_usec = 0,
+               size_t num_io_threads = 0);
     ~TaskManager();
 
     // Runs task threads and blocks current thread.
@@ -46,20 +63,55 @@ public:
     // Number of threads in the pool.
     inline size_t NumThreads() const { return num_threads_; }
 
-    // Add task with arguments.
+    // Number of workers dedicated to events. They have indices [0, NumIoThreads()).
+    inline size_t NumIoThreads() const { return num_io_threads_; }
+
+    // Worker only polls events and runs tasks pinned to it.
+    inline bool IsIoThread(size_t thread_index) const { return thread_index < num_io_threads_; }
+
+    // Counters of all workers added up. Lock-free, can be called from any thread while running.
+    TaskStats Stats() const;
+
+    // Counters of a single worker.
+    TaskStats WorkerStats(size_t thread_index) const;
+
+    // Add task with arguments. Entry points are spread over workers round robin
+    // (except for io ones, see NumIoThreads).
     template<class T, class...Args>
     inline void AddEntryPoint(Args...args);
+
+    // Add task that always runs on the worker thread_index: it's never stolen by other workers
+    // and is resumed on that worker. Tasks it spawns are regular ones.
+    template<class T, class...Args>
+    inline void AddPinnedEntryPoint(size_t thread_index, Args...args);
 private:
     Dep<Log> log_;
     Dependable<EventQueue*> event_queue_;
+    // Wakeup slots of all tasks. Outlives workers: events polled by them point to the slots.
+    detail::WaitSlotTable wait_slots_;
     Vec<detail::TaskTuple> entrypoints_;
     WorkerThread *threads_ = nullptr;
     size_t num_threads_ = 0;
+    size_t num_io_threads_ = 0;
     bool pin_threads_ = true;
     bool takeover_current_thread_ = false;
+    bool numa_aware_ = false;
+    uint64_t max_spin_usec_ = 0;
+
+    // Number of workers parked waiting for new tasks.
+    alignas(k_cache_line_size) std::atomic<size_t> num_parked_;
 
     bool IsRunning() const;
 
+    // Wakes up at most one parked worker, searching starting after from_index.
+    void WakeParkedWorker(size_t from_index);
+
+    // Wakes up to count parked workers, searching starting after from_index.
+    void WakeParkedWorkers(size_t from_index, size_t count);
+
+    // Returns true if any of the workers has tasks in its queue.
+    bool HasQueuedTasks() const;
+
     // Will stop all threads and block until they all exit.
     void StopInternal();
 };
@@ -74,4 +126,13 @@ void TaskManager::AddEntryPoint(Args...args) {
     entrypoints_.emplace_back(detail::TaskCtorWrap<T>(), std::forward<Args>(args)...);
 }
 
+template<class T, class...Args>
+void TaskManager::AddPinnedEntryPoint(size_t thread_index, Args...args) {
+    XYAssert(!IsRunning());
+    XYAssert(thread_index < num_threads_);
+
+    entrypoints_.emplace_back(detail::TaskCtorWrap<T>(), std::forward<Args>(args)...);
+    entrypoints_.back().pinned_thread_ = static_cast<int>(thread_index);
+}
+
 } // xynq
\ No newline at end of file
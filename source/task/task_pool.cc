@@ -0,0 +1,121 @@
+#include "task_pool.h"
+
+#include "base/assert.h"
+#include "base/system_allocator.h"
+#include "os/stack.h"
+
+using namespace xynq;
+
+namespace {
+
+// Unpooled stacks are rounded up to page size.
+static constexpr size_t kStackPageSize = 4096;
+
+} // anon namespace
+
+TaskPool::TaskPool(detail::WaitSlotTable &wait_slots, size_t max_cached_per_class, int numa_node)
+    : wait_slots_(wait_slots)
+    , max_cached_per_class_(max_cached_per_class)
+    , numa_node_(numa_node) {
+}
+
+TaskPool::~TaskPool() {
+    for (Bucket &bucket : buckets_) {
+        while (bucket.head_ != nullptr) {
+            Task *task = bucket.head_;
+            bucket.head_ = task->pool_next_;
+            DestroyTask(task);
+        }
+        bucket.num_free_ = 0;
+    }
+}
+
+TaskPtr TaskPool::Acquire(size_t stack_size) {
+    size_t class_index = ClassIndex(stack_size);
+
+    TaskPtr task = nullptr;
+    if (class_index < kNumClasses && buckets_[class_index].head_ != nullptr) {
+        Bucket &bucket = buckets_[class_index];
+        task = bucket.head_;
+        bucket.head_ = task->pool_next_;
+        --bucket.num_free_;
+    } else {
+        task = CreateTask(StackSizeForClass(stack_size));
+    }
+
+    task->pool_next_ = nullptr;
+    task->state_ = TaskState::NotStarted;
+    task->thread_ = nullptr;
+    return task;
+}
+
+void TaskPool::Release(TaskPtr task) {
+    XYAssert(task != nullptr);
+    XYAssert(task->pool_next_ == nullptr);
+
+    // Events of the finished task might still be in flight: they must not wake up the next one.
+    task->wait_slot_->Retire();
+
+    size_t class_index = ClassIndex(task->StackSize());
+    if (class_index >= kNumClasses
+        || buckets_[class_index].num_free_ >= max_cached_per_class_
+        || task->numa_node_ != numa_node_) {
+        DestroyTask(task);
+        return;
+    }
+
+    Bucket &bucket = buckets_[class_index];
+    task->pool_next_ = bucket.head_;
+    bucket.head_ = task;
+    ++bucket.num_free_;
+}
+
+size_t TaskPool::NumFree() const {
+    size_t num_free = 0;
+    for (const Bucket &bucket : buckets_) {
+        num_free += bucket.num_free_;
+    }
+    return num_free;
+}
+
+size_t TaskPool::StackSizeForClass(size_t stack_size) {
+    if (stack_size > kTaskMaxPooledStackSize) {
+        return (stack_size + kStackPageSize - 1) & ~(kStackPageSize - 1);
+    }
+
+    size_t class_size = kTaskMinStackSize;
+    while (class_size < stack_size) {
+        class_size <<= 1;
+    }
+    return class_size;
+}
+
+size_t TaskPool::ClassIndex(size_t stack_size) {
+    if (stack_size > kTaskMaxPooledStackSize) {
+        return kNumClasses;
+    }
+
+    size_t index = 0;
+    size_t class_size = kTaskMinStackSize;
+    while (class_size < stack_size) {
+        class_size <<= 1;
+        ++index;
+    }
+    return index;
+}
+
+TaskPtr TaskPool::CreateTask(size_t stack_size) {
+    TaskPtr task = CreateObject<Task>(SystemAllocator::Shared());
+    task->stack_buf_ = (char *)platform::AllocStack(stack_size, numa_node_); // Page aligned, guarded.
+    task->stack_size_ = stack_size;
+    task->numa_node_ = numa_node_;
+    task->wait_slot_ = wait_slots_.Allocate(task);
+    XYAssert(task->stack_buf_ != nullptr);
+    return task;
+}
+
+void TaskPool::DestroyTask(TaskPtr task) {
+    wait_slots_.Free(task->wait_slot_);
+    platform::FreeStack(task->stack_buf_, task->stack_size_);
+    DestroyObject(SystemAllocator::Shared(), task);
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include "task.h"
+
+#include <cstddef>
+
+namespace xynq {
+
+// Per-thread cache of tasks together with their stacks.
+// Tasks are bucketed by stack size class (see kTaskMinStackSize), finished tasks
+// are returned into the bucket and reused by the next task of the same class.
+// Not thread-safe: every worker thread owns its pool. A task may be released into a pool
+// of a different thread than the one it was acquired from (ie. when it was stolen).
+// Stacks are mmaped with a guard page below them (see platform::AllocStack).
+class TaskPool {
+public:
+    // wait_slots: table wakeup slots of tasks are allocated from (see Task::WakeupSlot).
+    // max_cached_per_class: limit of free tasks kept in every bucket,
+    // tasks released above the limit are freed.
+    // numa_node: node to place stacks on, -1 - default placement.
+    // Tasks with stacks from other nodes are not cached.
+    TaskPool(detail::WaitSlotTable &wait_slots, size_t max_cached_per_class, int numa_node = -1);
+    ~TaskPool();
+
+    TaskPool(const TaskPool &) = delete;
+    TaskPool &operator=(const TaskPool &) = delete;
+
+    // Returns task with stack of at least stack_size bytes.
+    // Task is in NotStarted state.
+    TaskPtr Acquire(size_t stack_size);
+
+    // Returns task back into the pool. Its wakeup slot is retired.
+    void Release(TaskPtr task);
+
+    // Number of free tasks kept in the pool.
+    size_t NumFree() const;
+
+    // Stack size that will be allocated for the requested stack_size.
+    static size_t StackSizeForClass(size_t stack_size);
+private:
+    static constexpr size_t kNumClasses = 6; // 8k, 16k, 32k, 64k, 128k, 256k.
+    static_assert((kTaskMinStackSize << (kNumClasses - 1)) == kTaskMaxPooledStackSize,
+                  "Number of classes doesn't match min/max pooled stack sizes.");
+
+    struct Bucket {
+        Task *head_ = nullptr;
+        size_t num_free_ = 0;
+    };
+
+    detail::WaitSlotTable &wait_slots_;
+    Bucket buckets_[kNumClasses];
+    size_t max_cached_per_class_ = 0;
+    int numa_node_ = -1;
+
+    // Returns kNumClasses for stacks that are not pooled.
+    static size_t ClassIndex(size_t stack_size);
+
+    TaskPtr CreateTask(size_t stack_size);
+    void DestroyTask(TaskPtr task);
+};
+
+} // xynq
@@ -1,8 +1,6 @@
 #pragma once
 
-#include "base/platform_def.h"
-
-#include <atomic>
+#include "task_sync.h"
 
 namespace xynq {
 
@@ -11,16 +9,16 @@ class TaskContext;
 // Supports two operations: Wait and Signal.
 // On ctor sets internal counter to the value passed in ctor.
 // Every time Signal is called - decrements counter.
-// Wait blocks until counter is zero.
+// Wait suspends the task until counter is zero.
 class TaskSemaphore {
 public:
     TaskSemaphore(unsigned count);
 
-    void Signal();
+    void Signal(TaskContext &tc);
 
     void Wait(TaskContext &tc);
 private:
-    alignas(k_cache_line_size) std::atomic<unsigned> count_;
+    TaskLatch latch_;
 };
 
-} // xynq
\ No newline at end of file
+} // xynq
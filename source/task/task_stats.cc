@@ -0,0 +1,40 @@
+#include "task_stats.h"
+
+#include <algorithm>
+
+using namespace xynq;
+using namespace xynq::detail;
+
+void TaskStats::Merge(const TaskStats &other) {
+    tasks_created += other.tasks_created;
+    tasks_finished += other.tasks_finished;
+    tasks_executed += other.tasks_executed;
+    tasks_resumed += other.tasks_resumed;
+    yields += other.yields;
+    steals_attempted += other.steals_attempted;
+    steals_succeeded += other.steals_succeeded;
+    event_wakeups += other.event_wakeups;
+    idle_usec += other.idle_usec;
+    spins += other.spins;
+    spin_hits += other.spin_hits;
+    max_queue_depth = std::max(max_queue_depth, other.max_queue_depth);
+    fibers_cached += other.fibers_cached;
+}
+
+TaskStats TaskCounters::Snapshot() const {
+    TaskStats stats;
+    stats.tasks_created = tasks_created.load(std::memory_order_relaxed);
+    stats.tasks_finished = tasks_finished.load(std::memory_order_relaxed);
+    stats.tasks_executed = tasks_executed.load(std::memory_order_relaxed);
+    stats.tasks_resumed = tasks_resumed.load(std::memory_order_relaxed);
+    stats.yields = yields.load(std::memory_order_relaxed);
+    stats.steals_attempted = steals_attempted.load(std::memory_order_relaxed);
+    stats.steals_succeeded = steals_succeeded.load(std::memory_order_relaxed);
+    stats.event_wakeups = event_wakeups.load(std::memory_order_relaxed);
+    stats.idle_usec = idle_usec.load(std::memory_order_relaxed);
+    stats.spins = spins.load(std::memory_order_relaxed);
+    stats.spin_hits = spin_hits.load(std::memory_order_relaxed);
+    stats.max_queue_depth = max_queue_depth.load(std::memory_order_relaxed);
+    stats.fibers_cached = fibers_cached.load(std::memory_order_relaxed);
+    return stats;
+}
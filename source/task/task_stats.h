@@ -0,0 +1,110 @@
+#pragma once
+
+#include "base/platform_def.h"
+#include "base/span.h"
+
+#include <atomic>
+#include <cstdint>
+
+// Scheduler counters are compiled in unless XYNQ_TASK_NO_STATS is defined.
+#if !defined(XYNQ_TASK_NO_STATS)
+    #define XYNQ_TASK_STATS
+#endif
+
+#if defined(XYNQ_TASK_STATS)
+    #define XYTaskStatAdd(counters, name, value) (counters).Add((counters).name, (value))
+    #define XYTaskStatMax(counters, name, value) (counters).Max((counters).name, (value))
+    #define XYTaskStatSet(counters, name, value) (counters).name.store((value), std::memory_order_relaxed)
+#else
+    #define XYTaskStatAdd(counters, name, value) ((void)0)
+    #define XYTaskStatMax(counters, name, value) ((void)0)
+    #define XYTaskStatSet(counters, name, value) ((void)0)
+#endif
+
+namespace xynq {
+
+// Snapshot of scheduler counters. Counters are cumulative since the start
+// unless stated otherwise. All zeroes if stats are compiled out.
+struct TaskStats {
+    uint64_t tasks_created = 0;    // Tasks bound to fibers.
+    uint64_t tasks_finished = 0;
+    uint64_t tasks_executed = 0;   // Tasks started.
+    uint64_t tasks_resumed = 0;    // Resumes of suspended tasks.
+    uint64_t yields = 0;
+    uint64_t steals_attempted = 0; // Steal attempts from queues of other workers.
+    uint64_t steals_succeeded = 0;
+    uint64_t event_wakeups = 0;    // Tasks woken up by events and io completions.
+    uint64_t idle_usec = 0;        // Time spent waiting for events, including spinning.
+    uint64_t spins = 0;            // Spin phases before parking.
+    uint64_t spin_hits = 0;        // Spin phases that found work without parking.
+    uint64_t max_queue_depth = 0;  // High-water mark of tasks queued on a single worker.
+    uint64_t fibers_cached = 0;    // Current number of free fibers in pools.
+
+    // Number of tasks that were created, but have not finished yet.
+    inline uint64_t TasksAlive() const { return tasks_created - tasks_finished; }
+
+    // Adds up counters of another worker. High-water marks are maxed.
+    void Merge(const TaskStats &other);
+
+    // Calls fn(CStrSpan name, uint64_t value) for every counter.
+    template<class Func>
+    inline void Enumerate(Func fn) const;
+};
+
+namespace detail {
+
+// Counters of a single worker. Only the owning worker writes them: updates are plain
+// relaxed load+store without atomic read-modify-write, while any thread can read them.
+struct alignas(k_cache_line_size) TaskCounters {
+    std::atomic<uint64_t> tasks_created{0};
+    std::atomic<uint64_t> tasks_finished{0};
+    std::atomic<uint64_t> tasks_executed{0};
+    std::atomic<uint64_t> tasks_resumed{0};
+    std::atomic<uint64_t> yields{0};
+    std::atomic<uint64_t> steals_attempted{0};
+    std::atomic<uint64_t> steals_succeeded{0};
+    std::atomic<uint64_t> event_wakeups{0};
+    std::atomic<uint64_t> idle_usec{0};
+    std::atomic<uint64_t> spins{0};
+    std::atomic<uint64_t> spin_hits{0};
+    std::atomic<uint64_t> max_queue_depth{0};
+    std::atomic<uint64_t> fibers_cached{0};
+
+    static inline void Add(std::atomic<uint64_t> &counter, uint64_t value) {
+        counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+    }
+
+    static inline void Max(std::atomic<uint64_t> &counter, uint64_t value) {
+        if (value > counter.load(std::memory_order_relaxed)) {
+            counter.store(value, std::memory_order_relaxed);
+        }
+    }
+
+    TaskStats Snapshot() const;
+};
+
+} // detail
+////////////////////////////////////////////////////////////
+
+
+
+// Implementation
+template<class Func>
+void TaskStats::Enumerate(Func fn) const {
+    fn(CStrSpan{"tasks_created"}, tasks_created);
+    fn(CStrSpan{"tasks_finished"}, tasks_finished);
+    fn(CStrSpan{"tasks_alive"}, TasksAlive());
+    fn(CStrSpan{"tasks_executed"}, tasks_executed);
+    fn(CStrSpan{"tasks_resumed"}, tasks_resumed);
+    fn(CStrSpan{"yields"}, yields);
+    fn(CStrSpan{"steals_attempted"}, steals_attempted);
+    fn(CStrSpan{"steals_succeeded"}, steals_succeeded);
+    fn(CStrSpan{"event_wakeups"}, event_wakeups);
+    fn(CStrSpan{"idle_usec"}, idle_usec);
+    fn(CStrSpan{"spins"}, spins);
+    fn(CStrSpan{"spin_hits"}, spin_hits);
+    fn(CStrSpan{"max_queue_depth"}, max_queue_depth);
+    fn(CStrSpan{"fibers_cached"}, fibers_cached);
+}
+
+} // xynq
@@ -0,0 +1,123 @@
+#include "task_sync.h"
+#include "task_context.h"
+
+using namespace xynq;
+using namespace xynq::detail;
+
+void TaskMutex::Lock(TaskContext &tc) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (!locked_) {
+        locked_ = true;
+        return;
+    }
+
+    // Unlock hands the mutex over, so it's owned once the task is resumed.
+    TaskWaiter waiter;
+    waiter.task_ = &tc;
+    waiters_.PushBack(&waiter);
+    tc.SuspendAndUnlock(lock);
+}
+
+bool TaskMutex::TryLock() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (locked_) {
+        return false;
+    }
+
+    locked_ = true;
+    return true;
+}
+
+void TaskMutex::Unlock(TaskContext &tc) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    XYAssert(locked_);
+
+    TaskWaiter *waiter = waiters_.PopFront();
+    if (waiter == nullptr) {
+        locked_ = false;
+        return;
+    }
+
+    TaskPtr task = waiter->task_;
+    lock.unlock();
+    tc.Wake(task);
+}
+
+void TaskCondVar::Wait(TaskContext &tc, TaskMutex &mutex) {
+    // Waiter is added before the mutex is unlocked: notification can't be missed in between.
+    std::unique_lock<std::mutex> lock(mutex_);
+    TaskWaiter waiter;
+    waiter.task_ = &tc;
+    waiters_.PushBack(&waiter);
+
+    mutex.Unlock(tc);
+    tc.SuspendAndUnlock(lock);
+    mutex.Lock(tc);
+}
+
+void TaskCondVar::NotifyOne(TaskContext &tc) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    TaskWaiter *waiter = waiters_.PopFront();
+    if (waiter == nullptr) {
+        return;
+    }
+
+    TaskPtr task = waiter->task_;
+    lock.unlock();
+    tc.Wake(task);
+}
+
+void TaskCondVar::NotifyAll(TaskContext &tc) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    TaskWaitList waiters = waiters_;
+    waiters_ = TaskWaitList{};
+    lock.unlock();
+
+    // Waiter nodes are gone once their task is resumed.
+    while (TaskWaiter *waiter = waiters.PopFront()) {
+        tc.Wake(waiter->task_);
+    }
+}
+
+TaskLatch::TaskLatch(unsigned count)
+    : count_(count) {
+}
+
+void TaskLatch::CountDown(TaskContext &tc, unsigned n) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    XYAssert(count_ >= n);
+    count_ -= n;
+    if (count_ > 0) {
+        return;
+    }
+
+    TaskWaitList waiters = waiters_;
+    waiters_ = TaskWaitList{};
+    lock.unlock();
+
+    while (TaskWaiter *waiter = waiters.PopFront()) {
+        tc.Wake(waiter->task_);
+    }
+}
+
+bool TaskLatch::TryWait() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return count_ == 0;
+}
+
+void TaskLatch::Wait(TaskContext &tc) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (count_ == 0) {
+        return;
+    }
+
+    TaskWaiter waiter;
+    waiter.task_ = &tc;
+    waiters_.PushBack(&waiter);
+    tc.SuspendAndUnlock(lock);
+}
+
+void TaskLatch::ArriveAndWait(TaskContext &tc, unsigned n) {
+    CountDown(tc, n);
+    Wait(tc);
+}
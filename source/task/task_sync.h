@@ -0,0 +1,109 @@
+#pragma once
+
+#include "task.h"
+
+#include "containers/list.h"
+
+#include <mutex>
+
+namespace xynq {
+
+class TaskContext;
+
+namespace detail {
+
+// Task suspended on a synchronization primitive. Lives on the stack of the waiting task.
+struct TaskWaiter {
+    TaskPtr task_ = nullptr;
+    TaskWaiter *next_ = nullptr;
+};
+
+using TaskWaitList = List<TaskWaiter, &TaskWaiter::next_>;
+
+} // detail
+
+// Synchronization primitives below suspend waiting tasks instead of blocking worker threads.
+// Waiters are parked on intrusive lists and are queued on the worker of the task that wakes them up,
+// so all operations that can wake a waiter up take TaskContext of the calling task.
+// Internal locks are only held for a few instructions and never while a task is suspended.
+
+// Mutex that suspends the task while it's locked by another task.
+// Ownership is handed over to waiters in FIFO order.
+// Task can be suspended (ie. wait for events) and resumed on another worker while holding the mutex.
+class TaskMutex {
+public:
+    TaskMutex() = default;
+    TaskMutex(const TaskMutex &) = delete;
+    TaskMutex &operator=(const TaskMutex &) = delete;
+
+    void Lock(TaskContext &tc);
+
+    // Returns false if the mutex is already locked.
+    bool TryLock();
+
+    void Unlock(TaskContext &tc);
+private:
+    std::mutex mutex_;
+    bool locked_ = false;
+    detail::TaskWaitList waiters_;
+};
+
+// Condition variable for TaskMutex.
+class TaskCondVar {
+public:
+    TaskCondVar() = default;
+    TaskCondVar(const TaskCondVar &) = delete;
+    TaskCondVar &operator=(const TaskCondVar &) = delete;
+
+    // Unlocks mutex and suspends task until notified. Mutex is locked again before returning.
+    // Wakeups are not spurious, but condition might have been changed by another task
+    // that got the mutex first.
+    void Wait(TaskContext &tc, TaskMutex &mutex);
+
+    // Waits until pred() returns true. Mutex must be locked.
+    template<class Pred>
+    inline void Wait(TaskContext &tc, TaskMutex &mutex, Pred pred);
+
+    void NotifyOne(TaskContext &tc);
+    void NotifyAll(TaskContext &tc);
+private:
+    std::mutex mutex_;
+    detail::TaskWaitList waiters_;
+};
+
+// Single-use countdown. Tasks waiting on the latch are resumed once counter reaches zero.
+class TaskLatch {
+public:
+    explicit TaskLatch(unsigned count);
+    TaskLatch(const TaskLatch &) = delete;
+    TaskLatch &operator=(const TaskLatch &) = delete;
+
+    // Decrements counter by n.
+    void CountDown(TaskContext &tc, unsigned n = 1);
+
+    // True if counter has reached zero.
+    bool TryWait();
+
+    // Suspends task until counter reaches zero.
+    void Wait(TaskContext &tc);
+
+    // Decrements counter by n and waits for it to reach zero.
+    void ArriveAndWait(TaskContext &tc, unsigned n = 1);
+private:
+    std::mutex mutex_;
+    unsigned count_ = 0;
+    detail::TaskWaitList waiters_;
+};
+////////////////////////////////////////////////////////////
+
+
+
+// Implementation
+template<class Pred>
+void TaskCondVar::Wait(TaskContext &tc, TaskMutex &mutex, Pred pred) {
+    while (!pred()) {
+        Wait(tc, mutex);
+    }
+}
+
+} // xynq
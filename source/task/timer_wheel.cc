@@ -0,0 +1,102 @@
+#include "timer_wheel.h"
+
+#include <algorithm>
+
+using namespace xynq;
+
+TimerWheel::TimerWheel(uint64_t now)
+    : now_(now) {
+    for (size_t level = 0; level < kNumLevels; ++level) {
+        for (Node &slot : slots_[level]) {
+            slot.prev_ = slot.next_ = &slot;
+        }
+    }
+}
+
+TimerWheel::~TimerWheel() {
+    XYAssert(size_ == 0); // Owner must clear all timers.
+}
+
+void TimerWheel::Insert(Node *node, uint64_t deadline) {
+    XYAssert(node != nullptr);
+    XYAssert(!node->IsScheduled());
+
+    node->deadline_ = deadline;
+    Link(node, now_ + 1); // Current tick has already been processed.
+    ++size_;
+}
+
+void TimerWheel::Remove(Node *node) {
+    XYAssert(node != nullptr);
+    if (!node->IsScheduled()) {
+        return;
+    }
+
+    Unlink(node);
+    --size_;
+}
+
+int64_t TimerWheel::TicksUntilNext() const {
+    if (size_ == 0) {
+        return -1;
+    }
+
+    // Level 0 slot expires when the wheel reaches it, higher level slots are cascaded
+    // when the wheel reaches their start.
+    uint64_t ticks = kMaxDelta;
+    for (size_t level = 0; level < kNumLevels; ++level) {
+        unsigned shift = level * kLevelBits;
+        uint64_t position = now_ >> shift;
+        for (uint64_t offset = 1; offset <= kSlotsPerLevel; ++offset) {
+            if (!IsEmpty(slots_[level][(position + offset) & kSlotMask])) {
+                ticks = std::min(ticks, ((position + offset) << shift) - now_);
+                break;
+            }
+        }
+    }
+    return static_cast<int64_t>(ticks);
+}
+
+void TimerWheel::Link(Node *node, uint64_t earliest) {
+    uint64_t deadline = std::max(node->deadline_, earliest);
+    uint64_t delta = deadline - now_;
+
+    // Too far in the future - park in the last level. Will be relinked on cascade.
+    if (delta > kMaxDelta) {
+        delta = kMaxDelta;
+        deadline = now_ + kMaxDelta;
+    }
+
+    size_t level = 0;
+    while (level + 1 < kNumLevels && delta >= (uint64_t(1) << ((level + 1) * kLevelBits))) {
+        ++level;
+    }
+
+    Node &slot = slots_[level][(deadline >> (level * kLevelBits)) & kSlotMask];
+    node->prev_ = slot.prev_;
+    node->next_ = &slot;
+    slot.prev_->next_ = node;
+    slot.prev_ = node;
+}
+
+void TimerWheel::Unlink(Node *node) {
+    node->prev_->next_ = node->next_;
+    node->next_->prev_ = node->prev_;
+    node->prev_ = node->next_ = nullptr;
+}
+
+void TimerWheel::Cascade(size_t level) {
+    uint64_t index = (now_ >> (level * kLevelBits)) & kSlotMask;
+
+    // Higher level wrapped as well - it goes first, its timers might land into this slot.
+    if (index == 0 && level + 1 < kNumLevels) {
+        Cascade(level + 1);
+    }
+
+    Node &slot = slots_[level][index];
+    while (!IsEmpty(slot)) {
+        Node *node = slot.next_;
+        Unlink(node);
+        Link(node, now_); // Current tick is processed right after cascading.
+    }
+}
@@ -0,0 +1,136 @@
+#pragma once
+
+#include "base/assert.h"
+
+#include <cstddef>
+#include <cstdint>
+
+namespace xynq {
+
+// Hierarchical timing wheel. Time is measured in ticks (milliseconds for the task system).
+// kNumLevels wheels of kSlotsPerLevel slots: a slot on level N covers kSlotsPerLevel^N ticks.
+// Timers are kept in the coarsest level that fits and are cascaded into lower levels
+// once the wheel gets closer to their deadline.
+// Insert/Remove are O(1), every timer is cascaded at most kNumLevels times.
+// Timers are intrusive nodes owned by the caller. Not thread-safe.
+class TimerWheel {
+public:
+    // Intrusive timer node. Must stay alive while it's scheduled.
+    class Node {
+        friend class TimerWheel;
+    public:
+        inline Node() = default;
+        Node(const Node &) = delete;
+        Node &operator=(const Node &) = delete;
+
+        // True if node is scheduled in a wheel.
+        inline bool IsScheduled() const { return next_ != nullptr; }
+
+        // Tick the node expires at.
+        inline uint64_t Deadline() const { return deadline_; }
+    private:
+        Node *prev_ = nullptr;
+        Node *next_ = nullptr;
+        uint64_t deadline_ = 0;
+    };
+
+    // now: current tick.
+    explicit TimerWheel(uint64_t now);
+    ~TimerWheel();
+
+    TimerWheel(const TimerWheel &) = delete;
+    TimerWheel &operator=(const TimerWheel &) = delete;
+
+    // Schedules node to expire at deadline tick.
+    // Deadlines in the past expire on the next tick.
+    void Insert(Node *node, uint64_t deadline);
+
+    // Unschedules node. Does nothing if node is not scheduled.
+    void Remove(Node *node);
+
+    // Moves wheel forward to now and calls on_expired(Node *) for every expired node.
+    // Nodes are unscheduled before the call, so on_expired can schedule them again.
+    template<class Func>
+    inline void Advance(uint64_t now, Func on_expired);
+
+    // Unschedules all nodes calling on_removed(Node *) for each.
+    template<class Func>
+    inline void Clear(Func on_removed);
+
+    // Number of ticks until the wheel has to be advanced next time. -1 if there are no timers.
+    // Timers far in the future need to be cascaded first, so this can be earlier than the deadline.
+    int64_t TicksUntilNext() const;
+
+    // Number of scheduled nodes.
+    inline size_t Size() const { return size_; }
+
+    // Current tick.
+    inline uint64_t Now() const { return now_; }
+private:
+    static constexpr unsigned kLevelBits = 8;
+    static constexpr size_t kSlotsPerLevel = size_t(1) << kLevelBits;
+    static constexpr uint64_t kSlotMask = kSlotsPerLevel - 1;
+    static constexpr size_t kNumLevels = 4;
+    static constexpr uint64_t kMaxDelta = (uint64_t(1) << (kLevelBits * kNumLevels)) - 1;
+
+    // Slots are circular lists with the slot node as a sentinel.
+    Node slots_[kNumLevels][kSlotsPerLevel];
+    uint64_t now_ = 0;
+    size_t size_ = 0;
+
+    // Links node into the slot of its deadline, but not earlier than earliest tick.
+    void Link(Node *node, uint64_t earliest);
+    static void Unlink(Node *node);
+    static inline bool IsEmpty(const Node &slot) { return slot.next_ == &slot; }
+
+    // Redistributes timers of the current slot of the level into lower levels.
+    void Cascade(size_t level);
+};
+////////////////////////////////////////////////////////////
+
+
+// Implementation
+template<class Func>
+void TimerWheel::Advance(uint64_t now, Func on_expired) {
+    while (now_ < now) {
+        // Skip ticks where nothing is going to happen.
+        if (IsEmpty(slots_[0][(now_ + 1) & kSlotMask])) {
+            int64_t ticks = TicksUntilNext();
+            if (ticks < 0 || now_ + static_cast<uint64_t>(ticks) > now) {
+                now_ = now;
+                break;
+            }
+            now_ += static_cast<uint64_t>(ticks) - 1;
+        }
+
+        ++now_;
+        if ((now_ & kSlotMask) == 0) {
+            Cascade(1);
+        }
+
+        Node &slot = slots_[0][now_ & kSlotMask];
+        while (!IsEmpty(slot)) {
+            Node *node = slot.next_;
+            Unlink(node);
+            --size_;
+            on_expired(node);
+        }
+    }
+}
+
+template<class Func>
+void TimerWheel::Clear(Func on_removed) {
+    for (size_t level = 0; level < kNumLevels; ++level) {
+        for (Node &slot : slots_[level]) {
+            while (!IsEmpty(slot)) {
+                Node *node = slot.next_;
+                Unlink(node);
+                --size_;
+                on_removed(node);
+            }
+        }
+    }
+    XYAssert(size_ == 0);
+}
+
+} // xynq
@@ -0,0 +1,66 @@
+#include "wait_slot.h"
+
+#include "base/system_allocator.h"
+
+#include <new>
+
+using namespace xynq;
+using namespace xynq::detail;
+
+WaitSlotTable::WaitSlotTable() {
+    chunks_ = (std::atomic<WaitSlot *> *)SystemAllocator::Shared().Alloc(sizeof(std::atomic<WaitSlot *>) * kMaxChunks);
+    XYAssert(chunks_ != nullptr);
+    for (uint32_t i = 0; i < kMaxChunks; ++i) {
+        new (&chunks_[i]) std::atomic<WaitSlot *>(nullptr);
+    }
+}
+
+WaitSlotTable::~WaitSlotTable() {
+    for (uint32_t i = 0; i < kMaxChunks; ++i) {
+        WaitSlot *chunk = chunks_[i].load(std::memory_order_relaxed);
+        if (chunk == nullptr) {
+            break;
+        }
+
+        for (uint32_t slot = 0; slot < kSlotsPerChunk; ++slot) {
+            chunk[slot].~WaitSlot();
+        }
+        SystemAllocator::Shared().Free(chunk);
+    }
+    SystemAllocator::Shared().Free(chunks_);
+}
+
+WaitSlot *WaitSlotTable::Allocate(Task *task) {
+    XYAssert(task != nullptr);
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    uint32_t index = free_head_;
+    if (index != 0) {
+        free_head_ = At(index).next_free_;
+    } else {
+        index = num_slots_++;
+        uint32_t chunk_index = index / kSlotsPerChunk;
+        XYAssert(chunk_index < kMaxChunks);
+        if (chunks_[chunk_index].load(std::memory_order_relaxed) == nullptr) {
+            WaitSlot *chunk = (WaitSlot *)SystemAllocator::Shared().Alloc(sizeof(WaitSlot) * kSlotsPerChunk);
+            XYAssert(chunk != nullptr);
+            for (uint32_t slot = 0; slot < kSlotsPerChunk; ++slot) {
+                new (&chunk[slot]) WaitSlot{};
+                chunk[slot].index_ = chunk_index * kSlotsPerChunk + slot;
+            }
+            chunks_[chunk_index].store(chunk, std::memory_order_release);
+        }
+    }
+
+    WaitSlot &slot = At(index);
+    slot.task_ = task;
+    slot.next_free_ = 0;
+    return &slot;
+}
+
+void WaitSlotTable::Free(WaitSlot *slot) {
+    XYAssert(slot != nullptr && slot->index_ != 0);
+    std::lock_guard<std::mutex> lock(mutex_);
+    slot->next_free_ = free_head_;
+    free_head_ = slot->index_;
+}
@@ -0,0 +1,193 @@
+#pragma once
+
+#include "base/assert.h"
+#include "event/event_def.h"
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+
+namespace xynq {
+
+class Task;
+
+namespace detail {
+
+// Wakeup state of a task. Events and io requests the task waits for are registered with
+// handles of its slot, not with the task itself: slots outlive tasks, so an event that is still
+// in flight once the task is gone (ie. in a batch another worker has polled) never touches freed memory.
+// Suspended task can be woken up by several sources (ie. event and its timeout).
+// Every wait has its own generation: slot is armed with it before the task suspends and only the source
+// that claims the armed generation queues the task. Sources of earlier waits (ie. event that lost to the timeout)
+// can't end the later ones.
+class WaitSlot {
+    friend class WaitSlotTable;
+public:
+    // Generations and incarnations are kept in handles (see WaitSlotTable::Handle), so they wrap around
+    // at kGenerationBits bits. 0 is never used.
+    static constexpr unsigned kGenerationBits = 29;
+    static constexpr uint32_t kGenerationMask = (1u << kGenerationBits) - 1;
+
+    // Task the slot belongs to.
+    inline Task *Owner() const { return task_; }
+
+    // Index of the slot in its table.
+    inline uint32_t Index() const { return index_; }
+
+    // Changes every time the task is released (see Retire). Handles of edge-triggered events carry it.
+    inline uint32_t Incarnation() const { return static_cast<uint32_t>(edge_.load(std::memory_order_relaxed) >> 32); }
+
+    // Called before the task suspends by the worker that runs it. Returns generation of the new wait
+    // to register handles with.
+    inline uint32_t ArmWakeup();
+
+    // Returns true if the wait of generation is armed and the caller is the one to queue the task.
+    inline bool ClaimWakeup(uint32_t generation);
+
+    // Edge-triggered events stay registered while the task runs, so an edge might come
+    // when the task is not waiting for it. Edge is remembered then and the next wait ends right away.
+    // Edges of the previous incarnations are ignored: task that registered them is gone.
+    // Returns true if the task was waiting for an edge and the caller is the one to queue it.
+    inline bool SignalEdge(uint32_t incarnation);
+
+    // Called once the task is suspended and armed with generation waiting for an edge.
+    // Returns true if an edge has already come and the caller is the one to queue the task.
+    inline bool StartEdgeWait(uint32_t generation);
+
+    // Called by the task once it's resumed from the edge wait. Edges that come after this are remembered.
+    inline void FinishEdgeWait();
+
+    // Called once the task is released: nothing registered by it wakes the slot up after that.
+    inline void Retire();
+
+private:
+    static constexpr uint64_t kEdgeReady = 1;
+    static constexpr unsigned kEdgeWaitingShift = 1;
+    static constexpr uint64_t kEdgeIncarnationMask = ~0ull << 32;
+
+    Task *task_ = nullptr;
+    uint32_t index_ = 0;
+    uint32_t next_free_ = 0; // Next free slot in the table. 0 - none.
+    uint32_t generation_ = 0; // Last armed wait. Not reset by Retire: handles of the previous task are still around.
+    std::atomic<uint32_t> armed_{0}; // Armed wait. 0 - none.
+    // Incarnation in the high 32 bits, generation of the edge wait in progress (0 - none)
+    // in the bits above kEdgeReady.
+    std::atomic<uint64_t> edge_{1ull << 32};
+};
+
+// Slots of all tasks of a task manager. Slots are allocated in chunks that are only freed
+// together with the table, freed slots are reused by new tasks.
+class WaitSlotTable {
+public:
+    WaitSlotTable();
+    ~WaitSlotTable();
+
+    WaitSlotTable(const WaitSlotTable &) = delete;
+    WaitSlotTable &operator=(const WaitSlotTable &) = delete;
+
+    // Binds a free slot to task. Thread-safe.
+    WaitSlot *Allocate(Task *task);
+
+    // Returns retired slot into the table. Thread-safe.
+    void Free(WaitSlot *slot);
+
+    // Handle of the wait with generation, or of the edge-triggered events of the incarnation.
+    // Handles are not pointers, but their low bits are clear the same way (see kEventUserHandleTagBit).
+    static inline EventUserHandle Handle(const WaitSlot &slot, uint32_t generation, bool edge);
+
+    // Passes the event with handle on to its slot. Returns the task to queue or nullptr
+    // if the task is not waiting for it. Can be called from any thread.
+    inline Task *Wake(EventUserHandle handle);
+
+private:
+    static constexpr uint32_t kSlotsPerChunk = 4096;
+    static constexpr uint32_t kMaxChunks = 16 * 1024;
+    static constexpr unsigned kHandleIndexShift = 32;
+    static constexpr unsigned kHandleGenerationShift = 3; // Bits below are left to callers and queues.
+
+    std::atomic<WaitSlot *> *chunks_ = nullptr; // kMaxChunks, published once allocated.
+    std::mutex mutex_;
+    uint32_t num_slots_ = 1; // Slot 0 is never used: handle 0 is reserved by queues.
+    uint32_t free_head_ = 0;
+
+    inline WaitSlot &At(uint32_t index);
+};
+////////////////////////////////////////////////////////////
+
+
+// Implementation.
+uint32_t WaitSlot::ArmWakeup() {
+    generation_ = (generation_ + 1) & kGenerationMask;
+    if (generation_ == 0) {
+        generation_ = 1;
+    }
+    armed_.store(generation_, std::memory_order_release);
+    return generation_;
+}
+
+bool WaitSlot::ClaimWakeup(uint32_t generation) {
+    return armed_.compare_exchange_strong(generation, 0, std::memory_order_acq_rel, std::memory_order_relaxed);
+}
+
+bool WaitSlot::SignalEdge(uint32_t incarnation) {
+    uint64_t state = edge_.load(std::memory_order_seq_cst);
+    do {
+        if (static_cast<uint32_t>(state >> 32) != incarnation) {
+            return false;
+        }
+    } while (!edge_.compare_exchange_weak(state, (state & kEdgeIncarnationMask) | kEdgeReady, std::memory_order_seq_cst));
+
+    uint32_t waiting = static_cast<uint32_t>(state) >> kEdgeWaitingShift;
+    return waiting != 0 && ClaimWakeup(waiting);
+}
+
+bool WaitSlot::StartEdgeWait(uint32_t generation) {
+    uint64_t state = edge_.load(std::memory_order_seq_cst);
+    do {
+        if (state & kEdgeReady) {
+            return ClaimWakeup(generation);
+        }
+    } while (!edge_.compare_exchange_weak(state, state | (static_cast<uint64_t>(generation) << kEdgeWaitingShift),
+                                          std::memory_order_seq_cst));
+    return false;
+}
+
+void WaitSlot::FinishEdgeWait() {
+    edge_.fetch_and(kEdgeIncarnationMask, std::memory_order_seq_cst);
+}
+
+void WaitSlot::Retire() {
+    uint32_t incarnation = (Incarnation() + 1) & kGenerationMask;
+    if (incarnation == 0) {
+        incarnation = 1;
+    }
+    armed_.store(0, std::memory_order_relaxed);
+    edge_.store(static_cast<uint64_t>(incarnation) << 32, std::memory_order_seq_cst);
+}
+
+EventUserHandle WaitSlotTable::Handle(const WaitSlot &slot, uint32_t generation, bool edge) {
+    uint64_t handle = (static_cast<uint64_t>(slot.index_) << kHandleIndexShift)
+                    | (static_cast<uint64_t>(generation) << kHandleGenerationShift)
+                    | (edge ? kEventUserHandleTagBit : 0);
+    return reinterpret_cast<EventUserHandle>(handle);
+}
+
+Task *WaitSlotTable::Wake(EventUserHandle handle) {
+    uint64_t value = reinterpret_cast<uint64_t>(handle);
+    WaitSlot &slot = At(static_cast<uint32_t>(value >> kHandleIndexShift));
+    uint32_t generation = static_cast<uint32_t>(value >> kHandleGenerationShift) & WaitSlot::kGenerationMask;
+
+    bool claimed = (value & kEventUserHandleTagBit) != 0 ? slot.SignalEdge(generation) : slot.ClaimWakeup(generation);
+    return claimed ? slot.task_ : nullptr;
+}
+
+WaitSlot &WaitSlotTable::At(uint32_t index) {
+    XYAssert(index != 0 && index / kSlotsPerChunk < kMaxChunks);
+    WaitSlot *chunk = chunks_[index / kSlotsPerChunk].load(std::memory_order_acquire);
+    XYAssert(chunk != nullptr);
+    return chunk[index % kSlotsPerChunk];
+}
+
+} // detail
+
+} // xynq
@@ -0,0 +1,58 @@
+#include "worker_placement.h"
+
+#include "base/assert.h"
+#include "os/utils.h"
+
+using namespace xynq;
+using namespace xynq::detail;
+
+Vec<WorkerPlacement> xynq::detail::PlaceWorkers(size_t num_workers,
+                                                const Vec<platform::NumaNode> &nodes,
+                                                bool pin_threads,
+                                                bool numa_aware) {
+    Vec<WorkerPlacement> placements;
+    placements.resize(num_workers);
+
+    if (numa_aware) {
+        XYAssert(!nodes.empty());
+
+        // (cpu, node index) in node order.
+        Vec<std::pair<unsigned, size_t>> cpus;
+        for (size_t node_index = 0; node_index < nodes.size(); ++node_index) {
+            for (unsigned cpu : nodes[node_index].cpus) {
+                cpus.emplace_back(cpu, node_index);
+            }
+        }
+        XYAssert(!cpus.empty());
+
+        for (size_t i = 0; i < num_workers; ++i) {
+            auto [cpu, node_index] = cpus[i % cpus.size()];
+            WorkerPlacement &placement = placements[i];
+            placement.cpu = pin_threads ? static_cast<int>(cpu) : -1;
+            placement.numa_node = static_cast<int>(nodes[node_index].id);
+            placement.node_cpus.assign(nodes[node_index].cpus.begin(), nodes[node_index].cpus.end());
+        }
+    } else if (pin_threads) {
+        for (size_t i = 0; i < num_workers; ++i) {
+            placements[i].cpu = static_cast<int>(i % platform::NumCores());
+        }
+    }
+
+    // Ring order starting after the worker, workers of the same node go first.
+    for (size_t i = 0; i < num_workers; ++i) {
+        Vec<size_t> &victims = placements[i].victims;
+        victims.reserve(num_workers - 1);
+        for (size_t j = i + 1; j < i + num_workers; ++j) {
+            if (placements[j % num_workers].numa_node == placements[i].numa_node) {
+                victims.push_back(j % num_workers);
+            }
+        }
+        for (size_t j = i + 1; j < i + num_workers; ++j) {
+            if (placements[j % num_workers].numa_node != placements[i].numa_node) {
+                victims.push_back(j % num_workers);
+            }
+        }
+    }
+
+    return placements;
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include "containers/vec.h"
+#include "os/numa.h"
+
+#include <cstddef>
+
+namespace xynq {
+namespace detail {
+
+// Where a worker runs and whom it steals from.
+struct WorkerPlacement {
+    int cpu = -1;        // Cpu the worker is pinned to. -1 - not pinned to a single cpu.
+    int numa_node = -1;  // Node of the worker. -1 - NUMA unaware.
+    Vec<unsigned> node_cpus; // Cpus of the node. Worker is bound to them if not pinned to a cpu.
+    Vec<size_t> victims; // Workers to steal from and to wake up: same node first, then the rest.
+};
+
+// Spreads workers over cpus.
+// NUMA aware: cpus are filled node by node, so workers share nodes as much as possible.
+// Otherwise workers are pinned to cpus by index and all of them form a single group.
+Vec<WorkerPlacement> PlaceWorkers(size_t num_workers,
+                                  const Vec<platform::NumaNode> &nodes,
+                                  bool pin_threads,
+                                  bool numa_aware);
+
+} // detail
+} // xynq
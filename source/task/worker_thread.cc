@@ -1,33 +1,84 @@
 #include "worker_thread.h"
 #include "task_manager.h"
 
+#include "base/system_allocator.h"
+#include "os/numa.h"
+#include "os/stack.h"
 #include "os/utils.h"
 
+#include <algorithm>
+#include <climits>
+
 using namespace xynq;
 using namespace xynq::detail;
 
 DefineTaggedLog(Task)
 
+namespace {
+
+// Max number of free tasks every worker keeps per stack size class.
+static constexpr size_t kMaxCachedTasksPerClass = 256;
+
+// Max number of free task argument blocks every worker keeps per size class.
+static constexpr size_t kMaxCachedArgsPerClass = 64;
+
+// Bulk task is run after this many tasks of higher classes were run in front of it.
+static constexpr unsigned kBulkStarvationLimit = 16;
+
+// Events are polled once per this many checks of the queues while spinning: polling is a syscall.
+static constexpr unsigned kSpinEventPollInterval = 64;
+
+// Weight of the last wait in the moving average of idle time: 1/2^kIdleAverageShift.
+static constexpr unsigned kIdleAverageShift = 3;
+
+// Min-heap order for deadline tasks.
+static bool LaterDeadline(const TaskTuple &lhs, const TaskTuple &rhs) {
+    return lhs.deadline_msec_ > rhs.deadline_msec_;
+}
+
+} // anon namespace
+
+TaskTuple PinnedQueue::Pop() {
+    XYAssert(!IsEmpty());
+    TaskTuple task = tasks_[head_++];
+
+    // Taken tasks are dropped once they make up half of the queue, so every task is moved once on average.
+    if (head_ == tasks_.size()) {
+        tasks_.clear();
+        head_ = 0;
+    } else if (head_ * 2 >= tasks_.size()) {
+        tasks_.erase(tasks_.begin(), tasks_.begin() + head_);
+        head_ = 0;
+    }
+    return task;
+}
 
 WorkerThread::WorkerThread(TaskManager &task_manager,
                            size_t index,
                            Dep<Log> log,
                            Dep<EventQueue> events,
-                           bool pin_thread,
+                           WorkerPlacement &&placement,
                            bool take_current_thread,
                            MutSpan<TaskTuple> entrypoints)
     : running_(true)
     , finished_(false)
+    , parked_(false)
     , task_manager_(task_manager)
     , index_(index)
     , log_(Log{*log, StrBuilder<32>(index).MakeCStr()})
     , events_(events)
-    , pin_thread_(pin_thread)
+    , placement_(std::move(placement))
+    , io_worker_(task_manager.IsIoThread(index))
+    , polls_events_(io_worker_ || task_manager.NumIoThreads() == 0)
     , has_thread_(!take_current_thread)
-    , local_task_queue_(1024) {
+    , num_deadline_tasks_(0)
+    , num_pinned_tasks_(0)
+    , task_pool_(task_manager.wait_slots_, kMaxCachedTasksPerClass, placement_.numa_node)
+    , arg_pool_(kMaxCachedArgsPerClass)
+    , timers_(platform::MonotonicTimeMsec()) {
 
     for (TaskTuple &task : entrypoints) {
-        local_task_queue_.Push(std::move(task));
+        PushLocal(task);
     }
 
     if (entrypoints.Size() > 0) {
@@ -39,6 +90,14 @@ WorkerThread::~WorkerThread() {
     if (has_thread_) {
         this_thread_.join();
     }
+
+    // Wakeup timers belong to tasks that will never be resumed.
+    timers_.Clear([](TimerWheel::Node *node) {
+        TaskTimer *timer = static_cast<TaskTimer *>(node);
+        if (timer->kind_ == TaskTimer::Kind::Periodic) {
+            DestroyObject(SystemAllocator::Shared(), static_cast<PeriodicTimer *>(timer));
+        }
+    });
 }
 
 void WorkerThread::Start() {
@@ -57,29 +116,65 @@ void WorkerThread::DelayedStop() {
 
 void WorkerThread::ThreadProc() {
     id_ = std::this_thread::get_id();
+    TaskArgPool::SetCurrent(&arg_pool_);
+
+    if (!platform::InitThreadSignalStack()) {
+        XYTaskWarning(log_, "Failed to set up signal stack. Stack overflows will not be reported.");
+    }
+
+    if (placement_.cpu >= 0) {
+        XYTaskInfo(log_, "Pinning thread to cpu ", placement_.cpu);
+        if (!platform::PinThread(placement_.cpu)) {
+            XYTaskWarning(log_, "Failed to pin thread: ", index_, " to core ", placement_.cpu);
+        }
+    } else if (!placement_.node_cpus.empty()) {
+        if (!platform::PinThreadToCpus(placement_.node_cpus.data(), placement_.node_cpus.size())) {
+            XYTaskWarning(log_, "Failed to bind thread: ", index_, " to cpus of NUMA node ", placement_.numa_node);
+        }
+    }
 
-    if (pin_thread_) {
-        size_t core_index = index_ % platform::NumCores();
-        XYTaskInfo(log_, "Pinning thread to cpu ", core_index);
-        if (!platform::PinThread(index_)) {
-            XYTaskWarning(log_, "Failed to pin thread: ", index_, " to core ", core_index);
+    // Memory first touched by the worker (ie. vault objects) is placed on its node.
+    if (placement_.numa_node >= 0) {
+        XYTaskInfo(log_, "Running on NUMA node ", placement_.numa_node);
+        if (!platform::SetThreadNumaNode(placement_.numa_node)) {
+            XYTaskWarning(log_, "Failed to set memory policy for NUMA node ", placement_.numa_node);
         }
     }
 
 
     while (running_.load(std::memory_order_relaxed)) {
-        Span<Event> triggered_events = events_->Wait(index_, -1);
+        Span<Event> triggered_events = WaitEvents();
 
         // Process events.
+        bool has_events = false;
         for (const Event &e : triggered_events) {
-            TaskPtr task = static_cast<Task *>(e.UserHandle());
-            if (task == nullptr) {
+            if (e.UserHandle() == nullptr) {
                 // Event does not have any fiber bound to it.
                 // ie. forced wakeup event.
                 continue;
             }
 
+            // Task has already been woken up by its timeout, has finished, is busy or waits for something else.
+            // Edge is remembered for its next wait then.
+            TaskPtr task = task_manager_.wait_slots_.Wake(e.UserHandle());
+            if (task == nullptr) {
+                continue;
+            }
+
              QueueTask(task);
+             has_events = true;
+             XYTaskStatAdd(counters_, event_wakeups, 1);
+        }
+
+        if (ProcessTimers() > 0) {
+            has_events = true;
+        }
+
+        // This worker was polling and is going to be busy with tasks now.
+        // Let parked worker take over polling and steal some of the tasks.
+        // Io worker does not run the tasks itself: wake up workers for all of them.
+        if (has_events) {
+            task_manager_.WakeParkedWorkers(index_, io_worker_ ? NumQueuedTasks() : 1);
         }
 
         // Execute pending tasks.
@@ -100,6 +195,17 @@ void WorkerThread::ThreadProc() {
             } else if (task->State() == TaskState::Suspended) {
                 ResumeTask(task, main_context);
             }
+
+            // Wakeups are batched: once per executed task, at most one per queued task
+            // and parked worker. And none if this worker is going to run the only queued task itself.
+            // Pinned tasks are run first, so all of the queued ones are left for others then.
+            if (exec_.tasks_queued_ > 0) {
+                size_t num_queued = NumQueuedTasks();
+                size_t num_own = io_worker_ || num_pinned_tasks_.load(std::memory_order_relaxed) > 0 ? 0 : 1;
+                if (num_queued > num_own) {
+                    task_manager_.WakeParkedWorkers(index_, std::min<size_t>(exec_.tasks_queued_, num_queued - num_own));
+                }
+            }
         }
     }
 
@@ -107,6 +213,120 @@ void WorkerThread::ThreadProc() {
     task_manager_.StopInternal(); // Will block until all threads finish
 
     task_manager_.hooks.after_thread_stop.Invoke(index_, UserData());
+    TaskArgPool::SetCurrent(nullptr);
+    platform::ShutdownThreadSignalStack();
+}
+
+Span<Event> WorkerThread::WaitEvents() {
+    uint64_t wait_start = platform::MonotonicTimeUsec();
+
+    Span<Event> events;
+    if (!Spin(wait_start, events)) {
+        // Announce parking first and re-check queues after: a producer either sees
+        // this worker parked and wakes it up, or this worker sees the queued task.
+        parked_.store(true, std::memory_order_relaxed);
+        task_manager_.num_parked_.fetch_add(1, std::memory_order_relaxed);
+        int timeout_msec = HasRunnableTasks() ? 0 : TimersTimeout();
+
+        if (polls_events_) {
+            events = events_->Wait(index_, timeout_msec);
+        } else {
+            events_->Park(index_, timeout_msec);
+        }
+        Unpark();
+    }
+
+    uint64_t idle_usec = platform::MonotonicTimeUsec() - wait_start;
+    XYTaskStatAdd(counters_, idle_usec, idle_usec);
+
+    // Long waits are clamped, so a single quiet period does not turn spinning off for long.
+    idle_usec = std::min(idle_usec, 2 * task_manager_.max_spin_usec_);
+    avg_idle_usec_ = avg_idle_usec_ - (avg_idle_usec_ >> kIdleAverageShift) + (idle_usec >> kIdleAverageShift);
+    return events;
+}
+
+bool WorkerThread::Spin(uint64_t start_usec, Span<Event> &events) {
+    uint64_t budget_usec = SpinBudgetUsec();
+    int timers_timeout_msec = TimersTimeout();
+    if (timers_timeout_msec >= 0) {
+        budget_usec = std::min(budget_usec, static_cast<uint64_t>(timers_timeout_msec) * 1000);
+    }
+
+    if (budget_usec == 0) {
+        return false;
+    }
+
+    XYTaskStatAdd(counters_, spins, 1);
+    for (unsigned iteration = 0;; ++iteration) {
+        if (HasRunnableTasks()) {
+            XYTaskStatAdd(counters_, spin_hits, 1);
+            return true;
+        }
+
+        if (iteration % kSpinEventPollInterval == 0) {
+            if (polls_events_) {
+                events = events_->Wait(index_, 0);
+                if (!events.IsEmpty()) {
+                    XYTaskStatAdd(counters_, spin_hits, 1);
+                    return true;
+                }
+            }
+
+            if (!running_.load(std::memory_order_relaxed)) {
+                return true;
+            }
+
+            if (platform::MonotonicTimeUsec() - start_usec >= budget_usec) {
+                return false;
+            }
+        }
+
+        platform::CpuRelax();
+    }
+}
+
+uint64_t WorkerThread::SpinBudgetUsec() const {
+    uint64_t max_spin_usec = task_manager_.max_spin_usec_;
+
+    // Work has not been arriving often enough lately: spinning would only burn cpu.
+    if (max_spin_usec == 0 || avg_idle_usec_ > max_spin_usec) {
+        return 0;
+    }
+
+    // Spin about twice as long as the recent waits, but not for a too short time to catch anything.
+    return std::min(max_spin_usec, std::max(avg_idle_usec_ * 2, max_spin_usec / 4));
+}
+
+bool WorkerThread::HasRunnableTasks() const {
+    // Pairs with the fence in PushPinned.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (num_pinned_tasks_.load(std::memory_order_relaxed) > 0) {
+        return true;
+    }
+
+    return !io_worker_ && task_manager_.HasQueuedTasks();
+}
+
+size_t WorkerThread::EventThreadIndex() const {
+    return polls_events_ ? index_ : index_ % task_manager_.num_io_threads_;
+}
+
+TaskStats WorkerThread::Stats() const {
+#if defined(XYNQ_TASK_STATS)
+    return counters_.Snapshot();
+#else
+    return TaskStats{};
+#endif
+}
+
+bool WorkerThread::Unpark() {
+    bool expected = true;
+    if (!parked_.compare_exchange_strong(expected, false, std::memory_order_acq_rel, std::memory_order_relaxed)) {
+        return false;
+    }
+
+    task_manager_.num_parked_.fetch_sub(1, std::memory_order_relaxed);
+    return true;
 }
 
 void WorkerThread::QueueTask(TaskPtr task) {
@@ -114,46 +334,309 @@ void WorkerThread::QueueTask(TaskPtr task) {
     XYTaskInfo(log_, "Queueing: ", task->debug_name_);
 #endif // XYNQ_TASK_HAS_DEBUGNAME
 
-    TaskTuple t(task);
-    local_task_queue_.Push(std::move(t));
+    PushLocal(TaskTuple{task});
 }
 
 void WorkerThread::QueueTask(TaskTuple &&task) {
 #if defined(XYNQ_TASK_HAS_DEBUGNAME)
     XYTaskInfo(log_, "Queueing: ", task.task_ ? task.task_->debug_name_ : task.debug_name_);
 #endif // XYNQ_TASK_HAS_DEBUGNAME
-    local_task_queue_.Push(std::move(task));
+    PushLocal(task);
 }
 
-bool WorkerThread::DequeNextTask(TaskTuple &task) {
-    if (local_task_queue_.Pop(task)) {
+void WorkerThread::QueueTasks(Span<TaskTuple> tasks) {
 #if defined(XYNQ_TASK_HAS_DEBUGNAME)
-        XYTaskInfo(log_, "Dequeued: ", task.task_ ? task.task_->debug_name_ : task.debug_name_);
+    XYTaskInfo(log_, "Queueing batch of ", tasks.Size(), " tasks");
 #endif // XYNQ_TASK_HAS_DEBUGNAME
+
+    // Consecutive tasks of the same class without deadlines go into their queue at once.
+    auto publish = [this](const TaskTuple *begin, const TaskTuple *end) {
+        if (begin != end) {
+            size_t queue_index = static_cast<size_t>(begin->priority_);
+            local_task_queues_[queue_index].PushBatch(Span<TaskTuple>{begin, static_cast<size_t>(end - begin)});
+        }
+    };
+
+    const TaskTuple *run_begin = tasks.begin();
+    for (const TaskTuple *task = tasks.begin(); task != tasks.end(); ++task) {
+        if (task->deadline_msec_ != 0 || task->pinned_thread_ >= 0) {
+            publish(run_begin, task);
+            PushLocal(*task);
+            run_begin = task + 1;
+        } else if (task->priority_ != run_begin->priority_) {
+            publish(run_begin, task);
+            run_begin = task;
+        }
+    }
+    publish(run_begin, tasks.end());
+    XYTaskStatMax(counters_, max_queue_depth, NumQueuedTasks());
+}
+
+void WorkerThread::PushLocal(const TaskTuple &task) {
+    if (task.pinned_thread_ >= 0) {
+        PushPinned(task);
+        return;
+    }
+
+    if (task.deadline_msec_ == 0) {
+        local_task_queues_[static_cast<size_t>(task.priority_)].Push(task);
+    } else {
+        std::lock_guard<std::mutex> lock(deadline_tasks_mutex_);
+        deadline_tasks_.push_back(task);
+        std::push_heap(deadline_tasks_.begin(), deadline_tasks_.end(), LaterDeadline);
+        num_deadline_tasks_.store(deadline_tasks_.size(), std::memory_order_relaxed);
+    }
+
+    XYTaskStatMax(counters_, max_queue_depth, NumQueuedTasks());
+}
+
+void WorkerThread::PushPinned(const TaskTuple &task) {
+    XYAssert(static_cast<size_t>(task.pinned_thread_) < task_manager_.num_threads_);
+    XYAssert(task.deadline_msec_ == 0); // Pinned tasks are only scheduled by class.
+    WorkerThread &owner = task_manager_.threads_[task.pinned_thread_];
+    {
+        std::lock_guard<std::mutex> lock(owner.pinned_tasks_mutex_);
+        owner.pinned_tasks_[static_cast<size_t>(task.priority_)].Push(task);
+        owner.num_pinned_tasks_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // Pinned task can only be run by its worker.
+    if (&owner != this) {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (owner.Unpark()) {
+            events_->Interrupt(owner.index_);
+        }
+    }
+}
+
+bool WorkerThread::PopPinned(TaskPriority priority, TaskTuple &task) {
+    if (num_pinned_tasks_.load(std::memory_order_relaxed) == 0) {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(pinned_tasks_mutex_);
+    PinnedQueue &queue = pinned_tasks_[static_cast<size_t>(priority)];
+    if (queue.IsEmpty()) {
+        return false;
+    }
+
+    task = queue.Pop();
+    num_pinned_tasks_.fetch_sub(1, std::memory_order_relaxed);
+    return true;
+}
+
+bool WorkerThread::PopPinned(TaskTuple &task) {
+    return PopPinned(TaskPriority::Realtime, task)
+        || PopPinned(TaskPriority::Interactive, task)
+        || PopPinned(TaskPriority::Bulk, task);
+}
+
+bool WorkerThread::PopLocal(TaskTuple &task) {
+    WorkStealingDeque<TaskTuple> &bulk = local_task_queues_[static_cast<size_t>(TaskPriority::Bulk)];
+    bool bulk_waiting = !bulk.IsEmpty();
+    if (!bulk_waiting && num_pinned_tasks_.load(std::memory_order_relaxed) > 0) {
+        std::lock_guard<std::mutex> lock(pinned_tasks_mutex_);
+        bulk_waiting = !pinned_tasks_[static_cast<size_t>(TaskPriority::Bulk)].IsEmpty();
+    }
+
+    // Bulk task has waited long enough - let it run even though there are more important ones.
+    // The oldest one is the one that has waited: newer bulk tasks keep coming to the bottom.
+    if (bulk_waiting && bulk_skipped_ >= kBulkStarvationLimit
+        && (PopPinned(TaskPriority::Bulk, task) || bulk.Steal(task))) {
+        bulk_skipped_ = 0;
         return true;
     }
 
-    for (size_t i = index_; i < index_ + task_manager_.num_threads_; ++i) {
-        WorkerThread &thread = task_manager_.threads_[i % task_manager_.num_threads_];
+    if (PopPinned(TaskPriority::Realtime, task)
+     || local_task_queues_[static_cast<size_t>(TaskPriority::Realtime)].Pop(task)
+     || PopDeadlineTask(task)
+     || PopPinned(TaskPriority::Interactive, task)
+     || local_task_queues_[static_cast<size_t>(TaskPriority::Interactive)].Pop(task)) {
+        if (bulk_waiting) {
+            ++bulk_skipped_;
+        }
+        return true;
+    }
+
+    bulk_skipped_ = 0;
+    return PopPinned(TaskPriority::Bulk, task) || bulk.Pop(task);
+}
+
+bool WorkerThread::PopOwn(TaskTuple &task) {
+    return io_worker_ ? PopPinned(task) : PopLocal(task);
+}
+
+bool WorkerThread::PopDeadlineTask(TaskTuple &task) {
+    if (num_deadline_tasks_.load(std::memory_order_relaxed) == 0) {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(deadline_tasks_mutex_);
+    if (deadline_tasks_.empty()) {
+        return false;
+    }
+
+    std::pop_heap(deadline_tasks_.begin(), deadline_tasks_.end(), LaterDeadline);
+    task = deadline_tasks_.back();
+    deadline_tasks_.pop_back();
+    num_deadline_tasks_.store(deadline_tasks_.size(), std::memory_order_relaxed);
+    return true;
+}
+
+size_t WorkerThread::NumQueuedTasks() const {
+    size_t num_tasks = num_deadline_tasks_.load(std::memory_order_relaxed);
+    for (const WorkStealingDeque<TaskTuple> &queue : local_task_queues_) {
+        num_tasks += queue.Size();
+    }
+    return num_tasks + yielded_tasks_.Size();
+}
+
+bool WorkerThread::DequeNextTask(TaskTuple &task) {
+    // Own tasks first: most recently queued are the hottest in cache.
+    bool found = PopOwn(task);
+
+    // Expired timers are only checked once local queues run dry.
+    if (!found && ProcessTimers() > 0) {
+        found = PopOwn(task);
+    }
+
+    // Nothing else to do locally - give yielded tasks a chance to run, oldest first.
+    // Taken from the top as other workers do, so only a thief can make it fail.
+    while (!found && !yielded_tasks_.IsEmpty()) {
+        found = yielded_tasks_.Steal(task);
+    }
+
+    // Io workers leave the rest of tasks to other workers.
+    if (!found && !io_worker_) {
+        found = StealTask(task);
+    }
 
-        if (thread.local_task_queue_.Pop(task)) {
 #if defined(XYNQ_TASK_HAS_DEBUGNAME)
-            XYTaskInfo(log_, "Dequeued: ", task.task_ ? task.task_->debug_name_ : task.debug_name_);
+    if (found) {
+        XYTaskInfo(log_, "Dequeued: ", task.task_ ? task.task_->debug_name_ : task.debug_name_);
+    }
 #endif // XYNQ_TASK_HAS_DEBUGNAME
-            return true;
+    return found;
+}
+
+bool WorkerThread::StealTask(TaskTuple &task) {
+    // Same order as for local tasks: realtime, deadline, interactive, bulk and yielded ones.
+    // Every class is looked up on all workers before moving to the next one.
+    // Workers of the same NUMA node are tried first.
+    for (size_t step = 0; step <= kNumTaskPriorities + 1; ++step) {
+        for (size_t victim : placement_.victims) {
+            WorkerThread &thread = task_manager_.threads_[victim];
+
+            bool stolen = false;
+            XYTaskStatAdd(counters_, steals_attempted, 1);
+            if (step == 1) {
+                stolen = thread.PopDeadlineTask(task);
+            } else if (step == kNumTaskPriorities + 1) {
+                stolen = thread.yielded_tasks_.Steal(task);
+            } else {
+                size_t queue_index = step == 0 ? 0 : step - 1; // Deadline tasks are taken at step 1.
+                stolen = thread.local_task_queues_[queue_index].Steal(task);
+            }
+
+            if (stolen) {
+                XYTaskStatAdd(counters_, steals_succeeded, 1);
+
+                // Victim still has work - pass the wakeup along.
+                if (thread.NumQueuedTasks() > 0) {
+                    task_manager_.WakeParkedWorker(index_);
+                }
+                return true;
+            }
         }
     }
 
     return false;
 }
 
+void WorkerThread::ScheduleTimer(TaskTimer *timer) {
+    std::lock_guard<std::mutex> lock(timers_mutex_);
+    timer->thread_index_ = index_;
+    timers_.Insert(timer, timer->deadline_msec_);
+}
+
+void WorkerThread::CancelTimer(TaskTimer *timer) {
+    WorkerThread &owner = task_manager_.threads_[timer->thread_index_];
+    std::lock_guard<std::mutex> lock(owner.timers_mutex_);
+    owner.timers_.Remove(timer);
+}
+
+PeriodicTimer *WorkerThread::SchedulePeriodic(TaskTuple &&task, uint64_t interval_msec) {
+    PeriodicTimer *timer = CreateObject<PeriodicTimer>(SystemAllocator::Shared());
+    timer->kind_ = TaskTimer::Kind::Periodic;
+    timer->deadline_msec_ = platform::MonotonicTimeMsec() + interval_msec;
+    timer->task_data_ = std::move(task);
+    timer->interval_msec_ = interval_msec;
+    ScheduleTimer(timer);
+    return timer;
+}
+
+size_t WorkerThread::ProcessTimers() {
+    uint64_t now = platform::MonotonicTimeMsec();
+    size_t num_queued = 0;
+
+    {
+        std::lock_guard<std::mutex> lock(timers_mutex_);
+        timers_.Advance(now, [this, now, &num_queued](TimerWheel::Node *node) {
+            TaskTimer *timer = static_cast<TaskTimer *>(node);
+            if (timer->kind_ == TaskTimer::Kind::Periodic) {
+                PeriodicTimer *periodic = static_cast<PeriodicTimer *>(timer);
+                QueueTask(TaskTuple{periodic->task_data_});
+                ++num_queued;
+
+                // Fixed rate. Ticks missed while the worker was busy are skipped.
+                periodic->deadline_msec_ += periodic->interval_msec_;
+                if (periodic->deadline_msec_ <= now) {
+                    periodic->deadline_msec_ = now + periodic->interval_msec_;
+                }
+                timers_.Insert(periodic, periodic->deadline_msec_);
+            } else if (timer->task_->WakeupSlot().ClaimWakeup(timer->generation_)) {
+                // Timer lives on the task stack: it's only safe to touch until the task is queued.
+                expired_timers_.push_back(timer);
+            }
+        });
+    }
+
+    for (TaskTimer *timer : expired_timers_) {
+        TaskPtr task = timer->task_;
+        timer->expired_ = true;
+        if (timer->event_source_ != nullptr) {
+            events_->RemoveEvent(index_, *timer->event_source_);
+        }
+        QueueTask(task);
+        ++num_queued;
+    }
+    expired_timers_.clear();
+    return num_queued;
+}
+
+int WorkerThread::TimersTimeout() {
+    std::lock_guard<std::mutex> lock(timers_mutex_);
+    int64_t ticks = timers_.TicksUntilNext();
+    if (ticks < 0) {
+        return -1;
+    }
+
+    // Wheel is only advanced in ProcessTimers and can lag behind.
+    uint64_t lag = platform::MonotonicTimeMsec() - timers_.Now();
+    ticks = static_cast<uint64_t>(ticks) > lag ? ticks - static_cast<int64_t>(lag) : 0;
+    return ticks < INT_MAX ? static_cast<int>(ticks) : INT_MAX;
+}
+
 TaskPtr WorkerThread::CreateTask(const detail::TaskTuple &task_data) {
-    // TEMP: should be pooled. For now just create new task every time.
-    TaskPtr task = new Task;
+    TaskPtr task = task_pool_.Acquire(task_data.stack_size_);
     task->Bind(task_data.func_);
+    task->SetSchedule(task_data.priority_, task_data.deadline_msec_);
+    task->SetPinnedThread(task_data.pinned_thread_);
+    XYTaskStatAdd(counters_, tasks_created, 1);
+    XYTaskStatSet(counters_, fibers_cached, task_pool_.NumFree());
 
-#if defined(XYNQ_TASK_HAS_DEBUGNAME)
     task->debug_name_ = task_data.debug_name_;
+#if defined(XYNQ_TASK_HAS_DEBUGNAME)
     XYTaskInfo(log_, "Created: ", task->debug_name_);
 #endif // XYNQ_TASK_HAS_DEBUGNAME
     return task;
@@ -163,8 +646,9 @@ void WorkerThread::DestroyTask(TaskPtr task) {
 #if defined(XYNQ_TASK_HAS_DEBUGNAME)
     XYTaskInfo(log_, "Destroying: ", task->debug_name_);
 #endif // XYNQ_TASK_HAS_DEBUGNAME
-    // TEMP: should be pooled. For now just destroy the task every time.
-    delete task;
+    task_pool_.Release(task);
+    XYTaskStatAdd(counters_, tasks_finished, 1);
+    XYTaskStatSet(counters_, fibers_cached, task_pool_.NumFree());
 }
 
 void WorkerThread::PreTask(TaskPtr task) {
@@ -173,6 +657,7 @@ void WorkerThread::PreTask(TaskPtr task) {
 
     exec_.tasks_queued_ = 0;
     exec_.current_task_ = task;
+    platform::SetCurrentStack(task->StackBuffer(), task->StackSize(), task->debug_name_);
 
 #if defined(XYNQ_TASK_HAS_DEBUGNAME)
         XYTaskInfo(log_, "Will start: ", task->debug_name_);
@@ -199,19 +684,88 @@ void WorkerThread::PostTask(TaskPtr task) {
 #endif // XYNQ_TASK_TRACK_STACK_SIZE
 
     exec_.main_context_ = nullptr;
-    if (exec_.has_pending_event_) {
+    platform::SetCurrentStack(nullptr, 0, nullptr);
+
+    if (exec_.has_pending_event_ || exec_.pending_io_ != nullptr || exec_.pending_multishot_ != nullptr
+        || exec_.pending_timer_ != nullptr) {
         XYAssert(task->State() == TaskState::Suspended);
-        XYAssert(exec_.pending_event_ != nullptr);
-        events_->AddEvent(*exec_.pending_event_, exec_.pending_event_flags_, task);
-        exec_.pending_event_ = nullptr;
-        exec_.has_pending_event_ = false;
+        WaitSlot &slot = task->WakeupSlot();
+        uint32_t generation = slot.ArmWakeup();
+
+        // Timer goes first: event can wake the task up on another worker as soon as it's added.
+        if (exec_.pending_timer_ != nullptr) {
+            exec_.pending_timer_->generation_ = generation;
+            ScheduleTimer(exec_.pending_timer_);
+            exec_.pending_timer_ = nullptr;
+        }
+
+        size_t event_index = EventThreadIndex();
+        bool has_submission = exec_.has_pending_event_ || exec_.pending_io_ != nullptr || exec_.pending_multishot_ != nullptr;
+        if (exec_.has_pending_event_ && (exec_.pending_event_flags_ & EventFlags::EdgeTriggered) != 0) {
+            // Edge-triggered event is only added by the first wait and stays registered.
+            // Its handle stays valid until the task is released.
+            XYAssert(exec_.pending_event_ != nullptr);
+            has_submission = !exec_.pending_event_->IsAdded();
+            if (has_submission) {
+                EventUserHandle handle = WaitSlotTable::Handle(slot, slot.Incarnation(), true);
+                events_->AddEvent(event_index, *exec_.pending_event_, exec_.pending_event_flags_, handle);
+            }
+            if (slot.StartEdgeWait(generation)) {
+                QueueTask(task);
+            }
+            exec_.pending_event_ = nullptr;
+            exec_.has_pending_event_ = false;
+        } else if (exec_.has_pending_event_) {
+            XYAssert(exec_.pending_event_ != nullptr);
+            events_->AddEvent(event_index, *exec_.pending_event_, exec_.pending_event_flags_,
+                              WaitSlotTable::Handle(slot, generation, false));
+            exec_.pending_event_ = nullptr;
+            exec_.has_pending_event_ = false;
+        } else if (exec_.pending_io_ != nullptr) {
+            events_->SubmitIoRequest(event_index, *exec_.pending_io_, WaitSlotTable::Handle(slot, generation, false));
+            exec_.pending_io_ = nullptr;
+        } else if (exec_.pending_multishot_ != nullptr) {
+            // Completions are reported as edges: they can come while the task is busy with earlier ones.
+            // Request that has ended is submitted again once its last completion is taken.
+            EventMultishotRequest *request = exec_.pending_multishot_;
+            has_submission = !request->IsArmed() && !request->HasCompletions();
+            if (has_submission) {
+                events_->SubmitMultishot(event_index, *request, WaitSlotTable::Handle(slot, slot.Incarnation(), true));
+            }
+            if (slot.StartEdgeWait(generation)) {
+                QueueTask(task);
+            }
+            exec_.pending_multishot_ = nullptr;
+        }
+
+        // io_uring submissions are flushed by the owner of the ring once it waits next time.
+        if (has_submission && event_index != index_ && events_->Backend() == EventBackend::IoUring) {
+            events_->Interrupt(event_index);
+        }
 
 #if defined(XYNQ_TASK_HAS_DEBUGNAME)
         XYTaskInfo(log_, "Will suspend: ", task->debug_name_);
 #endif // XYNQ_TASK_HAS_DEBUGNAME
+    } else if (exec_.pending_unlock_ != nullptr) {
+        XYAssert(task->State() == TaskState::Suspended);
+#if defined(XYNQ_TASK_HAS_DEBUGNAME)
+        XYTaskInfo(log_, "Will wait: ", task->debug_name_);
+#endif // XYNQ_TASK_HAS_DEBUGNAME
+
+        // Task can be resumed on another worker as soon as the lock is released.
+        exec_.pending_unlock_->unlock();
+        exec_.pending_unlock_ = nullptr;
     } else if (exec_.yield_) {
-        QueueTask(exec_.current_task_);
+        // Pinned task goes to the back of its queue, the rest can be taken by other workers.
+        TaskTuple yielded{exec_.current_task_};
+        if (yielded.pinned_thread_ >= 0) {
+            PushPinned(yielded);
+        } else {
+            yielded_tasks_.Push(yielded);
+            exec_.tasks_queued_++;
+        }
         exec_.yield_ = false;
+        XYTaskStatAdd(counters_, yields, 1);
 
 #if defined(XYNQ_TASK_HAS_DEBUGNAME)
         XYTaskInfo(log_, "Yielding: ", task->debug_name_);
@@ -225,12 +779,14 @@ void WorkerThread::PostTask(TaskPtr task) {
 
 void WorkerThread::ExecuteTask(TaskPtr task, TaskArgStorage *args, platform::ExecContext &exec_context) {
     PreTask(task);
+    XYTaskStatAdd(counters_, tasks_executed, 1);
     exec_.current_task_->Execute(this, exec_context, args);
     PostTask(task);
 }
 
 void WorkerThread::ResumeTask(TaskPtr task, platform::ExecContext &exec_context) {
     PreTask(task);
+    XYTaskStatAdd(counters_, tasks_resumed, 1);
     exec_.current_task_->Resume(this, exec_context);
     PostTask(task);
 }
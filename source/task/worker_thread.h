@@ -1,28 +1,76 @@
 #pragma once
 
 #include "task.h"
+#include "task_arg_pool.h"
+#include "task_pool.h"
+#include "task_stats.h"
+#include "timer_wheel.h"
+#include "worker_placement.h"
 
 #include "base/dep.h"
 #include "event/eventqueue.h"
-#include "containers/MRSWRing.h"
+#include "containers/vec.h"
+#include "containers/work_stealing_deque.h"
 #include "base/platform_def.h"
 
 #include <atomic>
+#include <mutex>
 #include <thread>
 
 namespace xynq {
 
 class TaskManager;
-class TaskManager;
+
+namespace detail {
+
+// Timer scheduled on the timer wheel of a worker.
+// Wakeup timers live on the stack of the suspended task, periodic timers are owned by the worker.
+struct TaskTimer : public TimerWheel::Node {
+    enum class Kind {
+        Wakeup,   // Resumes suspended task.
+        Periodic, // Queues a new task every interval.
+    };
+
+    Kind kind_ = Kind::Wakeup;
+    uint64_t deadline_msec_ = 0;
+    size_t thread_index_ = 0; // Worker which wheel the timer is scheduled on.
+
+    // Wakeup timers.
+    TaskPtr task_ = nullptr;
+    uint32_t generation_ = 0; // Wait of the task the timer ends (see WaitSlot::ArmWakeup).
+    EventSource *event_source_ = nullptr; // Event to remove if the timer expires first.
+    bool expired_ = false;
+};
+
+struct PeriodicTimer : public TaskTimer {
+    TaskTuple task_data_;
+    uint64_t interval_msec_ = 0;
+};
+
+// Queue of tasks pinned to a worker. Oldest task is taken first.
+class PinnedQueue {
+public:
+    inline bool IsEmpty() const { return head_ == tasks_.size(); }
+    inline void Push(const TaskTuple &task) { tasks_.push_back(task); }
+
+    // Queue must not be empty.
+    TaskTuple Pop();
+private:
+    Vec<TaskTuple> tasks_;
+    size_t head_ = 0; // Tasks in front of it have been taken.
+};
+
+} // detail
 
 class WorkerThread {
     friend class TaskContext;
+    friend class TaskManager;
 public:
     WorkerThread(TaskManager &task_manager,
                  size_t index,
                  Dep<Log> log,
                  Dep<EventQueue> events,
-                 bool pin_thread,
+                 detail::WorkerPlacement &&placement,
                  bool take_current_thread,
                  MutSpan<detail::TaskTuple> entrypoints);
 
@@ -45,6 +93,9 @@ public:
     // User-data.
     ThreadUserDataStorage &UserData() { return user_data_; }
 
+    // Snapshot of worker's counters. Can be called from any thread.
+    TaskStats Stats() const;
+
     //Dep<Log> Log() { return log_; }
 private:
     // Per execution state of a task.
@@ -59,6 +110,18 @@ private:
         unsigned pending_event_flags_ = 0;
         bool has_pending_event_ = false;
 
+        // Io request that current task waits to complete.
+        EventIoRequest *pending_io_ = nullptr;
+
+        // Multishot request that current task waits for completions of.
+        EventMultishotRequest *pending_multishot_ = nullptr;
+
+        // Timer that wakes up current task.
+        detail::TaskTimer *pending_timer_ = nullptr;
+
+        // Lock of the wait list current task has been put on.
+        std::mutex *pending_unlock_ = nullptr;
+
         bool yield_ = false;
 
         unsigned tasks_queued_ = 0;
@@ -67,6 +130,7 @@ private:
     alignas(k_cache_line_size)
     std::atomic<bool> running_;
     std::atomic<bool> finished_; // ThreadProc has finished.
+    std::atomic<bool> parked_;   // Waiting for new tasks or events.
 
     TaskManager &task_manager_;
     size_t index_ = 0;
@@ -78,19 +142,100 @@ private:
      // Each thread has its own logging channel that writes index into log.
     Dependable<Log> log_;
     Dep<EventQueue> events_;
-    bool pin_thread_ = false;
+    detail::WorkerPlacement placement_;
+    // Only polls events and runs tasks pinned to it (see TaskManager::NumIoThreads).
+    bool io_worker_ = false;
+    // False for the rest of workers when there are io workers: they park without polling.
+    bool polls_events_ = true;
     bool has_thread_ = false;
     std::thread this_thread_;
-    MRSWRing<detail::TaskTuple> local_task_queue_;
+    // Queue per scheduling class.
+    // Owner pushes/pops at the bottom, other workers steal from the top.
+    WorkStealingDeque<detail::TaskTuple> local_task_queues_[kNumTaskPriorities];
+    // Tasks with deadlines. Min-heap by deadline, other workers steal under the lock as well.
+    std::mutex deadline_tasks_mutex_;
+    Vec<detail::TaskTuple> deadline_tasks_;
+    std::atomic<size_t> num_deadline_tasks_;
+    // Tasks pinned to this worker (see TaskManager::AddPinnedEntryPoint). Not stolen, other workers
+    // push resumed pinned tasks here. Queue per scheduling class.
+    std::mutex pinned_tasks_mutex_;
+    detail::PinnedQueue pinned_tasks_[kNumTaskPriorities];
+    std::atomic<size_t> num_pinned_tasks_;
+    // Number of tasks taken from other queues while bulk queue was not empty.
+    unsigned bulk_skipped_ = 0;
+    // Moving average of how long the worker has waited for work lately. Drives the spin budget.
+    uint64_t avg_idle_usec_ = 0;
+    // Tasks that yielded, oldest on top. Owner takes them once the rest of its queues is drained,
+    // so the yielding task does not get immediately popped back. Other workers steal them last.
+    WorkStealingDeque<detail::TaskTuple> yielded_tasks_;
+    // Recycled tasks and their stacks.
+    TaskPool task_pool_;
+    // Recycled blocks of task arguments that did not fit into task tuple.
+    detail::TaskArgPool arg_pool_;
+    // Timers are only scheduled by the owner, other workers can cancel them.
+    std::mutex timers_mutex_;
+    TimerWheel timers_;
+    Vec<detail::TaskTimer *> expired_timers_;
     ExecutionState exec_;
+#if defined(XYNQ_TASK_STATS)
+    detail::TaskCounters counters_;
+#endif
 
     void ThreadProc();
 
+    // Spins and then parks the worker until there are new events or it's woken up for new tasks.
+    Span<Event> WaitEvents();
+
+    // Polls queues and events without parking for up to the spin budget.
+    // Returns true if there is work to do. Events are returned in events.
+    bool Spin(uint64_t start_usec, Span<Event> &events);
+
+    // How long to spin before parking. 0 - park right away.
+    uint64_t SpinBudgetUsec() const;
+
+    // True if there are queued tasks this worker can run.
+    bool HasRunnableTasks() const;
+
+    // Worker which events and io requests of tasks run by this worker are registered with.
+    size_t EventThreadIndex() const;
+
+    // Clears parked flag. Returns false if the worker is not parked or was already unparked.
+    bool Unpark();
+
     TaskPtr CreateTask(const detail::TaskTuple &task);
     void DestroyTask(TaskPtr task);
     void QueueTask(TaskPtr task);
     void QueueTask(detail::TaskTuple &&task);
+    // Queues tasks publishing tasks of the same class at once.
+    void QueueTasks(Span<detail::TaskTuple> tasks);
+    // Pushes task into the queue of its scheduling class.
+    void PushLocal(const detail::TaskTuple &task);
+    // Pushes task into the pinned queue of its worker.
+    void PushPinned(const detail::TaskTuple &task);
+    // Pops the oldest task of the class pinned to this worker.
+    bool PopPinned(TaskPriority priority, detail::TaskTuple &task);
+    // Pops next task pinned to this worker: realtime, interactive and then bulk ones.
+    bool PopPinned(detail::TaskTuple &task);
+    // Pops next local task: realtime, deadline, interactive and then bulk ones.
+    // Pinned tasks go first within a class: other workers can't take them.
+    bool PopLocal(detail::TaskTuple &task);
+    // Pops next task from own queues: only pinned ones for io workers.
+    bool PopOwn(detail::TaskTuple &task);
+    // Pops task with the earliest deadline. Can be called from any worker.
+    bool PopDeadlineTask(detail::TaskTuple &task);
+    // Approximate number of queued tasks that can be stolen.
+    size_t NumQueuedTasks() const;
     bool DequeNextTask(detail::TaskTuple &task);
+    bool StealTask(detail::TaskTuple &task);
+
+    void ScheduleTimer(detail::TaskTimer *timer);
+    // Unschedules timer from the wheel of the worker it was scheduled on. Can be called from any worker.
+    void CancelTimer(detail::TaskTimer *timer);
+    detail::PeriodicTimer *SchedulePeriodic(detail::TaskTuple &&task, uint64_t interval_msec);
+    // Queues tasks of expired timers. Returns number of queued tasks.
+    size_t ProcessTimers();
+    // Milliseconds until the next timer has to be processed. -1 if there are no timers.
+    int TimersTimeout();
 
     void PreTask(TaskPtr task);
     void PostTask(TaskPtr task);
@@ -0,0 +1,100 @@
+#include "base/stream.h"
+
+#include "gtest/gtest.h"
+
+#include <string>
+#include <vector>
+
+using namespace xynq;
+
+namespace {
+
+// Records every write separately.
+class RecordingOutStream final : public OutStream {
+public:
+    std::vector<std::string> writes;
+    size_t num_writev_calls = 0;
+    bool support_writev = false;
+
+    StreamWriteResult DoWrite(DataSpan write_buf) final {
+        writes.emplace_back((const char *)write_buf.Data(), write_buf.Size());
+        return StreamWriteSuccess{};
+    }
+
+    StreamWriteResult DoWriteV(Span<DataSpan> write_bufs) final {
+        if (!support_writev) {
+            return OutStream::DoWriteV(write_bufs);
+        }
+
+        ++num_writev_calls;
+        std::string joined;
+        for (DataSpan buf : write_bufs) {
+            joined.append((const char *)buf.Data(), buf.Size());
+        }
+        writes.push_back(joined);
+        return StreamWriteSuccess{};
+    }
+};
+
+} // anon namespace
+
+TEST(Stream, WriteVFallback) {
+    RecordingOutStream stream;
+    DataSpan bufs[] = {{"ab", 2}, {"", size_t(0)}, {"cde", 3}};
+    ASSERT_TRUE(stream.WriteV({bufs, 3}).IsRight());
+
+    ASSERT_EQ(stream.writes.size(), 3u);
+    ASSERT_EQ(stream.writes[0], "ab");
+    ASSERT_EQ(stream.writes[2], "cde");
+}
+
+TEST(Stream, WriterSmallWritesAreBuffered) {
+    RecordingOutStream stream;
+    stream.support_writev = true;
+    char buf[8];
+    {
+        StreamWriter writer{buf, stream};
+        writer.Write(StrSpan{"abc"});
+        writer.Write(StrSpan{"defgh"});
+        writer.Write(StrSpan{"ij"});
+    }
+
+    ASSERT_EQ(stream.num_writev_calls, 0u);
+    ASSERT_EQ(stream.writes.size(), 2u);
+    ASSERT_EQ(stream.writes[0], "abcdefgh");
+    ASSERT_EQ(stream.writes[1], "ij");
+}
+
+TEST(Stream, WriterBigWritesAreNotCopied) {
+    RecordingOutStream stream;
+    stream.support_writev = true;
+    char buf[8];
+    {
+        StreamWriter writer{buf, stream};
+        writer.Write(StrSpan{"abc"});
+        writer.Write(StrSpan{"0123456789"}); // Sent together with buffered data.
+        writer.Write(StrSpan{"0123456789"}); // Nothing buffered.
+        writer.Write(StrSpan{"x"});
+    }
+
+    ASSERT_EQ(stream.num_writev_calls, 2u);
+    ASSERT_EQ(stream.writes.size(), 3u);
+    ASSERT_EQ(stream.writes[0], "abc0123456789");
+    ASSERT_EQ(stream.writes[1], "0123456789");
+    ASSERT_EQ(stream.writes[2], "x");
+}
+
+TEST(Stream, WriterBufferedSize) {
+    RecordingOutStream stream;
+    char buf[8];
+    StreamWriter writer{buf, stream};
+    ASSERT_EQ(writer.BufferedSize(), 0u);
+
+    writer.Write(StrSpan{"abc"});
+    ASSERT_EQ(writer.BufferedSize(), 3u);
+    ASSERT_TRUE(stream.writes.empty());
+
+    writer.Flush();
+    ASSERT_EQ(writer.BufferedSize(), 0u);
+    ASSERT_EQ(stream.writes.size(), 1u);
+}
@@ -0,0 +1,270 @@
+#include "binary/binary_protocol.h"
+
+#include "base/log.h"
+#include "base/system_allocator.h"
+#include "storage/storage.h"
+#include "types/basic_types.h"
+#include "types/type_vault.h"
+
+#include "gtest/gtest.h"
+
+#include <cstring>
+#include <string>
+
+using namespace xynq;
+
+namespace {
+
+// Returns written data chunk by chunk, then closes.
+class TestInStream final : public InStream {
+public:
+    explicit TestInStream(const std::string &data)
+        : data_(data)
+    {}
+
+    Either<StreamError, size_t> DoRead(MutDataSpan read_buf) final {
+        if (offset_ >= data_.size()) {
+            return StreamError::Closed;
+        }
+
+        size_t size = std::min(read_buf.Size(), data_.size() - offset_);
+        memcpy(read_buf.Data(), data_.data() + offset_, size);
+        offset_ += size;
+        return size;
+    }
+
+private:
+    std::string data_;
+    size_t offset_ = 0;
+};
+
+class TestOutStream final : public OutStream {
+public:
+    std::string data;
+
+    StreamWriteResult DoWrite(DataSpan write_buf) final {
+        data.append((const char *)write_buf.Data(), write_buf.Size());
+        return StreamWriteSuccess{};
+    }
+};
+
+#pragma pack(push, 1)
+struct PackedPosition {
+    uint32_t id;
+    double x;
+    double y;
+};
+#pragma pack(pop)
+
+// Layout of the object in storage.
+struct Position {
+    uint32_t id;
+    double x;
+    double y;
+};
+
+struct Named {
+    uint32_t id;
+    StrSpan name;
+};
+
+template<class T>
+void Append(std::string &out, const T &value) {
+    out.append((const char *)&value, sizeof(value));
+}
+
+void AppendRequest(std::string &out, BinaryOpcode opcode, uint64_t request_id, StrSpan type_name, const std::string &fields = {}) {
+    BinaryFrameHeader header;
+    header.payload_size = (uint32_t)(1 + type_name.Size() + fields.size());
+    header.opcode = (uint8_t)opcode;
+    header.request_id = request_id;
+    Append(out, header);
+    Append(out, (uint8_t)type_name.Size());
+    out.append(type_name.Data(), type_name.Size());
+    out.append(fields);
+}
+
+std::string PackPosition(uint32_t id, double x, double y) {
+    std::string out;
+    Append(out, PackedPosition{id, x, y});
+    return out;
+}
+
+// Cuts first response frame from the front of data.
+BinaryFrameHeader TakeResponse(std::string &data, std::string &payload) {
+    BinaryFrameHeader header;
+    EXPECT_GE(data.size(), sizeof(header));
+    memcpy(&header, data.data(), sizeof(header));
+    payload = data.substr(sizeof(header), header.payload_size);
+    data.erase(0, sizeof(header) + header.payload_size);
+    return header;
+}
+
+class BinaryProtocolTest : public ::testing::Test {
+protected:
+    Dependable<Log> log_{std::move(Log::Create(LogLevel::None, 0, {}).Right())};
+    Dependable<TypeManager> type_manager_{log_, SystemAllocator::SharedDep(), std::initializer_list<TypeSchemaPtr>{
+        XYBasicType(double),
+        XYBasicType(uint32_t),
+        XYBasicType(StrSpan),
+    }};
+    Dep<TypeVault> types_ = type_manager_->CreateVault(log_);
+    Dependable<Storage> storage_;
+
+    void SetUp() override {
+        static const char kFieldNames[] = "idxy";
+        TypeSchemaPtr schema = types_->CreateSchema("Position", 3, sizeof(kFieldNames) - 1, [](TypeSchema &schema, char *fields_buf) {
+            memcpy(fields_buf, kFieldNames, sizeof(kFieldNames) - 1);
+            schema.fields[0] = FieldSchema{StrSpan{fields_buf, 2}, XYBasicType(uint32_t)};
+            schema.fields[1] = FieldSchema{StrSpan{fields_buf + 2, 1}, XYBasicType(double)};
+            schema.fields[2] = FieldSchema{StrSpan{fields_buf + 3, 1}, XYBasicType(double)};
+            schema.alignment = alignof(Position);
+            schema.size = sizeof(Position);
+            return true;
+        });
+        ASSERT_NE(schema, k_types_invalid_schema);
+
+        // String fields are not stored inline in the object.
+        static const char kNamedFieldNames[] = "idname";
+        TypeSchemaPtr named_schema = types_->CreateSchema("Named", 2, sizeof(kNamedFieldNames) - 1, [](TypeSchema &schema, char *fields_buf) {
+            memcpy(fields_buf, kNamedFieldNames, sizeof(kNamedFieldNames) - 1);
+            schema.fields[0] = FieldSchema{StrSpan{fields_buf, 2}, XYBasicType(uint32_t)};
+            schema.fields[1] = FieldSchema{StrSpan{fields_buf + 2, 4}, XYBasicType(StrSpan)};
+            schema.alignment = alignof(Named);
+            schema.size = sizeof(Named);
+            return true;
+        });
+        ASSERT_NE(named_schema, k_types_invalid_schema);
+    }
+
+    // Serves all requests, returns all responses.
+    std::string Serve(const std::string &requests, size_t buf_size = 256) {
+        TestInStream in{requests};
+        TestOutStream out;
+        std::string in_buf(buf_size, '\0');
+        char out_buf[64];
+        {
+            StreamReader reader{MutDataSpan{&in_buf[0], in_buf.size()}, in};
+            StreamWriter writer{MutDataSpan{out_buf, sizeof(out_buf)}, out};
+            BinaryRequestHandler handler{storage_, types_};
+            while (handler.Process(reader, writer)) {
+            }
+        }
+        return out.data;
+    }
+};
+
+} // anon namespace
+
+TEST_F(BinaryProtocolTest, CreateAndSelect) {
+    std::string requests;
+    AppendRequest(requests, BinaryOpcode::Create, 1, "Position", PackPosition(7, 1.5, -2.0));
+    AppendRequest(requests, BinaryOpcode::Create, 2, "Position", PackPosition(8, 3.0, 4.25));
+    AppendRequest(requests, BinaryOpcode::Select, 3, "Position");
+
+    std::string responses = Serve(requests);
+    std::string payload;
+
+    BinaryFrameHeader created = TakeResponse(responses, payload);
+    ASSERT_EQ(created.request_id, 1u);
+    ASSERT_EQ(created.opcode, (uint8_t)BinaryOpcode::Create);
+    ASSERT_EQ(created.status, (uint8_t)BinaryStatus::Ok);
+    ASSERT_EQ(payload.size(), sizeof(uint64_t));
+
+    created = TakeResponse(responses, payload);
+    ASSERT_EQ(created.request_id, 2u);
+
+    BinaryFrameHeader selected = TakeResponse(responses, payload);
+    ASSERT_EQ(selected.request_id, 3u);
+    ASSERT_EQ(selected.status, (uint8_t)BinaryStatus::Ok);
+    ASSERT_EQ(payload.size(), sizeof(uint32_t) + 2 * sizeof(Position));
+    ASSERT_TRUE(responses.empty());
+
+    uint32_t num_objects = 0;
+    memcpy(&num_objects, payload.data(), sizeof(num_objects));
+    ASSERT_EQ(num_objects, 2u);
+
+    Position positions[2];
+    memcpy(positions, payload.data() + sizeof(num_objects), sizeof(positions));
+    ASSERT_EQ(positions[0].id, 7u);
+    ASSERT_EQ(positions[0].x, 1.5);
+    ASSERT_EQ(positions[0].y, -2.0);
+    ASSERT_EQ(positions[1].id, 8u);
+    ASSERT_EQ(positions[1].x, 3.0);
+    ASSERT_EQ(positions[1].y, 4.25);
+}
+
+TEST_F(BinaryProtocolTest, Errors) {
+    std::string requests;
+    AppendRequest(requests, BinaryOpcode::Create, 1, "Unknown", PackPosition(1, 0, 0));
+    AppendRequest(requests, BinaryOpcode::Create, 2, "Position", "short");
+    AppendRequest(requests, (BinaryOpcode)100, 3, "Position");
+    AppendRequest(requests, BinaryOpcode::Create, 4, "Position", std::string(1000, 'x')); // Bigger than the buffer.
+    AppendRequest(requests, BinaryOpcode::Create, 5, "Position", PackPosition(1, 0, 0));
+
+    std::string responses = Serve(requests);
+    std::string payload;
+    for (uint64_t request_id = 1; request_id <= 4; ++request_id) {
+        BinaryFrameHeader header = TakeResponse(responses, payload);
+        ASSERT_EQ(header.request_id, request_id);
+        ASSERT_EQ(header.status, (uint8_t)BinaryStatus::Error);
+        ASSERT_FALSE(payload.empty());
+    }
+
+    // Connection is still usable.
+    BinaryFrameHeader header = TakeResponse(responses, payload);
+    ASSERT_EQ(header.request_id, 5u);
+    ASSERT_EQ(header.status, (uint8_t)BinaryStatus::Ok);
+}
+
+TEST_F(BinaryProtocolTest, FramesSplitOverReads) {
+    std::string requests;
+    for (uint32_t i = 0; i < 100; ++i) {
+        AppendRequest(requests, BinaryOpcode::Create, i, "Position", PackPosition(i, i, i));
+    }
+
+    // Frames don't line up with the buffer size.
+    std::string responses = Serve(requests, 50);
+    std::string payload;
+    for (uint64_t request_id = 0; request_id < 100; ++request_id) {
+        BinaryFrameHeader header = TakeResponse(responses, payload);
+        ASSERT_EQ(header.request_id, request_id);
+        ASSERT_EQ(header.status, (uint8_t)BinaryStatus::Ok);
+    }
+}
+
+TEST_F(BinaryProtocolTest, StringFieldsAreRejected) {
+    std::string requests;
+    AppendRequest(requests, BinaryOpcode::Create, 1, "Named", std::string(sizeof(uint32_t) + sizeof(StrSpan), 'x'));
+    AppendRequest(requests, BinaryOpcode::Select, 2, "Named");
+
+    std::string responses = Serve(requests);
+    std::string payload;
+    for (uint64_t request_id = 1; request_id <= 2; ++request_id) {
+        BinaryFrameHeader header = TakeResponse(responses, payload);
+        ASSERT_EQ(header.request_id, request_id);
+        ASSERT_EQ(header.status, (uint8_t)BinaryStatus::Error);
+        ASSERT_EQ(payload, "Unsupported type");
+    }
+    ASSERT_TRUE(responses.empty());
+}
+
+TEST_F(BinaryProtocolTest, FailedCreateLeavesNoObject) {
+    std::string requests;
+    AppendRequest(requests, BinaryOpcode::Create, 1, "Position", "short");
+    AppendRequest(requests, BinaryOpcode::Create, 2, "Position", PackPosition(3, 1.0, 2.0));
+    AppendRequest(requests, BinaryOpcode::Select, 3, "Position");
+
+    std::string responses = Serve(requests);
+    std::string payload;
+    ASSERT_EQ(TakeResponse(responses, payload).status, (uint8_t)BinaryStatus::Error);
+    ASSERT_EQ(TakeResponse(responses, payload).status, (uint8_t)BinaryStatus::Ok);
+
+    BinaryFrameHeader selected = TakeResponse(responses, payload);
+    ASSERT_EQ(selected.status, (uint8_t)BinaryStatus::Ok);
+    ASSERT_EQ(payload.size(), sizeof(uint32_t) + sizeof(Position));
+
+    Position position;
+    memcpy(&position, payload.data() + sizeof(uint32_t), sizeof(position));
+    ASSERT_EQ(position.id, 3u);
+}
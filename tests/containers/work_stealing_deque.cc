@@ -0,0 +1,118 @@
+#include "containers/work_stealing_deque.h"
+#include "gtest/gtest.h"
+
+#include <thread>
+
+using namespace xynq;
+
+TEST(WorkStealingDequeTest, Empty) {
+    WorkStealingDeque<int> q(4);
+    int value = 0;
+    ASSERT_TRUE(q.IsEmpty());
+    ASSERT_FALSE(q.Pop(value));
+    ASSERT_FALSE(q.Steal(value));
+}
+
+TEST(WorkStealingDequeTest, PopIsLifoStealIsFifo) {
+    WorkStealingDeque<int> q(4);
+    for (int i = 1; i <= 3; ++i) {
+        q.Push(i);
+    }
+
+    int value = 0;
+    ASSERT_TRUE(q.Steal(value));
+    ASSERT_EQ(value, 1);
+    ASSERT_TRUE(q.Pop(value));
+    ASSERT_EQ(value, 3);
+    ASSERT_TRUE(q.Pop(value));
+    ASSERT_EQ(value, 2);
+    ASSERT_FALSE(q.Pop(value));
+}
+
+TEST(WorkStealingDequeTest, Grow) {
+    WorkStealingDeque<int> q(2);
+    for (int i = 0; i < 1000; ++i) {
+        q.Push(i);
+    }
+    ASSERT_EQ(q.Size(), 1000u);
+
+    for (int i = 999; i >= 0; --i) {
+        int value = -1;
+        ASSERT_TRUE(q.Pop(value));
+        ASSERT_EQ(value, i);
+    }
+    ASSERT_TRUE(q.IsEmpty());
+}
+
+TEST(WorkStealingDequeTest, PushBatch) {
+    WorkStealingDeque<int> q(4);
+    q.Push(-1);
+
+    int values[100];
+    for (int i = 0; i < 100; ++i) {
+        values[i] = i;
+    }
+    q.PushBatch(Span<int>{values, 100});
+    ASSERT_EQ(q.Size(), 101u);
+
+    int value = 0;
+    ASSERT_TRUE(q.Steal(value));
+    ASSERT_EQ(value, -1);
+    for (int i = 99; i >= 0; --i) {
+        ASSERT_TRUE(q.Pop(value));
+        ASSERT_EQ(value, i);
+    }
+    ASSERT_TRUE(q.IsEmpty());
+}
+
+TEST(WorkStealingDequeTest, MultiThreaded) {
+    static const int num_thieves = 4;
+    static const int num_entries = 100000;
+
+    WorkStealingDeque<int> q(16);
+    std::atomic<int64_t> sum = 0;
+    std::atomic<int> count = 0;
+    std::atomic<bool> done = false;
+
+    std::thread thieves[num_thieves];
+    for (auto &thief : thieves) {
+        thief = std::thread([&] {
+            int value;
+            while (!done) {
+                if (q.Steal(value)) {
+                    sum += value;
+                    ++count;
+                }
+            }
+        });
+    }
+
+    // Owner pushes and pops concurrently with thieves.
+    for (int i = 1; i <= num_entries; ++i) {
+        q.Push(i);
+        int value;
+        if ((i & 3) == 0 && q.Pop(value)) {
+            sum += value;
+            ++count;
+        }
+    }
+
+    int value;
+    while (q.Pop(value)) {
+        sum += value;
+        ++count;
+    }
+
+    int num_tries = 0;
+    while (count != num_entries && num_tries++ < 10000) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    done = true;
+    for (auto &thief : thieves) {
+        thief.join();
+    }
+
+    ASSERT_EQ(count, num_entries);
+    ASSERT_EQ(sum, int64_t(num_entries) * (num_entries + 1) / 2);
+}
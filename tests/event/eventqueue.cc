@@ -0,0 +1,265 @@
+#include "event/eventqueue.h"
+
+#include "base/log.h"
+
+#include "gtest/gtest.h"
+
+#include <netinet/in.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <set>
+#include <string>
+#include <vector>
+
+using namespace xynq;
+
+namespace {
+
+class EventQueueTest : public ::testing::TestWithParam<EventBackend> {
+protected:
+    Dependable<Log> log_{std::move(Log::Create(LogLevel::None, 0, {}).Right())};
+    int socks_[2] = {-1, -1};
+
+    void SetUp() override {
+        ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, socks_), 0);
+    }
+
+    void TearDown() override {
+        close(socks_[0]);
+        close(socks_[1]);
+    }
+
+    // Waits until event with handle arrives.
+    static Maybe<Event> WaitFor(EventQueue &queue, void *handle) {
+        for (int i = 0; i < 10; ++i) {
+            for (const Event &e : queue.Wait(0, 100)) {
+                if (e.UserHandle() == handle) {
+                    return e;
+                }
+            }
+        }
+        return {};
+    }
+};
+
+} // anon namespace
+
+
+TEST_P(EventQueueTest, ReadEvent) {
+    EventQueue queue{log_, GetParam(), 16, 1};
+
+    int handle = 0;
+    EventSource source{socks_[0]};
+    queue.AddEvent(0, source, EventFlags::Read | EventFlags::ExactlyOnce, &handle);
+    ASSERT_EQ(queue.Wait(0, 0).Size(), 0u);
+
+    ASSERT_EQ(write(socks_[1], "x", 1), 1);
+    Maybe<Event> event = WaitFor(queue, &handle);
+    ASSERT_TRUE(event.HasValue());
+    ASSERT_TRUE(event.Value().IsRead());
+}
+
+TEST_P(EventQueueTest, Interrupt) {
+    EventQueue queue{log_, GetParam(), 16, 1};
+
+    queue.Interrupt(0);
+    ASSERT_EQ(queue.Wait(0, -1).Size(), 0u); // Must not block.
+}
+
+TEST_P(EventQueueTest, IoRequests) {
+    EventQueue queue{log_, GetParam(), 16, 1};
+    if (!queue.SupportsIoRequests()) {
+        GTEST_SKIP();
+    }
+
+    char recv_buf[8] = {};
+    int handle = 0;
+    EventIoRequest recv_request;
+    recv_request.op = EventIoRequest::Op::Recv;
+    recv_request.fd = socks_[0];
+    recv_request.buf = recv_buf;
+    recv_request.size = sizeof(recv_buf);
+    queue.SubmitIoRequest(0, recv_request, &handle);
+
+    char send_buf[] = "hello";
+    int send_handle = 0;
+    EventIoRequest send_request;
+    send_request.op = EventIoRequest::Op::Send;
+    send_request.fd = socks_[1];
+    send_request.buf = send_buf;
+    send_request.size = 5;
+    queue.SubmitIoRequest(0, send_request, &send_handle);
+
+    ASSERT_TRUE(WaitFor(queue, &handle).HasValue());
+    ASSERT_EQ(recv_request.result, 5);
+    ASSERT_STREQ(recv_buf, "hello");
+
+    if (send_request.result == 0) { // Could have completed after recv.
+        ASSERT_TRUE(WaitFor(queue, &send_handle).HasValue());
+    }
+    ASSERT_EQ(send_request.result, 5);
+}
+
+TEST_P(EventQueueTest, TaggedHandle) {
+    EventQueue queue{log_, GetParam(), 16, 1};
+
+    // Tag bit is reported back as is. The handle is not taken for anything else (ie. io request).
+    int64_t handle_storage = 0;
+    void *handle = reinterpret_cast<void *>(reinterpret_cast<uintptr_t>(&handle_storage) | kEventUserHandleTagBit);
+    EventSource source{socks_[0]};
+    queue.AddEvent(0, source, EventFlags::Read | EventFlags::ExactlyOnce, handle);
+
+    ASSERT_EQ(write(socks_[1], "x", 1), 1);
+    Maybe<Event> event = WaitFor(queue, handle);
+    ASSERT_TRUE(event.HasValue());
+    ASSERT_TRUE(event.Value().IsRead());
+    ASSERT_EQ(handle_storage, 0);
+}
+
+TEST_P(EventQueueTest, MultishotSurvivesOverflow) {
+    EventQueue queue{log_, GetParam(), 16, 1};
+
+    // More sources than completion queue of io_uring can hold: polls that don't fit are terminated.
+    static constexpr size_t kNumSources = 100;
+    int fds[kNumSources];
+    EventSource sources[kNumSources];
+    int64_t handles[kNumSources] = {};
+    for (size_t i = 0; i < kNumSources; ++i) {
+        fds[i] = eventfd(0, EFD_NONBLOCK);
+        ASSERT_GE(fds[i], 0);
+        sources[i] = EventSource{fds[i]};
+        queue.AddEvent(0, sources[i], EventFlags::Read, &handles[i]);
+    }
+    ASSERT_EQ(queue.Wait(0, 0).Size(), 0u);
+
+    for (int round = 0; round < 2; ++round) {
+        uint64_t value = 1;
+        for (size_t i = 0; i < kNumSources; ++i) {
+            ASSERT_EQ(write(fds[i], &value, sizeof(value)), (ssize_t)sizeof(value));
+        }
+
+        std::set<void *> ready;
+        for (int i = 0; i < 100 && ready.size() < kNumSources; ++i) {
+            for (const Event &e : queue.Wait(0, 10)) {
+                ASSERT_TRUE(e.IsRead());
+                ready.insert(e.UserHandle());
+            }
+        }
+        ASSERT_EQ(ready.size(), kNumSources) << "Round " << round;
+
+        for (size_t i = 0; i < kNumSources; ++i) {
+            ASSERT_EQ(read(fds[i], &value, sizeof(value)), (ssize_t)sizeof(value));
+        }
+    }
+
+    for (size_t i = 0; i < kNumSources; ++i) {
+        queue.RemoveEvent(0, sources[i]);
+        close(fds[i]);
+    }
+    queue.Wait(0, 0);
+}
+
+TEST_P(EventQueueTest, MultishotRecv) {
+    EventQueue queue{log_, GetParam(), 16, 1};
+    if (!queue.SupportsRecvBuffers()) {
+        GTEST_SKIP();
+    }
+
+    int handle = 0;
+    EventMultishotRequest request{EventMultishotRequest::Op::Recv, socks_[0]};
+    queue.SubmitMultishot(0, request, &handle);
+
+    // Buffers are not released: request ends once all of them are taken.
+    std::string received;
+    std::vector<uint32_t> buffers;
+    EventMultishotRequest::Completion completion;
+    while (request.IsArmed()) {
+        ASSERT_EQ(write(socks_[1], "x", 1), 1);
+        ASSERT_TRUE(WaitFor(queue, &handle).HasValue());
+        while (request.Take(completion)) {
+            if (completion.result > 0) {
+                DataSpan data = queue.RecvData(request, completion);
+                received.append((const char *)data.Data(), data.Size());
+                buffers.push_back(completion.buffer);
+            }
+        }
+    }
+    ASSERT_EQ(completion.result, -ENOBUFS);
+    ASSERT_EQ(received.size(), buffers.size());
+    ASSERT_GT(buffers.size(), 0u);
+
+    // Data that didn't fit is still there for the next request.
+    for (uint32_t buffer : buffers) {
+        queue.ReleaseRecvBuffer(request, buffer);
+    }
+    queue.SubmitMultishot(0, request, &handle);
+    ASSERT_TRUE(WaitFor(queue, &handle).HasValue());
+    ASSERT_TRUE(request.Take(completion));
+    ASSERT_EQ(completion.result, 1);
+    ASSERT_EQ(*(const char *)queue.RecvData(request, completion).Data(), 'x');
+    queue.ReleaseRecvBuffer(request, completion.buffer);
+
+    queue.CancelMultishot(0, request);
+    ASSERT_TRUE(WaitFor(queue, &handle).HasValue());
+    ASSERT_TRUE(request.Take(completion));
+    ASSERT_EQ(completion.result, -ECANCELED);
+    ASSERT_FALSE(request.IsArmed());
+}
+
+TEST_P(EventQueueTest, MultishotAccept) {
+    EventQueue queue{log_, GetParam(), 16, 1};
+    if (!queue.SupportsIoRequests()) {
+        GTEST_SKIP();
+    }
+
+    int listen_sock = socket(AF_INET, SOCK_STREAM, 0);
+    ASSERT_GE(listen_sock, 0);
+    sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t addr_len = sizeof(addr);
+    ASSERT_EQ(bind(listen_sock, (sockaddr *)&addr, sizeof(addr)), 0);
+    ASSERT_EQ(getsockname(listen_sock, (sockaddr *)&addr, &addr_len), 0);
+    ASSERT_EQ(listen(listen_sock, 16), 0);
+
+    int handle = 0;
+    EventMultishotRequest request{EventMultishotRequest::Op::Accept, listen_sock};
+    queue.SubmitMultishot(0, request, &handle);
+
+    // Single submission accepts every connection.
+    static constexpr size_t kNumClients = 3;
+    int clients[kNumClients];
+    size_t num_accepted = 0;
+    EventMultishotRequest::Completion completion;
+    for (size_t i = 0; i < kNumClients; ++i) {
+        clients[i] = socket(AF_INET, SOCK_STREAM, 0);
+        ASSERT_EQ(connect(clients[i], (sockaddr *)&addr, sizeof(addr)), 0);
+        while (num_accepted <= i) {
+            ASSERT_TRUE(WaitFor(queue, &handle).HasValue());
+            while (request.Take(completion)) {
+                ASSERT_GE(completion.result, 0);
+                close(completion.result);
+                ++num_accepted;
+            }
+        }
+        ASSERT_TRUE(request.IsArmed());
+    }
+    ASSERT_EQ(num_accepted, kNumClients);
+
+    queue.CancelMultishot(0, request);
+    while (request.IsArmed()) {
+        WaitFor(queue, &handle);
+    }
+    for (int client : clients) {
+        close(client);
+    }
+    close(listen_sock);
+}
+
+INSTANTIATE_TEST_SUITE_P(Backends, EventQueueTest,
+                         ::testing::Values(EventBackend::Epoll, EventBackend::IoUring));
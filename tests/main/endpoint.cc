@@ -0,0 +1,162 @@
+#include "main/endpoint.h"
+#include "main/shared_deps.h"
+
+#include "base/log.h"
+#include "base/system_allocator.h"
+#include "binary/binary_protocol.h"
+#include "storage/storage.h"
+#include "task/task_manager.h"
+#include "types/basic_types.h"
+#include "types/type_vault.h"
+
+#include "gtest/gtest.h"
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+using namespace xynq;
+
+namespace {
+
+// Size of the response to a single create request.
+static constexpr size_t kCreateResponseSize = sizeof(BinaryFrameHeader) + sizeof(uint64_t);
+
+// Returns scripted chunks one per read, then closes.
+// Every read and write is logged in order, writes are logged with the number of responses in them.
+class ScriptedStream final : public InOutStream {
+public:
+    explicit ScriptedStream(std::vector<std::string> reads)
+        : reads_(std::move(reads))
+    {}
+
+    std::vector<std::string> log;
+
+protected:
+    Either<StreamError, size_t> DoRead(MutDataSpan read_buf) final {
+        log.push_back("read");
+        if (next_read_ >= reads_.size()) {
+            return StreamError::Closed;
+        }
+
+        const std::string &data = reads_[next_read_++];
+        EXPECT_LE(data.size(), read_buf.Size());
+        memcpy(read_buf.Data(), data.data(), data.size());
+        return data.size();
+    }
+
+    StreamWriteResult DoWrite(DataSpan write_buf) final {
+        return DoWriteV({&write_buf, 1});
+    }
+
+    // Logged as a single write, same as a single writev syscall.
+    StreamWriteResult DoWriteV(Span<DataSpan> write_bufs) final {
+        size_t size = 0;
+        for (const DataSpan &buf : write_bufs) {
+            size += buf.Size();
+        }
+        EXPECT_EQ(size % kCreateResponseSize, 0u);
+        log.push_back("write " + std::to_string(size / kCreateResponseSize));
+        return StreamWriteSuccess{};
+    }
+
+private:
+    std::vector<std::string> reads_;
+    size_t next_read_ = 0;
+};
+
+template<class T>
+void Append(std::string &out, const T &value) {
+    out.append((const char *)&value, sizeof(value));
+}
+
+// Binary create requests for the Id type.
+std::string CreateRequests(uint64_t first_request_id, size_t num_requests) {
+    std::string out;
+    for (uint64_t request_id = first_request_id; request_id < first_request_id + num_requests; ++request_id) {
+        BinaryFrameHeader header;
+        header.payload_size = (uint32_t)(1 + 2 + sizeof(uint32_t));
+        header.opcode = (uint8_t)BinaryOpcode::Create;
+        header.request_id = request_id;
+        Append(out, header);
+        Append(out, (uint8_t)2);
+        out.append("Id");
+        Append(out, (uint32_t)request_id);
+    }
+    return out;
+}
+
+struct ServeEndpoint : public TaskDefaults {
+    static constexpr unsigned stack_size = 16 * 1024; // Same as connection handlers.
+    static constexpr auto exec = [](TaskContext *tc, ScriptedStream *stream) {
+        Endpoint endpoint{"test", stream};
+        endpoint.Serve(tc);
+        tc->Exit();
+    };
+};
+
+class EndpointTest : public ::testing::Test {
+protected:
+    Dependable<Log> log_{std::move(Log::Create(LogLevel::None, 0, {}).Right())};
+    Dependable<TypeManager> type_manager_{log_, SystemAllocator::SharedDep(), std::initializer_list<TypeSchemaPtr>{
+        XYBasicType(uint32_t),
+    }};
+    Dep<TypeVault> types_ = type_manager_->CreateVault(log_);
+    Dependable<Storage> storage_;
+
+    void SetUp() override {
+        static const char kFieldNames[] = "id";
+        TypeSchemaPtr schema = types_->CreateSchema("Id", 1, sizeof(kFieldNames) - 1, [](TypeSchema &schema, char *fields_buf) {
+            memcpy(fields_buf, kFieldNames, sizeof(kFieldNames) - 1);
+            schema.fields[0] = FieldSchema{StrSpan{fields_buf, 2}, XYBasicType(uint32_t)};
+            schema.alignment = alignof(uint32_t);
+            schema.size = sizeof(uint32_t);
+            return true;
+        });
+        ASSERT_NE(schema, k_types_invalid_schema);
+    }
+
+    // Serves binary protocol connection with scripted reads, returns the log of the stream.
+    std::vector<std::string> Serve(std::vector<std::string> reads, bool coalesce_responses) {
+        reads[0].insert(reads[0].begin(), (char)kBinaryProtocolMagic);
+
+        // Responses are never flushed because of the delay: machine running the test might be slow.
+        EndpointParameters params;
+        params.coalesce_responses = coalesce_responses;
+        params.coalesce_max_delay_usec = 60ull * 1000 * 1000;
+
+        Dependable<TaskManager> task_manager{log_, 10, 1, false, true};
+        task_manager->hooks.before_thread_start.Add([&](size_t, Dep<Log> log, ThreadUserDataStorage &store) {
+            new (&store) SharedDeps{nullptr, storage_, type_manager_->CreateVault(log), task_manager, params};
+        });
+        task_manager->hooks.after_thread_stop.Add([](size_t, ThreadUserDataStorage &store) {
+            ((SharedDeps *)&store)->~SharedDeps();
+        });
+
+        ScriptedStream stream{std::move(reads)};
+        task_manager->AddEntryPoint<ServeEndpoint>(&stream);
+        task_manager->Run();
+        return stream.log;
+    }
+};
+
+} // anon namespace
+
+TEST_F(EndpointTest, PipelinedResponsesCoalesced) {
+    std::vector<std::string> log = Serve({CreateRequests(1, 3)}, true);
+    std::vector<std::string> expected = {"read", "write 3", "read"};
+    ASSERT_EQ(log, expected);
+}
+
+TEST_F(EndpointTest, FlushBeforeBlockingRead) {
+    // Peer waits for the first responses before sending more requests.
+    std::vector<std::string> log = Serve({CreateRequests(1, 2), CreateRequests(3, 1)}, true);
+    std::vector<std::string> expected = {"read", "write 2", "read", "write 1", "read"};
+    ASSERT_EQ(log, expected);
+}
+
+TEST_F(EndpointTest, NoCoalescing) {
+    std::vector<std::string> log = Serve({CreateRequests(1, 3)}, false);
+    std::vector<std::string> expected = {"read", "write 1", "write 1", "write 1", "read"};
+    ASSERT_EQ(log, expected);
+}
@@ -0,0 +1,72 @@
+#include "net/shm_stream.h"
+
+#include "gtest/gtest.h"
+
+#include <cstring>
+
+using namespace xynq;
+
+namespace {
+
+static constexpr size_t kCapacity = 16;
+
+class ShmRingTest : public ::testing::Test {
+protected:
+    ShmRingHeader header_;
+    uint8_t data_[kCapacity];
+    ShmRing ring_{&header_, data_, kCapacity};
+
+    size_t Write(const char *str) {
+        auto written = ring_.Write(DataSpan{str, strlen(str)});
+        EXPECT_TRUE(written.HasValue());
+        return written.GetOrDefault(0);
+    }
+
+    std::string Read(size_t size) {
+        std::string out(size, '\0');
+        auto read = ring_.Read(MutDataSpan{&out[0], out.size()});
+        EXPECT_TRUE(read.HasValue());
+        out.resize(read.GetOrDefault(0));
+        return out;
+    }
+};
+
+} // anon namespace
+
+TEST_F(ShmRingTest, WrapAround) {
+    ASSERT_EQ(Write("0123456789"), 10u);
+    ASSERT_EQ(Read(6), "012345");
+
+    // Doesn't fit: only free space is taken. Data wraps around the end of the ring.
+    ASSERT_EQ(Write("abcdefghijklmnop"), 12u);
+    ASSERT_EQ(Write("x"), 0u);
+    ASSERT_EQ(Read(100), "6789abcdefghijkl");
+    ASSERT_EQ(Read(100), "");
+}
+
+TEST_F(ShmRingTest, WaitingFlags) {
+    // Empty ring: reader sleeps and is woken up by the next write.
+    ASSERT_TRUE(ring_.PrepareWaitRead());
+    ASSERT_EQ(Write("abc"), 3u);
+    ASSERT_TRUE(ring_.TakeReaderWaiting());
+    ASSERT_FALSE(ring_.TakeReaderWaiting());
+
+    // Data came in: no need to sleep.
+    ASSERT_FALSE(ring_.PrepareWaitRead());
+
+    // Full ring: writer sleeps and is woken up by the next read.
+    ASSERT_EQ(Write("0123456789abcdef"), 13u);
+    ASSERT_TRUE(ring_.PrepareWaitWrite());
+    ASSERT_EQ(Read(1), "a");
+    ASSERT_TRUE(ring_.TakeWriterWaiting());
+    ASSERT_FALSE(ring_.TakeWriterWaiting());
+    ASSERT_FALSE(ring_.PrepareWaitWrite());
+}
+
+TEST_F(ShmRingTest, CorruptedCounters) {
+    // Peer claims there is more data than the ring can hold.
+    header_.head.store(kCapacity + 1);
+    char buf[4];
+    ASSERT_FALSE(ring_.Read(MutDataSpan{buf, sizeof(buf)}).HasValue());
+    ASSERT_FALSE(ring_.Write(DataSpan{buf, sizeof(buf)}).HasValue());
+}
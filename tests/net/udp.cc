@@ -0,0 +1,212 @@
+#include "net/udp.h"
+#include "net/udp_peer_table.h"
+
+#include "base/defer.h"
+#include "base/log.h"
+#include "base/system_allocator.h"
+#include "binary/binary_protocol.h"
+#include "main/shared_deps.h"
+#include "storage/storage.h"
+#include "types/basic_types.h"
+#include "types/type_vault.h"
+
+#include "gtest/gtest.h"
+
+#include <cstring>
+#include <string>
+#include <thread>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+using namespace xynq;
+
+namespace {
+
+static constexpr uint64_t kPeerTimeoutMsec = 1000;
+
+UdpPeer MakePeer(uint32_t ip, uint16_t port) {
+    UdpPeer peer;
+    peer.ip[0] = ip;
+    peer.port = port;
+    peer.family = AF_INET;
+    return peer;
+}
+
+// Finds udp port nobody listens on.
+int FreeUdpPort() {
+    int sock = socket(AF_INET, SOCK_DGRAM, 0);
+    sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t addr_len = sizeof(addr);
+    EXPECT_EQ(bind(sock, (sockaddr *)&addr, sizeof(addr)), 0);
+    EXPECT_EQ(getsockname(sock, (sockaddr *)&addr, &addr_len), 0);
+    close(sock);
+    return ntohs(addr.sin_port);
+}
+
+template<class T>
+void Append(std::string &out, const T &value) {
+    out.append((const char *)&value, sizeof(value));
+}
+
+} // anon namespace
+
+TEST(UdpPeerTable, StaleAndDuplicate) {
+    UdpPeerTable peers{kPeerTimeoutMsec};
+    UdpPeer peer = MakePeer(1, 100);
+
+    ASSERT_TRUE(peers.Accept(peer, 10, 0));
+    ASSERT_FALSE(peers.Accept(peer, 10, 1)); // Duplicate.
+    ASSERT_FALSE(peers.Accept(peer, 9, 2));  // Reordered.
+    ASSERT_TRUE(peers.Accept(peer, 11, 3));
+    ASSERT_TRUE(peers.Accept(peer, 20, 4));  // Gaps are fine.
+    ASSERT_FALSE(peers.Accept(peer, 15, 5));
+
+    // Peers are told apart by address and port.
+    ASSERT_TRUE(peers.Accept(MakePeer(1, 101), 1, 6));
+    ASSERT_TRUE(peers.Accept(MakePeer(2, 100), 1, 7));
+    ASSERT_EQ(peers.NumPeers(), 3u);
+}
+
+TEST(UdpPeerTable, SequenceWrapAround) {
+    UdpPeerTable peers{kPeerTimeoutMsec};
+    UdpPeer peer = MakePeer(1, 100);
+
+    ASSERT_TRUE(peers.Accept(peer, UINT64_MAX - 1, 0));
+    ASSERT_TRUE(peers.Accept(peer, UINT64_MAX, 1));
+    ASSERT_TRUE(peers.Accept(peer, 0, 2));
+    ASSERT_TRUE(peers.Accept(peer, 1, 3));
+    ASSERT_FALSE(peers.Accept(peer, UINT64_MAX, 4));
+    ASSERT_FALSE(peers.Accept(peer, 0, 5));
+}
+
+TEST(UdpPeerTable, TimeoutResetsSequence) {
+    UdpPeerTable peers{kPeerTimeoutMsec};
+    UdpPeer peer = MakePeer(1, 100);
+
+    ASSERT_TRUE(peers.Accept(peer, 1000, 0));
+    ASSERT_FALSE(peers.Accept(peer, 1, kPeerTimeoutMsec - 1));
+
+    // Stale datagrams don't count as activity: peer restarted and starts over.
+    ASSERT_TRUE(peers.Accept(peer, 1, kPeerTimeoutMsec));
+    ASSERT_FALSE(peers.Accept(peer, 1, kPeerTimeoutMsec + 1));
+    ASSERT_TRUE(peers.Accept(peer, 2, kPeerTimeoutMsec + 2));
+}
+
+TEST(UdpPeerTable, Eviction) {
+    UdpPeerTable peers{kPeerTimeoutMsec};
+    for (uint32_t i = 0; i < kMaxTrackedPeers / 2; ++i) {
+        ASSERT_TRUE(peers.Accept(MakePeer(i, 1), 100, 0));
+    }
+    for (uint32_t i = kMaxTrackedPeers / 2; i < kMaxTrackedPeers; ++i) {
+        ASSERT_TRUE(peers.Accept(MakePeer(i, 1), 100, kPeerTimeoutMsec / 2));
+    }
+    ASSERT_EQ(peers.NumPeers(), kMaxTrackedPeers);
+
+    // Only peers that timed out are forgotten.
+    ASSERT_TRUE(peers.Accept(MakePeer(kMaxTrackedPeers, 1), 100, kPeerTimeoutMsec));
+    ASSERT_EQ(peers.NumPeers(), kMaxTrackedPeers / 2 + 1);
+    ASSERT_FALSE(peers.Accept(MakePeer(kMaxTrackedPeers - 1, 1), 100, kPeerTimeoutMsec));
+    ASSERT_TRUE(peers.Accept(MakePeer(0, 1), 1, kPeerTimeoutMsec));
+
+    // Every peer is active: table starts over.
+    for (uint32_t i = kMaxTrackedPeers + 1; peers.NumPeers() < kMaxTrackedPeers; ++i) {
+        ASSERT_TRUE(peers.Accept(MakePeer(i, 1), 100, kPeerTimeoutMsec));
+    }
+    ASSERT_TRUE(peers.Accept(MakePeer(UINT32_MAX, 1), 100, kPeerTimeoutMsec));
+    ASSERT_EQ(peers.NumPeers(), 1u);
+    ASSERT_TRUE(peers.Accept(MakePeer(kMaxTrackedPeers - 1, 1), 1, kPeerTimeoutMsec));
+}
+
+TEST(Udp, EndpointDatagramRoundTrip) {
+    Dependable<Log> log{std::move(Log::Create(LogLevel::None, 0, {}).Right())};
+    Dependable<TypeManager> type_manager{log, SystemAllocator::SharedDep(), std::initializer_list<TypeSchemaPtr>{
+        XYBasicType(uint32_t),
+    }};
+    Dependable<Storage> storage;
+    Dependable<TaskManager> task_manager{log, 10, 2, false, true};
+
+    // Types are shared by all vaults.
+    static const char kFieldNames[] = "id";
+    Dep<TypeVault> types = type_manager->CreateVault(log);
+    TypeSchemaPtr schema = types->CreateSchema("Id", 1, sizeof(kFieldNames) - 1, [](TypeSchema &schema, char *fields_buf) {
+        memcpy(fields_buf, kFieldNames, sizeof(kFieldNames) - 1);
+        schema.fields[0] = FieldSchema{StrSpan{fields_buf, 2}, XYBasicType(uint32_t)};
+        schema.alignment = alignof(uint32_t);
+        schema.size = sizeof(uint32_t);
+        return true;
+    });
+    ASSERT_NE(schema, k_types_invalid_schema);
+
+    task_manager->hooks.before_thread_start.Add([&](size_t, Dep<Log> log, ThreadUserDataStorage &store) {
+        new (&store) SharedDeps{nullptr, storage, type_manager->CreateVault(log), task_manager, {}};
+    });
+    task_manager->hooks.after_thread_stop.Add([](size_t, ThreadUserDataStorage &store) {
+        ((SharedDeps *)&store)->~SharedDeps();
+    });
+
+    int port = FreeUdpPort();
+    std::string bind_str = "127.0.0.1:" + std::to_string(port);
+    CStrSpan bind_addr{bind_str.c_str()};
+    auto udp = UdpManager::Create(log, task_manager, UdpParameters{}, Span<CStrSpan>{&bind_addr, 1}, ServeEndpointDatagram);
+    ASSERT_TRUE(udp.HasValue());
+
+    int client = socket(AF_INET, SOCK_DGRAM, 0);
+    ASSERT_GE(client, 0);
+    Defer close_client([&] {
+        close(client);
+    });
+    timeval recv_timeout{0, 100 * 1000};
+    ASSERT_EQ(setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &recv_timeout, sizeof(recv_timeout)), 0);
+
+    sockaddr_in server_addr;
+    memset(&server_addr, 0, sizeof(server_addr));
+    server_addr.sin_family = AF_INET;
+    server_addr.sin_port = htons(port);
+    server_addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    // Single datagram with two pipelined creates, sent again until the server is up.
+    std::string reply;
+    std::thread client_thread([&] {
+        for (UdpSequence sequence = 1; sequence <= 100 && reply.empty(); ++sequence) {
+            std::string datagram;
+            Append(datagram, sequence);
+            for (uint64_t request_id = 1; request_id <= 2; ++request_id) {
+                BinaryFrameHeader header;
+                header.payload_size = (uint32_t)(1 + 2 + sizeof(uint32_t));
+                header.opcode = (uint8_t)BinaryOpcode::Create;
+                header.request_id = request_id;
+                Append(datagram, header);
+                Append(datagram, (uint8_t)2);
+                datagram.append("Id");
+                Append(datagram, (uint32_t)request_id);
+            }
+            sendto(client, datagram.data(), datagram.size(), 0, (sockaddr *)&server_addr, sizeof(server_addr));
+
+            char buf[1500];
+            ssize_t size = recv(client, buf, sizeof(buf), 0);
+            if (size > 0) {
+                reply.assign(buf, size);
+                EXPECT_EQ(memcmp(buf, &sequence, sizeof(sequence)), 0); // Reply starts with the datagram sequence.
+            }
+        }
+        task_manager->Stop();
+    });
+    task_manager->Run();
+    client_thread.join();
+
+    ASSERT_EQ(reply.size(), sizeof(UdpSequence) + 2 * (sizeof(BinaryFrameHeader) + sizeof(uint64_t)));
+    for (uint64_t request_id = 1; request_id <= 2; ++request_id) {
+        BinaryFrameHeader header;
+        memcpy(&header, reply.data() + sizeof(UdpSequence) + (request_id - 1) * (sizeof(header) + sizeof(uint64_t)), sizeof(header));
+        ASSERT_EQ(header.request_id, request_id);
+        ASSERT_EQ(header.opcode, (uint8_t)BinaryOpcode::Create);
+        ASSERT_EQ(header.status, (uint8_t)BinaryStatus::Ok);
+    }
+}
@@ -1,11 +1,20 @@
+#include "task/task_batch.h"
 #include "task/task_manager.h"
 #include "task/task_semaphore.h"
 
 #include "base/defer.h"
 #include "base/log.h"
+#include "os/utils.h"
 
 #include "gtest/gtest.h"
 
+#include <atomic>
+#include <cerrno>
+#include <thread>
+
+#include <sys/socket.h>
+#include <unistd.h>
+
 using namespace xynq;
 
 namespace {
@@ -39,7 +48,7 @@ struct Fib : public TaskDefaults {
                 tc->Exit(); // Exiting initial task.
             }
 
-            sem->Signal(); // Signaling parent this task is done.
+            sem->Signal(*tc); // Signaling parent this task is done.
         });
 
         if (seq_number <= 1) {
@@ -57,6 +66,386 @@ struct Fib : public TaskDefaults {
     };
 };
 
+// Sleeps and records how long it took.
+struct SleepTask : public TaskDefaults {
+    static constexpr auto exec = [](TaskContext *tc, uint64_t *slept_msec) {
+        uint64_t start = TaskContext::NowMsec();
+        tc->Sleep(20);
+        *slept_msec = TaskContext::NowMsec() - start;
+        tc->Exit();
+    };
+};
+
+// Counts ticks of periodic task.
+struct TickTask : public TaskDefaults {
+    static constexpr auto exec = [](TaskContext *, std::atomic<int> *ticks) {
+        ticks->fetch_add(1);
+    };
+};
+
+struct PeriodicTest : public TaskDefaults {
+    static constexpr auto exec = [](TaskContext *tc, std::atomic<int> *ticks) {
+        PeriodicTaskHandle handle = tc->PerformPeriodic<TickTask>(5, ticks);
+        while (ticks->load() < 3) {
+            tc->Sleep(1);
+        }
+        tc->CancelPeriodic(handle);
+        tc->Exit();
+    };
+};
+
+// Waits on a socket nobody writes to.
+struct EventTimeoutTest : public TaskDefaults {
+    static constexpr auto exec = [](TaskContext *tc, int sock, bool *received) {
+        EventSource source{sock};
+        *received = tc->WaitEvent(&source, EventFlags::Read | EventFlags::ExactlyOnce, TaskContext::NowMsec() + 10);
+        tc->Exit();
+    };
+};
+
+static constexpr int kNumEdgeWrites = 2000;
+
+// Reads first and only waits for an edge if there is nothing to read.
+// Yields between reads, so some edges come while the reader is not waiting.
+struct EdgeReader : public TaskDefaults {
+    static constexpr auto exec = [](TaskContext *tc, int sock, int *num_received) {
+        EventSource source{sock};
+        while (*num_received < kNumEdgeWrites) {
+            char buf[16];
+            ssize_t received = recv(sock, buf, sizeof(buf), MSG_DONTWAIT);
+            if (received > 0) {
+                *num_received += static_cast<int>(received);
+                tc->Yield();
+            } else if (received < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                tc->WaitEvent(&source, EventFlags::Read | EventFlags::EdgeTriggered);
+            } else {
+                break;
+            }
+        }
+
+        tc->EventQueue()->RemoveEvent(tc->ThreadIndex(), source);
+        tc->Exit();
+    };
+};
+
+struct EdgeWriter : public TaskDefaults {
+    static constexpr auto exec = [](TaskContext *tc, int sock) {
+        char byte = 0;
+        for (int i = 0; i < kNumEdgeWrites; ++i) {
+            XYAssert(write(sock, &byte, 1) == 1);
+            if (i % 3 == 0) {
+                tc->Yield();
+            }
+        }
+    };
+};
+
+// Receives with multishot request. Yields between completions, so some of them come while
+// the reader is busy. Buffers are given back at once, request is submitted again only if kernel
+// ran out of them.
+struct MultishotReader : public TaskDefaults {
+    static constexpr auto exec = [](TaskContext *tc, int sock, int *num_received, int *num_completions, int *num_submissions) {
+        EventMultishotRequest request{EventMultishotRequest::Op::Recv, sock};
+        EventMultishotRequest::Completion completion;
+        while (*num_received < kNumEdgeWrites) {
+            if (!request.Take(completion)) {
+                *num_submissions += request.IsArmed() ? 0 : 1;
+                tc->WaitMultishot(request);
+                continue;
+            }
+
+            if (completion.result == -ENOBUFS) {
+                continue;
+            }
+            if (completion.result <= 0) {
+                break;
+            }
+            *num_received += completion.result;
+            *num_completions += 1;
+            tc->EventQueue()->ReleaseRecvBuffer(request, completion.buffer);
+            tc->Yield();
+        }
+
+        // Completions are taken until the last one: waits return right away while there are any.
+        tc->CancelMultishot(request);
+        while (true) {
+            while (request.Take(completion)) {
+                if (completion.buffer != EventMultishotRequest::kNoBuffer) {
+                    tc->EventQueue()->ReleaseRecvBuffer(request, completion.buffer);
+                }
+            }
+            if (!request.IsArmed()) {
+                break;
+            }
+            tc->WaitMultishot(request);
+        }
+        tc->Exit();
+    };
+};
+
+// Records the order tasks were run in.
+struct OrderData {
+    int order[64] = {};
+    int num_run = 0;
+    int num_expected = 0;
+};
+
+struct OrderTask : public TaskDefaults {
+    static constexpr auto exec = [](TaskContext *tc, OrderData *data, int id) {
+        data->order[data->num_run++] = id;
+        if (data->num_run == data->num_expected) {
+            tc->Exit();
+        }
+    };
+};
+
+struct BulkOrderTask : public OrderTask {
+    static constexpr TaskPriority priority = TaskPriority::Bulk;
+};
+
+struct RealtimeOrderTask : public OrderTask {
+    static constexpr TaskPriority priority = TaskPriority::Realtime;
+};
+
+struct ScheduleTest : public TaskDefaults {
+    static constexpr auto exec = [](TaskContext *tc, OrderData *data) {
+        uint64_t now = TaskContext::NowMsec();
+        data->num_expected = 5;
+        tc->PerformAsync<BulkOrderTask>(data, 0);
+        tc->PerformAsync<OrderTask>(data, 1);
+        tc->PerformScheduled<OrderTask>(TaskSchedule{TaskPriority::Bulk, now + 2000}, data, 2);
+        tc->PerformScheduled<OrderTask>(TaskSchedule{TaskPriority::Interactive, now + 1000}, data, 3);
+        tc->PerformAsync<RealtimeOrderTask>(data, 4);
+    };
+};
+
+// Pinned tasks are run by class as well, in the order they were queued.
+struct PinnedScheduleTest : public TaskDefaults {
+    static constexpr auto exec = [](TaskContext *tc, OrderData *data) {
+        data->num_expected = 6;
+        TaskBatch batch;
+        batch.AddPinned<BulkOrderTask>(0, data, 0);
+        batch.AddPinned<OrderTask>(0, data, 1);
+        batch.AddPinned<OrderTask>(0, data, 2);
+        batch.AddPinned<RealtimeOrderTask>(0, data, 3);
+        tc->PerformAsyncBatch(batch);
+        tc->PerformScheduled<OrderTask>(TaskSchedule{TaskPriority::Interactive, TaskContext::NowMsec() + 1000}, data, 4);
+        tc->PerformAsync<OrderTask>(data, 5);
+    };
+};
+
+// Bulk task must not wait for all interactive tasks.
+struct StarvationTest : public TaskDefaults {
+    static constexpr auto exec = [](TaskContext *tc, OrderData *data) {
+        data->num_expected = 64;
+        tc->PerformAsync<BulkOrderTask>(data, 0);
+        for (int i = 1; i < 64; ++i) {
+            tc->PerformAsync<OrderTask>(data, i);
+        }
+    };
+};
+
+struct BulkStreamData {
+    static constexpr int kMaxLinks = 10000;
+
+    bool first_run = false;
+    int num_links = 0;
+};
+
+struct BulkStreamChild : public TaskDefaults {
+    static constexpr TaskPriority priority = TaskPriority::Bulk;
+    static constexpr auto exec = [](TaskContext *, BulkStreamData *data, bool first) {
+        if (first) {
+            data->first_run = true;
+        }
+    };
+};
+
+// Interactive chain that queues new bulk work with every link.
+struct BulkStreamLink : public TaskDefaults {
+    static constexpr auto exec = [](TaskContext *tc, BulkStreamData *data) {
+        tc->PerformAsync<BulkStreamChild>(data, false);
+        if (data->first_run || ++data->num_links == BulkStreamData::kMaxLinks) {
+            tc->Exit();
+            return;
+        }
+        tc->PerformAsync<BulkStreamLink>(data);
+    };
+};
+
+// First bulk task must not wait behind the bulk tasks queued after it.
+struct BulkStreamTest : public TaskDefaults {
+    static constexpr auto exec = [](TaskContext *tc, BulkStreamData *data) {
+        tc->PerformAsync<BulkStreamChild>(data, true);
+        tc->PerformAsync<BulkStreamLink>(data);
+    };
+};
+
+struct YieldData {
+    static constexpr int kMaxLinks = 1000000;
+
+    std::atomic<bool> resumed{false};
+    std::atomic<int> num_links{0};
+};
+
+// Keeps its worker busy: queues the next link pinned to the same worker.
+struct YieldLink : public TaskDefaults {
+    static constexpr auto exec = [](TaskContext *tc, YieldData *data) {
+        if (data->resumed.load() || data->num_links.fetch_add(1) + 1 == YieldData::kMaxLinks) {
+            tc->Exit();
+            return;
+        }
+
+        TaskBatch batch;
+        batch.AddPinned<YieldLink>(tc->ThreadIndex(), data);
+        tc->PerformAsyncBatch(batch);
+    };
+};
+
+// Yields on a worker that never runs out of its own tasks. Other worker has to pick it up.
+struct YieldTest : public TaskDefaults {
+    static constexpr auto exec = [](TaskContext *tc, YieldData *data) {
+        TaskBatch batch;
+        batch.AddPinned<YieldLink>(tc->ThreadIndex(), data);
+        tc->PerformAsyncBatch(batch);
+        tc->Yield();
+        data->resumed = true;
+    };
+};
+
+// Recurses until the stack overflows.
+struct OverflowTask : public TaskDefaults {
+    static constexpr auto debug_name = "OverflowTask";
+
+    static int Recurse(int depth) {
+        volatile char buf[512];
+        buf[0] = char(depth);
+        return depth > 1000000 ? buf[0] : Recurse(depth + 1) + buf[0];
+    }
+
+    static constexpr auto exec = [](TaskContext *tc, int *result) {
+        *result = Recurse(0);
+        tc->Exit();
+    };
+};
+
+struct PinnedData {
+    static constexpr int kNumThreads = 4;
+    std::atomic<int> misplaced{0};
+    std::atomic<int> running{kNumThreads};
+};
+
+// Checks that the task always runs on its worker.
+struct PinnedTask : public TaskDefaults {
+    static constexpr auto exec = [](TaskContext *tc, size_t thread_index, PinnedData *data) {
+        for (int i = 0; i < 20; ++i) {
+            if (tc->ThreadIndex() != thread_index) {
+                data->misplaced.fetch_add(1);
+            }
+
+            if (i % 2 == 0) {
+                tc->Yield();
+            } else {
+                tc->Sleep(1);
+            }
+        }
+
+        if (data->running.fetch_sub(1) == 1) {
+            tc->Exit();
+        }
+    };
+};
+
+// Spreads PinnedTask over workers with a single batch.
+struct PinnedBatchSpawner : public TaskDefaults {
+    static constexpr auto exec = [](TaskContext *tc, PinnedData *data) {
+        TaskBatch batch;
+        for (size_t thread_index = 0; thread_index < PinnedData::kNumThreads; ++thread_index) {
+            batch.AddPinned<PinnedTask>(thread_index, thread_index, data);
+        }
+        tc->PerformAsyncBatch(batch);
+    };
+};
+
+struct IoThreadData {
+    int socks[2] = {-1, -1};
+    std::atomic<int> misplaced{0};
+    std::atomic<int> running{2};
+};
+
+// Bounces a byte over the socket pair. Never runs on the io worker.
+struct IoThreadEcho : public TaskDefaults {
+    static constexpr auto exec = [](TaskContext *tc, IoThreadData *data, int sock, bool first) {
+        EventSource source{sock};
+        char byte = 0;
+        for (int i = 0; i < 50; ++i) {
+            if (first) {
+                ASSERT_EQ(write(sock, &byte, 1), 1);
+            }
+            tc->WaitEvent(&source, EventFlags::Read | EventFlags::ExactlyOnce);
+            ASSERT_EQ(read(sock, &byte, 1), 1);
+            if (!first) {
+                ASSERT_EQ(write(sock, &byte, 1), 1);
+            }
+
+            if (tc->ThreadIndex() == 0) {
+                data->misplaced.fetch_add(1);
+            }
+        }
+
+        if (data->running.fetch_sub(1) == 1) {
+            tc->Exit();
+        }
+    };
+};
+
+// Pinned to the io worker, like socket accepts.
+struct IoThreadSpawner : public TaskDefaults {
+    static constexpr auto exec = [](TaskContext *tc, IoThreadData *data) {
+        if (tc->ThreadIndex() != 0) {
+            data->misplaced.fetch_add(1);
+        }
+        tc->PerformAsync<IoThreadEcho>(data, data->socks[0], true);
+        tc->PerformAsync<IoThreadEcho>(data, data->socks[1], false);
+    };
+};
+
+struct BatchData {
+    static constexpr unsigned kNumTasks = 10000;
+
+    TaskLatch done{kNumTasks};
+    std::atomic<unsigned> sum{0};
+};
+
+struct BatchChild : public TaskDefaults {
+    static constexpr auto exec = [](TaskContext *tc, BatchData *data, unsigned value) {
+        data->sum.fetch_add(value);
+        data->done.CountDown(*tc);
+    };
+};
+
+struct BatchTest : public TaskDefaults {
+    static constexpr auto exec = [](TaskContext *tc, BatchData *data) {
+        TaskBatch batch;
+        batch.Reserve(BatchData::kNumTasks);
+        for (unsigned i = 0; i < BatchData::kNumTasks; ++i) {
+            // Mix in other classes and deadlines to split the batch.
+            if (i % 1000 == 0) {
+                batch.AddScheduled<BatchChild>(TaskSchedule{TaskPriority::Bulk, TaskContext::NowMsec() + i}, data, i);
+            } else if (i % 100 == 0) {
+                batch.AddScheduled<BatchChild>(TaskSchedule{TaskPriority::Realtime}, data, i);
+            } else {
+                batch.Add<BatchChild>(data, i);
+            }
+        }
+        tc->PerformAsyncBatch(batch);
+        EXPECT_TRUE(batch.IsEmpty());
+
+        data->done.Wait(*tc);
+        tc->Exit();
+    };
+};
+
 } // anon namespace
 
 
@@ -81,6 +470,311 @@ TEST(Task, Fib) {
     ASSERT_EQ(test_data.int_val, 55);
 }
 
+TEST(Task, FibManyThreads) {
+    Dependable<Log> log{std::move(Log::Create(LogLevel::None, 0, {}).Right())};
+    TaskManager task_manager(log, 10, 8, false, true);
+
+    TestData test_data;
+    task_manager.AddEntryPoint<Fib>(&test_data, 16, nullptr);
+    task_manager.Run();
+    ASSERT_EQ(test_data.int_val, 987);
+}
+
+TEST(Task, FibIoUring) {
+    Dependable<Log> log{std::move(Log::Create(LogLevel::None, 0, {}).Right())};
+    TaskManager task_manager(log, 10, 4, false, true, EventBackend::IoUring);
+
+    TestData test_data;
+    task_manager.AddEntryPoint<Fib>(&test_data, 12, nullptr);
+    task_manager.Run();
+    ASSERT_EQ(test_data.int_val, 144);
+}
+
+TEST(Task, Sleep) {
+    Dependable<Log> log{std::move(Log::Create(LogLevel::None, 0, {}).Right())};
+    TaskManager task_manager(log, 10, 2, false, true);
+
+    uint64_t slept_msec = 0;
+    task_manager.AddEntryPoint<SleepTask>(&slept_msec);
+    task_manager.Run();
+    ASSERT_GE(slept_msec, 20u);
+}
+
+TEST(Task, Periodic) {
+    Dependable<Log> log{std::move(Log::Create(LogLevel::None, 0, {}).Right())};
+    TaskManager task_manager(log, 10, 2, false, true);
+
+    std::atomic<int> ticks{0};
+    task_manager.AddEntryPoint<PeriodicTest>(&ticks);
+    task_manager.Run();
+    ASSERT_GE(ticks.load(), 3);
+}
+
+TEST(Task, WaitEventTimeout) {
+    int socks[2];
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, socks), 0);
+    Defer close_socks([&] {
+        close(socks[0]);
+        close(socks[1]);
+    });
+
+    for (EventBackend backend : {EventBackend::Epoll, EventBackend::IoUring}) {
+        Dependable<Log> log{std::move(Log::Create(LogLevel::None, 0, {}).Right())};
+        TaskManager task_manager(log, 10, 2, false, true, backend);
+
+        bool received = true;
+        task_manager.AddEntryPoint<EventTimeoutTest>(socks[0], &received);
+        task_manager.Run();
+        ASSERT_FALSE(received);
+    }
+}
+
+TEST(Task, EdgeTriggeredWait) {
+    int socks[2];
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, socks), 0);
+    Defer close_socks([&] {
+        close(socks[0]);
+        close(socks[1]);
+    });
+
+    Dependable<Log> log{std::move(Log::Create(LogLevel::None, 0, {}).Right())};
+    TaskManager task_manager(log, 10, 2, false, true);
+
+    int num_received = 0;
+    task_manager.AddEntryPoint<EdgeReader>(socks[0], &num_received);
+    task_manager.AddEntryPoint<EdgeWriter>(socks[1]);
+    task_manager.Run();
+
+    // No edge is lost: reader would never finish otherwise.
+    ASSERT_EQ(num_received, kNumEdgeWrites);
+}
+
+TEST(Task, MultishotWait) {
+    int socks[2];
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, socks), 0);
+    Defer close_socks([&] {
+        close(socks[0]);
+        close(socks[1]);
+    });
+
+    Dependable<Log> log{std::move(Log::Create(LogLevel::None, 0, {}).Right())};
+    if (!EventQueue{log, EventBackend::IoUring, 1, 1}.SupportsRecvBuffers()) {
+        GTEST_SKIP();
+    }
+    TaskManager task_manager(log, 10, 2, false, true, EventBackend::IoUring);
+
+    // Writer is not a task: blocking write would stall the ring owned by its worker,
+    // and reader's request could be the one submitted there.
+    std::thread writer([&] {
+        char byte = 0;
+        for (int i = 0; i < kNumEdgeWrites; ++i) {
+            XYAssert(write(socks[1], &byte, 1) == 1);
+            if (i % 3 == 0) {
+                std::this_thread::yield();
+            }
+        }
+    });
+
+    int num_received = 0;
+    int num_completions = 0;
+    int num_submissions = 0;
+    task_manager.AddEntryPoint<MultishotReader>(socks[0], &num_received, &num_completions, &num_submissions);
+    task_manager.Run();
+    writer.join();
+
+    // No completion is lost: reader would never finish otherwise.
+    ASSERT_EQ(num_received, kNumEdgeWrites);
+    ASSERT_GE(num_submissions, 1);
+    ASSERT_LT(num_submissions, num_completions);
+}
+
+TEST(Task, Schedule) {
+    Dependable<Log> log{std::move(Log::Create(LogLevel::None, 0, {}).Right())};
+    TaskManager task_manager(log, 10, 1, false, true);
+
+    OrderData data;
+    task_manager.AddEntryPoint<ScheduleTest>(&data);
+    task_manager.Run();
+
+    // Realtime, deadline ones by deadline, interactive, bulk.
+    int expected[] = {4, 3, 2, 1, 0};
+    ASSERT_EQ(data.num_run, 5);
+    for (int i = 0; i < 5; ++i) {
+        ASSERT_EQ(data.order[i], expected[i]);
+    }
+}
+
+TEST(Task, PinnedSchedule) {
+    Dependable<Log> log{std::move(Log::Create(LogLevel::None, 0, {}).Right())};
+    TaskManager task_manager(log, 10, 1, false, true);
+
+    OrderData data;
+    task_manager.AddEntryPoint<PinnedScheduleTest>(&data);
+    task_manager.Run();
+
+    // Realtime, deadline, interactive ones with pinned first and bulk.
+    int expected[] = {3, 4, 1, 2, 5, 0};
+    ASSERT_EQ(data.num_run, 6);
+    for (int i = 0; i < 6; ++i) {
+        ASSERT_EQ(data.order[i], expected[i]);
+    }
+}
+
+TEST(Task, BulkStarvation) {
+    Dependable<Log> log{std::move(Log::Create(LogLevel::None, 0, {}).Right())};
+    TaskManager task_manager(log, 10, 1, false, true);
+
+    OrderData data;
+    task_manager.AddEntryPoint<StarvationTest>(&data);
+    task_manager.Run();
+
+    ASSERT_EQ(data.num_run, 64);
+    int bulk_position = 0;
+    while (data.order[bulk_position] != 0) {
+        ++bulk_position;
+    }
+    ASSERT_LT(bulk_position, 32);
+}
+
+TEST(Task, ContinuousBulkStarvation) {
+    Dependable<Log> log{std::move(Log::Create(LogLevel::None, 0, {}).Right())};
+    TaskManager task_manager(log, 10, 1, false, true);
+
+    BulkStreamData data;
+    task_manager.AddEntryPoint<BulkStreamTest>(&data);
+    task_manager.Run();
+
+    ASSERT_TRUE(data.first_run);
+    ASSERT_LT(data.num_links, 64);
+}
+
+TEST(Task, YieldOnBusyWorker) {
+    Dependable<Log> log{std::move(Log::Create(LogLevel::None, 0, {}).Right())};
+    TaskManager task_manager(log, 10, 2, false, true);
+
+    YieldData data;
+    task_manager.AddEntryPoint<YieldTest>(&data);
+    task_manager.Run();
+
+    ASSERT_TRUE(data.resumed.load());
+    ASSERT_LT(data.num_links.load(), YieldData::kMaxLinks);
+}
+
+TEST(Task, Batch) {
+    Dependable<Log> log{std::move(Log::Create(LogLevel::None, 0, {}).Right())};
+    TaskManager task_manager(log, 10, 4, false, true);
+
+    BatchData data;
+    task_manager.AddEntryPoint<BatchTest>(&data);
+    task_manager.Run();
+    ASSERT_EQ(data.sum.load(), BatchData::kNumTasks * (BatchData::kNumTasks - 1) / 2);
+}
+
+TEST(Task, PinnedEntryPoints) {
+    Dependable<Log> log{std::move(Log::Create(LogLevel::None, 0, {}).Right())};
+    TaskManager task_manager(log, 10, PinnedData::kNumThreads, false, true);
+
+    PinnedData data;
+    for (size_t i = 0; i < PinnedData::kNumThreads; ++i) {
+        task_manager.AddPinnedEntryPoint<PinnedTask>(i, i, &data);
+    }
+    task_manager.Run();
+    ASSERT_EQ(data.running.load(), 0);
+    ASSERT_EQ(data.misplaced.load(), 0);
+}
+
+TEST(Task, PinnedBatch) {
+    Dependable<Log> log{std::move(Log::Create(LogLevel::None, 0, {}).Right())};
+    TaskManager task_manager(log, 10, PinnedData::kNumThreads, false, true);
+
+    PinnedData data;
+    task_manager.AddEntryPoint<PinnedBatchSpawner>(&data);
+    task_manager.Run();
+    ASSERT_EQ(data.running.load(), 0);
+    ASSERT_EQ(data.misplaced.load(), 0);
+}
+
+TEST(Task, IoThreads) {
+    for (EventBackend backend : {EventBackend::Epoll, EventBackend::IoUring}) {
+        IoThreadData data;
+        ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, data.socks), 0);
+        Defer close_socks([&] {
+            close(data.socks[0]);
+            close(data.socks[1]);
+        });
+
+        Dependable<Log> log{std::move(Log::Create(LogLevel::None, 0, {}).Right())};
+        TaskManager task_manager(log, 10, 3, false, true, backend, false, 0, 1);
+        ASSERT_EQ(task_manager.NumIoThreads(), 1u);
+
+        task_manager.AddPinnedEntryPoint<IoThreadSpawner>(0, &data);
+        task_manager.Run();
+        ASSERT_EQ(data.running.load(), 0);
+        ASSERT_EQ(data.misplaced.load(), 0);
+    }
+}
+
+TEST(Task, Stats) {
+    Dependable<Log> log{std::move(Log::Create(LogLevel::None, 0, {}).Right())};
+    TaskManager task_manager(log, 10, 4, false, true);
+
+    TestData test_data;
+    task_manager.AddEntryPoint<Fib>(&test_data, 10, nullptr);
+    task_manager.Run();
+    ASSERT_EQ(test_data.int_val, 55);
+
+    TaskStats stats = task_manager.Stats();
+#if defined(XYNQ_TASK_STATS)
+    // 177 calls of Fib to get 10th number.
+    ASSERT_GE(stats.tasks_created, 177u);
+    ASSERT_GE(stats.tasks_executed, 177u);
+    ASSERT_GT(stats.tasks_resumed, 0u);
+    ASSERT_GE(stats.steals_attempted, stats.steals_succeeded);
+    ASSERT_GT(stats.max_queue_depth, 0u);
+
+    TaskStats sum;
+    for (size_t i = 0; i < task_manager.NumThreads(); ++i) {
+        sum.Merge(task_manager.WorkerStats(i));
+    }
+    ASSERT_EQ(sum.tasks_executed, stats.tasks_executed);
+#else
+    ASSERT_EQ(stats.tasks_created, 0u);
+#endif
+}
+
+TEST(Task, SpinBeforePark) {
+    Dependable<Log> log{std::move(Log::Create(LogLevel::None, 0, {}).Right())};
+    TaskManager task_manager(log, 10, 4, false, true, EventBackend::Epoll, false, 200);
+
+    TestData test_data;
+    task_manager.AddEntryPoint<Fib>(&test_data, 15, nullptr);
+    task_manager.Run();
+    ASSERT_EQ(test_data.int_val, 610);
+
+#if defined(XYNQ_TASK_STATS)
+    TaskStats stats = task_manager.Stats();
+    if (platform::NumCores() >= task_manager.NumThreads()) {
+        // Workers without entry points start idle and spin first.
+        ASSERT_GT(stats.spins, 0u);
+        ASSERT_GE(stats.spins, stats.spin_hits);
+    } else {
+        ASSERT_EQ(stats.spins, 0u);
+    }
+#endif
+}
+
+TEST(Task, StackOverflowDeath) {
+    ::testing::FLAGS_gtest_death_test_style = "threadsafe";
+    ASSERT_DEATH({
+        Dependable<Log> log{std::move(Log::Create(LogLevel::None, 0, {}).Right())};
+        TaskManager task_manager(log, 10, 1, false, true);
+
+        int result = 0;
+        task_manager.AddEntryPoint<OverflowTask>(&result);
+        task_manager.Run();
+    }, "Stack overflow in task 'OverflowTask'");
+}
+
 TEST(Task, UserData) {
     Dependable<Log> log{std::move(Log::Create(LogLevel::None, 0, {}).Right())};
     TaskManager task_manager(log, 10, 2, false, true);
@@ -0,0 +1,158 @@
+#include "task/task_arg_pool.h"
+#include "task/task_batch.h"
+#include "task/task_manager.h"
+
+#include "base/defer.h"
+#include "base/log.h"
+
+#include "gtest/gtest.h"
+
+#include <atomic>
+#include <cstring>
+
+using namespace xynq;
+using namespace xynq::detail;
+
+namespace {
+
+static constexpr size_t kPayloadSize = 512;
+static constexpr int kNumPayloadTasks = 1000;
+
+// Does not fit into kTaskMaxArgsSize, so task arguments are spilled.
+struct Payload {
+    unsigned char bytes[kPayloadSize];
+
+    static std::atomic<int> num_alive;
+
+    explicit Payload(unsigned char value) {
+        memset(bytes, value, sizeof(bytes));
+        ++num_alive;
+    }
+
+    Payload(const Payload &other) {
+        memcpy(bytes, other.bytes, sizeof(bytes));
+        ++num_alive;
+    }
+
+    ~Payload() {
+        --num_alive;
+    }
+
+    bool Check(unsigned char value) const {
+        for (unsigned char byte : bytes) {
+            if (byte != value) {
+                return false;
+            }
+        }
+        return true;
+    }
+};
+
+std::atomic<int> Payload::num_alive{0};
+
+struct PayloadCheck : public TaskDefaults {
+    static constexpr auto exec = [](TaskContext *tc, const Payload &payload, unsigned char value, std::atomic<int> *num_valid) {
+        tc->Yield(); // Might be resumed on another worker.
+        if (payload.Check(value)) {
+            ++*num_valid;
+        }
+    };
+};
+
+struct PayloadSpawner : public TaskDefaults {
+    static constexpr auto exec = [](TaskContext *tc, std::atomic<int> *num_valid) {
+        for (int i = 0; i < kNumPayloadTasks; ++i) {
+            tc->PerformAsync<PayloadCheck>(Payload{(unsigned char)i}, (unsigned char)i, num_valid);
+        }
+
+        while (num_valid->load() < kNumPayloadTasks) {
+            tc->Yield();
+        }
+        tc->Exit();
+    };
+};
+
+} // anon namespace
+
+TEST(TaskArgPool, Reuse) {
+    TaskArgPool pool{4};
+
+    void *block = pool.Acquire(200);
+    ASSERT_EQ((uintptr_t)block % TaskArgPool::kAlignment, 0u);
+    pool.Release(block);
+    ASSERT_EQ(pool.NumFree(), 1u);
+
+    // Same class -> same block.
+    ASSERT_EQ(pool.Acquire(256), block);
+
+    // Different class -> new block.
+    void *big_block = pool.Acquire(1000);
+    ASSERT_NE(big_block, block);
+
+    // Not pooled.
+    void *huge_block = pool.Acquire(64 * 1024);
+    pool.Release(huge_block);
+    ASSERT_EQ(pool.NumFree(), 0u);
+
+    pool.Release(block);
+    pool.Release(big_block);
+    ASSERT_EQ(pool.NumFree(), 2u);
+}
+
+TEST(TaskArgPool, CacheLimit) {
+    TaskArgPool pool{1};
+
+    void *first = pool.Acquire(300);
+    void *second = pool.Acquire(300);
+    pool.Release(first);
+    pool.Release(second); // Above limit - freed.
+
+    ASSERT_EQ(pool.NumFree(), 1u);
+    ASSERT_EQ(pool.Acquire(300), first);
+    pool.Release(first);
+}
+
+TEST(TaskArgPool, SpilledArguments) {
+    static_assert(!kTaskArgsFitInline<Payload>, "Payload must be spilled");
+
+    Dependable<Log> log{std::move(Log::Create(LogLevel::None, 0, {}).Right())};
+    std::atomic<int> num_valid{0};
+    {
+        TaskManager task_manager(log, 10, 4, false, true);
+        task_manager.AddEntryPoint<PayloadSpawner>(&num_valid);
+        task_manager.Run();
+    }
+
+    ASSERT_EQ(num_valid.load(), kNumPayloadTasks);
+    ASSERT_EQ(Payload::num_alive.load(), 0); // Every spilled tuple is destroyed.
+}
+
+TEST(TaskArgPool, DroppedBatch) {
+    TaskArgPool pool{4};
+    TaskArgPool::SetCurrent(&pool);
+    Defer reset_pool([] {
+        TaskArgPool::SetCurrent(nullptr);
+    });
+
+    int num_alive = Payload::num_alive.load();
+    std::atomic<int> num_valid{0};
+    {
+        TaskBatch batch;
+        batch.Add<PayloadCheck>(Payload{1}, (unsigned char)1, &num_valid);
+        batch.Add<PayloadCheck>(Payload{2}, (unsigned char)2, &num_valid);
+        ASSERT_EQ(Payload::num_alive.load(), num_alive + 2);
+
+        // Cleared batch gives spilled arguments back and is reusable.
+        batch.Clear();
+        ASSERT_EQ(Payload::num_alive.load(), num_alive);
+        ASSERT_EQ(pool.NumFree(), 2u);
+
+        batch.Add<PayloadCheck>(Payload{3}, (unsigned char)3, &num_valid);
+        ASSERT_EQ(pool.NumFree(), 1u);
+    }
+
+    // Batch that was never submitted releases them too.
+    ASSERT_EQ(Payload::num_alive.load(), num_alive);
+    ASSERT_EQ(pool.NumFree(), 2u);
+    ASSERT_EQ(num_valid.load(), 0);
+}
@@ -0,0 +1,110 @@
+#include "task/task_manager.h"
+
+#include "base/log.h"
+
+#include "gtest/gtest.h"
+
+#include <string>
+
+using namespace xynq;
+
+namespace {
+
+int FibStep(TaskContext *tc, int seq_number);
+
+// Calculates n-th fibonacci number with futures.
+struct FibFuture : public TaskDefaults {
+    static constexpr auto exec = [](TaskContext *tc, int seq_number) -> int {
+        return FibStep(tc, seq_number);
+    };
+};
+
+// Task type has to be complete to deduce its result type.
+int FibStep(TaskContext *tc, int seq_number) {
+    if (seq_number <= 1) {
+        return seq_number;
+    }
+
+    auto left = tc->PerformAsyncWithResult<FibFuture>(seq_number - 1);
+    auto right = tc->PerformAsyncWithResult<FibFuture>(seq_number - 2);
+    return left.Await(*tc) + right.Await(*tc);
+}
+
+struct FibTest : public TaskDefaults {
+    static constexpr auto exec = [](TaskContext *tc, int seq_number, int *result) {
+        auto fib = tc->PerformAsyncWithResult<FibFuture>(seq_number);
+        *result = fib.Await(*tc);
+        tc->Exit();
+    };
+};
+
+// Result bigger than task arguments.
+struct BigResult {
+    int values[64];
+};
+
+struct MakeBigResult : public TaskDefaults {
+    static constexpr auto exec = [](TaskContext *, int base) {
+        BigResult result;
+        for (int i = 0; i < 64; ++i) {
+            result.values[i] = base + i;
+        }
+        return result;
+    };
+};
+
+struct MakeString : public TaskDefaults {
+    static constexpr auto exec = [](TaskContext *, int length) {
+        return std::string(length, 'x');
+    };
+};
+
+struct SetFlag : public TaskDefaults {
+    static constexpr auto exec = [](TaskContext *, bool *flag) {
+        *flag = true;
+    };
+};
+
+struct ResultTypesTest : public TaskDefaults {
+    static constexpr auto exec = [](TaskContext *tc, bool *passed) {
+        auto big = tc->PerformAsyncWithResult<MakeBigResult>(100);
+        auto str = tc->PerformAsyncWithResult<MakeString>(200);
+        bool flag = false;
+        auto done = tc->PerformAsyncWithResult<SetFlag>(&flag);
+
+        // Let the tasks finish before awaiting.
+        while (!str.IsReady()) {
+            tc->Yield();
+        }
+
+        done.Await(*tc);
+        BigResult big_result = big.Await(*tc);
+        *passed = flag
+               && big_result.values[0] == 100
+               && big_result.values[63] == 163
+               && str.Await(*tc) == std::string(200, 'x');
+        tc->Exit();
+    };
+};
+
+} // anon namespace
+
+TEST(TaskFuture, Fib) {
+    Dependable<Log> log{std::move(Log::Create(LogLevel::None, 0, {}).Right())};
+    TaskManager task_manager(log, 10, 4, false, true);
+
+    int result = 0;
+    task_manager.AddEntryPoint<FibTest>(15, &result);
+    task_manager.Run();
+    ASSERT_EQ(result, 610);
+}
+
+TEST(TaskFuture, ResultTypes) {
+    Dependable<Log> log{std::move(Log::Create(LogLevel::None, 0, {}).Right())};
+    TaskManager task_manager(log, 10, 2, false, true);
+
+    bool passed = false;
+    task_manager.AddEntryPoint<ResultTypesTest>(&passed);
+    task_manager.Run();
+    ASSERT_TRUE(passed);
+}
@@ -0,0 +1,102 @@
+#include "task/task_manager.h"
+
+#include "base/log.h"
+
+#include "gtest/gtest.h"
+
+#include <atomic>
+#include <vector>
+
+using namespace xynq;
+
+namespace {
+
+struct FibData {
+    int result = 0;
+};
+
+// Calculates n-th fibonacci number forking both halves into a group.
+struct GroupFib : public TaskDefaults {
+    static constexpr auto exec = [](TaskContext *tc, FibData *data, int n) {
+        if (n <= 1) {
+            data->result = n;
+            return;
+        }
+
+        FibData left, right;
+        TaskGroup group;
+        group.Run<GroupFib>(*tc, &left, n - 1);
+        group.Run<GroupFib>(*tc, &right, n - 2);
+        group.Wait(*tc);
+        data->result = left.result + right.result;
+    };
+};
+
+struct GroupFibTest : public TaskDefaults {
+    static constexpr auto exec = [](TaskContext *tc, FibData *data, int n) {
+        GroupFib::exec(tc, data, n);
+        tc->Exit();
+    };
+};
+
+struct ParallelForData {
+    std::vector<std::atomic<int>> visited;
+    std::atomic<size_t> num_chunks{0};
+    size_t max_chunk = 0;
+
+    explicit ParallelForData(size_t size) : visited(size) {}
+};
+
+struct ParallelForTest : public TaskDefaults {
+    static constexpr auto exec = [](TaskContext *tc, ParallelForData *data, size_t grain) {
+        tc->ParallelFor(0, data->visited.size(), grain, [data, grain](TaskContext &, size_t begin, size_t end) {
+            EXPECT_LE(end - begin, grain);
+            for (size_t i = begin; i < end; ++i) {
+                data->visited[i].fetch_add(1);
+            }
+            data->num_chunks.fetch_add(1);
+        });
+        tc->Exit();
+    };
+};
+
+} // anon namespace
+
+
+TEST(TaskGroup, Fib) {
+    Dependable<Log> log{std::move(Log::Create(LogLevel::None, 0, {}).Right())};
+    TaskManager task_manager(log, 10, 4, false, true);
+
+    FibData data;
+    task_manager.AddEntryPoint<GroupFibTest>(&data, 16);
+    task_manager.Run();
+    ASSERT_EQ(data.result, 987);
+}
+
+TEST(TaskGroup, ParallelFor) {
+    Dependable<Log> log{std::move(Log::Create(LogLevel::None, 0, {}).Right())};
+    TaskManager task_manager(log, 10, 4, false, true);
+
+    ParallelForData data{100000};
+    task_manager.AddEntryPoint<ParallelForTest>(&data, size_t(1000));
+    task_manager.Run();
+
+    for (const std::atomic<int> &visited : data.visited) {
+        ASSERT_EQ(visited.load(), 1);
+    }
+    ASSERT_GE(data.num_chunks.load(), 100u);
+}
+
+TEST(TaskGroup, ParallelForSmallRange) {
+    Dependable<Log> log{std::move(Log::Create(LogLevel::None, 0, {}).Right())};
+    TaskManager task_manager(log, 10, 2, false, true);
+
+    ParallelForData data{7};
+    task_manager.AddEntryPoint<ParallelForTest>(&data, size_t(16));
+    task_manager.Run();
+
+    for (const std::atomic<int> &visited : data.visited) {
+        ASSERT_EQ(visited.load(), 1);
+    }
+    ASSERT_EQ(data.num_chunks.load(), 1u);
+}
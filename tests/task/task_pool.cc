@@ -0,0 +1,47 @@
+#include "task/task_pool.h"
+
+#include "gtest/gtest.h"
+
+using namespace xynq;
+
+TEST(TaskPool, StackSizeClasses) {
+    ASSERT_EQ(TaskPool::StackSizeForClass(1), kTaskMinStackSize);
+    ASSERT_EQ(TaskPool::StackSizeForClass(kTaskMinStackSize), kTaskMinStackSize);
+    ASSERT_EQ(TaskPool::StackSizeForClass(kTaskMinStackSize + 1), 2 * kTaskMinStackSize);
+    ASSERT_EQ(TaskPool::StackSizeForClass(kTaskMaxPooledStackSize), kTaskMaxPooledStackSize);
+    ASSERT_EQ(TaskPool::StackSizeForClass(kTaskMaxPooledStackSize + 1), kTaskMaxPooledStackSize + 4096);
+}
+
+TEST(TaskPool, Reuse) {
+    detail::WaitSlotTable wait_slots;
+    TaskPool pool{wait_slots, 4};
+
+    TaskPtr task = pool.Acquire(1024);
+    ASSERT_EQ(task->StackSize(), kTaskMinStackSize);
+    ASSERT_EQ(task->State(), TaskState::NotStarted);
+    pool.Release(task);
+
+    // Same class -> same task.
+    ASSERT_EQ(pool.Acquire(kTaskMinStackSize), task);
+
+    // Different class -> new task.
+    TaskPtr big_task = pool.Acquire(kTaskMinStackSize * 3);
+    ASSERT_NE(big_task, task);
+    ASSERT_EQ(big_task->StackSize(), kTaskMinStackSize * 4);
+
+    pool.Release(task);
+    pool.Release(big_task);
+}
+
+TEST(TaskPool, CacheLimit) {
+    detail::WaitSlotTable wait_slots;
+    TaskPool pool{wait_slots, 1};
+
+    TaskPtr first = pool.Acquire(1024);
+    TaskPtr second = pool.Acquire(1024);
+    pool.Release(first);
+    pool.Release(second); // Above limit - freed.
+
+    ASSERT_EQ(pool.Acquire(1024), first);
+    pool.Release(first);
+}
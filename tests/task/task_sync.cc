@@ -0,0 +1,198 @@
+#include "task/task_channel.h"
+#include "task/task_manager.h"
+#include "task/task_sync.h"
+
+#include "base/log.h"
+
+#include "gtest/gtest.h"
+
+#include <atomic>
+
+using namespace xynq;
+
+namespace {
+
+static constexpr int kNumTasks = 8;
+static constexpr int kNumIterations = 1000;
+
+struct MutexData {
+    TaskMutex mutex;
+    TaskLatch done{kNumTasks};
+    int counter = 0;
+};
+
+struct MutexWorker : public TaskDefaults {
+    static constexpr auto exec = [](TaskContext *tc, MutexData *data) {
+        for (int i = 0; i < kNumIterations; ++i) {
+            data->mutex.Lock(*tc);
+            int value = data->counter;
+            if (i % 64 == 0) {
+                tc->Yield(); // Let others pile up on the mutex.
+            }
+            data->counter = value + 1;
+            data->mutex.Unlock(*tc);
+        }
+        data->done.CountDown(*tc);
+    };
+};
+
+struct MutexTest : public TaskDefaults {
+    static constexpr auto exec = [](TaskContext *tc, MutexData *data) {
+        for (int i = 0; i < kNumTasks; ++i) {
+            tc->PerformAsync<MutexWorker>(data);
+        }
+        data->done.Wait(*tc);
+        tc->Exit();
+    };
+};
+
+struct CondVarData {
+    TaskMutex mutex;
+    TaskCondVar cond;
+    TaskLatch started{kNumTasks};
+    TaskLatch done{kNumTasks};
+    bool ready = false;
+    int woken = 0;
+};
+
+struct CondVarWorker : public TaskDefaults {
+    static constexpr auto exec = [](TaskContext *tc, CondVarData *data) {
+        data->mutex.Lock(*tc);
+        data->started.CountDown(*tc);
+        data->cond.Wait(*tc, data->mutex, [data] { return data->ready; });
+        data->woken++;
+        data->mutex.Unlock(*tc);
+        data->done.CountDown(*tc);
+    };
+};
+
+struct CondVarTest : public TaskDefaults {
+    static constexpr auto exec = [](TaskContext *tc, CondVarData *data) {
+        for (int i = 0; i < kNumTasks; ++i) {
+            tc->PerformAsync<CondVarWorker>(data);
+        }
+        data->started.Wait(*tc);
+
+        data->mutex.Lock(*tc);
+        data->ready = true;
+        data->mutex.Unlock(*tc);
+        data->cond.NotifyAll(*tc);
+
+        data->done.Wait(*tc);
+        tc->Exit();
+    };
+};
+
+struct LatchWorker : public TaskDefaults {
+    static constexpr auto exec = [](TaskContext *tc, TaskLatch *latch, std::atomic<int> *passed) {
+        latch->ArriveAndWait(*tc);
+        passed->fetch_add(1);
+    };
+};
+
+struct LatchTest : public TaskDefaults {
+    static constexpr auto exec = [](TaskContext *tc, std::atomic<int> *passed) {
+        TaskLatch latch{kNumTasks + 1};
+        for (int i = 0; i < kNumTasks; ++i) {
+            tc->PerformAsync<LatchWorker>(&latch, passed);
+        }
+        latch.ArriveAndWait(*tc);
+
+        // Workers might still be on the way out of the latch.
+        while (passed->load() < kNumTasks) {
+            tc->Yield();
+        }
+        tc->Exit();
+    };
+};
+
+struct ChannelData {
+    TaskChannel<int> channel{8};
+    TaskLatch producers_done{kNumTasks};
+    TaskLatch consumers_done{2};
+    std::atomic<int64_t> sum{0};
+    std::atomic<int> received{0};
+};
+
+struct Producer : public TaskDefaults {
+    static constexpr auto exec = [](TaskContext *tc, ChannelData *data) {
+        for (int i = 1; i <= kNumIterations; ++i) {
+            data->channel.Send(*tc, int{i});
+        }
+        data->producers_done.CountDown(*tc);
+    };
+};
+
+struct Consumer : public TaskDefaults {
+    static constexpr auto exec = [](TaskContext *tc, ChannelData *data) {
+        for (;;) {
+            Maybe<int> value = data->channel.Receive(*tc);
+            if (!value.HasValue()) {
+                break;
+            }
+            data->sum.fetch_add(value.Value());
+            data->received.fetch_add(1);
+        }
+        data->consumers_done.CountDown(*tc);
+    };
+};
+
+struct ChannelTest : public TaskDefaults {
+    static constexpr auto exec = [](TaskContext *tc, ChannelData *data) {
+        tc->PerformAsync<Consumer>(data);
+        tc->PerformAsync<Consumer>(data);
+        for (int i = 0; i < kNumTasks; ++i) {
+            tc->PerformAsync<Producer>(data);
+        }
+
+        data->producers_done.Wait(*tc);
+        data->channel.Close(*tc);
+        data->consumers_done.Wait(*tc);
+        tc->Exit();
+    };
+};
+
+} // anon namespace
+
+
+TEST(TaskSync, Mutex) {
+    Dependable<Log> log{std::move(Log::Create(LogLevel::None, 0, {}).Right())};
+    TaskManager task_manager(log, 10, 4, false, true);
+
+    MutexData data;
+    task_manager.AddEntryPoint<MutexTest>(&data);
+    task_manager.Run();
+    ASSERT_EQ(data.counter, kNumTasks * kNumIterations);
+}
+
+TEST(TaskSync, CondVar) {
+    Dependable<Log> log{std::move(Log::Create(LogLevel::None, 0, {}).Right())};
+    TaskManager task_manager(log, 10, 4, false, true);
+
+    CondVarData data;
+    task_manager.AddEntryPoint<CondVarTest>(&data);
+    task_manager.Run();
+    ASSERT_EQ(data.woken, kNumTasks);
+}
+
+TEST(TaskSync, Latch) {
+    Dependable<Log> log{std::move(Log::Create(LogLevel::None, 0, {}).Right())};
+    TaskManager task_manager(log, 10, 4, false, true);
+
+    std::atomic<int> passed{0};
+    task_manager.AddEntryPoint<LatchTest>(&passed);
+    task_manager.Run();
+    ASSERT_EQ(passed.load(), kNumTasks);
+}
+
+TEST(TaskSync, Channel) {
+    Dependable<Log> log{std::move(Log::Create(LogLevel::None, 0, {}).Right())};
+    TaskManager task_manager(log, 10, 4, false, true);
+
+    ChannelData data;
+    task_manager.AddEntryPoint<ChannelTest>(&data);
+    task_manager.Run();
+    ASSERT_EQ(data.received.load(), kNumTasks * kNumIterations);
+    ASSERT_EQ(data.sum.load(), int64_t(kNumTasks) * kNumIterations * (kNumIterations + 1) / 2);
+    ASSERT_EQ(data.channel.Size(), 0u);
+}
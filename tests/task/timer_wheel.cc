@@ -0,0 +1,111 @@
+#include "task/timer_wheel.h"
+
+#include "containers/vec.h"
+
+#include "gtest/gtest.h"
+
+#include <memory>
+
+using namespace xynq;
+
+namespace {
+
+// Advances wheel and collects expired nodes.
+Vec<TimerWheel::Node *> Advance(TimerWheel &wheel, uint64_t now) {
+    Vec<TimerWheel::Node *> expired;
+    wheel.Advance(now, [&](TimerWheel::Node *node) {
+        expired.push_back(node);
+    });
+    return expired;
+}
+
+} // anon namespace
+
+TEST(TimerWheel, ExpiresInOrder) {
+    TimerWheel wheel{1000};
+    TimerWheel::Node a, b, c;
+    wheel.Insert(&c, 1000 + 70000); // Level 2.
+    wheel.Insert(&b, 1000 + 300);   // Level 1.
+    wheel.Insert(&a, 1000 + 5);     // Level 0.
+    ASSERT_EQ(wheel.Size(), 3u);
+    ASSERT_EQ(wheel.TicksUntilNext(), 5);
+
+    ASSERT_TRUE(Advance(wheel, 1004).empty());
+    Vec<TimerWheel::Node *> expired_a = Advance(wheel, 1005);
+    ASSERT_EQ(expired_a.size(), 1u);
+    ASSERT_EQ(expired_a[0], &a);
+    ASSERT_FALSE(a.IsScheduled());
+
+    ASSERT_TRUE(Advance(wheel, 1299).empty());
+    Vec<TimerWheel::Node *> expired_b = Advance(wheel, 1300);
+    ASSERT_EQ(expired_b.size(), 1u);
+    ASSERT_EQ(expired_b[0], &b);
+
+    ASSERT_TRUE(Advance(wheel, 70999).empty());
+    Vec<TimerWheel::Node *> expired_c = Advance(wheel, 71000);
+    ASSERT_EQ(expired_c.size(), 1u);
+    ASSERT_EQ(expired_c[0], &c);
+    ASSERT_EQ(wheel.Size(), 0u);
+    ASSERT_EQ(wheel.TicksUntilNext(), -1);
+}
+
+TEST(TimerWheel, Remove) {
+    TimerWheel wheel{0};
+    TimerWheel::Node a, b;
+    wheel.Insert(&a, 10);
+    wheel.Insert(&b, 10);
+    wheel.Remove(&a);
+    wheel.Remove(&a); // Not scheduled anymore - no-op.
+
+    Vec<TimerWheel::Node *> expired = Advance(wheel, 100);
+    ASSERT_EQ(expired.size(), 1u);
+    ASSERT_EQ(expired[0], &b);
+}
+
+TEST(TimerWheel, PastDeadline) {
+    TimerWheel wheel{100};
+    TimerWheel::Node a;
+    wheel.Insert(&a, 50);
+    ASSERT_EQ(wheel.TicksUntilNext(), 1);
+    ASSERT_EQ(Advance(wheel, 101).size(), 1u);
+}
+
+TEST(TimerWheel, BeyondRange) {
+    TimerWheel wheel{0};
+    TimerWheel::Node a;
+    uint64_t deadline = (uint64_t(1) << 33) + 7;
+    wheel.Insert(&a, deadline);
+
+    // Jump closely to the deadline following TicksUntilNext like a worker would.
+    uint64_t now = 0;
+    size_t num_expired = 0;
+    while (num_expired == 0) {
+        int64_t ticks = wheel.TicksUntilNext();
+        ASSERT_GT(ticks, 0);
+        now += ticks;
+        ASSERT_LE(now, deadline);
+        num_expired = Advance(wheel, now).size();
+    }
+    ASSERT_EQ(now, deadline);
+}
+
+TEST(TimerWheel, ManyTimers) {
+    TimerWheel wheel{0};
+    const size_t num_nodes = 100000;
+    std::unique_ptr<TimerWheel::Node[]> nodes{new TimerWheel::Node[num_nodes]};
+    for (size_t i = 0; i < num_nodes; ++i) {
+        wheel.Insert(&nodes[i], (i * 7919) % 100000 + 1);
+    }
+
+    uint64_t last_deadline = 0;
+    size_t num_expired = 0;
+    for (uint64_t now = 1; now <= 100000; ++now) {
+        wheel.Advance(now, [&](TimerWheel::Node *node) {
+            ASSERT_EQ(node->Deadline(), now);
+            ASSERT_GE(node->Deadline(), last_deadline);
+            last_deadline = node->Deadline();
+            ++num_expired;
+        });
+    }
+    ASSERT_EQ(num_expired, num_nodes);
+}
@@ -0,0 +1,78 @@
+#include "task/task_pool.h"
+
+#include "gtest/gtest.h"
+
+using namespace xynq;
+using namespace xynq::detail;
+
+TEST(WaitSlot, EdgeRemembered) {
+    WaitSlotTable wait_slots;
+    TaskPool pool{wait_slots, 4};
+    TaskPtr task = pool.Acquire(1024);
+    WaitSlot &slot = task->WakeupSlot();
+    EventUserHandle edge = WaitSlotTable::Handle(slot, slot.Incarnation(), true);
+    ASSERT_EQ(reinterpret_cast<uintptr_t>(edge) & ~kEventUserHandleTagBit & 7, 0u);
+
+    // Edge that comes while the task is busy ends its next wait right away.
+    ASSERT_EQ(wait_slots.Wake(edge), nullptr);
+    ASSERT_TRUE(slot.StartEdgeWait(slot.ArmWakeup()));
+    slot.FinishEdgeWait();
+
+    // Task waits for the next one.
+    ASSERT_FALSE(slot.StartEdgeWait(slot.ArmWakeup()));
+    ASSERT_EQ(wait_slots.Wake(edge), task);
+    ASSERT_EQ(wait_slots.Wake(edge), nullptr);
+    slot.FinishEdgeWait();
+
+    pool.Release(task);
+}
+
+TEST(WaitSlot, ReleasedTaskIgnoresHandles) {
+    // Released task is either cached and reused or destroyed and its slot is reused.
+    for (size_t max_cached : {4, 0}) {
+        WaitSlotTable wait_slots;
+        TaskPool pool{wait_slots, max_cached};
+        TaskPtr task = pool.Acquire(1024);
+        WaitSlot &slot = task->WakeupSlot();
+        EventUserHandle edge = WaitSlotTable::Handle(slot, slot.Incarnation(), true);
+
+        // Woken up by the timeout, the event is still in flight when the task finishes.
+        uint32_t generation = slot.ArmWakeup();
+        EventUserHandle event = WaitSlotTable::Handle(slot, generation, false);
+        ASSERT_TRUE(slot.ClaimWakeup(generation));
+        pool.Release(task);
+
+        TaskPtr next = pool.Acquire(1024);
+        WaitSlot &next_slot = next->WakeupSlot();
+        ASSERT_EQ(next_slot.Index(), slot.Index());
+        ASSERT_FALSE(next_slot.StartEdgeWait(next_slot.ArmWakeup()));
+        ASSERT_EQ(wait_slots.Wake(edge), nullptr);
+        ASSERT_EQ(wait_slots.Wake(event), nullptr);
+
+        // Edge of the new task still wakes it up.
+        ASSERT_EQ(wait_slots.Wake(WaitSlotTable::Handle(next_slot, next_slot.Incarnation(), true)), next);
+        next_slot.FinishEdgeWait();
+        pool.Release(next);
+    }
+}
+
+TEST(WaitSlot, StaleWakeupOfPreviousWait) {
+    WaitSlotTable wait_slots;
+    TaskPool pool{wait_slots, 4};
+    TaskPtr task = pool.Acquire(1024);
+    WaitSlot &slot = task->WakeupSlot();
+
+    // Timer wins, the event is still in flight.
+    uint32_t generation = slot.ArmWakeup();
+    EventUserHandle event = WaitSlotTable::Handle(slot, generation, false);
+    ASSERT_TRUE(slot.ClaimWakeup(generation));
+
+    // Event of the previous wait must not end the next one.
+    uint32_t next_generation = slot.ArmWakeup();
+    ASSERT_NE(next_generation, generation);
+    ASSERT_EQ(wait_slots.Wake(event), nullptr);
+    ASSERT_FALSE(slot.ClaimWakeup(generation));
+    ASSERT_EQ(wait_slots.Wake(WaitSlotTable::Handle(slot, next_generation, false)), task);
+
+    pool.Release(task);
+}
@@ -0,0 +1,66 @@
+#include "task/worker_placement.h"
+
+#include "gtest/gtest.h"
+
+using namespace xynq;
+using namespace xynq::detail;
+
+namespace {
+
+Vec<platform::NumaNode> TwoNodes() {
+    Vec<platform::NumaNode> nodes;
+    nodes.resize(2);
+    nodes[0].id = 0;
+    nodes[0].cpus = {0, 1};
+    nodes[1].id = 1;
+    nodes[1].cpus = {2, 3};
+    return nodes;
+}
+
+} // anon namespace
+
+TEST(WorkerPlacement, Flat) {
+    Vec<WorkerPlacement> placements = PlaceWorkers(3, {}, false, false);
+    ASSERT_EQ(placements.size(), 3u);
+    for (const WorkerPlacement &placement : placements) {
+        ASSERT_EQ(placement.cpu, -1);
+        ASSERT_EQ(placement.numa_node, -1);
+        ASSERT_TRUE(placement.node_cpus.empty());
+    }
+
+    ASSERT_EQ(placements[0].victims, (Vec<size_t>{1, 2}));
+    ASSERT_EQ(placements[2].victims, (Vec<size_t>{0, 1}));
+}
+
+TEST(WorkerPlacement, NumaNodes) {
+    Vec<WorkerPlacement> placements = PlaceWorkers(4, TwoNodes(), true, true);
+    ASSERT_EQ(placements.size(), 4u);
+
+    for (int i = 0; i < 4; ++i) {
+        ASSERT_EQ(placements[i].cpu, i);
+        ASSERT_EQ(placements[i].numa_node, i / 2);
+    }
+
+    // Same node first, then ring order over the rest.
+    ASSERT_EQ(placements[0].victims, (Vec<size_t>{1, 2, 3}));
+    ASSERT_EQ(placements[1].victims, (Vec<size_t>{0, 2, 3}));
+    ASSERT_EQ(placements[2].victims, (Vec<size_t>{3, 0, 1}));
+    ASSERT_EQ(placements[3].victims, (Vec<size_t>{2, 0, 1}));
+}
+
+TEST(WorkerPlacement, NumaNodesUnpinned) {
+    Vec<WorkerPlacement> placements = PlaceWorkers(3, TwoNodes(), false, true);
+
+    ASSERT_EQ(placements[0].cpu, -1);
+    ASSERT_EQ(placements[2].numa_node, 1);
+    ASSERT_EQ(placements[2].node_cpus, (Vec<unsigned>{2, 3}));
+    ASSERT_EQ(placements[2].victims, (Vec<size_t>{0, 1}));
+}
+
+TEST(WorkerPlacement, Topology) {
+    Vec<platform::NumaNode> nodes = platform::NumaTopology();
+    ASSERT_FALSE(nodes.empty());
+    for (const platform::NumaNode &node : nodes) {
+        ASSERT_FALSE(node.cpus.empty());
+    }
+}